@@ -11,8 +11,11 @@
 #include <b2nd.h>
 #include "context.h"
 #include "b2nd_utils.h"
+#include "zonemap.h"
 #include "blosc2.h"
 #include "blosc2/blosc2-common.h"
+#include "blosc2/codecs-registry.h"
+#include "blosc-private.h"
 #include <inttypes.h>
 
 
@@ -265,8 +268,8 @@ int array_new(b2nd_context_t *ctx, int special_value, b2nd_array_t **array) {
     }
   }
 
-  // Fill schunk with uninit values
-  if ((*array)->nitems != 0) {
+  // Fill schunk with uninit values (BLOSC2_NO_SPECIAL leaves it without chunks)
+  if ((*array)->nitems != 0 && special_value != BLOSC2_NO_SPECIAL) {
     int32_t chunksize = (int32_t) (*array)->extchunknitems * sc->typesize;
     int64_t nchunks = (*array)->extnitems / (*array)->chunknitems;
     int64_t nitems = nchunks * (*array)->extchunknitems;
@@ -462,12 +465,231 @@ int b2nd_free(b2nd_array_t *array) {
 }
 
 
+/* Arguments for each thread that encodes chunks from a C-ordered buffer */
+typedef struct {
+  const b2nd_array_t *array;
+  blosc2_context *cctx;
+  uint8_t *data;
+  const uint8_t *buffer;
+  const int64_t *buffershape;
+  const int64_t *buffer_start;
+  int64_t nchunk_first;
+  int nchunks;
+  int tid;
+  int nthreads;
+  uint8_t **chunks;
+  zonemap_entry *entries;
+  int rc;
+} encode_thread_t;
+
+
+static void *encode_chunks_worker(void *arg) {
+  encode_thread_t *th = (encode_thread_t *) arg;
+  const b2nd_array_t *array = th->array;
+  int8_t ndim = array->ndim;
+  uint8_t typesize = (uint8_t) array->sc->typesize;
+  int32_t data_nbytes = (int32_t) array->extchunknitems * typesize;
+  int32_t nblocks = (int32_t) (array->extchunknitems / array->blocknitems);
+
+  int64_t chunks_in_array[B2ND_MAX_DIM] = {0};
+  int64_t blocks_in_chunk[B2ND_MAX_DIM] = {0};
+  for (int i = 0; i < ndim; ++i) {
+    chunks_in_array[i] = array->extshape[i] / array->chunkshape[i];
+    blocks_in_chunk[i] = array->extchunkshape[i] / array->blockshape[i];
+  }
+  int64_t blockshape[B2ND_MAX_DIM] = {0};
+  for (int i = 0; i < ndim; ++i) {
+    blockshape[i] = array->blockshape[i];
+  }
+
+  for (int n = th->tid; n < th->nchunks; n += th->nthreads) {
+    int64_t nchunk = th->nchunk_first + n;
+    int64_t nchunk_ndim[B2ND_MAX_DIM] = {0};
+    blosc2_unidim_to_multidim(ndim, chunks_in_array, nchunk, nchunk_ndim);
+
+    // Gather the chunk from the buffer in block order; padding is set to zero
+    memset(th->data, 0, data_nbytes);
+    if (ndim == 0) {
+      memcpy(th->data, th->buffer, typesize);
+    }
+    for (int32_t nblock = 0; nblock < nblocks && ndim > 0; ++nblock) {
+      int64_t nblock_ndim[B2ND_MAX_DIM] = {0};
+      blosc2_unidim_to_multidim(ndim, blocks_in_chunk, nblock, nblock_ndim);
+      int64_t src_start[B2ND_MAX_DIM] = {0};
+      int64_t src_stop[B2ND_MAX_DIM] = {0};
+      int64_t dst_start[B2ND_MAX_DIM] = {0};
+      bool empty = false;
+      for (int i = 0; i < ndim; ++i) {
+        int64_t chunk_start = nchunk_ndim[i] * array->chunkshape[i];
+        int64_t chunk_stop = chunk_start + array->chunkshape[i];
+        if (chunk_stop > array->shape[i]) {
+          chunk_stop = array->shape[i];
+        }
+        int64_t block_start = chunk_start + nblock_ndim[i] * array->blockshape[i];
+        int64_t block_stop = block_start + array->blockshape[i];
+        if (block_stop > chunk_stop) {
+          block_stop = chunk_stop;
+        }
+        src_start[i] = block_start - th->buffer_start[i];
+        src_stop[i] = block_stop - th->buffer_start[i];
+        empty |= block_start >= block_stop;
+      }
+      if (empty) {
+        continue;
+      }
+      b2nd_copy_buffer(ndim, typesize,
+                       (void *) th->buffer, th->buffershape, src_start, src_stop,
+                       th->data + (int64_t) nblock * array->blocknitems * typesize, blockshape,
+                       dst_start);
+    }
+
+    uint8_t *chunk = malloc((size_t) data_nbytes + BLOSC2_MAX_OVERHEAD);
+    if (chunk == NULL) {
+      th->rc = BLOSC2_ERROR_MEMORY_ALLOC;
+      return NULL;
+    }
+    int cbytes = blosc2_compress_ctx(th->cctx, th->data, data_nbytes, chunk,
+                                     data_nbytes + BLOSC2_MAX_OVERHEAD);
+    if (cbytes < 0) {
+      BLOSC_TRACE_ERROR("Blosc error when compressing a chunk");
+      free(chunk);
+      th->rc = cbytes;
+      return NULL;
+    }
+    th->chunks[n] = chunk;
+    int rc = zonemap_entry_from_ctx(th->cctx, &th->entries[n]);
+    if (rc < 0) {
+      th->rc = rc;
+      return NULL;
+    }
+  }
+
+  return NULL;
+}
+
+
+/* Compress the chunks [nchunk_first, nchunk_stop) of the array out of a C-ordered
+ * buffer and append them to its super-chunk.  The buffer must cover the (unpadded)
+ * region of the array that these chunks span; `buffer_start` is the position of
+ * the buffer origin in the array.  Chunks are encoded concurrently using as many
+ * threads as the compression context of the super-chunk and appended in order. */
+static int append_chunks_from_cbuffer(b2nd_array_t *array, const void *buffer, const int64_t *buffershape,
+                                      const int64_t *buffer_start, int64_t nchunk_first, int64_t nchunk_stop) {
+  blosc2_schunk *sc = array->sc;
+  int nthreads = sc->cctx->nthreads > 0 ? sc->cctx->nthreads : 1;
+  int batch = nthreads > 1 ? 4 * nthreads : 1;
+  int32_t data_nbytes = (int32_t) array->extchunknitems * sc->typesize;
+  int rc = BLOSC2_ERROR_SUCCESS;
+
+  blosc2_cparams *cparams;
+  BLOSC_ERROR(blosc2_schunk_get_cparams(sc, &cparams));
+  cparams->nthreads = 1;
+  cparams->use_dict = sc->cctx->use_dict;
+
+  encode_thread_t *ths = calloc(nthreads, sizeof(encode_thread_t));
+  pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+  uint8_t **chunks = calloc(batch, sizeof(uint8_t *));
+  zonemap_entry *entries = calloc(batch, sizeof(zonemap_entry));
+  if (ths == NULL || threads == NULL || chunks == NULL || entries == NULL) {
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto out;
+  }
+  for (int tid = 0; tid < nthreads; ++tid) {
+    ths[tid].array = array;
+    ths[tid].cctx = blosc2_create_cctx(*cparams);
+    if (ths[tid].cctx != NULL) {
+      // The zone map is not a compression param
+      ths[tid].cctx->zonemap = sc->cctx->zonemap;
+    }
+    ths[tid].data = malloc(data_nbytes);
+    ths[tid].buffer = buffer;
+    ths[tid].buffershape = buffershape;
+    ths[tid].buffer_start = buffer_start;
+    ths[tid].tid = tid;
+    ths[tid].nthreads = nthreads;
+    ths[tid].chunks = chunks;
+    ths[tid].entries = entries;
+    if (ths[tid].cctx == NULL || ths[tid].data == NULL) {
+      rc = BLOSC2_ERROR_FAILURE;
+      goto out;
+    }
+  }
+
+  for (int64_t first = nchunk_first; first < nchunk_stop; first += batch) {
+    int nchunks = (int) (nchunk_stop - first < batch ? nchunk_stop - first : batch);
+    for (int tid = 0; tid < nthreads; ++tid) {
+      ths[tid].nchunk_first = first;
+      ths[tid].nchunks = nchunks;
+      ths[tid].rc = BLOSC2_ERROR_SUCCESS;
+    }
+    // The calling thread acts as the first worker
+    int nstarted = 1;
+    for (int tid = 1; tid < nthreads && tid < nchunks; ++tid) {
+      if (pthread_create(&threads[tid], NULL, encode_chunks_worker, &ths[tid]) != 0) {
+        BLOSC_TRACE_ERROR("Cannot create a thread for encoding chunks");
+        rc = BLOSC2_ERROR_THREAD_CREATE;
+        break;
+      }
+      nstarted++;
+    }
+    if (rc == BLOSC2_ERROR_SUCCESS) {
+      encode_chunks_worker(&ths[0]);
+    }
+    for (int tid = 1; tid < nstarted; ++tid) {
+      pthread_join(threads[tid], NULL);
+    }
+    for (int tid = 0; tid < nthreads && rc == BLOSC2_ERROR_SUCCESS; ++tid) {
+      rc = ths[tid].rc;
+    }
+    if (rc < 0) {
+      for (int i = 0; i < nchunks; ++i) {
+        free(chunks[i]);
+      }
+      goto out;
+    }
+    int64_t nchunks_ = schunk_append_chunks_stats(sc, chunks, nchunks, false, entries);
+    if (nchunks_ < 0) {
+      BLOSC_TRACE_ERROR("Blosc error when appending chunks");
+      rc = (int) nchunks_;
+      goto out;
+    }
+    memset(chunks, 0, batch * sizeof(uint8_t *));
+    for (int i = 0; i < nchunks; ++i) {
+      zonemap_entry_free(&entries[i]);
+    }
+  }
+
+  out:
+  if (ths != NULL) {
+    for (int tid = 0; tid < nthreads; ++tid) {
+      if (ths[tid].cctx != NULL) {
+        blosc2_free_ctx(ths[tid].cctx);
+      }
+      free(ths[tid].data);
+    }
+  }
+  if (entries != NULL) {
+    for (int i = 0; i < batch; ++i) {
+      zonemap_entry_free(&entries[i]);
+    }
+  }
+  free(ths);
+  free(threads);
+  free(chunks);
+  free(entries);
+  free(cparams);
+
+  return rc;
+}
+
+
 int b2nd_from_cbuffer(b2nd_context_t *ctx, b2nd_array_t **array, const void *buffer, int64_t buffersize) {
   BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
 
-  BLOSC_ERROR(b2nd_empty(ctx, array));
+  // Chunks are appended straight from the buffer, so start with an empty super-chunk
+  BLOSC_ERROR(array_new(ctx, BLOSC2_NO_SPECIAL, array));
 
   if (buffersize < (int64_t) (*array)->nitems * (*array)->sc->typesize) {
     BLOSC_TRACE_ERROR("The buffersize (%lld) is smaller than the array size (%lld)",
@@ -480,9 +702,8 @@ int b2nd_from_cbuffer(b2nd_context_t *ctx, b2nd_array_t **array, const void *buf
   }
 
   int64_t start[B2ND_MAX_DIM] = {0};
-  int64_t *stop = (*array)->shape;
-  int64_t *shape = (*array)->shape;
-  BLOSC_ERROR(b2nd_set_slice_cbuffer(buffer, shape, buffersize, start, stop, *array));
+  int64_t nchunks = (*array)->extnitems / (*array)->chunknitems;
+  BLOSC_ERROR(append_chunks_from_cbuffer(*array, buffer, (*array)->shape, start, 0, nchunks));
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -509,6 +730,44 @@ int b2nd_to_cbuffer(const b2nd_array_t *array, void *buffer,
 
 
 // Setting and getting slices
+/* Edge of the ZFP cells (they have 4^ndim items) */
+#define ZFP_CELL_EDGE 4
+
+/* Get the chunk for decoding only the ZFP cells needed from its blocks, when it is in fixed-rate mode */
+static int get_cells_chunk(b2nd_array_t *array, int64_t nchunk, uint8_t **chunk, bool *needs_free) {
+  *chunk = NULL;
+  *needs_free = false;
+  if ((array->sc->compcode != BLOSC_CODEC_ZFP_FIXED_RATE) || (array->ndim > ZFP_CELL_EDGE)) {
+    return 0;
+  }
+  return blosc2_schunk_get_lazychunk(array->sc, nchunk, chunk, needs_free);
+}
+
+/* Decode only the ZFP cells of a block intersecting the box [start, stop) (in block coordinates),
+   as long as they are at most half of the cells in the block.  Returns 1 if the block has been
+   decoded this way, 0 if it has to be decompressed in full or a negative value on errors. */
+static int get_block_cells(b2nd_array_t *array, const uint8_t *chunk, int32_t chunk_cbytes, int64_t nblock,
+                           const int64_t *start, const int64_t *stop, uint8_t *data) {
+  int64_t ncells = 1;
+  int64_t box_ncells = 1;
+  for (int i = 0; i < array->ndim; ++i) {
+    ncells *= (array->blockshape[i] - 1) / ZFP_CELL_EDGE + 1;
+    box_ncells *= (stop[i] - 1) / ZFP_CELL_EDGE - start[i] / ZFP_CELL_EDGE + 1;
+  }
+  if (2 * box_ncells > ncells) {
+    return 0;
+  }
+  int32_t block_nbytes = (int32_t) array->blocknitems * array->sc->typesize;
+  int rc = blosc2_getcells_ctx(array->sc->dctx, chunk, chunk_cbytes, (int32_t) nblock, start, stop,
+                               &data[nblock * block_nbytes], block_nbytes);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Error getting the ZFP cells of block %" PRId64, nblock);
+    return rc;
+  }
+  return rc > 0 ? 1 : 0;
+}
+
+
 int get_set_slice(void *buffer, int64_t buffersize, const int64_t *start, const int64_t *stop,
                   const int64_t *shape, b2nd_array_t *array, bool set_slice) {
   BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
@@ -536,7 +795,7 @@ int get_set_slice(void *buffer, int64_t buffersize, const int64_t *start, const
       if (blosc2_compress_ctx(array->sc->cctx, buffer_b, array->sc->typesize, chunk, chunk_size) < 0) {
         BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
       }
-      if (blosc2_schunk_update_chunk(array->sc, 0, chunk, false) < 0) {
+      if (schunk_update_chunk_ctx(array->sc, 0, chunk, false, array->sc->cctx) < 0) {
         BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
       }
 
@@ -634,6 +893,15 @@ int get_set_slice(void *buffer, int64_t buffersize, const int64_t *start, const
         memset(data, 0, data_nbytes);
       }
     } else {
+      // In ZFP fixed-rate mode, the blocks can be decoded cell by cell
+      uint8_t *chunk;
+      bool needs_free;
+      int32_t chunk_cbytes = get_cells_chunk(array, nchunk, &chunk, &needs_free);
+      if (chunk_cbytes < 0) {
+        BLOSC_TRACE_ERROR("Error getting chunk");
+        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+      }
+      bool decompress_chunk = false;
       bool *block_maskout = malloc(nblocks);
       BLOSC_ERROR_NULL(block_maskout, BLOSC2_ERROR_MEMORY_ALLOC);
       for (int nblock = 0; nblock < nblocks; ++nblock) {
@@ -662,17 +930,37 @@ int get_set_slice(void *buffer, int64_t buffersize, const int64_t *start, const
           block_empty |= (block_stop[i] <= start[i] || block_start[i] >= stop[i]);
         }
         block_maskout[nblock] = block_empty ? true : false;
+        if (!block_empty && chunk != NULL) {
+          int64_t box_start[B2ND_MAX_DIM];
+          int64_t box_stop[B2ND_MAX_DIM];
+          for (int i = 0; i < ndim; ++i) {
+            int64_t offset = chunk_start[i] + nblock_ndim[i] * array->blockshape[i];
+            box_start[i] = (start[i] > block_start[i] ? start[i] : block_start[i]) - offset;
+            box_stop[i] = (stop[i] < block_stop[i] ? stop[i] : block_stop[i]) - offset;
+          }
+          int rc = get_block_cells(array, chunk, chunk_cbytes, nblock, box_start, box_stop, data);
+          if (rc < 0) {
+            BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+          }
+          block_maskout[nblock] = (rc > 0);
+        }
+        decompress_chunk |= !block_maskout[nblock];
       }
-
-      if (blosc2_set_maskout(array->sc->dctx, block_maskout, nblocks) != BLOSC2_ERROR_SUCCESS) {
-        BLOSC_TRACE_ERROR("Error setting the maskout");
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+      if (needs_free) {
+        free(chunk);
       }
 
-      int err = blosc2_schunk_decompress_chunk(array->sc, nchunk, data, data_nbytes);
-      if (err < 0) {
-        BLOSC_TRACE_ERROR("Error decompressing chunk");
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+      if (decompress_chunk) {
+        if (blosc2_set_maskout(array->sc->dctx, block_maskout, nblocks) != BLOSC2_ERROR_SUCCESS) {
+          BLOSC_TRACE_ERROR("Error setting the maskout");
+          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+        }
+
+        int err = blosc2_schunk_decompress_chunk(array->sc, nchunk, data, data_nbytes);
+        if (err < 0) {
+          BLOSC_TRACE_ERROR("Error decompressing chunk");
+          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+        }
       }
 
       free(block_maskout);
@@ -783,7 +1071,7 @@ int get_set_slice(void *buffer, int64_t buffersize, const int64_t *start, const
         BLOSC_TRACE_ERROR("Blosc can not compress the data");
         BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
       }
-      int64_t brc_ = blosc2_schunk_update_chunk(array->sc, nchunk, chunk, false);
+      int64_t brc_ = schunk_update_chunk_ctx(array->sc, nchunk, chunk, false, array->sc->cctx);
       if (brc_ < 0) {
         BLOSC_TRACE_ERROR("Blosc can not update the chunk");
         BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
@@ -1308,6 +1596,20 @@ int b2nd_resize(b2nd_array_t *array, const int64_t *new_shape,
 }
 
 
+/* Whether growing `axis` from its end only adds whole new chunks at the end of the super-chunk */
+static bool append_is_chunk_aligned(const b2nd_array_t *array, int8_t axis) {
+  if (array->nitems == 0 || array->shape[axis] % array->chunkshape[axis] != 0) {
+    return false;
+  }
+  for (int i = 0; i < axis; ++i) {
+    if (array->extshape[i] != array->chunkshape[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
 int b2nd_insert(b2nd_array_t *array, const void *buffer, int64_t buffersize,
                 int8_t axis, int64_t insert_start) {
 
@@ -1338,6 +1640,36 @@ int b2nd_insert(b2nd_array_t *array, const void *buffer, int64_t buffersize,
   int64_t start[B2ND_MAX_DIM] = {0};
   start[axis] = insert_start;
 
+  if (insert_start == array->shape[axis] && buffershape[axis] > 0 &&
+      append_is_chunk_aligned(array, axis)) {
+    // The new data goes to brand new chunks, so compress them straight from the buffer.
+    // They are laid out with the grown shape, which the array only takes once they are in.
+    int64_t old_nchunks = array->sc->nchunks;
+    b2nd_array_t grown = *array;
+    grown.sc = NULL;  // do not touch the metalayer yet
+    BLOSC_ERROR(update_shape(&grown, array->ndim, newshape, array->chunkshape, array->blockshape));
+    grown.sc = array->sc;
+    int64_t nchunks = grown.extnitems / grown.chunknitems;
+    int rc = append_chunks_from_cbuffer(&grown, buffer, buffershape, start, old_nchunks, nchunks);
+    if (rc >= 0) {
+      b2nd_array_t old = *array;
+      rc = update_shape(array, array->ndim, newshape, array->chunkshape, array->blockshape);
+      if (rc < 0) {
+        *array = old;
+      }
+    }
+    if (rc < 0) {
+      // Drop the chunks that made it in, so that the array is left as it was
+      while (array->sc->nchunks > old_nchunks) {
+        if (blosc2_schunk_delete_chunk(array->sc, array->sc->nchunks - 1) < 0) {
+          break;
+        }
+      }
+      BLOSC_ERROR(rc);
+    }
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
   if (insert_start == array->shape[axis]) {
     BLOSC_ERROR(b2nd_resize(array, newshape, NULL));
   } else {
@@ -1538,7 +1870,10 @@ int iter_block_maskout(b2nd_array_t *array, int8_t ndim,
                        b2nd_selection_t **o_selection,
                        b2nd_selection_t **p_o_sel_block_0,
                        b2nd_selection_t **p_o_sel_block_1,
-                       bool *maskout) {
+                       bool *maskout,
+                       const uint8_t *chunk,
+                       int32_t chunk_cbytes,
+                       uint8_t *data) {
   p_o_sel_block_0[ndim] = o_selection[ndim];
   p_o_sel_block_1[ndim] = o_selection[ndim];
   while (p_o_sel_block_1[ndim] - o_selection[ndim] < sel_block_size[ndim]) {
@@ -1562,10 +1897,24 @@ int iter_block_maskout(b2nd_array_t *array, int8_t ndim,
         nblock += block_index[i] * block_chunk_strides[i];
       }
       maskout[nblock] = false;
+      if (chunk != NULL) {
+        // Decode only the cells intersecting the bounding box of the selection in the block
+        int64_t box_start[B2ND_MAX_DIM];
+        int64_t box_stop[B2ND_MAX_DIM];
+        for (int i = 0; i < array->ndim; ++i) {
+          box_start[i] = p_o_sel_block_0[i]->value % array->chunkshape[i] % array->blockshape[i];
+          box_stop[i] = (p_o_sel_block_1[i] - 1)->value % array->chunkshape[i] % array->blockshape[i] + 1;
+        }
+        int rc = get_block_cells(array, chunk, chunk_cbytes, nblock, box_start, box_stop, data);
+        if (rc < 0) {
+          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+        }
+        maskout[nblock] = (rc > 0);
+      }
     } else {
       BLOSC_ERROR(iter_block_maskout(array, (int8_t) (ndim + 1), sel_block_size,
                                      o_selection, p_o_sel_block_0, p_o_sel_block_1,
-                                     maskout)
+                                     maskout, chunk, chunk_cbytes, data)
       );
     }
     p_o_sel_block_0[ndim] = p_o_sel_block_1[ndim];
@@ -1620,7 +1969,20 @@ int iter_chunk(b2nd_array_t *array, int8_t ndim,
         chunk_selection_size[i] = p_ordered_selection_1[i] - p_ordered_selection_0[i];
       }
 
+      int data_nitems = (int) array->extchunknitems;
+      int data_nbytes = data_nitems * array->sc->typesize;
+      uint8_t *data = malloc(data_nitems * array->sc->typesize);
+      BLOSC_ERROR_NULL(data, BLOSC2_ERROR_MEMORY_ALLOC);
+      bool decompress_chunk = true;
       if (get) {
+        // In ZFP fixed-rate mode, the blocks can be decoded cell by cell
+        uint8_t *chunk;
+        bool needs_free;
+        int32_t chunk_cbytes = get_cells_chunk(array, nchunk, &chunk, &needs_free);
+        if (chunk_cbytes < 0) {
+          BLOSC_TRACE_ERROR("Error getting chunk");
+          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+        }
         bool *maskout = calloc(nblocks, sizeof(bool));
         for (int i = 0; i < nblocks; ++i) {
           maskout[i] = true;
@@ -1631,23 +1993,29 @@ int iter_chunk(b2nd_array_t *array, int8_t ndim,
                                        p_ordered_selection_0,
                                        p_chunk_selection_0,
                                        p_chunk_selection_1,
-                                       maskout));
+                                       maskout, chunk, chunk_cbytes, data));
+        if (needs_free) {
+          free(chunk);
+        }
 
-        if (blosc2_set_maskout(array->sc->dctx, maskout, (int) nblocks) !=
-            BLOSC2_ERROR_SUCCESS) {
+        decompress_chunk = false;
+        for (int i = 0; i < nblocks; ++i) {
+          decompress_chunk |= !maskout[i];
+        }
+        if (decompress_chunk &&
+            blosc2_set_maskout(array->sc->dctx, maskout, (int) nblocks) != BLOSC2_ERROR_SUCCESS) {
           BLOSC_TRACE_ERROR("Error setting the maskout");
           BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
         }
         free(maskout);
       }
-      int data_nitems = (int) array->extchunknitems;
-      int data_nbytes = data_nitems * array->sc->typesize;
-      uint8_t *data = malloc(data_nitems * array->sc->typesize);
-      BLOSC_ERROR_NULL(data, BLOSC2_ERROR_MEMORY_ALLOC);
-      int err = blosc2_schunk_decompress_chunk(array->sc, nchunk, data, data_nbytes);
-      if (err < 0) {
-        BLOSC_TRACE_ERROR("Error decompressing chunk");
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+      int err;
+      if (decompress_chunk) {
+        err = blosc2_schunk_decompress_chunk(array->sc, nchunk, data, data_nbytes);
+        if (err < 0) {
+          BLOSC_TRACE_ERROR("Error decompressing chunk");
+          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+        }
       }
       BLOSC_ERROR(iter_block_copy(array, 0, chunk_selection_size,
                                   p_ordered_selection_0, p_chunk_selection_0, p_chunk_selection_1,
@@ -1662,7 +2030,7 @@ int iter_chunk(b2nd_array_t *array, int8_t ndim,
           BLOSC_TRACE_ERROR("Error compressing data");
           BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
         }
-        err = (int) blosc2_schunk_update_chunk(array->sc, nchunk, chunk, false);
+        err = (int) schunk_update_chunk_ctx(array->sc, nchunk, chunk, false, array->sc->cctx);
         if (err < 0) {
           BLOSC_TRACE_ERROR("Error updating chunk");
           BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
@@ -1766,6 +2134,319 @@ int b2nd_set_orthogonal_selection(b2nd_array_t *array, int64_t **selection, int6
 }
 
 
+struct b2nd_iter_s {
+  const b2nd_array_t *array;
+  //!< The array being iterated.
+  int8_t level;
+  //!< Either B2ND_ITER_CHUNKS or B2ND_ITER_BLOCKS.
+  blosc2_context *dctx;
+  //!< The decompression context owned by the prefetching thread.
+  int64_t nchunks;
+  //!< The number of chunks in the array.
+  int32_t nblocks;
+  //!< The number of blocks in a chunk.
+  int32_t chunk_nbytes;
+  //!< The size of a decompressed (padded) chunk.
+  int64_t chunks_in_array[B2ND_MAX_DIM];
+  //!< The number of chunks along each dimension.
+  int64_t blocks_in_chunk[B2ND_MAX_DIM];
+  //!< The number of blocks along each dimension of a chunk.
+  uint8_t *slot_data[2];
+  //!< The double buffer where chunks are decompressed.
+  int64_t slot_nchunk[2];
+  //!< The chunk held in each slot (-1 if the slot is free).
+  int slot_rc[2];
+  //!< The result of decompressing the chunk in each slot.
+  uint8_t *chunk_buffer;
+  //!< The buffer where blocks are gathered when iterating over chunks.
+  int64_t nchunk;
+  //!< The chunk being served to the caller (-1 if none).
+  int32_t nblock;
+  //!< The next block to be served from the current chunk.
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  bool thread_started;
+  bool stop;
+};
+
+
+static int iter_decompress_chunk(b2nd_iter_t *iter, int64_t nchunk, uint8_t *dest) {
+  blosc2_schunk *sc = iter->array->sc;
+  if (nchunk >= sc->nchunks) {
+    memset(dest, 0, iter->chunk_nbytes);
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  uint8_t *chunk;
+  bool needs_free;
+  int cbytes = blosc2_schunk_get_chunk(sc, nchunk, &chunk, &needs_free);
+  if (cbytes < 0) {
+    BLOSC_TRACE_ERROR("Cannot get chunk %" PRId64, nchunk);
+    return cbytes;
+  }
+  int rc = BLOSC2_ERROR_SUCCESS;
+  if (cbytes == 0) {
+    memset(dest, 0, iter->chunk_nbytes);
+  } else {
+    rc = blosc2_decompress_ctx(iter->dctx, chunk, cbytes, dest, iter->chunk_nbytes);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Error decompressing chunk %" PRId64, nchunk);
+    }
+  }
+  if (needs_free) {
+    free(chunk);
+  }
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Decompress the chunks in order, one slot ahead of the caller */
+static void *iter_prefetch(void *arg) {
+  b2nd_iter_t *iter = (b2nd_iter_t *) arg;
+  for (int64_t nchunk = 0; nchunk < iter->nchunks; ++nchunk) {
+    int slot = (int) (nchunk % 2);
+    pthread_mutex_lock(&iter->mutex);
+    while (iter->slot_nchunk[slot] != -1 && !iter->stop) {
+      pthread_cond_wait(&iter->cond, &iter->mutex);
+    }
+    bool stop = iter->stop;
+    pthread_mutex_unlock(&iter->mutex);
+    if (stop) {
+      break;
+    }
+
+    int rc = iter_decompress_chunk(iter, nchunk, iter->slot_data[slot]);
+
+    pthread_mutex_lock(&iter->mutex);
+    iter->slot_rc[slot] = rc;
+    iter->slot_nchunk[slot] = nchunk;
+    pthread_cond_broadcast(&iter->cond);
+    pthread_mutex_unlock(&iter->mutex);
+    if (rc < 0) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+
+int b2nd_iter_begin(const b2nd_array_t *array, int8_t level, b2nd_iter_t **iter) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(iter, BLOSC2_ERROR_NULL_POINTER);
+  if (level != B2ND_ITER_CHUNKS && level != B2ND_ITER_BLOCKS) {
+    BLOSC_TRACE_ERROR("level must be B2ND_ITER_CHUNKS or B2ND_ITER_BLOCKS");
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+
+  b2nd_iter_t *it = calloc(1, sizeof(b2nd_iter_t));
+  BLOSC_ERROR_NULL(it, BLOSC2_ERROR_MEMORY_ALLOC);
+  it->array = array;
+  it->level = level;
+  it->nchunk = -1;
+  it->slot_nchunk[0] = -1;
+  it->slot_nchunk[1] = -1;
+
+  int8_t ndim = array->ndim;
+  it->nchunks = array->nitems == 0 ? 0 : 1;
+  it->nblocks = 1;
+  for (int i = 0; i < ndim && it->nchunks > 0; ++i) {
+    it->chunks_in_array[i] = array->extshape[i] / array->chunkshape[i];
+    it->blocks_in_chunk[i] = array->extchunkshape[i] / array->blockshape[i];
+    it->nchunks *= it->chunks_in_array[i];
+    it->nblocks *= (int32_t) it->blocks_in_chunk[i];
+  }
+  it->chunk_nbytes = (int32_t) array->extchunknitems * array->sc->typesize;
+
+  if (it->nchunks > 0) {
+    for (int i = 0; i < 2; ++i) {
+      it->slot_data[i] = malloc(it->chunk_nbytes);
+      if (it->slot_data[i] == NULL) {
+        b2nd_iter_end(it);
+        BLOSC_ERROR(BLOSC2_ERROR_MEMORY_ALLOC);
+      }
+    }
+    if (level == B2ND_ITER_CHUNKS) {
+      it->chunk_buffer = malloc(array->chunknitems * array->sc->typesize);
+      if (it->chunk_buffer == NULL) {
+        b2nd_iter_end(it);
+        BLOSC_ERROR(BLOSC2_ERROR_MEMORY_ALLOC);
+      }
+    }
+
+    blosc2_dparams *dparams;
+    if (blosc2_schunk_get_dparams(array->sc, &dparams) < 0) {
+      b2nd_iter_end(it);
+      BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+    }
+    it->dctx = blosc2_create_dctx(*dparams);
+    free(dparams);
+    if (it->dctx == NULL) {
+      b2nd_iter_end(it);
+      BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+    }
+
+    pthread_mutex_init(&it->mutex, NULL);
+    pthread_cond_init(&it->cond, NULL);
+    if (pthread_create(&it->thread, NULL, iter_prefetch, it) != 0) {
+      pthread_cond_destroy(&it->cond);
+      pthread_mutex_destroy(&it->mutex);
+      b2nd_iter_end(it);
+      BLOSC_TRACE_ERROR("Cannot create the prefetching thread");
+      BLOSC_ERROR(BLOSC2_ERROR_THREAD_CREATE);
+    }
+    it->thread_started = true;
+  }
+
+  *iter = it;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_iter_next(b2nd_iter_t *iter, b2nd_iter_item_t *item) {
+  BLOSC_ERROR_NULL(iter, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(item, BLOSC2_ERROR_NULL_POINTER);
+  const b2nd_array_t *array = iter->array;
+  int8_t ndim = array->ndim;
+  uint8_t typesize = (uint8_t) array->sc->typesize;
+
+  while (true) {
+    if (iter->nchunk >= iter->nchunks) {
+      return 0;
+    }
+    if (iter->nchunk < 0 || iter->nblock >= iter->nblocks) {
+      // Hand the slot of the consumed chunk back to the prefetching thread
+      if (iter->nchunk >= 0) {
+        pthread_mutex_lock(&iter->mutex);
+        iter->slot_nchunk[iter->nchunk % 2] = -1;
+        pthread_cond_broadcast(&iter->cond);
+        pthread_mutex_unlock(&iter->mutex);
+      }
+      if (iter->nchunk + 1 >= iter->nchunks) {
+        iter->nchunk = iter->nchunks;
+        return 0;
+      }
+      iter->nchunk++;
+      iter->nblock = 0;
+      int slot = (int) (iter->nchunk % 2);
+      pthread_mutex_lock(&iter->mutex);
+      while (iter->slot_nchunk[slot] != iter->nchunk) {
+        pthread_cond_wait(&iter->cond, &iter->mutex);
+      }
+      int rc = iter->slot_rc[slot];
+      pthread_mutex_unlock(&iter->mutex);
+      if (rc < 0) {
+        iter->nchunk = iter->nchunks;
+        return rc;
+      }
+    }
+
+    uint8_t *data = iter->slot_data[iter->nchunk % 2];
+    int64_t chunk_ndim[B2ND_MAX_DIM] = {0};
+    blosc2_unidim_to_multidim(ndim, (int64_t *) iter->chunks_in_array, iter->nchunk, chunk_ndim);
+    int64_t chunk_start[B2ND_MAX_DIM] = {0};
+    int64_t chunk_stop[B2ND_MAX_DIM] = {0};
+    for (int i = 0; i < ndim; ++i) {
+      chunk_start[i] = chunk_ndim[i] * array->chunkshape[i];
+      chunk_stop[i] = chunk_start[i] + array->chunkshape[i];
+      if (chunk_stop[i] > array->shape[i]) {
+        chunk_stop[i] = array->shape[i];
+      }
+    }
+
+    if (iter->level == B2ND_ITER_BLOCKS) {
+      int32_t nblock = iter->nblock++;
+      int64_t block_ndim[B2ND_MAX_DIM] = {0};
+      blosc2_unidim_to_multidim(ndim, (int64_t *) iter->blocks_in_chunk, nblock, block_ndim);
+      bool empty = false;
+      for (int i = 0; i < ndim; ++i) {
+        item->start[i] = chunk_start[i] + block_ndim[i] * array->blockshape[i];
+        item->stop[i] = item->start[i] + array->blockshape[i];
+        if (item->stop[i] > chunk_stop[i]) {
+          item->stop[i] = chunk_stop[i];
+        }
+        item->shape[i] = array->blockshape[i];
+        empty |= item->start[i] >= item->stop[i];
+      }
+      if (empty) {
+        // The block only holds padding
+        continue;
+      }
+      item->nchunk = iter->nchunk;
+      item->nblock = nblock;
+      item->data = data + (int64_t) nblock * array->blocknitems * typesize;
+      return 1;
+    }
+
+    // Gather the blocks of the chunk into a C-ordered buffer
+    iter->nblock = iter->nblocks;
+    int64_t chunk_shape[B2ND_MAX_DIM] = {0};
+    for (int i = 0; i < ndim; ++i) {
+      chunk_shape[i] = chunk_stop[i] - chunk_start[i];
+    }
+    if (ndim == 0) {
+      memcpy(iter->chunk_buffer, data, typesize);
+    }
+    for (int32_t nblock = 0; nblock < iter->nblocks && ndim > 0; ++nblock) {
+      int64_t block_ndim[B2ND_MAX_DIM] = {0};
+      blosc2_unidim_to_multidim(ndim, (int64_t *) iter->blocks_in_chunk, nblock, block_ndim);
+      int64_t src_start[B2ND_MAX_DIM] = {0};
+      int64_t src_stop[B2ND_MAX_DIM] = {0};
+      int64_t dst_start[B2ND_MAX_DIM] = {0};
+      int64_t block_pad_shape[B2ND_MAX_DIM] = {0};
+      bool empty = false;
+      for (int i = 0; i < ndim; ++i) {
+        dst_start[i] = block_ndim[i] * array->blockshape[i];
+        src_stop[i] = array->blockshape[i];
+        if (dst_start[i] + src_stop[i] > chunk_shape[i]) {
+          src_stop[i] = chunk_shape[i] - dst_start[i];
+        }
+        block_pad_shape[i] = array->blockshape[i];
+        empty |= src_stop[i] <= 0;
+      }
+      if (empty) {
+        continue;
+      }
+      b2nd_copy_buffer(ndim, typesize,
+                       data + (int64_t) nblock * array->blocknitems * typesize, block_pad_shape,
+                       src_start, src_stop,
+                       iter->chunk_buffer, chunk_shape, dst_start);
+    }
+    item->nchunk = iter->nchunk;
+    item->nblock = -1;
+    for (int i = 0; i < ndim; ++i) {
+      item->start[i] = chunk_start[i];
+      item->stop[i] = chunk_stop[i];
+      item->shape[i] = chunk_shape[i];
+    }
+    item->data = iter->chunk_buffer;
+    return 1;
+  }
+}
+
+
+int b2nd_iter_end(b2nd_iter_t *iter) {
+  BLOSC_ERROR_NULL(iter, BLOSC2_ERROR_NULL_POINTER);
+  if (iter->thread_started) {
+    pthread_mutex_lock(&iter->mutex);
+    iter->stop = true;
+    pthread_cond_broadcast(&iter->cond);
+    pthread_mutex_unlock(&iter->mutex);
+    pthread_join(iter->thread, NULL);
+    pthread_cond_destroy(&iter->cond);
+    pthread_mutex_destroy(&iter->mutex);
+  }
+  if (iter->dctx != NULL) {
+    blosc2_free_ctx(iter->dctx);
+  }
+  free(iter->slot_data[0]);
+  free(iter->slot_data[1]);
+  free(iter->chunk_buffer);
+  free(iter);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
 b2nd_context_t *
 b2nd_create_ctx(const blosc2_storage *b2_storage, int8_t ndim, const int64_t *shape, const int32_t *chunkshape,
                 const int32_t *blockshape, const char *dtype, int8_t dtype_format, const blosc2_metalayer *metalayers,
@@ -167,6 +167,103 @@ int register_filter_private(blosc2_filter *filter);
  */
 int register_codec_private(blosc2_codec *codec);
 
+/**
+ * @brief Register a filter that keeps a state per thread context in Blosc.
+ *
+ * See blosc2_register_filter_ex() for the parameters.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int register_filter_ex_private(blosc2_filter *filter, blosc2_plugin_init_cb init, blosc2_plugin_destroy_cb destroy,
+                               blosc2_filter_forward_ex_cb forward, blosc2_filter_backward_ex_cb backward);
+
+/**
+ * @brief Register a codec that keeps a state per thread context in Blosc.
+ *
+ * See blosc2_register_codec_ex() for the parameters.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int register_codec_ex_private(blosc2_codec *codec, blosc2_plugin_init_cb init, blosc2_plugin_destroy_cb destroy,
+                              blosc2_codec_encoder_ex_cb encoder, blosc2_codec_decoder_ex_cb decoder);
+
+/**
+ * @brief Make the threads of a context create the states of their codec and filter
+ * plugins again (e.g. after the metalayers of its super-chunk have changed).
+ *
+ * @param context The context (it can be NULL).
+ */
+void invalidate_plugin_states(blosc2_context *context);
+
+/**
+ * @brief Decode only the ZFP cells of a block that intersect a box.
+ *
+ * @param context The decompression context.
+ * @param src The (possibly lazy) chunk.
+ * @param srcsize The size of the chunk.
+ * @param nblock The block to get the cells from.
+ * @param start The start of the box, in block coordinates.
+ * @param stop The stop of the box, in block coordinates.
+ * @param dest The buffer where the block is decoded.  Only the items inside the cells
+ * intersecting the box are filled.
+ * @param destsize The size of @p dest.
+ *
+ * @return The size of the block if succeeds, 0 if the chunk cannot be decoded per cell (it is
+ * not a fixed-rate ZFP chunk or it uses filters) or a negative code in case of errors.
+ */
+int blosc2_getcells_ctx(blosc2_context* context, const void* src, int32_t srcsize, int32_t nblock,
+                        const int64_t* start, const int64_t* stop, void* dest, int32_t destsize);
+
+/**
+ * @brief Start reading all the blocks of a lazy chunk in the background, so that they are
+ * ready when @p chunk is decompressed with @p context.  It only does so if the io backend of
+ * the super-chunk of @p context reads asynchronously.  @p chunk must be alive until it is
+ * decompressed or lazychunk_read_ahead_cancel() is called.
+ *
+ * @return 1 if the blocks are being read, 0 if they are not or a negative code in case of errors.
+ */
+int lazychunk_read_ahead(blosc2_context* context, const uint8_t* chunk, int32_t cbytes);
+
+/**
+ * @brief Wait for the blocks read ahead in @p context and drop them.
+ */
+void lazychunk_read_ahead_cancel(blosc2_context* context);
+
+/**
+ * @brief Get the sync callback of the registered io backend @p io_cb (NULL if it has none).
+ */
+blosc2_sync_cb get_io_sync_cb(const blosc2_io_cb* io_cb);
+
+/**
+ * @brief The state of a super-chunk that is not part of #blosc2_schunk, so that the
+ * layout of the public struct does not change.  Super-chunks are always allocated
+ * with this size (see schunk_private()).
+ */
+typedef struct {
+  blosc2_schunk schunk;
+  struct blosc2_zonemap* zonemap;  // the zone map statistics of the chunks (NULL if not enabled)
+  struct blosc2_prefetch* prefetch;  // the read-ahead of chunks (NULL if not enabled)
+} blosc2_schunk_private;
+
+static inline blosc2_schunk_private* schunk_private(blosc2_schunk* schunk) {
+  return (blosc2_schunk_private*)schunk;
+}
+
+/**
+ * @brief Set the content of a variable-length metalayer of @p schunk (adding it if needed)
+ * without writing the frame.  The frame gets it with its next trailer update, e.g. the one
+ * of the chunk mutation in progress.
+ *
+ * @return The index of the variable-length metalayer, or a negative code in case of errors.
+ */
+int vlmeta_stage(blosc2_schunk* schunk, const char* name, uint8_t* content, int32_t content_len,
+                 blosc2_cparams* cparams);
+
+/**
+ * @brief Write the metalayers and variable-length metalayers of @p schunk to its frame (if any).
+ */
+int vlmetalayer_flush(blosc2_schunk* schunk);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,250 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // for O_DIRECT
+#endif
+
+#include "blosc2/blosc2-io-direct.h"
+#include "blosc2.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Alignment for the offsets, sizes and memory of direct writes, unless the filesystem says
+   otherwise */
+#define DIRECT_ALIGN 4096
+/* Size of the staging buffer */
+#define DIRECT_STAGE_SIZE (4 * 1024 * 1024)
+/* Smaller writes go through the page cache */
+#define DIRECT_MIN_WRITE (64 * 1024)
+
+
+static int64_t pwrite_full(int fd, const uint8_t *ptr, int64_t size, int64_t offset) {
+  int64_t nwritten = 0;
+  while (nwritten < size) {
+    ssize_t rc = pwrite(fd, ptr + nwritten, (size_t) (size - nwritten), (off_t) (offset + nwritten));
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      break;
+    }
+    nwritten += rc;
+  }
+  return nwritten;
+}
+
+/* Stop using O_DIRECT for this file */
+static void disable_direct(blosc2_direct_file *my_fp) {
+  close(my_fp->dfd);
+  my_fp->dfd = -1;
+}
+
+/* Get the alignments that the filesystem requires for direct I/O */
+static void get_direct_align(blosc2_direct_file *my_fp) {
+  my_fp->mem_align = DIRECT_ALIGN;
+  my_fp->offset_align = DIRECT_ALIGN;
+#if defined(STATX_DIOALIGN)
+  struct statx stx;
+  if (statx(my_fp->dfd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 && (stx.stx_mask & STATX_DIOALIGN)) {
+    if (stx.stx_dio_offset_align == 0) {
+      // Direct I/O is not supported for this file
+      disable_direct(my_fp);
+      return;
+    }
+    my_fp->mem_align = stx.stx_dio_mem_align;
+    my_fp->offset_align = stx.stx_dio_offset_align;
+  }
+#endif
+}
+
+/* Write an aligned region with O_DIRECT.  Returns the bytes written, which are less than
+   size if the filesystem refused them. */
+static int64_t direct_write(blosc2_direct_file *my_fp, const uint8_t *ptr, int64_t size, int64_t offset) {
+  if (((uintptr_t) ptr % my_fp->mem_align) == 0) {
+    // The memory is suitably aligned (e.g. devices often need just 4 bytes), so no need to stage the data
+    int64_t nwritten = pwrite_full(my_fp->dfd, ptr, size, offset);
+    if (nwritten < size) {
+      disable_direct(my_fp);
+      // Only whole aligned blocks are known to be written
+      nwritten -= nwritten % my_fp->offset_align;
+    }
+    return nwritten;
+  }
+
+  if (my_fp->stage == NULL) {
+    void *stage;
+    size_t align = my_fp->mem_align > DIRECT_ALIGN ? my_fp->mem_align : DIRECT_ALIGN;
+    if (posix_memalign(&stage, align, DIRECT_STAGE_SIZE) != 0) {
+      return 0;
+    }
+    my_fp->stage = stage;
+  }
+  int64_t nwritten = 0;
+  while (nwritten < size) {
+    int64_t len = size - nwritten < DIRECT_STAGE_SIZE ? size - nwritten : DIRECT_STAGE_SIZE;
+    memcpy(my_fp->stage, ptr + nwritten, (size_t) len);
+    int64_t rc = pwrite_full(my_fp->dfd, my_fp->stage, len, offset + nwritten);
+    if (rc < len) {
+      disable_direct(my_fp);
+      nwritten += rc - rc % my_fp->offset_align;
+      break;
+    }
+    nwritten += len;
+  }
+  return nwritten;
+}
+
+
+void *blosc2_direct_open(const char *urlpath, const char *mode, void *params) {
+  BLOSC_UNUSED_PARAM(params);
+  int plus = strchr(mode, '+') != NULL;
+  int flags;
+  switch (mode[0]) {
+    case 'r':
+      flags = plus ? O_RDWR : O_RDONLY;
+      break;
+    case 'w':
+      flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+      break;
+    case 'a':
+      // Appends are done at the end of the file by hand (see blosc2_direct_write)
+      flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT;
+      break;
+    default:
+      return NULL;
+  }
+  int fd = open(urlpath, flags | O_CLOEXEC, 0666);
+  if (fd < 0) {
+    return NULL;
+  }
+  blosc2_direct_file *my_fp = calloc(1, sizeof(blosc2_direct_file));
+  if (my_fp == NULL) {
+    close(fd);
+    return NULL;
+  }
+  my_fp->fd = fd;
+  my_fp->dfd = -1;
+  my_fp->append = mode[0] == 'a';
+  if (flags != O_RDONLY) {
+    // Not every filesystem supports O_DIRECT (then, all writes are buffered)
+    my_fp->dfd = open(urlpath, (flags & ~(O_CREAT | O_TRUNC)) | O_DIRECT | O_CLOEXEC);
+    if (my_fp->dfd >= 0) {
+      get_direct_align(my_fp);
+    }
+  }
+  return my_fp;
+}
+
+int blosc2_direct_close(void *stream) {
+  blosc2_direct_file *my_fp = (blosc2_direct_file *) stream;
+  if (my_fp->dfd >= 0) {
+    close(my_fp->dfd);
+  }
+  free(my_fp->stage);
+  int err = close(my_fp->fd);
+  free(my_fp);
+  return err;
+}
+
+int64_t blosc2_direct_tell(void *stream) {
+  blosc2_direct_file *my_fp = (blosc2_direct_file *) stream;
+  return my_fp->pos;
+}
+
+int blosc2_direct_seek(void *stream, int64_t offset, int whence) {
+  blosc2_direct_file *my_fp = (blosc2_direct_file *) stream;
+  int64_t pos;
+  switch (whence) {
+    case SEEK_SET:
+      pos = offset;
+      break;
+    case SEEK_CUR:
+      pos = my_fp->pos + offset;
+      break;
+    case SEEK_END: {
+      struct stat st;
+      if (fstat(my_fp->fd, &st) < 0) {
+        return -1;
+      }
+      pos = (int64_t) st.st_size + offset;
+      break;
+    }
+    default:
+      return -1;
+  }
+  if (pos < 0) {
+    return -1;
+  }
+  my_fp->pos = pos;
+  return 0;
+}
+
+int64_t blosc2_direct_write(const void *ptr, int64_t size, int64_t nitems, void *stream) {
+  blosc2_direct_file *my_fp = (blosc2_direct_file *) stream;
+  const uint8_t *src = ptr;
+  int64_t nbytes = size * nitems;
+  if (my_fp->append && blosc2_direct_seek(my_fp, 0, SEEK_END) < 0) {
+    return 0;
+  }
+  int64_t pos = my_fp->pos;
+
+  int64_t nwritten = 0;
+  if (my_fp->dfd >= 0 && nbytes >= DIRECT_MIN_WRITE) {
+    // The unaligned head is buffered, the aligned body goes direct
+    int64_t align = my_fp->offset_align;
+    int64_t head = (align - pos % align) % align;
+    nwritten = pwrite_full(my_fp->fd, src, head, pos);
+    if (nwritten == head) {
+      int64_t body = (nbytes - head) - (nbytes - head) % align;
+      nwritten += direct_write(my_fp, src + head, body, pos + head);
+    }
+  }
+  // The rest (the unaligned tail, small writes or after O_DIRECT failed)
+  nwritten += pwrite_full(my_fp->fd, src + nwritten, nbytes - nwritten, pos + nwritten);
+
+  my_fp->pos = pos + nwritten;
+  return size > 0 ? nwritten / size : 0;
+}
+
+int64_t blosc2_direct_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  blosc2_direct_file *my_fp = (blosc2_direct_file *) stream;
+  int64_t nbytes = size * nitems;
+  int64_t nread = 0;
+  while (nread < nbytes) {
+    ssize_t rc = pread(my_fp->fd, (uint8_t *) ptr + nread, (size_t) (nbytes - nread),
+                       (off_t) (my_fp->pos + nread));
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      break;
+    }
+    nread += rc;
+  }
+  my_fp->pos += nread;
+  return size > 0 ? nread / size : 0;
+}
+
+int blosc2_direct_truncate(void *stream, int64_t size) {
+  blosc2_direct_file *my_fp = (blosc2_direct_file *) stream;
+  return ftruncate(my_fp->fd, (off_t) size);
+}
+
+int blosc2_direct_sync(void *stream) {
+  blosc2_direct_file *my_fp = (blosc2_direct_file *) stream;
+  // Both fds refer to the same file, so this also flushes the direct writes out of the device cache
+  return fsync(my_fp->fd);
+}
@@ -0,0 +1,505 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "blosc2/blosc2-io-uring.h"
+#include "blosc2.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+/* Maximum number of reads in flight for a batch */
+#define URING_ENTRIES 64
+
+typedef struct {
+  int fd;
+  uint32_t entries;
+  uint32_t *sq_tail;
+  uint32_t *sq_mask;
+  uint32_t *sq_array;
+  struct io_uring_sqe *sqes;
+  uint32_t *cq_head;
+  uint32_t *cq_tail;
+  uint32_t *cq_mask;
+  struct io_uring_cqe *cqes;
+  void *sq_ptr;
+  size_t sq_len;
+  void *cq_ptr;
+  size_t cq_len;
+  size_t sqes_len;
+} uring_ring;
+
+
+static void ring_free(uring_ring *ring) {
+  if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+    munmap(ring->sqes, ring->sqes_len);
+  }
+  if (ring->cq_ptr != NULL && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr) {
+    munmap(ring->cq_ptr, ring->cq_len);
+  }
+  if (ring->sq_ptr != NULL && ring->sq_ptr != MAP_FAILED) {
+    munmap(ring->sq_ptr, ring->sq_len);
+  }
+  close(ring->fd);
+  free(ring);
+}
+
+/* Set up a ring and map its queues (see io_uring_setup(2)) */
+static uring_ring *ring_new(uint32_t entries) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  int fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+  if (fd < 0) {
+    return NULL;
+  }
+  uring_ring *ring = calloc(1, sizeof(uring_ring));
+  if (ring == NULL) {
+    close(fd);
+    return NULL;
+  }
+  ring->fd = fd;
+  ring->entries = p.sq_entries;
+  ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  int single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    if (ring->cq_len > ring->sq_len) {
+      ring->sq_len = ring->cq_len;
+    }
+    ring->cq_len = ring->sq_len;
+  }
+  ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ptr == MAP_FAILED) {
+    ring_free(ring);
+    return NULL;
+  }
+  if (single_mmap) {
+    ring->cq_ptr = ring->sq_ptr;
+  }
+  else {
+    ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ptr == MAP_FAILED) {
+      ring_free(ring);
+      return NULL;
+    }
+  }
+  ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    ring_free(ring);
+    return NULL;
+  }
+
+  uint8_t *sq = ring->sq_ptr;
+  ring->sq_tail = (uint32_t *) (sq + p.sq_off.tail);
+  ring->sq_mask = (uint32_t *) (sq + p.sq_off.ring_mask);
+  ring->sq_array = (uint32_t *) (sq + p.sq_off.array);
+  uint8_t *cq = ring->cq_ptr;
+  ring->cq_head = (uint32_t *) (cq + p.cq_off.head);
+  ring->cq_tail = (uint32_t *) (cq + p.cq_off.tail);
+  ring->cq_mask = (uint32_t *) (cq + p.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+  return ring;
+}
+
+static int ring_enter(uring_ring *ring, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+  int rc;
+  do {
+    rc = (int) syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete, flags, NULL, 0);
+  } while (rc < 0 && errno == EINTR);
+  return rc;
+}
+
+/* Read until size bytes are read or EOF is found */
+static int64_t pread_full(int fd, uint8_t *ptr, int64_t size, int64_t offset) {
+  int64_t nread = 0;
+  while (nread < size) {
+    ssize_t rc = pread(fd, ptr + nread, (size_t) (size - nread), (off_t) (offset + nread));
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      break;
+    }
+    nread += rc;
+  }
+  return nread;
+}
+
+/* The rings are reused by all the batches, because setting one up takes a syscall and three
+   mmaps.  A ring in the pool has no reads in flight. */
+#define URING_POOL_SIZE 8
+
+static uring_ring *ring_pool[URING_POOL_SIZE];
+static int ring_pool_len = 0;
+static pthread_mutex_t ring_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uring_ring *ring_acquire(void) {
+  uring_ring *ring = NULL;
+  pthread_mutex_lock(&ring_pool_mutex);
+  if (ring_pool_len > 0) {
+    ring = ring_pool[--ring_pool_len];
+  }
+  pthread_mutex_unlock(&ring_pool_mutex);
+  if (ring == NULL) {
+    ring = ring_new(URING_ENTRIES);
+  }
+  return ring;
+}
+
+static void ring_release(uring_ring *ring) {
+  pthread_mutex_lock(&ring_pool_mutex);
+  if (ring_pool_len < URING_POOL_SIZE) {
+    ring_pool[ring_pool_len++] = ring;
+    ring = NULL;
+  }
+  pthread_mutex_unlock(&ring_pool_mutex);
+  if (ring != NULL) {
+    ring_free(ring);
+  }
+}
+
+/* A batch of reads.  They are pushed to the ring as it has room for them, and completed
+   while someone waits for any of them. */
+typedef struct {
+  uring_ring *ring;  // NULL when the reads left are done synchronously
+  int fd;
+  int32_t nreads;
+  void **ptrs;
+  int64_t *offsets;
+  int64_t *sizes;
+  int64_t *nread;  // the bytes read by every read; -1 while it is pending
+  int32_t nqueued;  // the reads put in the submission queue
+  int32_t nsubmitted;  // the reads consumed by the kernel (i.e. in flight or completed)
+  int32_t ninflight;
+  int leaked;  // the ring failed with reads in flight
+  pthread_mutex_t mutex;
+} uring_request;
+
+/* Put as many reads as the ring has room for in the submission queue and submit them */
+static int request_submit(uring_request *req) {
+  uring_ring *ring = req->ring;
+  uint32_t tail = *ring->sq_tail;
+  uint32_t mask = *ring->sq_mask;
+  uint32_t n = 0;
+  while (req->nqueued < req->nreads && (uint32_t) req->ninflight + n < ring->entries) {
+    int32_t i = req->nqueued++;
+    uint32_t idx = (tail + n) & mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = req->fd;
+    sqe->addr = (uint64_t) (uintptr_t) req->ptrs[i];
+    sqe->len = (uint32_t) req->sizes[i];
+    sqe->off = (uint64_t) req->offsets[i];
+    sqe->user_data = (uint64_t) i;
+    ring->sq_array[idx] = idx;
+    n++;
+  }
+  __atomic_store_n(ring->sq_tail, tail + n, __ATOMIC_RELEASE);
+
+  while (req->nsubmitted < req->nqueued) {
+    int rc = ring_enter(ring, (uint32_t) (req->nqueued - req->nsubmitted), 0, 0);
+    if (rc <= 0) {
+      return -1;
+    }
+    req->nsubmitted += rc;
+    req->ninflight += rc;
+  }
+  return 0;
+}
+
+/* Reap the completions available; with wait, block until there is at least one */
+static int request_reap(uring_request *req, int wait) {
+  uring_ring *ring = req->ring;
+  uint32_t head = *ring->cq_head;
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    if (!wait) {
+      return 0;
+    }
+    int rc;
+    do {
+      rc = ring_enter(ring, 0, 1, IORING_ENTER_GETEVENTS);
+    } while (rc < 0 && (errno == EAGAIN || errno == EBUSY));
+    if (rc < 0) {
+      return -1;
+    }
+  }
+  while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+    int32_t i = (int32_t) cqe->user_data;
+    int64_t res = cqe->res;
+    head++;
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    req->ninflight--;
+    if (res < 0) {
+      // E.g. the kernel does not know about IORING_OP_READ
+      res = 0;
+    }
+    if (res < req->sizes[i]) {
+      // Short read; get the rest synchronously
+      res += pread_full(req->fd, (uint8_t *) req->ptrs[i] + res, req->sizes[i] - res, req->offsets[i] + res);
+    }
+    req->nread[i] = res;
+  }
+  return 0;
+}
+
+/* Stop using a failed ring.  The reads in flight write to the buffers of the caller, so the
+   ring is only freed after all of them complete; if that cannot be known, it is leaked and
+   -1 is returned. */
+static int request_drop_ring(uring_request *req) {
+  while (req->ninflight > 0) {
+    if (request_reap(req, 1) < 0) {
+      req->ring = NULL;
+      req->leaked = 1;
+      return -1;
+    }
+  }
+  // Reads never consumed by the kernel stay in the queue, so the ring cannot be reused
+  ring_free(req->ring);
+  req->ring = NULL;
+  return 0;
+}
+
+/* Wait for the read i (or all of them if i < 0); returns -1 if reads may still be in flight */
+static int request_wait(uring_request *req, int32_t i) {
+  pthread_mutex_lock(&req->mutex);
+  int rc = req->leaked ? -1 : 0;
+  while (req->ring != NULL && (i < 0 ? req->ninflight > 0 || req->nqueued < req->nreads : req->nread[i] < 0)) {
+    if (request_submit(req) < 0 || request_reap(req, 1) < 0) {
+      rc = request_drop_ring(req);
+      break;
+    }
+  }
+  if (req->ring == NULL && rc == 0) {
+    // No io_uring available (e.g. forbidden by a seccomp policy); just read synchronously
+    for (int32_t j = (i < 0) ? 0 : i; j < ((i < 0) ? req->nreads : i + 1); j++) {
+      if (req->nread[j] < 0) {
+        req->nread[j] = pread_full(req->fd, req->ptrs[j], req->sizes[j], req->offsets[j]);
+      }
+    }
+  }
+  pthread_mutex_unlock(&req->mutex);
+  return rc;
+}
+
+
+void *blosc2_uring_open(const char *urlpath, const char *mode, void *params) {
+  BLOSC_UNUSED_PARAM(params);
+  int plus = strchr(mode, '+') != NULL;
+  int flags;
+  switch (mode[0]) {
+    case 'r':
+      flags = plus ? O_RDWR : O_RDONLY;
+      break;
+    case 'w':
+      flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+      break;
+    case 'a':
+      flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+      break;
+    default:
+      return NULL;
+  }
+  int fd = open(urlpath, flags | O_CLOEXEC, 0666);
+  if (fd < 0) {
+    return NULL;
+  }
+  blosc2_uring_file *my_fp = calloc(1, sizeof(blosc2_uring_file));
+  if (my_fp == NULL) {
+    close(fd);
+    return NULL;
+  }
+  my_fp->fd = fd;
+  my_fp->append = mode[0] == 'a';
+  return my_fp;
+}
+
+int blosc2_uring_close(void *stream) {
+  blosc2_uring_file *my_fp = (blosc2_uring_file *) stream;
+  int err = close(my_fp->fd);
+  free(my_fp);
+  return err;
+}
+
+int64_t blosc2_uring_tell(void *stream) {
+  blosc2_uring_file *my_fp = (blosc2_uring_file *) stream;
+  return my_fp->pos;
+}
+
+int blosc2_uring_seek(void *stream, int64_t offset, int whence) {
+  blosc2_uring_file *my_fp = (blosc2_uring_file *) stream;
+  int64_t pos;
+  switch (whence) {
+    case SEEK_SET:
+      pos = offset;
+      break;
+    case SEEK_CUR:
+      pos = my_fp->pos + offset;
+      break;
+    case SEEK_END: {
+      struct stat st;
+      if (fstat(my_fp->fd, &st) < 0) {
+        return -1;
+      }
+      pos = (int64_t) st.st_size + offset;
+      break;
+    }
+    default:
+      return -1;
+  }
+  if (pos < 0) {
+    return -1;
+  }
+  my_fp->pos = pos;
+  return 0;
+}
+
+int64_t blosc2_uring_write(const void *ptr, int64_t size, int64_t nitems, void *stream) {
+  blosc2_uring_file *my_fp = (blosc2_uring_file *) stream;
+  int64_t nbytes = size * nitems;
+  int64_t nwritten = 0;
+  while (nwritten < nbytes) {
+    ssize_t rc;
+    if (my_fp->append) {
+      // pwrite() does not honor the offset for O_APPEND files
+      rc = write(my_fp->fd, (const uint8_t *) ptr + nwritten, (size_t) (nbytes - nwritten));
+    }
+    else {
+      rc = pwrite(my_fp->fd, (const uint8_t *) ptr + nwritten, (size_t) (nbytes - nwritten),
+                  (off_t) (my_fp->pos + nwritten));
+    }
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      break;
+    }
+    nwritten += rc;
+  }
+  if (my_fp->append) {
+    my_fp->pos = (int64_t) lseek(my_fp->fd, 0, SEEK_END);
+  }
+  else {
+    my_fp->pos += nwritten;
+  }
+  return size > 0 ? nwritten / size : 0;
+}
+
+int64_t blosc2_uring_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  blosc2_uring_file *my_fp = (blosc2_uring_file *) stream;
+  int64_t nread = pread_full(my_fp->fd, ptr, size * nitems, my_fp->pos);
+  my_fp->pos += nread;
+  return size > 0 ? nread / size : 0;
+}
+
+int blosc2_uring_truncate(void *stream, int64_t size) {
+  blosc2_uring_file *my_fp = (blosc2_uring_file *) stream;
+  return ftruncate(my_fp->fd, (off_t) size);
+}
+
+int blosc2_uring_sync(void *stream) {
+  blosc2_uring_file *my_fp = (blosc2_uring_file *) stream;
+  return fsync(my_fp->fd);
+}
+
+void *blosc2_uring_read_submit(void *stream, int32_t nreads, void **ptrs, const int64_t *offsets,
+                               const int64_t *sizes) {
+  blosc2_uring_file *my_fp = (blosc2_uring_file *) stream;
+  uring_request *req = calloc(1, sizeof(uring_request));
+  if (req == NULL) {
+    return NULL;
+  }
+  req->ptrs = malloc(nreads * sizeof(void *));
+  req->offsets = malloc(nreads * sizeof(int64_t));
+  req->sizes = malloc(nreads * sizeof(int64_t));
+  req->nread = malloc(nreads * sizeof(int64_t));
+  if (req->ptrs == NULL || req->offsets == NULL || req->sizes == NULL || req->nread == NULL) {
+    free(req->ptrs);
+    free(req->offsets);
+    free(req->sizes);
+    free(req->nread);
+    free(req);
+    return NULL;
+  }
+  memcpy(req->ptrs, ptrs, nreads * sizeof(void *));
+  memcpy(req->offsets, offsets, nreads * sizeof(int64_t));
+  memcpy(req->sizes, sizes, nreads * sizeof(int64_t));
+  for (int32_t i = 0; i < nreads; i++) {
+    req->nread[i] = -1;
+  }
+  req->fd = my_fp->fd;
+  req->nreads = nreads;
+  pthread_mutex_init(&req->mutex, NULL);
+  req->ring = ring_acquire();
+  if (req->ring != NULL && request_submit(req) < 0) {
+    request_drop_ring(req);
+  }
+  return req;
+}
+
+int64_t blosc2_uring_read_wait(void *request, int32_t i) {
+  uring_request *req = (uring_request *) request;
+  if (i < 0 || i >= req->nreads || request_wait(req, i) < 0) {
+    return -1;
+  }
+  return req->nread[i];
+}
+
+int64_t blosc2_uring_read_end(void *request) {
+  uring_request *req = (uring_request *) request;
+  if (request_wait(req, -1) < 0) {
+    // The buffers may still be written to; the request is leaked along with the ring
+    return -1;
+  }
+  int64_t nread = 0;
+  for (int32_t i = 0; i < req->nreads; i++) {
+    nread += req->nread[i];
+  }
+  if (req->ring != NULL) {
+    ring_release(req->ring);
+  }
+  pthread_mutex_destroy(&req->mutex);
+  free(req->ptrs);
+  free(req->offsets);
+  free(req->sizes);
+  free(req->nread);
+  free(req);
+  return nread;
+}
+
+int64_t blosc2_uring_read_batch(void *stream, int32_t nreads, void **ptrs, const int64_t *offsets,
+                                const int64_t *sizes) {
+  void *req = blosc2_uring_read_submit(stream, nreads, ptrs, offsets, sizes);
+  if (req == NULL) {
+    return -1;
+  }
+  return blosc2_uring_read_end(req);
+}
+
+void blosc2_uring_destroy(void) {
+  pthread_mutex_lock(&ring_pool_mutex);
+  while (ring_pool_len > 0) {
+    ring_free(ring_pool[--ring_pool_len]);
+  }
+  pthread_mutex_unlock(&ring_pool_mutex);
+}
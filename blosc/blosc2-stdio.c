@@ -12,6 +12,10 @@
 #include "blosc2/blosc2-stdio.h"
 #include "blosc2.h"
 
+#if defined(_WIN32)
+#include <io.h>
+#endif
+
 void *blosc2_stdio_open(const char *urlpath, const char *mode, void *params) {
   BLOSC_UNUSED_PARAM(params);
   FILE *file = fopen(urlpath, mode);
@@ -74,3 +78,17 @@ int blosc2_stdio_truncate(void *stream, int64_t size) {
 #endif
   return rc;
 }
+
+int blosc2_stdio_sync(void *stream) {
+  blosc2_stdio_file *my_fp = (blosc2_stdio_file *) stream;
+  if (fflush(my_fp->file) != 0) {
+    return -1;
+  }
+  int rc;
+#if defined(_WIN32)
+  rc = _commit(_fileno(my_fp->file));
+#else
+  rc = fsync(fileno(my_fp->file));
+#endif
+  return rc;
+}
@@ -20,13 +20,16 @@
 #include "blosc2.h"
 #include "blosc-private.h"
 #include "../plugins/codecs/zfp/blosc2-zfp.h"
+#include "../plugins/codecs/forpack/forpack.h"
 #include "frame.h"
+#include "sframe.h"
 
 
 #if defined(USING_CMAKE)
   #include "config.h"
 #endif /*  USING_CMAKE */
 #include "context.h"
+#include "zonemap.h"
 
 #include "shuffle.h"
 #include "delta.h"
@@ -51,6 +54,12 @@
 #elif defined(HAVE_ZLIB)
   #include "zlib.h"
 #endif /*  HAVE_MINIZ */
+#if defined(HAVE_IO_URING)
+  #include "blosc2/blosc2-io-uring.h"
+#endif
+#if defined(HAVE_IO_DIRECT)
+  #include "blosc2/blosc2-io-direct.h"
+#endif
 #if defined(HAVE_ZSTD)
   #include "zstd.h"
   #include "zstd_errors.h"
@@ -91,9 +100,39 @@ uint8_t g_ncodecs = 0;
 static blosc2_filter g_filters[256] = {0};
 static uint64_t g_nfilters = 0;
 
+/* The state hooks of the codecs and filters registered with blosc2_register_*_ex(), by id */
+typedef struct {
+  blosc2_plugin_init_cb init;
+  blosc2_plugin_destroy_cb destroy;
+  blosc2_codec_encoder_ex_cb encoder;
+  blosc2_codec_decoder_ex_cb decoder;
+} codec_hooks;
+
+typedef struct {
+  blosc2_plugin_init_cb init;
+  blosc2_plugin_destroy_cb destroy;
+  blosc2_filter_forward_ex_cb forward;
+  blosc2_filter_backward_ex_cb backward;
+} filter_hooks;
+
+static codec_hooks g_codec_hooks[256] = {0};
+static filter_hooks g_filter_hooks[256] = {0};
+
 static blosc2_io_cb g_io[256] = {0};
 static uint64_t g_nio = 0;
 
+/* The callbacks of the io backends that do not fit in blosc2_io_cb, in the same order as g_io */
+typedef struct {
+  blosc2_read_batch_cb read_batch;
+  // Asynchronous batched reads (only the io_uring backend has them)
+  void* (*read_submit)(void *stream, int32_t nreads, void **ptrs, const int64_t *offsets, const int64_t *sizes);
+  int64_t (*read_wait)(void *request, int32_t nread);
+  int64_t (*read_end)(void *request);
+  blosc2_sync_cb sync;
+} io_hooks;
+
+static io_hooks g_io_hooks[256] = {0};
+
 
 // Forward declarations
 int init_threadpool(blosc2_context *context);
@@ -472,15 +511,62 @@ static int zlib_wrap_decompress(const char* input, size_t compressed_length,
 
 
 #if defined(HAVE_ZSTD)
+/* Minimum block size for letting ZSTD use its own workers (2x ZSTDMT_JOBSIZE_MIN) */
+#define BLOSC_ZSTD_MT_MINBLOCK (1024 * 1024)
+
+/* Number of ZSTD workers to use for a block.  When BLOSC2_ZSTD_WORKERS is set and a
+   chunk has fewer blocks than threads, the spare threads are handed to ZSTD so that
+   large blocks (e.g. the ones chosen for HCR codecs) are still compressed using all
+   the cores. */
+static int zstd_nworkers(blosc2_context* context, size_t input_length) {
+  if (!(context->compcode_meta & BLOSC2_ZSTD_WORKERS)) {
+    return 0;
+  }
+  if (context->nthreads <= 1 || input_length < BLOSC_ZSTD_MT_MINBLOCK) {
+    return 0;
+  }
+  /* Blocks compressed at the same time (mirrors the serial/parallel choice in do_job) */
+  int32_t nconcurrent = (context->sourcesize / context->blocksize <= 1) ? 1 : context->nblocks;
+  if (nconcurrent >= context->nthreads) {
+    return 0;
+  }
+  return context->nthreads / nconcurrent;
+}
+
+/* Setup the ZSTD context for multithreaded compression.  Returns false if the
+   ZSTD library does not support it. */
+static bool zstd_setup_workers(ZSTD_CCtx* cctx, int clevel, int nworkers, size_t input_length) {
+  ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+  if (ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, clevel))) {
+    return false;
+  }
+  if (ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, nworkers))) {
+    // ZSTD has been compiled without multithreading support
+    return false;
+  }
+  size_t jobsize = input_length / nworkers;
+  if (jobsize < BLOSC_ZSTD_MT_MINBLOCK / 2) {
+    jobsize = BLOSC_ZSTD_MT_MINBLOCK / 2;
+  }
+  ZSTD_CCtx_setParameter(cctx, ZSTD_c_jobSize, (int)jobsize);
+  return true;
+}
+
+/* Map a Blosc clevel into a ZSTD one */
+static int zstd_clevel(int clevel) {
+  clevel = (clevel < 9) ? clevel * 2 - 1 : ZSTD_maxCLevel();
+  /* Make the level 8 close enough to maxCLevel */
+  if (clevel == 8) clevel = ZSTD_maxCLevel() - 2;
+  return clevel;
+}
+
 static int zstd_wrap_compress(struct thread_context* thread_context,
                               const char* input, size_t input_length,
                               char* output, size_t maxout, int clevel) {
   size_t code;
   blosc2_context* context = thread_context->parent_context;
 
-  clevel = (clevel < 9) ? clevel * 2 - 1 : ZSTD_maxCLevel();
-  /* Make the level 8 close enough to maxCLevel */
-  if (clevel == 8) clevel = ZSTD_maxCLevel() - 2;
+  clevel = zstd_clevel(clevel);
 
   if (thread_context->zstd_cctx == NULL) {
     thread_context->zstd_cctx = ZSTD_createCCtx();
@@ -492,8 +578,15 @@ static int zstd_wrap_compress(struct thread_context* thread_context,
             thread_context->zstd_cctx, (void*)output, maxout, (void*)input,
             input_length, context->dict_cdict);
   } else {
-    code = ZSTD_compressCCtx(thread_context->zstd_cctx,
-        (void*)output, maxout, (void*)input, input_length, clevel);
+    int nworkers = zstd_nworkers(context, input_length);
+    if (nworkers > 1 && zstd_setup_workers(thread_context->zstd_cctx, clevel, nworkers, input_length)) {
+      code = ZSTD_compress2(thread_context->zstd_cctx,
+          (void*)output, maxout, (void*)input, input_length);
+    }
+    else {
+      code = ZSTD_compressCCtx(thread_context->zstd_cctx,
+          (void*)output, maxout, (void*)input, input_length, clevel);
+    }
   }
   if (ZSTD_isError(code) != ZSTD_error_no_error) {
     // Do not print anything because blosc will just memcpy this buffer
@@ -530,8 +623,105 @@ static int zstd_wrap_decompress(struct thread_context* thread_context,
   }
   return (int)code;
 }
+
+/* Maximum window for the chunk-window mode (larger ones would need ZSTD_d_windowLogMax) */
+#define BLOSC_ZSTD_WINDOWLOG_MAX 27
+
+/* Start a new ZSTD stream for the blocks of a chunk in chunk-window mode */
+static int zstd_window_start(struct thread_context* thread_context) {
+  blosc2_context* context = thread_context->parent_context;
+
+  if (context->do_compress) {
+    if (thread_context->zstd_cctx == NULL) {
+      thread_context->zstd_cctx = ZSTD_createCCtx();
+      BLOSC_ERROR_NULL(thread_context->zstd_cctx, BLOSC2_ERROR_MEMORY_ALLOC);
+    }
+    ZSTD_CCtx* cctx = thread_context->zstd_cctx;
+    /* A window covering the whole chunk */
+    int windowlog = 10;
+    while (windowlog < BLOSC_ZSTD_WINDOWLOG_MAX && ((int64_t)1 << windowlog) < context->sourcesize) {
+      windowlog++;
+    }
+    ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+    if (ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, zstd_clevel(context->clevel))) ||
+        ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_enableLongDistanceMatching, 1)) ||
+        ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, windowlog))) {
+      BLOSC_TRACE_ERROR("Cannot set the ZSTD params for the chunk-window mode.");
+      return BLOSC2_ERROR_CODEC_PARAM;
+    }
+  }
+  else {
+    if (thread_context->zstd_dctx == NULL) {
+      thread_context->zstd_dctx = ZSTD_createDCtx();
+      BLOSC_ERROR_NULL(thread_context->zstd_dctx, BLOSC2_ERROR_MEMORY_ALLOC);
+    }
+    ZSTD_DCtx_reset(thread_context->zstd_dctx, ZSTD_reset_session_only);
+  }
+  thread_context->zstd_window_nblock = 0;
+
+  return 0;
+}
+
+/* Compress a block as the continuation of the ZSTD stream of the chunk.  The stream
+   is flushed, so that the block can be decompressed as soon as its data is read. */
+static int zstd_window_compress(struct thread_context* thread_context,
+                                const char* input, size_t input_length,
+                                char* output, size_t maxout) {
+  ZSTD_inBuffer in = {input, input_length, 0};
+  ZSTD_outBuffer out = {output, maxout, 0};
+  size_t remaining;
+  do {
+    remaining = ZSTD_compressStream2(thread_context->zstd_cctx, &out, &in, ZSTD_e_flush);
+    if (ZSTD_isError(remaining)) {
+      return 0;
+    }
+  } while (remaining > 0 && out.pos < out.size);
+  if (remaining > 0) {
+    // The block does not fit in the output
+    return 0;
+  }
+  return (int)out.pos;
+}
+
+static int zstd_window_decompress(struct thread_context* thread_context,
+                                  const char* input, size_t compressed_length,
+                                  char* output, size_t maxout) {
+  ZSTD_inBuffer in = {input, compressed_length, 0};
+  ZSTD_outBuffer out = {output, maxout, 0};
+  while (in.pos < in.size || out.pos < out.size) {
+    size_t in_pos = in.pos;
+    size_t out_pos = out.pos;
+    size_t code = ZSTD_decompressStream(thread_context->zstd_dctx, &out, &in);
+    if (ZSTD_isError(code)) {
+      BLOSC_TRACE_ERROR("Error in ZSTD decompression: '%s'.  Giving up.",
+                        ZDICT_getErrorName(code));
+      return 0;
+    }
+    if (in.pos == in_pos && out.pos == out_pos) {
+      break;
+    }
+  }
+  if (in.pos != in.size) {
+    BLOSC_TRACE_ERROR("ZSTD stream does not match the block boundaries.");
+    return 0;
+  }
+  return (int)out.pos;
+}
 #endif /*  HAVE_ZSTD */
 
+/* Whether the blocks of the chunk form a single ZSTD stream (see BLOSC2_ZSTD_CHUNK_WINDOW) */
+static bool zstd_chunk_window(blosc2_context* context) {
+#if defined(HAVE_ZSTD)
+  uint8_t compformat = (context->header_flags & (uint8_t)0xe0) >> 5u;
+  return (compformat == BLOSC_ZSTD_FORMAT) &&
+         (context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH) &&
+         (context->compcode_meta & BLOSC2_ZSTD_CHUNK_WINDOW) && !context->use_dict;
+#else
+  BLOSC_UNUSED_PARAM(context);
+  return false;
+#endif
+}
+
 /* Compute acceleration for blosclz */
 static int get_accel(const blosc2_context* context) {
   int clevel = context->clevel;
@@ -671,7 +861,7 @@ int read_chunk_header(const uint8_t* src, int32_t srcsize, bool extended_header,
     header->cbytes = bswap32_(header->cbytes);
   }
 
-  if (header->version > BLOSC2_VERSION_FORMAT) {
+  if (header->version > BLOSC2_VERSION_FORMAT_MAX) {
     /* Version from future */
     return BLOSC2_ERROR_VERSION_SUPPORT;
   }
@@ -817,12 +1007,77 @@ static int blosc2_intialize_header_from_context(blosc2_context* context, blosc_h
     if (context->blosc2_flags & BLOSC2_INSTR_CODEC) {
       header->blosc2_flags |= BLOSC2_INSTR_CODEC;
     }
+    if (zstd_chunk_window(context)) {
+      /* Readers not knowing about this mode would decode the blocks independently */
+      header->version = BLOSC2_VERSION_FORMAT_ZSTD_WINDOW;
+    }
   }
 
   return 0;
 }
 
 
+void invalidate_plugin_states(blosc2_context* context) {
+  if (context != NULL) {
+    context->plugin_epoch++;
+  }
+}
+
+/* Release the state of a user-defined codec or filter */
+static void release_plugin_state(struct plugin_state* pstate) {
+  if (pstate->state != NULL && pstate->destroy != NULL) {
+    pstate->destroy(pstate->state);
+  }
+  pstate->id = -1;
+  pstate->state = NULL;
+  pstate->destroy = NULL;
+}
+
+/* Get the state of a user-defined codec or filter, creating it via its init hook if needed */
+static int get_plugin_state(struct thread_context* thread_context, struct plugin_state* pstate, int id,
+                            uint8_t meta, blosc2_plugin_init_cb init, blosc2_plugin_destroy_cb destroy,
+                            blosc2_cparams* cparams, blosc2_dparams* dparams, void** state) {
+  blosc2_context* context = thread_context->parent_context;
+  bool compress = (cparams != NULL);
+  if (init == NULL) {
+    *state = NULL;
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (pstate->id == id && pstate->meta == meta && pstate->compress == compress &&
+      pstate->typesize == context->typesize && pstate->epoch == context->plugin_epoch) {
+    *state = pstate->state;
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  release_plugin_state(pstate);
+  void* new_state = NULL;
+  int rc = init(meta, cparams, dparams, &new_state);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Init hook of user-defined plugin %d failed", id);
+    return rc;
+  }
+  pstate->id = id;
+  pstate->meta = meta;
+  pstate->compress = compress;
+  pstate->typesize = context->typesize;
+  pstate->epoch = context->plugin_epoch;
+  pstate->state = new_state;
+  pstate->destroy = destroy;
+  *state = new_state;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Get the state of the user-defined codec of the context for decoding, creating it if needed */
+static int get_codec_decoder_state(struct thread_context* thread_context, void** state) {
+  blosc2_context* context = thread_context->parent_context;
+  codec_hooks *hooks = &g_codec_hooks[context->compcode];
+  blosc2_dparams dparams;
+  blosc2_ctx_get_dparams(context, &dparams);
+  return get_plugin_state(thread_context, &thread_context->codec_state, context->compcode,
+                          context->compcode_meta, hooks->init, hooks->destroy, NULL, &dparams, state);
+}
+
+
 uint8_t* pipeline_forward(struct thread_context* thread_context, const int32_t bsize,
                           const uint8_t* src, const int32_t offset,
                           uint8_t* dest, uint8_t* tmp, uint8_t* tmp2) {
@@ -909,7 +1164,18 @@ uint8_t* pipeline_forward(struct thread_context* thread_context, const int32_t b
       // Look for the filters_meta in user filters and run it
       for (uint64_t j = 0; j < g_nfilters; ++j) {
         if (g_filters[j].id == filters[i]) {
-          if (g_filters[j].forward != NULL) {
+          filter_hooks *hooks = &g_filter_hooks[g_filters[j].id];
+          if (hooks->forward != NULL) {
+            blosc2_cparams cparams;
+            blosc2_ctx_get_cparams(context, &cparams);
+            void *state;
+            rc = get_plugin_state(thread_context, &thread_context->filter_states[i], g_filters[j].id,
+                                  filters_meta[i], hooks->init, hooks->destroy, &cparams, NULL, &state);
+            if (rc < 0) {
+              return NULL;
+            }
+            rc = hooks->forward(_src, _dest, bsize, filters_meta[i], &cparams, g_filters[j].id, state);
+          } else if (g_filters[j].forward != NULL) {
             blosc2_cparams cparams;
             blosc2_ctx_get_cparams(context, &cparams);
             rc = g_filters[j].forward(_src, _dest, bsize, filters_meta[i], &cparams, g_filters[j].id);
@@ -967,6 +1233,58 @@ static bool get_run(const uint8_t* ip, const uint8_t* ip_bound) {
   return ip == ip_bound ? true : false;
 }
 
+/* Parameters for sampling streams when predicting whether they are compressible */
+#define PROBE_MIN_SIZE (4 * 1024)
+#define PROBE_NWINDOWS 8
+#define PROBE_WINDOW 512
+#define PROBE_HASHLOG 10
+
+/* Guess whether a stream cannot be compressed by the regular codecs.  A sample of
+   the stream should have an almost flat byte histogram (so entropy coding does not help)
+   and very few repeated 4-byte sequences (so there are no matches either). */
+static bool is_incompressible(const uint8_t* src, int32_t size) {
+  if (size < PROBE_MIN_SIZE) {
+    return false;
+  }
+  // Several histograms, so that updates of repeated bytes do not stall each other
+  uint32_t counts[4][256];
+  uint32_t seqs[1U << PROBE_HASHLOG];
+  memset(counts, 0, sizeof(counts));
+  memset(seqs, 0, sizeof(seqs));
+
+  int32_t step = size / PROBE_NWINDOWS;
+  int32_t nmatches = 0;
+  for (int w = 0; w < PROBE_NWINDOWS; w++) {
+    const uint8_t* ip = src + w * step;
+    for (int i = 0; i < PROBE_WINDOW; i += 4) {
+      counts[0][ip[i]]++;
+      counts[1][ip[i + 1]]++;
+      counts[2][ip[i + 2]]++;
+      counts[3][ip[i + 3]]++;
+    }
+    for (int i = 0; i < PROBE_WINDOW - 3; i++) {
+      uint32_t seq;
+      memcpy(&seq, ip + i, sizeof(seq));
+      uint32_t hval = (seq * 2654435761U) >> (32U - PROBE_HASHLOG);
+      nmatches += (seqs[hval] == seq);
+      seqs[hval] = seq;
+    }
+  }
+
+  int64_t n = PROBE_NWINDOWS * PROBE_WINDOW;
+  if (nmatches * 64 > n) {
+    return false;
+  }
+  // For uniformly distributed bytes, the sum of squared counts is about n + n^2 / 256
+  int64_t sumsq = 0;
+  for (int i = 0; i < 256; i++) {
+    int64_t count = counts[0][i] + counts[1][i] + counts[2][i] + counts[3][i];
+    sumsq += count * count;
+  }
+  // Allow a 10% excess, which still means more than 7.8 bits of entropy per byte
+  return sumsq * 256 * 10 <= (n * n + 256 * n) * 11;
+}
+
 
 /* Shuffle & compress a single block */
 static int blosc_c(struct thread_context* thread_context, int32_t bsize,
@@ -996,6 +1314,19 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
     blosc_set_timestamp(&last);
   }
 
+  // Summarize the block while it is still in cache
+  zonemap_block_stats(context, src, offset, bsize);
+
+  bool chunk_window = zstd_chunk_window(context);
+#if defined(HAVE_ZSTD)
+  if (chunk_window && offset == 0) {
+    int rc = zstd_window_start(thread_context);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+#endif /* HAVE_ZSTD */
+
   // See whether we have a run here
   if (last_filter_index >= 0 || context->prefilter != NULL) {
     /* Apply the filter pipeline just for the prefilter */
@@ -1027,6 +1358,13 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
   /* Calculate acceleration for different compressors */
   accel = get_accel(context);
 
+  /* BloscLZ does its own entropy probing, and user-defined codecs may be lossy,
+     so predicting incompressible data only makes sense for the other codecs.  The
+     sample may miss long-period repetitions, so this is opt-in. */
+  bool probe_codec = (context->compcode == BLOSC_LZ4 || context->compcode == BLOSC_LZ4HC ||
+                      context->compcode == BLOSC_ZLIB || context->compcode == BLOSC_ZSTD) &&
+                     (context->compcode_meta & BLOSC2_PROBE_INCOMPRESSIBLE) && !context->use_dict;
+
   /* The number of compressed data streams for this block */
   if (!dont_split && !leftoverblock && !dict_training) {
     nstreams = (int32_t)typesize;
@@ -1108,6 +1446,10 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
       memcpy(dest, _src + j * neblock, (unsigned int)neblock);
       cbytes = (int32_t)neblock;
     }
+    else if (probe_codec && is_incompressible(_src + j * neblock, neblock)) {
+      // Do not waste time with the codec; the stream will be stored as is
+      cbytes = 0;
+    }
     else if (context->compcode == BLOSC_BLOSCLZ) {
       cbytes = blosclz_compress(context->clevel, _src + j * neblock,
                                 (int)neblock, dest, maxout, context);
@@ -1132,9 +1474,16 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
   #endif /* HAVE_ZLIB */
   #if defined(HAVE_ZSTD)
     else if (context->compcode == BLOSC_ZSTD) {
-      cbytes = zstd_wrap_compress(thread_context,
-                                  (char*)_src + j * neblock, (size_t)neblock,
-                                  (char*)dest, (size_t)maxout, context->clevel);
+      if (chunk_window) {
+        cbytes = zstd_window_compress(thread_context,
+                                      (char*)_src + j * neblock, (size_t)neblock,
+                                      (char*)dest, (size_t)maxout);
+      }
+      else {
+        cbytes = zstd_wrap_compress(thread_context,
+                                    (char*)_src + j * neblock, (size_t)neblock,
+                                    (char*)dest, (size_t)maxout, context->clevel);
+      }
     }
   #endif /* HAVE_ZSTD */
     else if (context->compcode > BLOSC2_DEFINED_CODECS_STOP) {
@@ -1142,6 +1491,18 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
         if (g_codecs[i].compcode == context->compcode) {
           blosc2_cparams cparams;
           blosc2_ctx_get_cparams(context, &cparams);
+          codec_hooks *hooks = &g_codec_hooks[g_codecs[i].compcode];
+          if (hooks->encoder != NULL) {
+            void *state;
+            int rc = get_plugin_state(thread_context, &thread_context->codec_state, g_codecs[i].compcode,
+                                      context->compcode_meta, hooks->init, hooks->destroy, &cparams, NULL, &state);
+            if (rc < 0) {
+              return rc;
+            }
+            cbytes = hooks->encoder(_src + j * neblock, neblock, dest, maxout, context->compcode_meta,
+                                    &cparams, context->src, state);
+            goto urcodecsuccess;
+          }
           cbytes = g_codecs[i].encoder(_src + j * neblock,
                                         neblock,
                                         dest,
@@ -1171,6 +1532,10 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
       /* cbytes should never be negative */
       return BLOSC2_ERROR_DATA;
     }
+    if (chunk_window && (cbytes == 0 || cbytes >= neblock)) {
+      // The ZSTD stream cannot skip blocks, so the whole chunk is non-compressible
+      return 0;
+    }
     if (cbytes == 0) {
       // When cbytes is 0, the compressor has not been able to compress anything
       cbytes = neblock;
@@ -1297,7 +1662,18 @@ int pipeline_backward(struct thread_context* thread_context, const int32_t bsize
         // Look for the filters_meta in user filters and run it
         for (uint64_t j = 0; j < g_nfilters; ++j) {
           if (g_filters[j].id == filters[i]) {
-            if (g_filters[j].backward != NULL) {
+            filter_hooks *hooks = &g_filter_hooks[g_filters[j].id];
+            if (hooks->backward != NULL) {
+              blosc2_dparams dparams;
+              blosc2_ctx_get_dparams(context, &dparams);
+              void *state;
+              rc = get_plugin_state(thread_context, &thread_context->filter_states[i], g_filters[j].id,
+                                    filters_meta[i], hooks->init, hooks->destroy, NULL, &dparams, &state);
+              if (rc < 0) {
+                return rc;
+              }
+              rc = hooks->backward(_src, _dest, bsize, filters_meta[i], &dparams, g_filters[j].id, state);
+            } else if (g_filters[j].backward != NULL) {
               blosc2_dparams dparams;
               blosc2_ctx_get_dparams(context, &dparams);
               rc = g_filters[j].backward(_src, _dest, bsize, filters_meta[i], &dparams, g_filters[j].id);
@@ -1445,6 +1821,255 @@ static int32_t set_values(int32_t typesize, const uint8_t* src, uint8_t* dest, i
 }
 
 
+/* Open the file where a lazy chunk is.  Its blocks are at *chunk_start plus their offset
+   inside the chunk. */
+static void* open_lazy_chunk(blosc2_schunk* schunk, const uint8_t* src, int32_t nblocks, blosc2_io_cb* io_cb,
+                             int64_t* chunk_start) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  const blosc2_io* io = schunk->storage->io;
+  size_t trailer_offset = BLOSC_EXTENDED_HEADER_LENGTH + nblocks * sizeof(int32_t);
+  // The nchunk and the offset of the current chunk are in the trailer
+  int32_t nchunk = *(int32_t*)(src + trailer_offset);
+  int64_t chunk_offset = *(int64_t*)(src + trailer_offset + sizeof(int32_t));
+
+  if (frame->sframe && frame->segment_size > 0) {
+    // The chunk is packed in a segment file (nchunk is the segment here)
+    *chunk_start = chunk_offset;
+    return sframe_open_segment(frame->urlpath, nchunk, "rb", io);
+  }
+  if (frame->sframe) {
+    // The chunk is not in the frame
+    *chunk_start = 0;
+    return sframe_open_chunk(frame->urlpath, nchunk, "rb", io);
+  }
+  *chunk_start = frame->file_offset + chunk_offset;
+  return io_cb->open(frame->urlpath, "rb", io->params);
+}
+
+
+/* Start reading the blocks of a lazy chunk that are not masked out (all of them if maskout
+   is NULL) with a single call to the io backend.  Returns 1 if the blocks are being read,
+   0 if the backend cannot read in batches or a negative value in case of errors. */
+static int lazy_read_start(blosc2_schunk* schunk, lazy_read* lazy, const uint8_t* src, int32_t srcsize,
+                           int32_t nblocks, const bool* maskout) {
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(schunk->storage->io->id);
+  if (io_cb == NULL) {
+    return 0;
+  }
+  io_hooks *hooks = &g_io_hooks[io_cb - g_io];
+  if (hooks->read_batch == NULL && hooks->read_submit == NULL) {
+    return 0;
+  }
+
+  size_t trailer_offset = BLOSC_EXTENDED_HEADER_LENGTH + nblocks * sizeof(int32_t);
+  size_t trailer_len = sizeof(int32_t) + sizeof(int64_t) + nblocks * sizeof(int32_t);
+  if ((size_t)srcsize < trailer_offset + trailer_len) {
+    BLOSC_TRACE_ERROR("The lazy chunk is too small for its trailer.");
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+  const int32_t* bstarts = (const int32_t*)(src + BLOSC_EXTENDED_HEADER_LENGTH);
+  const int32_t* block_csizes = (const int32_t*)(src + trailer_offset + sizeof(int32_t) + sizeof(int64_t));
+
+  if (lazy->npos < nblocks) {
+    free(lazy->block_pos);
+    free(lazy->block_read);
+    lazy->block_pos = malloc(nblocks * sizeof(int64_t));
+    lazy->block_read = malloc(nblocks * sizeof(int32_t));
+    if (lazy->block_pos == NULL || lazy->block_read == NULL) {
+      free(lazy->block_pos);
+      free(lazy->block_read);
+      lazy->block_pos = NULL;
+      lazy->block_read = NULL;
+      lazy->npos = 0;
+      BLOSC_TRACE_ERROR("Error allocating memory!");
+      return BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    lazy->npos = nblocks;
+  }
+  int64_t total = 0;
+  int32_t nreads = 0;
+  for (int32_t i = 0; i < nblocks; i++) {
+    if (maskout != NULL && maskout[i]) {
+      lazy->block_pos[i] = -1;
+      continue;
+    }
+    lazy->block_pos[i] = total;
+    lazy->block_read[i] = nreads++;
+    total += block_csizes[i];
+  }
+  if (nreads == 0) {
+    return 0;
+  }
+  if (lazy->blocks_size < total) {
+    free(lazy->blocks);
+    lazy->blocks = malloc(total);
+    lazy->blocks_size = lazy->blocks != NULL ? total : 0;
+    BLOSC_ERROR_NULL(lazy->blocks, BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+
+  void** ptrs = malloc(nreads * sizeof(void*));
+  int64_t* offsets = malloc(nreads * sizeof(int64_t));
+  int64_t* sizes = malloc(nreads * sizeof(int64_t));
+  if (ptrs == NULL || offsets == NULL || sizes == NULL) {
+    free(ptrs);
+    free(offsets);
+    free(sizes);
+    BLOSC_TRACE_ERROR("Error allocating memory!");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  int64_t chunk_start;
+  void* fp = open_lazy_chunk(schunk, src, nblocks, io_cb, &chunk_start);
+  if (fp == NULL) {
+    free(ptrs);
+    free(offsets);
+    free(sizes);
+    BLOSC_TRACE_ERROR("Cannot open the file of the lazy chunk.");
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  for (int32_t i = 0; i < nblocks; i++) {
+    if (lazy->block_pos[i] < 0) {
+      continue;
+    }
+    int32_t j = lazy->block_read[i];
+    ptrs[j] = lazy->blocks + lazy->block_pos[i];
+    offsets[j] = chunk_start + sw32_(bstarts + i);
+    sizes[j] = block_csizes[i];
+  }
+
+  int rc = 1;
+  if (hooks->read_submit != NULL) {
+    // The blocks are waited for as they are decompressed
+    lazy->request = hooks->read_submit(fp, nreads, ptrs, offsets, sizes);
+    if (lazy->request == NULL) {
+      io_cb->close(fp);
+      BLOSC_TRACE_ERROR("Cannot submit the reads of the (lazy) blocks.");
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    else {
+      lazy->read_wait = hooks->read_wait;
+      lazy->read_end = hooks->read_end;
+      lazy->fp = fp;
+    }
+  }
+  else {
+    int64_t rbytes = hooks->read_batch(fp, nreads, ptrs, offsets, sizes);
+    io_cb->close(fp);
+    if (rbytes != total) {
+      BLOSC_TRACE_ERROR("Cannot read the (lazy) blocks out of the fileframe.");
+      rc = BLOSC2_ERROR_READ_BUFFER;
+    }
+  }
+  free(ptrs);
+  free(offsets);
+  free(sizes);
+  if (rc > 0) {
+    lazy->io_cb = io_cb;
+    lazy->chunk = src;
+    lazy->cbytes = srcsize;
+  }
+  return rc;
+}
+
+
+/* Wait for the reads of a batch still in flight and release it */
+static int lazy_read_end(lazy_read* lazy) {
+  int rc = 0;
+  if (lazy->request != NULL) {
+    if (lazy->read_end(lazy->request) < 0) {
+      // The reads may still write to the blocks, so they cannot be reused (nor freed)
+      BLOSC_TRACE_ERROR("Cannot wait for the reads of the (lazy) blocks.");
+      lazy->blocks = NULL;
+      lazy->blocks_size = 0;
+      rc = BLOSC2_ERROR_READ_BUFFER;
+    }
+    lazy->request = NULL;
+    lazy->io_cb->close(lazy->fp);
+    lazy->fp = NULL;
+  }
+  lazy->chunk = NULL;
+  return rc;
+}
+
+
+void lazychunk_read_ahead_cancel(blosc2_context* context) {
+  for (int i = 0; i < 2; i++) {
+    lazy_read_end(&context->lazy_reads[i]);
+  }
+}
+
+
+int lazychunk_read_ahead(blosc2_context* context, const uint8_t* chunk, int32_t cbytes) {
+  if (context->schunk == NULL || context->schunk->frame == NULL) {
+    return 0;
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(context->schunk->storage->io->id);
+  if (io_cb == NULL || g_io_hooks[io_cb - g_io].read_submit == NULL) {
+    // Reading ahead synchronously would not overlap with anything
+    return 0;
+  }
+  blosc_header header;
+  int rc = read_chunk_header(chunk, cbytes, true, &header);
+  if (rc < 0) {
+    return rc;
+  }
+  bool extended = (header.flags & BLOSC_DOSHUFFLE) && (header.flags & BLOSC_DOBITSHUFFLE);
+  bool special = ((header.blosc2_flags >> 4) & BLOSC2_SPECIAL_MASK) != BLOSC2_NO_SPECIAL;
+  if (!extended || !(header.blosc2_flags & 0x08u) || special || (header.flags & BLOSC_MEMCPYED)) {
+    return 0;
+  }
+  for (int i = 0; i < 2; i++) {
+    lazy_read* lazy = &context->lazy_reads[i];
+    if (lazy->chunk == chunk) {
+      return 1;
+    }
+    if (lazy->chunk == NULL) {
+      int32_t nblocks = header.nbytes / header.blocksize + (header.nbytes % header.blocksize > 0);
+      return lazy_read_start(context->schunk, lazy, chunk, cbytes, nblocks, NULL);
+    }
+  }
+  return 0;
+}
+
+
+/* Read the blocks to be decompressed out of a lazy chunk with a single call, if the io
+   backend supports batched reads (or use the ones read ahead).  Otherwise, blosc_d reads
+   them one by one. */
+static int read_lazy_blocks(blosc2_context* context) {
+  context->lazy_current = NULL;
+  bool is_lazy = ((context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH) &&
+                  (context->blosc2_flags & 0x08u) && !context->special_type);
+  bool memcpyed = context->header_flags & (uint8_t)BLOSC_MEMCPYED;
+  if (!is_lazy || memcpyed || context->schunk == NULL || context->schunk->frame == NULL) {
+    return 0;
+  }
+
+  lazy_read* lazy = NULL;
+  for (int i = 0; i < 2; i++) {
+    if (context->lazy_reads[i].chunk == context->src && context->lazy_reads[i].cbytes == context->srcsize) {
+      // All its blocks have been read ahead
+      context->lazy_current = &context->lazy_reads[i];
+      return 0;
+    }
+    if (lazy == NULL && context->lazy_reads[i].chunk == NULL) {
+      lazy = &context->lazy_reads[i];
+    }
+  }
+  if (lazy == NULL) {
+    // Nobody is going to use the blocks read ahead
+    lazychunk_read_ahead_cancel(context);
+    lazy = &context->lazy_reads[0];
+  }
+  // Blocks in chunk-window mode are needed for decompressing the next ones
+  const bool* maskout = zstd_chunk_window(context) ? NULL : context->block_maskout;
+  int rc = lazy_read_start(context->schunk, lazy, context->src, context->srcsize, context->nblocks, maskout);
+  if (rc > 0) {
+    context->lazy_current = lazy;
+  }
+
+  return rc < 0 ? rc : 0;
+}
+
+
 /* Decompress & unshuffle a single block */
 static int blosc_d(
     struct thread_context* thread_context, int32_t bsize,
@@ -1468,8 +2093,10 @@ static int blosc_d(
   bool instr_codec = context->blosc2_flags & BLOSC2_INSTR_CODEC;
   const char* compname;
   int rc;
+  // Blocks in chunk-window mode are needed for decompressing the next ones
+  bool chunk_window = zstd_chunk_window(context);
 
-  if (context->block_maskout != NULL && context->block_maskout[nblock]) {
+  if (context->block_maskout != NULL && context->block_maskout[nblock] && !chunk_window) {
     // Do not decompress, but act as if we successfully decompressed everything
     return bsize;
   }
@@ -1498,50 +2125,39 @@ static int blosc_d(
       BLOSC_TRACE_ERROR("Lazy chunk needs an associated frame.");
       return BLOSC2_ERROR_INVALID_PARAM;
     }
-    blosc2_frame_s* frame = (blosc2_frame_s*)context->schunk->frame;
-    char* urlpath = frame->urlpath;
     size_t trailer_offset = BLOSC_EXTENDED_HEADER_LENGTH + context->nblocks * sizeof(int32_t);
-    int32_t nchunk;
-    int64_t chunk_offset;
-    // The nchunk and the offset of the current chunk are in the trailer
-    nchunk = *(int32_t*)(src + trailer_offset);
-    chunk_offset = *(int64_t*)(src + trailer_offset + sizeof(int32_t));
     // Get the csize of the nblock
     int32_t *block_csizes = (int32_t *)(src + trailer_offset + sizeof(int32_t) + sizeof(int64_t));
     int32_t block_csize = block_csizes[nblock];
-    // Read the lazy block on disk
-    void* fp = NULL;
-    blosc2_io_cb *io_cb = blosc2_get_io_cb(context->schunk->storage->io->id);
-    if (io_cb == NULL) {
-      BLOSC_TRACE_ERROR("Error getting the input/output API");
-      return BLOSC2_ERROR_PLUGIN_IO;
-    }
-
-    if (frame->sframe) {
-      // The chunk is not in the frame
-      char* chunkpath = malloc(strlen(frame->urlpath) + 1 + 8 + strlen(".chunk") + 1);
-      BLOSC_ERROR_NULL(chunkpath, BLOSC2_ERROR_MEMORY_ALLOC);
-      sprintf(chunkpath, "%s/%08X.chunk", frame->urlpath, nchunk);
-      fp = io_cb->open(chunkpath, "rb", context->schunk->storage->io->params);
-      BLOSC_ERROR_NULL(fp, BLOSC2_ERROR_FILE_OPEN);
-      free(chunkpath);
-      // The offset of the block is src_offset
-      io_cb->seek(fp, src_offset, SEEK_SET);
+    lazy_read* lazy = context->lazy_current;
+    if (lazy != NULL && lazy->block_pos[nblock] >= 0) {
+      // The block is read along with the rest of the chunk
+      if (lazy->request != NULL && lazy->read_wait(lazy->request, lazy->block_read[nblock]) != block_csize) {
+        BLOSC_TRACE_ERROR("Cannot read the (lazy) block out of the fileframe.");
+        return BLOSC2_ERROR_READ_BUFFER;
+      }
+      src = lazy->blocks + lazy->block_pos[nblock];
     }
     else {
-      fp = io_cb->open(urlpath, "rb", context->schunk->storage->io->params);
+      // Read the lazy block on disk
+      blosc2_io_cb *io_cb = blosc2_get_io_cb(context->schunk->storage->io->id);
+      if (io_cb == NULL) {
+        BLOSC_TRACE_ERROR("Error getting the input/output API");
+        return BLOSC2_ERROR_PLUGIN_IO;
+      }
+      int64_t chunk_start;
+      void* fp = open_lazy_chunk(context->schunk, src, context->nblocks, io_cb, &chunk_start);
       BLOSC_ERROR_NULL(fp, BLOSC2_ERROR_FILE_OPEN);
-      // The offset of the block is src_offset
-      io_cb->seek(fp, frame->file_offset + chunk_offset + src_offset, SEEK_SET);
-    }
-    // We can make use of tmp3 because it will be used after src is not needed anymore
-    int64_t rbytes = io_cb->read(tmp3, 1, block_csize, fp);
-    io_cb->close(fp);
-    if ((int32_t)rbytes != block_csize) {
-      BLOSC_TRACE_ERROR("Cannot read the (lazy) block out of the fileframe.");
-      return BLOSC2_ERROR_READ_BUFFER;
+      io_cb->seek(fp, chunk_start + src_offset, SEEK_SET);
+      // We can make use of tmp3 because it will be used after src is not needed anymore
+      int64_t rbytes = io_cb->read(tmp3, 1, block_csize, fp);
+      io_cb->close(fp);
+      if ((int32_t)rbytes != block_csize) {
+        BLOSC_TRACE_ERROR("Cannot read the (lazy) block out of the fileframe.");
+        return BLOSC2_ERROR_READ_BUFFER;
+      }
+      src = tmp3;
     }
-    src = tmp3;
     src_offset = 0;
     srcsize = block_csize;
   }
@@ -1627,6 +2243,21 @@ static int blosc_d(
   src += src_offset;
   srcsize -= src_offset;
 
+#if defined(HAVE_ZSTD)
+  if (chunk_window) {
+    if (nblock == 0) {
+      rc = zstd_window_start(thread_context);
+      if (rc < 0) {
+        return rc;
+      }
+    }
+    else if (nblock != thread_context->zstd_window_nblock) {
+      BLOSC_TRACE_ERROR("Blocks in ZSTD chunk-window mode must be decompressed in order.");
+      return BLOSC2_ERROR_DATA;
+    }
+  }
+#endif /* HAVE_ZSTD */
+
   int last_filter_index = last_filter(filters, 'd');
   if (instr_codec) {
     // If instrumented, we don't want to run the filters
@@ -1729,9 +2360,16 @@ static int blosc_d(
   #endif /*  HAVE_ZLIB */
   #if defined(HAVE_ZSTD)
       else if (compformat == BLOSC_ZSTD_FORMAT) {
-        nbytes = zstd_wrap_decompress(thread_context,
-                                      (char*)src, (size_t)cbytes,
-                                      (char*)_dest, (size_t)neblock);
+        if (chunk_window) {
+          nbytes = zstd_window_decompress(thread_context,
+                                          (char*)src, (size_t)cbytes,
+                                          (char*)_dest, (size_t)neblock);
+        }
+        else {
+          nbytes = zstd_wrap_decompress(thread_context,
+                                        (char*)src, (size_t)cbytes,
+                                        (char*)_dest, (size_t)neblock);
+        }
       }
   #endif /*  HAVE_ZSTD */
       else if (compformat == BLOSC_UDCODEC_FORMAT) {
@@ -1739,8 +2377,35 @@ static int blosc_d(
 
 #if defined(HAVE_PLUGINS)
         if ((context->compcode == BLOSC_CODEC_ZFP_FIXED_RATE) &&
+            (thread_context->zfp_box_stop != NULL)) {
+          void *state;
+          int rc = get_codec_decoder_state(thread_context, &state);
+          if (rc < 0) {
+            return rc;
+          }
+          nbytes = zfp_getcells(thread_context, src, cbytes, _dest, neblock, state);
+          if (nbytes < 0) {
+            return BLOSC2_ERROR_DATA;
+          }
+          getcell = true;
+        }
+        else if ((context->compcode == BLOSC_CODEC_FORPACK) &&
+                 (thread_context->codec_item_nitems > 0)) {
+          nbytes = forpack_getitem(src, cbytes, _dest, thread_context->codec_item_start,
+                                   thread_context->codec_item_nitems);
+          if (nbytes < 0) {
+            return BLOSC2_ERROR_DATA;
+          }
+          getcell = true;
+        }
+        else if ((context->compcode == BLOSC_CODEC_ZFP_FIXED_RATE) &&
             (thread_context->zfp_cell_nitems > 0)) {
-          nbytes = zfp_getcell(thread_context, src, cbytes, _dest, neblock);
+          void *state;
+          int rc = get_codec_decoder_state(thread_context, &state);
+          if (rc < 0) {
+            return rc;
+          }
+          nbytes = zfp_getcell(thread_context, src, cbytes, _dest, neblock, state);
           if (nbytes < 0) {
             return BLOSC2_ERROR_DATA;
           }
@@ -1755,6 +2420,19 @@ static int blosc_d(
             if (g_codecs[i].compcode == context->compcode) {
               blosc2_dparams dparams;
               blosc2_ctx_get_dparams(context, &dparams);
+              codec_hooks *hooks = &g_codec_hooks[g_codecs[i].compcode];
+              if (hooks->decoder != NULL) {
+                void *state;
+                int rc = get_plugin_state(thread_context, &thread_context->codec_state, g_codecs[i].compcode,
+                                          context->compcode_meta, hooks->init, hooks->destroy, NULL, &dparams,
+                                          &state);
+                if (rc < 0) {
+                  return rc;
+                }
+                nbytes = hooks->decoder(src, cbytes, _dest, neblock, context->compcode_meta, &dparams,
+                                        context->src, state);
+                goto urcodecsuccess;
+              }
               nbytes = g_codecs[i].decoder(src,
                                            cbytes,
                                            _dest,
@@ -1781,7 +2459,8 @@ static int blosc_d(
       }
 
       /* Check that decompressed bytes number is correct */
-      if ((nbytes != neblock) && (thread_context->zfp_cell_nitems == 0)) {
+      if ((nbytes != neblock) && (thread_context->zfp_cell_nitems == 0) &&
+          (thread_context->zfp_box_stop == NULL) && (thread_context->codec_item_nitems == 0)) {
         return BLOSC2_ERROR_DATA;
       }
 
@@ -1792,6 +2471,12 @@ static int blosc_d(
     ntbytes += nbytes;
   } /* Closes j < nstreams */
 
+#if defined(HAVE_ZSTD)
+  if (chunk_window) {
+    thread_context->zstd_window_nblock = nblock + 1;
+  }
+#endif /* HAVE_ZSTD */
+
   if (!instr_codec) {
     if (last_filter_index >= 0 || context->postfilter != NULL) {
       /* Apply regular filter pipeline */
@@ -1921,9 +2606,20 @@ static int init_thread_context(struct thread_context* thread_context, blosc2_con
   thread_context->tmp_blocksize = context->blocksize;
   thread_context->zfp_cell_nitems = 0;
   thread_context->zfp_cell_start = 0;
+  thread_context->zfp_box_start = NULL;
+  thread_context->zfp_box_stop = NULL;
+  thread_context->codec_item_start = 0;
+  thread_context->codec_item_nitems = 0;
+  thread_context->codec_state.state = NULL;
+  release_plugin_state(&thread_context->codec_state);
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+    thread_context->filter_states[i].state = NULL;
+    release_plugin_state(&thread_context->filter_states[i]);
+  }
   #if defined(HAVE_ZSTD)
   thread_context->zstd_cctx = NULL;
   thread_context->zstd_dctx = NULL;
+  thread_context->zstd_window_nblock = 0;
   #endif
 
   /* Create the hash table for LZ4 in case we are using IPP */
@@ -1960,6 +2656,10 @@ create_thread_context(blosc2_context* context, int32_t tid) {
 /* free members of thread_context, but not thread_context itself */
 static void destroy_thread_context(struct thread_context* thread_context) {
   my_free(thread_context->tmp);
+  release_plugin_state(&thread_context->codec_state);
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+    release_plugin_state(&thread_context->filter_states[i]);
+  }
 #if defined(HAVE_ZSTD)
   if (thread_context->zstd_cctx != NULL) {
     ZSTD_freeCCtx(thread_context->zstd_cctx);
@@ -2011,9 +2711,10 @@ static int do_job(blosc2_context* context) {
   /* Check whether we need to restart threads */
   check_nthreads(context);
 
-  /* Run the serial version when nthreads is 1 or when the buffers are
-     not larger than blocksize */
-  if (context->nthreads == 1 || (context->sourcesize / context->blocksize) <= 1) {
+  /* Run the serial version when nthreads is 1, when the buffers are
+     not larger than blocksize or when the blocks form a single ZSTD stream */
+  if (context->nthreads == 1 || (context->sourcesize / context->blocksize) <= 1 ||
+      zstd_chunk_window(context)) {
     /* The context for this 'thread' has no been initialized yet */
     if (context->serial_context == NULL) {
       context->serial_context = create_thread_context(context, 0);
@@ -2061,7 +2762,10 @@ static int initialize_context_compression(
   context->new_nthreads = new_nthreads;
   context->end_threads = 0;
   context->clevel = clevel;
-  context->schunk = schunk;
+  if (context->schunk != schunk) {
+    context->schunk = schunk;
+    invalidate_plugin_states(context);
+  }
   context->btune = btune_config;
   context->udbtune = udbtune;
   context->splitmode = splitmode;
@@ -2111,6 +2815,11 @@ static int initialize_context_compression(
 
   blosc2_calculate_blocks(context);
 
+  int rc = zonemap_ctx_start(context);
+  if (rc < 0) {
+    return rc;
+  }
+
   return 1;
 }
 
@@ -2268,14 +2977,16 @@ static int write_compression_header(blosc2_context* context, bool extended_heade
       context->header_flags |= BLOSC_DODELTA;
     }
 
+    /* codec starts at bit 5 */
+    uint8_t compformat = compcode_to_compformat(context->compcode);
+    context->header_flags |= compformat << 5;
+
+    /* A ZSTD stream per chunk does not mix well with splitting the blocks */
     dont_split = !split_block(context, context->typesize,
-                              context->blocksize);
+                              context->blocksize) || zstd_chunk_window(context);
 
     /* dont_split is in bit 4 */
     context->header_flags |= dont_split << 4;
-    /* codec starts at bit 5 */
-    uint8_t compformat = compcode_to_compformat(context->compcode);
-    context->header_flags |= compformat << 5;
   }
 
   // Create blosc header and store to dest
@@ -2360,6 +3071,13 @@ static int blosc_compress_context(blosc2_context* context) {
   /* Set the number of bytes in dest buffer (might be useful for btune) */
   context->destsize = ntbytes;
 
+  if (ntbytes > 0) {
+    zonemap_ctx_finish(context);
+  }
+  else {
+    context->zonemap_valid = false;
+  }
+
   if (context->btune != NULL) {
     blosc_set_timestamp(&current);
     double ctime = blosc_elapsed_secs(last, current);
@@ -2717,8 +3435,20 @@ static int blosc_run_decompression_with_context(blosc2_context* context, const v
     return rc;
   }
 
+  rc = read_lazy_blocks(context);
+  if (rc < 0) {
+    return rc;
+  }
+
   /* Do the actual decompression */
   ntbytes = do_job(context);
+  if (context->lazy_current != NULL) {
+    rc = lazy_read_end(context->lazy_current);
+    context->lazy_current = NULL;
+    if (rc < 0 && ntbytes >= 0) {
+      ntbytes = rc;
+    }
+  }
   if (ntbytes < 0) {
     return ntbytes;
   }
@@ -2803,6 +3533,22 @@ int blosc1_decompress(const void* src, void* dest, size_t destsize) {
 }
 
 
+/* Resize the temporaries in serial context if needed */
+static int resize_serial_tmp(struct thread_context* scontext, const blosc_header* header) {
+  if (header->blocksize > scontext->tmp_blocksize) {
+    int32_t ebsize = header->blocksize + header->typesize * (signed)sizeof(int32_t);
+    my_free(scontext->tmp);
+    scontext->tmp_nbytes = (size_t)4 * ebsize;
+    scontext->tmp = my_malloc(scontext->tmp_nbytes);
+    BLOSC_ERROR_NULL(scontext->tmp, BLOSC2_ERROR_MEMORY_ALLOC);
+    scontext->tmp2 = scontext->tmp + ebsize;
+    scontext->tmp3 = scontext->tmp2 + ebsize;
+    scontext->tmp4 = scontext->tmp3 + ebsize;
+    scontext->tmp_blocksize = (int32_t)header->blocksize;
+  }
+  return 0;
+}
+
 /* Specific routine optimized for decompression a small number of
    items out of a compressed chunk.  This does not use threads because
    it would affect negatively to performance. */
@@ -2811,7 +3557,7 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
   uint8_t* _src = (uint8_t*)(src);  /* current pos for source buffer */
   uint8_t* _dest = (uint8_t*)(dest);
   int32_t ntbytes = 0;              /* the number of uncompressed bytes */
-  int32_t bsize, bsize2, ebsize, leftoverblock;
+  int32_t bsize, bsize2, leftoverblock;
   int32_t startb, stopb;
   int32_t stop = start + nitems;
   int j, rc;
@@ -2853,6 +3599,7 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
 
   bool is_lazy = ((context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH) &&
                   (context->blosc2_flags & 0x08u) && !context->special_type);
+  bool chunk_window = zstd_chunk_window(context);
   if (memcpyed && !is_lazy && !context->postfilter) {
     // Short-circuit for (non-lazy) memcpyed or special values
     ntbytes = nitems * header->typesize;
@@ -2889,18 +3636,10 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
     return ntbytes;
   }
 
-  ebsize = header->blocksize + header->typesize * (signed)sizeof(int32_t);
   struct thread_context* scontext = context->serial_context;
-  /* Resize the temporaries in serial context if needed */
-  if (header->blocksize > scontext->tmp_blocksize) {
-    my_free(scontext->tmp);
-    scontext->tmp_nbytes = (size_t)4 * ebsize;
-    scontext->tmp = my_malloc(scontext->tmp_nbytes);
-    BLOSC_ERROR_NULL(scontext->tmp, BLOSC2_ERROR_MEMORY_ALLOC);
-    scontext->tmp2 = scontext->tmp + ebsize;
-    scontext->tmp3 = scontext->tmp2 + ebsize;
-    scontext->tmp4 = scontext->tmp3 + ebsize;
-    scontext->tmp_blocksize = (int32_t)header->blocksize;
+  rc = resize_serial_tmp(scontext, header);
+  if (rc < 0) {
+    return rc;
   }
 
   for (j = 0; j < context->nblocks; j++) {
@@ -2918,7 +3657,9 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
       // We can exit as soon as this block is beyond stop
       break;
     }
-    if (startb >= header->blocksize) {
+    // In ZSTD chunk-window mode, the previous blocks are needed for decoding the next ones
+    bool skip_block = (startb >= header->blocksize);
+    if (skip_block && (memcpyed || !chunk_window)) {
       continue;
     }
     if (startb < 0) {
@@ -2934,12 +3675,20 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
       scontext->zfp_cell_start = startb / context->typesize;
       scontext->zfp_cell_nitems = nitems;
     }
+    // FORPACK streams can be decoded item by item when they are not split nor filtered
+    if ((context->compcode == BLOSC_CODEC_FORPACK) && !skip_block && (context->header_flags & 0x10) &&
+        (last_filter(context->filters, 'd') < 0) && (context->postfilter == NULL) &&
+        !(context->blosc2_flags & BLOSC2_INSTR_CODEC) &&
+        (startb % context->typesize == 0) && (bsize2 % context->typesize == 0)) {
+      scontext->codec_item_start = startb / context->typesize;
+      scontext->codec_item_nitems = bsize2 / context->typesize;
+    }
 #endif /* HAVE_PLUGINS */
 
     /* Do the actual data copy */
     // Regular decompression.  Put results in tmp2.
     // If the block is aligned and the worst case fits in destination, let's avoid a copy
-    bool get_single_block = ((startb == 0) && (bsize == nitems * header->typesize));
+    bool get_single_block = ((startb == 0) && (bsize == nitems * header->typesize)) && !skip_block;
     uint8_t* tmp2 = get_single_block ? dest : scontext->tmp2;
 
     // If memcpyed we don't have a bstarts section (because it is not needed)
@@ -2953,6 +3702,9 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
       ntbytes = cbytes;
       break;
     }
+    if (skip_block) {
+      continue;
+    }
     if (scontext->zfp_cell_nitems > 0) {
       if (cbytes == bsize2) {
         memcpy((uint8_t *) dest, tmp2, (unsigned int) bsize2);
@@ -2961,13 +3713,16 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
         cbytes = bsize2;
       }
     } else if (!get_single_block) {
-      /* Copy to destination */
-      memcpy((uint8_t *) dest + ntbytes, tmp2 + startb, (unsigned int) bsize2);
+      /* Copy to destination (only the items asked for are there if they have been decoded one by one) */
+      bool items_decoded = (scontext->codec_item_nitems > 0) && (cbytes == bsize2);
+      memcpy((uint8_t *) dest + ntbytes, items_decoded ? tmp2 : tmp2 + startb, (unsigned int) bsize2);
     }
+    scontext->codec_item_nitems = 0;
     ntbytes += bsize2;
   }
 
   scontext->zfp_cell_nitems = 0;
+  scontext->codec_item_nitems = 0;
 
   return ntbytes;
 }
@@ -3029,6 +3784,78 @@ int blosc2_getitem_ctx(blosc2_context* context, const void* src, int32_t srcsize
   return result;
 }
 
+int blosc2_getcells_ctx(blosc2_context* context, const void* src, int32_t srcsize, int32_t nblock,
+                        const int64_t* start, const int64_t* stop, void* dest, int32_t destsize) {
+#if defined(HAVE_PLUGINS)
+  blosc_header header;
+  int result;
+
+  /* Minimally populate the context */
+  result = read_chunk_header((uint8_t *) src, srcsize, true, &header);
+  if (result < 0) {
+    return result;
+  }
+
+  context->src = src;
+  context->srcsize = srcsize;
+  context->dest = dest;
+  context->destsize = destsize;
+
+  result = blosc2_initialize_context_from_header(context, &header);
+  if (result < 0) {
+    return result;
+  }
+
+  /* Only blocks made of a single fixed-rate ZFP stream, without filters, can be decoded per cell */
+  bool memcpyed = header.flags & (uint8_t)BLOSC_MEMCPYED;
+  if ((context->compcode != BLOSC_CODEC_ZFP_FIXED_RATE) || context->special_type || memcpyed ||
+      !(context->header_flags & 0x10) || (context->postfilter != NULL) ||
+      (last_filter(context->filters, 'd') >= 0)) {
+    return 0;
+  }
+  if ((nblock < 0) || (nblock >= context->nblocks) ||
+      ((nblock == context->nblocks - 1) && (context->leftover > 0)) ||
+      (destsize < context->blocksize)) {
+    return 0;
+  }
+
+  context->bstarts = (int32_t*)((uint8_t*)src + context->header_overhead);
+  if ((uint8_t*)src + srcsize < (uint8_t*)(context->bstarts + context->nblocks)) {
+    BLOSC_TRACE_ERROR("`bstarts` out of bounds.");
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+
+  if (context->serial_context == NULL) {
+    context->serial_context = create_thread_context(context, 0);
+  }
+  BLOSC_ERROR_NULL(context->serial_context, BLOSC2_ERROR_THREAD_CREATE);
+  struct thread_context* scontext = context->serial_context;
+  result = resize_serial_tmp(scontext, &header);
+  if (result < 0) {
+    return result;
+  }
+
+  scontext->zfp_box_start = start;
+  scontext->zfp_box_stop = stop;
+  result = blosc_d(scontext, context->blocksize, 0, false, src, srcsize,
+                   sw32_(context->bstarts + nblock), nblock, dest, 0, scontext->tmp, scontext->tmp3);
+  scontext->zfp_box_start = NULL;
+  scontext->zfp_box_stop = NULL;
+
+  return result;
+#else
+  BLOSC_UNUSED_PARAM(context);
+  BLOSC_UNUSED_PARAM(src);
+  BLOSC_UNUSED_PARAM(srcsize);
+  BLOSC_UNUSED_PARAM(nblock);
+  BLOSC_UNUSED_PARAM(start);
+  BLOSC_UNUSED_PARAM(stop);
+  BLOSC_UNUSED_PARAM(dest);
+  BLOSC_UNUSED_PARAM(destsize);
+  return 0;
+#endif /* HAVE_PLUGINS */
+}
+
 /* execute single compression/decompression job for a single thread_context */
 static void t_blosc_do_job(void *ctxt)
 {
@@ -3578,10 +4405,53 @@ void blosc1_set_splitmode(int mode)
 void blosc_set_schunk(blosc2_schunk* schunk) {
   g_schunk = schunk;
   g_global_context->schunk = schunk;
+  invalidate_plugin_states(g_global_context);
 }
 
 blosc2_io *blosc2_io_global = NULL;
 
+#if defined(HAVE_IO_URING)
+static const blosc2_io_cb BLOSC2_IO_CB_URING = {
+    .id = BLOSC2_IO_URING,
+    .open = blosc2_uring_open,
+    .close = blosc2_uring_close,
+    .tell = blosc2_uring_tell,
+    .seek = blosc2_uring_seek,
+    .write = blosc2_uring_write,
+    .read = blosc2_uring_read,
+    .truncate = blosc2_uring_truncate,
+};
+
+static const io_hooks BLOSC2_IO_HOOKS_URING = {
+    .read_batch = blosc2_uring_read_batch,
+    .read_submit = blosc2_uring_read_submit,
+    .read_wait = blosc2_uring_read_wait,
+    .read_end = blosc2_uring_read_end,
+    .sync = blosc2_uring_sync,
+};
+#endif
+
+#if defined(HAVE_IO_DIRECT)
+static const blosc2_io_cb BLOSC2_IO_CB_DIRECT = {
+    .id = BLOSC2_IO_DIRECT,
+    .open = blosc2_direct_open,
+    .close = blosc2_direct_close,
+    .tell = blosc2_direct_tell,
+    .seek = blosc2_direct_seek,
+    .write = blosc2_direct_write,
+    .read = blosc2_direct_read,
+    .truncate = blosc2_direct_truncate,
+};
+
+static const io_hooks BLOSC2_IO_HOOKS_DIRECT = {
+    .sync = blosc2_direct_sync,
+};
+#endif
+
+static const io_hooks BLOSC2_IO_HOOKS_DEFAULTS = {
+    .sync = blosc2_stdio_sync,
+};
+
 void blosc2_init(void) {
   /* Return if Blosc is already initialized */
   if (g_initlib) return;
@@ -3597,6 +4467,8 @@ void blosc2_init(void) {
 
   g_ncodecs = 0;
   g_nfilters = 0;
+  memset(g_codec_hooks, 0, sizeof(g_codec_hooks));
+  memset(g_filter_hooks, 0, sizeof(g_filter_hooks));
 
 #if defined(HAVE_PLUGINS)
   #include "blosc2/blosc2-common.h"
@@ -3629,6 +4501,9 @@ void blosc2_destroy(void) {
   blosc2_free_resources();
   g_initlib = 0;
   blosc2_free_ctx(g_global_context);
+#if defined(HAVE_IO_URING)
+  blosc2_uring_destroy();
+#endif
 
   pthread_mutex_destroy(&global_comp_mutex);
 
@@ -3939,6 +4814,13 @@ void blosc2_free_ctx(blosc2_context* context) {
   if (context->block_maskout != NULL) {
     free(context->block_maskout);
   }
+  lazychunk_read_ahead_cancel(context);
+  for (int i = 0; i < 2; i++) {
+    free(context->lazy_reads[i].blocks);
+    free(context->lazy_reads[i].block_pos);
+    free(context->lazy_reads[i].block_read);
+  }
+  free(context->zonemap_stats);
   my_free(context);
 }
 
@@ -3962,6 +4844,9 @@ int blosc2_ctx_get_cparams(blosc2_context *ctx, blosc2_cparams *cparams) {
   cparams->preparams = ctx->preparams;
   cparams->udbtune = ctx->udbtune;
   cparams->codec_params = ctx->codec_params;
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; ++i) {
+    cparams->filter_params[i] = ctx->filter_params[i];
+  }
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -4213,6 +5098,37 @@ int blosc2_register_filter(blosc2_filter *filter) {
 }
 
 
+int register_filter_ex_private(blosc2_filter *filter, blosc2_plugin_init_cb init, blosc2_plugin_destroy_cb destroy,
+                               blosc2_filter_forward_ex_cb forward, blosc2_filter_backward_ex_cb backward) {
+  BLOSC_ERROR_NULL(filter, BLOSC2_ERROR_INVALID_PARAM);
+  if (init == NULL || forward == NULL || backward == NULL) {
+    BLOSC_TRACE_ERROR("The init, forward and backward functions cannot be NULL");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  BLOSC_ERROR(register_filter_private(filter));
+
+  filter_hooks *hooks = &g_filter_hooks[filter->id];
+  hooks->init = init;
+  hooks->destroy = destroy;
+  hooks->forward = forward;
+  hooks->backward = backward;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_register_filter_ex(blosc2_filter *filter, blosc2_plugin_init_cb init, blosc2_plugin_destroy_cb destroy,
+                              blosc2_filter_forward_ex_cb forward, blosc2_filter_backward_ex_cb backward) {
+  BLOSC_ERROR_NULL(filter, BLOSC2_ERROR_INVALID_PARAM);
+  if (filter->id < BLOSC2_USER_REGISTERED_FILTERS_START) {
+    BLOSC_TRACE_ERROR("The id must be greater or equal to %d", BLOSC2_USER_REGISTERED_FILTERS_START);
+    return BLOSC2_ERROR_FAILURE;
+  }
+
+  return register_filter_ex_private(filter, init, destroy, forward, backward);
+}
+
+
 /* Register codecs */
 
 int register_codec_private(blosc2_codec *codec) {
@@ -4257,7 +5173,38 @@ int blosc2_register_codec(blosc2_codec *codec) {
 }
 
 
-int _blosc2_register_io_cb(const blosc2_io_cb *io) {
+int register_codec_ex_private(blosc2_codec *codec, blosc2_plugin_init_cb init, blosc2_plugin_destroy_cb destroy,
+                              blosc2_codec_encoder_ex_cb encoder, blosc2_codec_decoder_ex_cb decoder) {
+  BLOSC_ERROR_NULL(codec, BLOSC2_ERROR_INVALID_PARAM);
+  if (init == NULL || encoder == NULL || decoder == NULL) {
+    BLOSC_TRACE_ERROR("The init, encoder and decoder functions cannot be NULL");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  BLOSC_ERROR(register_codec_private(codec));
+
+  codec_hooks *hooks = &g_codec_hooks[codec->compcode];
+  hooks->init = init;
+  hooks->destroy = destroy;
+  hooks->encoder = encoder;
+  hooks->decoder = decoder;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_register_codec_ex(blosc2_codec *codec, blosc2_plugin_init_cb init, blosc2_plugin_destroy_cb destroy,
+                             blosc2_codec_encoder_ex_cb encoder, blosc2_codec_decoder_ex_cb decoder) {
+  BLOSC_ERROR_NULL(codec, BLOSC2_ERROR_INVALID_PARAM);
+  if (codec->compcode < BLOSC2_USER_REGISTERED_CODECS_START) {
+    BLOSC_TRACE_ERROR("The compcode must be greater or equal than %d", BLOSC2_USER_REGISTERED_CODECS_START);
+    return BLOSC2_ERROR_CODEC_PARAM;
+  }
+
+  return register_codec_ex_private(codec, init, destroy, encoder, decoder);
+}
+
+
+static int register_io_cb_ex_private(const blosc2_io_cb *io, const io_hooks *hooks) {
 
   // Check if the io is already registered
   for (uint64_t i = 0; i < g_nio; ++i) {
@@ -4267,12 +5214,22 @@ int _blosc2_register_io_cb(const blosc2_io_cb *io) {
     }
   }
 
+  if (hooks != NULL) {
+    g_io_hooks[g_nio] = *hooks;
+  }
+  else {
+    memset(&g_io_hooks[g_nio], 0, sizeof(io_hooks));
+  }
   blosc2_io_cb *io_new = &g_io[g_nio++];
   memcpy(io_new, io, sizeof(blosc2_io_cb));
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
+int _blosc2_register_io_cb(const blosc2_io_cb *io) {
+  return register_io_cb_ex_private(io, NULL);
+}
+
 int blosc2_register_io_cb(const blosc2_io_cb *io) {
   BLOSC_ERROR_NULL(io, BLOSC2_ERROR_INVALID_PARAM);
   if (g_nio == UINT8_MAX) {
@@ -4288,6 +5245,27 @@ int blosc2_register_io_cb(const blosc2_io_cb *io) {
   return _blosc2_register_io_cb(io);
 }
 
+int blosc2_register_io_cb_ex(const blosc2_io_cb *io, blosc2_read_batch_cb read_batch,
+                             blosc2_sync_cb sync) {
+  BLOSC_ERROR_NULL(io, BLOSC2_ERROR_INVALID_PARAM);
+  if (g_nio == UINT8_MAX) {
+    BLOSC_TRACE_ERROR("Can not register more codecs");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+
+  if (io->id < BLOSC2_IO_REGISTERED) {
+    BLOSC_TRACE_ERROR("The compcode must be greater or equal than %d", BLOSC2_IO_REGISTERED);
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+
+  io_hooks hooks = {.read_batch = read_batch, .sync = sync};
+  return register_io_cb_ex_private(io, &hooks);
+}
+
+blosc2_sync_cb get_io_sync_cb(const blosc2_io_cb *io_cb) {
+  return g_io_hooks[io_cb - g_io].sync;
+}
+
 blosc2_io_cb *blosc2_get_io_cb(uint8_t id) {
   for (uint64_t i = 0; i < g_nio; ++i) {
     if (g_io[i].id == id) {
@@ -4295,12 +5273,30 @@ blosc2_io_cb *blosc2_get_io_cb(uint8_t id) {
     }
   }
   if (id == BLOSC2_IO_FILESYSTEM) {
-    if (_blosc2_register_io_cb(&BLOSC2_IO_CB_DEFAULTS) < 0) {
+    if (register_io_cb_ex_private(&BLOSC2_IO_CB_DEFAULTS, &BLOSC2_IO_HOOKS_DEFAULTS) < 0) {
       BLOSC_TRACE_ERROR("Error registering the default IO API");
       return NULL;
     }
     return blosc2_get_io_cb(id);
   }
+#if defined(HAVE_IO_DIRECT)
+  if (id == BLOSC2_IO_DIRECT) {
+    if (register_io_cb_ex_private(&BLOSC2_IO_CB_DIRECT, &BLOSC2_IO_HOOKS_DIRECT) < 0) {
+      BLOSC_TRACE_ERROR("Error registering the direct IO API");
+      return NULL;
+    }
+    return blosc2_get_io_cb(id);
+  }
+#endif
+#if defined(HAVE_IO_URING)
+  if (id == BLOSC2_IO_URING) {
+    if (register_io_cb_ex_private(&BLOSC2_IO_CB_URING, &BLOSC2_IO_HOOKS_URING) < 0) {
+      BLOSC_TRACE_ERROR("Error registering the io_uring IO API");
+      return NULL;
+    }
+    return blosc2_get_io_cb(id);
+  }
+#endif
   return NULL;
 }
 
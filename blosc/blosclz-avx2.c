@@ -0,0 +1,129 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "blosclz-avx2.h"
+
+/* Make sure AVX2 is available for the compilation target and compiler. */
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ALIGNED_(x) __declspec(align(x))
+#else
+#define ALIGNED_(x) __attribute__ ((aligned(x)))
+#endif
+#define ALIGNED_TYPE_(t, x) t ALIGNED_(x)
+
+
+/* Index of the first byte that differs in a (non-zero) comparison mask */
+static inline int first_diff(uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (int)index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+
+uint8_t *blosclz_get_run_avx2(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
+  uint8_t x = ip[-1];
+  /* Broadcast the value for every byte in a 256-bit register */
+  __m256i value = _mm256_set1_epi8((char)x);
+
+  while (ip < (ip_bound - sizeof(__m256i))) {
+    __m256i value2 = _mm256_loadu_si256((const __m256i *)ref);
+    uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(value, value2));
+    if (mask != 0) {
+      /* Return the byte that starts to differ */
+      return ip + first_diff(mask);
+    }
+    ip += sizeof(__m256i);
+    ref += sizeof(__m256i);
+  }
+  /* Look into the remainder */
+  while ((ip < ip_bound) && (*ref++ == x)) ip++;
+  return ip;
+}
+
+
+uint8_t *blosclz_get_match_avx2(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
+  while (ip < (ip_bound - sizeof(__m256i))) {
+    __m256i value = _mm256_loadu_si256((const __m256i *)ip);
+    __m256i value2 = _mm256_loadu_si256((const __m256i *)ref);
+    uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(value, value2));
+    if (mask != 0) {
+      /* Return the byte after the one that starts to differ */
+      return ip + first_diff(mask) + 1;
+    }
+    ip += sizeof(__m256i);
+    ref += sizeof(__m256i);
+  }
+  /* Look into the remainder */
+  while ((ip < ip_bound) && (*ref++ == *ip++)) {}
+  return ip;
+}
+
+
+void blosclz_wild_copy_avx2(uint8_t *out, const uint8_t *from, uint8_t *end) {
+  do {
+    _mm256_storeu_si256((__m256i *)out, _mm256_loadu_si256((const __m256i *)from));
+    out += sizeof(__m256i);
+    from += sizeof(__m256i);
+  } while (out < end);
+}
+
+
+// See https://habr.com/en/company/yandex/blog/457612/
+uint8_t *blosclz_copy_match_avx2(uint8_t *op, const uint8_t *match, int32_t len) {
+  size_t offset = op - match;
+  while (len >= 16) {
+
+    static const ALIGNED_TYPE_(uint8_t, 16) masks[] =
+      {
+                0,  1,  2,  1,  4,  1,  4,  2,  8,  7,  6,  5,  4,  3,  2,  1, // offset = 0, not used as mask, but for shift
+                0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // offset = 1
+                0,  1,  0,  1,  0,  1,  0,  1,  0,  1,  0,  1,  0,  1,  0,  1,
+                0,  1,  2,  0,  1,  2,  0,  1,  2,  0,  1,  2,  0,  1,  2,  0,
+                0,  1,  2,  3,  0,  1,  2,  3,  0,  1,  2,  3,  0,  1,  2,  3,
+                0,  1,  2,  3,  4,  0,  1,  2,  3,  4,  0,  1,  2,  3,  4,  0,
+                0,  1,  2,  3,  4,  5,  0,  1,  2,  3,  4,  5,  0,  1,  2,  3,
+                0,  1,  2,  3,  4,  5,  6,  0,  1,  2,  3,  4,  5,  6,  0,  1,
+                0,  1,  2,  3,  4,  5,  6,  7,  0,  1,  2,  3,  4,  5,  6,  7,
+                0,  1,  2,  3,  4,  5,  6,  7,  8,  0,  1,  2,  3,  4,  5,  6,
+                0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  0,  1,  2,  3,  4,  5,
+                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10,  0,  1,  2,  3,  4,
+                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11,  0,  1,  2,  3,
+                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12,  0,  1,  2,
+                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13,  0,  1,
+                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,  0,
+                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,  15, // offset = 16
+      };
+
+    _mm_storeu_si128((__m128i *)(op),
+                     _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(match)),
+                                      _mm_load_si128((const __m128i *)(masks) + offset)));
+
+    match += masks[offset];
+
+    op += 16;
+    len -= 16;
+  }
+  // Deal with remainders
+  for (; len > 0; len--) {
+    *op++ = *match++;
+  }
+  return op;
+}
+
+#endif /* defined(__AVX2__) */
@@ -0,0 +1,47 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* AVX2-accelerated routines for the BloscLZ match finder and decoder. */
+
+#ifndef BLOSCLZ_AVX2_H
+#define BLOSCLZ_AVX2_H
+
+#include "blosc2/blosc2-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  Return the position where the run of ip[-1] bytes starting at ref ends.
+*/
+BLOSC_NO_EXPORT uint8_t *blosclz_get_run_avx2(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref);
+
+/**
+  Return the position after the first byte where ip and ref differ.
+*/
+BLOSC_NO_EXPORT uint8_t *blosclz_get_match_avx2(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref);
+
+/**
+  Copy from `from` to `out` in 32-byte chunks until `end` is reached.
+  `out - from` must be at least 32 and `out` may be overrun by up to 31 bytes.
+*/
+BLOSC_NO_EXPORT void blosclz_wild_copy_avx2(uint8_t *out, const uint8_t *from, uint8_t *end);
+
+/**
+  Copy a match whose distance is not larger than 16 bytes.
+*/
+BLOSC_NO_EXPORT uint8_t *blosclz_copy_match_avx2(uint8_t *op, const uint8_t *match, int32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOSCLZ_AVX2_H */
@@ -0,0 +1,78 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "blosclz-neon.h"
+
+/* Make sure NEON is available for the compilation target and compiler. */
+#if defined(__ARM_NEON)
+
+#include <arm_neon.h>
+
+
+/* Whether all the bytes in a comparison result are set */
+static inline int all_equal(uint8x16_t cmp) {
+  uint64x2_t cmp64 = vreinterpretq_u64_u8(cmp);
+  return (vgetq_lane_u64(cmp64, 0) & vgetq_lane_u64(cmp64, 1)) == UINT64_MAX;
+}
+
+
+uint8_t *blosclz_get_run_neon(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
+  uint8_t x = ip[-1];
+  /* Broadcast the value for every byte in a 128-bit register */
+  uint8x16_t value = vdupq_n_u8(x);
+
+  while (ip < (ip_bound - 2 * sizeof(uint8x16_t))) {
+    uint8x16_t cmp = vandq_u8(vceqq_u8(value, vld1q_u8(ref)),
+                              vceqq_u8(value, vld1q_u8(ref + sizeof(uint8x16_t))));
+    if (!all_equal(cmp)) {
+      /* Return the byte that starts to differ */
+      while (*ref++ == x) ip++;
+      return ip;
+    }
+    ip += 2 * sizeof(uint8x16_t);
+    ref += 2 * sizeof(uint8x16_t);
+  }
+  /* Look into the remainder */
+  while ((ip < ip_bound) && (*ref++ == x)) ip++;
+  return ip;
+}
+
+
+uint8_t *blosclz_get_match_neon(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
+  while (ip < (ip_bound - 2 * sizeof(uint8x16_t))) {
+    uint8x16_t cmp = vandq_u8(vceqq_u8(vld1q_u8(ip), vld1q_u8(ref)),
+                              vceqq_u8(vld1q_u8(ip + sizeof(uint8x16_t)),
+                                       vld1q_u8(ref + sizeof(uint8x16_t))));
+    if (!all_equal(cmp)) {
+      /* Return the byte after the one that starts to differ */
+      while (*ref++ == *ip++) {}
+      return ip;
+    }
+    ip += 2 * sizeof(uint8x16_t);
+    ref += 2 * sizeof(uint8x16_t);
+  }
+  /* Look into the remainder */
+  while ((ip < ip_bound) && (*ref++ == *ip++)) {}
+  return ip;
+}
+
+
+void blosclz_wild_copy_neon(uint8_t *out, const uint8_t *from, uint8_t *end) {
+  do {
+    uint8x16_t v0 = vld1q_u8(from);
+    uint8x16_t v1 = vld1q_u8(from + sizeof(uint8x16_t));
+    vst1q_u8(out, v0);
+    vst1q_u8(out + sizeof(uint8x16_t), v1);
+    out += 2 * sizeof(uint8x16_t);
+    from += 2 * sizeof(uint8x16_t);
+  } while (out < end);
+}
+
+#endif /* defined(__ARM_NEON) */
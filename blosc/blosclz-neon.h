@@ -0,0 +1,42 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* NEON-accelerated routines for the BloscLZ match finder and decoder. */
+
+#ifndef BLOSCLZ_NEON_H
+#define BLOSCLZ_NEON_H
+
+#include "blosc2/blosc2-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  Return the position where the run of ip[-1] bytes starting at ref ends.
+*/
+BLOSC_NO_EXPORT uint8_t *blosclz_get_run_neon(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref);
+
+/**
+  Return the position after the first byte where ip and ref differ.
+*/
+BLOSC_NO_EXPORT uint8_t *blosclz_get_match_neon(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref);
+
+/**
+  Copy from `from` to `out` in 32-byte chunks until `end` is reached.
+  `out - from` must be at least 32 and `out` may be overrun by up to 31 bytes.
+*/
+BLOSC_NO_EXPORT void blosclz_wild_copy_neon(uint8_t *out, const uint8_t *from, uint8_t *end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOSCLZ_NEON_H */
@@ -18,8 +18,21 @@
 #include <stdbool.h>
 #include "blosclz.h"
 #include "fastcopy.h"
+#include "shuffle.h"
 #include "blosc2/blosc2-common.h"
 
+/* Toggle the hardware-accelerated routines based on BLOSCLZ_*_ENABLED macros
+   and availability on the target architecture. */
+#if defined(BLOSCLZ_AVX2_ENABLED) && defined(__SSE2__)
+  #define BLOSCLZ_USE_AVX2
+  #include "blosclz-avx2.h"
+#endif
+
+#if defined(BLOSCLZ_NEON_ENABLED) && defined(__ARM_NEON)
+  #define BLOSCLZ_USE_NEON
+  #include "blosclz-neon.h"
+#endif
+
 
 /*
  * Give hints to the compiler for branch prediction optimization.
@@ -52,7 +65,9 @@
 #endif
 
 #define HASH_LOG (14U)
-#define HASH_LOG2 (12U)
+
+// Number of bytes to compress before checking the cratio
+#define PROBE_LENGTH (1U << 12U)
 
 // This is used in LZ4 and seems to work pretty well here too
 #define HASH_FUNCTION(v, s, h) {      \
@@ -60,32 +75,6 @@
 }
 
 
-#if defined(__AVX2__)
-static uint8_t *get_run_32(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
-    uint8_t x = ip[-1];
-
-    while (ip < (ip_bound - (sizeof(__m256i)))) {
-        __m256i value, value2, cmp;
-        /* Broadcast the value for every byte in a 256-bit register */
-        memset(&value, x, sizeof(__m256i));
-        value2 = _mm256_loadu_si256((__m256i *)ref);
-        cmp = _mm256_cmpeq_epi64(value, value2);
-        if ((unsigned)_mm256_movemask_epi8(cmp) != 0xFFFFFFFF) {
-            /* Return the byte that starts to differ */
-            while (*ref++ == x) ip++;
-            return ip;
-        }
-        else {
-            ip += sizeof(__m256i);
-            ref += sizeof(__m256i);
-        }
-    }
-    /* Look into the remainder */
-    while ((ip < ip_bound) && (*ref++ == x)) ip++;
-    return ip;
-}
-#endif
-
 #if defined(__SSE2__)
 uint8_t *get_run_16(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
   uint8_t x = ip[-1];
@@ -188,55 +177,108 @@ static uint8_t *get_match_16(uint8_t *ip, const uint8_t *ip_bound, const uint8_t
 #endif
 
 
-#if defined(__AVX2__)
-static uint8_t *get_match_32(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
+// LZ4 wildCopy which can reach excellent copy bandwidth (even if insecure)
+static inline void wild_copy(uint8_t *out, const uint8_t* from, uint8_t* end) {
+  uint8_t* d = out;
+  const uint8_t* s = from;
+  uint8_t* const e = end;
 
-  while (ip < (ip_bound - sizeof(__m256i))) {
-    __m256i value, value2, cmp;
-    value = _mm256_loadu_si256((__m256i *) ip);
-    value2 = _mm256_loadu_si256((__m256i *)ref);
-    cmp = _mm256_cmpeq_epi64(value, value2);
-    if ((unsigned)_mm256_movemask_epi8(cmp) != 0xFFFFFFFF) {
-      /* Return the byte that starts to differ */
-      while (*ref++ == *ip++) {}
-      return ip;
-    }
-    else {
-      ip += sizeof(__m256i);
-      ref += sizeof(__m256i);
-    }
-  }
-  /* Look into the remainder */
-  while ((ip < ip_bound) && (*ref++ == *ip++)) {}
-  return ip;
+  do { memcpy(d,s,8); d+=8; s+=8; } while (d<e);
 }
-#endif
 
+// Same as wild_copy, but for matches at a distance of 32 bytes or more
+static void wild_copy_32(uint8_t *out, const uint8_t* from, uint8_t* end) {
+  do { memcpy(out, from, 32); out += 32; from += 32; } while (out < end);
+}
 
-static uint8_t* get_run_or_match(uint8_t* ip, uint8_t* ip_bound, const uint8_t* ref, bool run) {
-  if (BLOSCLZ_UNLIKELY(run)) {
-#if defined(__AVX2__)
-    // Extensive experiments on AMD Ryzen3 say that regular get_run is faster
-    // ip = get_run_32(ip, ip_bound, ref);
-    ip = get_run(ip, ip_bound, ref);
-#elif defined(__SSE2__)
-    // Extensive experiments on AMD Ryzen3 say that regular get_run is faster
-    // ip = get_run_16(ip, ip_bound, ref);
-    ip = get_run(ip, ip_bound, ref);
+static uint8_t* copy_match_generic(uint8_t *op, const uint8_t *match, int32_t len) {
+  return copy_match(op, match, (unsigned) len);
+}
+
+
+/*  Define function pointer types for the match finder and decoder routines. */
+typedef uint8_t* (* get_run_func)(uint8_t*, const uint8_t*, const uint8_t*);
+typedef uint8_t* (* get_match_func)(uint8_t*, const uint8_t*, const uint8_t*);
+typedef void (* wild_copy_func)(uint8_t*, const uint8_t*, uint8_t*);
+typedef uint8_t* (* copy_match_func)(uint8_t*, const uint8_t*, int32_t);
+
+/* An implementation of the match finder and decoder routines. */
+typedef struct blosclz_implementation {
+  /* Name of this implementation. */
+  const char* name;
+  /* Extend a run of the previous byte. */
+  get_run_func get_run;
+  /* Extend a match. */
+  get_match_func get_match;
+  /* Copy a match at a distance of 32 bytes or more. */
+  wild_copy_func wild_copy_32;
+  /* Copy a match at a distance of 16 bytes or less. */
+  copy_match_func copy_match_16;
+} blosclz_implementation_t;
+
+static blosclz_implementation_t get_blosclz_implementation(void) {
+  blosc_cpu_features cpu_features = blosc_get_cpu_features();
+  blosclz_implementation_t impl;
+#if defined(BLOSCLZ_USE_AVX2)
+  if (cpu_features & BLOSC_HAVE_AVX2) {
+    impl.name = "avx2";
+    impl.get_run = blosclz_get_run_avx2;
+    impl.get_match = blosclz_get_match_avx2;
+    impl.wild_copy_32 = blosclz_wild_copy_avx2;
+    impl.copy_match_16 = blosclz_copy_match_avx2;
+    return impl;
+  }
+#endif  /* defined(BLOSCLZ_USE_AVX2) */
+
+#if defined(BLOSCLZ_USE_NEON)
+  if (cpu_features & BLOSC_HAVE_NEON) {
+    impl.name = "neon";
+    impl.get_run = blosclz_get_run_neon;
+    impl.get_match = blosclz_get_match_neon;
+    impl.wild_copy_32 = blosclz_wild_copy_neon;
+    impl.copy_match_16 = copy_match_generic;
+    return impl;
+  }
+#endif  /* defined(BLOSCLZ_USE_NEON) */
+
+  BLOSC_UNUSED_PARAM(cpu_features);
+  impl.name = "generic";
+  // Without AVX2 or NEON, use the scalar get_run: extensive experiments on AMD Ryzen3 say
+  // that it is faster than the SSE2 get_run_16 (the AVX2 get_run above beats both)
+  impl.get_run = get_run;
+#if defined(__SSE2__)
+  impl.get_match = get_match_16;
 #else
-    ip = get_run(ip, ip_bound, ref);
+  impl.get_match = get_match;
 #endif
+  impl.wild_copy_32 = wild_copy_32;
+  impl.copy_match_16 = copy_match_generic;
+  return impl;
+}
+
+/* Flag indicating whether the implementation has been initialized. */
+static int32_t implementation_initialized;
+
+/* The dynamically-chosen implementation.
+   This is only safe to use once `implementation_initialized` is set. */
+static blosclz_implementation_t host_implementation;
+
+/* Initialize the implementation, if necessary.  As for shuffle, concurrent
+   initializations are harmless because all of them get the same result. */
+static inline void init_blosclz_implementation(void) {
+  if (BLOSCLZ_UNLIKELY(!implementation_initialized)) {
+    host_implementation = get_blosclz_implementation();
+    implementation_initialized = 1;
+  }
+}
+
+
+static inline uint8_t* get_run_or_match(uint8_t* ip, uint8_t* ip_bound, const uint8_t* ref, bool run) {
+  if (BLOSCLZ_UNLIKELY(run)) {
+    ip = host_implementation.get_run(ip, ip_bound, ref);
   }
   else {
-#if defined(__AVX2__)
-    // Extensive experiments on AMD Ryzen3 say that regular get_match_16 is faster
-    // ip = get_match_32(ip, ip_bound, ref);
-    ip = get_match_16(ip, ip_bound, ref);
-#elif defined(__SSE2__)
-    ip = get_match_16(ip, ip_bound, ref);
-#else
-    ip = get_match(ip, ip_bound, ref);
-#endif
+    ip = host_implementation.get_match(ip, ip_bound, ref);
   }
 
   return ip;
@@ -255,16 +297,6 @@ static uint8_t* get_run_or_match(uint8_t* ip, uint8_t* ip_bound, const uint8_t*
   }                                                     \
 }
 
-#define LITERAL2(ip, anchor, copy) {                    \
-  oc++; (anchor)++;                                     \
-  (ip) = (anchor);                                      \
-  (copy)++;                                             \
-  if (BLOSCLZ_UNLIKELY((copy) == MAX_COPY)) {           \
-    (copy) = 0;                                         \
-    oc++;                                               \
-  }                                                     \
-}
-
 #define MATCH_SHORT(op, op_limit, len, distance) {        \
   if (BLOSCLZ_UNLIKELY((op) + 2 > (op_limit)))            \
     goto out;                                             \
@@ -314,128 +346,14 @@ static uint8_t* get_run_or_match(uint8_t* ip, uint8_t* ip_bound, const uint8_t*
 }
 
 
-// Get a guess for the compressed size of a buffer
-static double get_cratio(uint8_t* ibase, int maxlen, int minlen, int ipshift) {
-  uint8_t* ip = ibase;
-  int32_t oc = 0;
-  const uint16_t hashlen = (1U << (uint8_t)HASH_LOG2);
-  uint16_t htab[1U << (uint8_t)HASH_LOG2];
-  uint32_t hval;
-  uint32_t seq;
-  uint8_t copy;
-  // Make a tradeoff between testing too much and too little
-  uint16_t limit = (maxlen > hashlen) ? hashlen : maxlen;
-  uint8_t* ip_bound = ibase + limit - 1;
-  uint8_t* ip_limit = ibase + limit - 12;
-
-  // Initialize the hash table to distances of 0
-  memset(htab, 0, hashlen * sizeof(uint16_t));
-
-  /* we start with literal copy */
-  copy = 4;
-  oc += 5;
-
-  /* main loop */
-  while (BLOSCLZ_LIKELY(ip < ip_limit)) {
-    const uint8_t* ref;
-    unsigned distance;
-    uint8_t* anchor = ip;    /* comparison starting-point */
-
-    /* find potential match */
-    seq = BLOSCLZ_READU32(ip);
-    HASH_FUNCTION(hval, seq, HASH_LOG2)
-    ref = ibase + htab[hval];
-
-    /* calculate distance to the match */
-    distance = (unsigned int)(anchor - ref);
-
-    /* update hash table */
-    htab[hval] = (uint16_t) (anchor - ibase);
-
-    if (distance == 0 || (distance >= MAX_FARDISTANCE)) {
-      LITERAL2(ip, anchor, copy)
-      continue;
-    }
-
-    /* is this a match? check the first 4 bytes */
-    if (BLOSCLZ_READU32(ref) == BLOSCLZ_READU32(ip)) {
-      ref += 4;
-    }
-    else {
-      /* no luck, copy as a literal */
-      LITERAL2(ip, anchor, copy)
-      continue;
-    }
-
-    /* last matched byte */
-    ip = anchor + 4;
-
-    /* distance is biased */
-    distance--;
-
-    /* get runs or matches; zero distance means a run */
-    ip = get_run_or_match(ip, ip_bound, ref, !distance);
-
-    ip -= ipshift;
-    int len = (int)(ip - anchor);
-    if (len < minlen) {
-      LITERAL2(ip, anchor, copy)
-      continue;
-    }
-
-    /* if we haven't copied anything, adjust the output counter */
-    if (!copy)
-      oc--;
-    /* reset literal counter */
-    copy = 0;
-
-    /* encode the match */
-    if (distance < MAX_DISTANCE) {
-      if (len >= 7) {
-        oc += ((len - 7) / 255) + 1;
-      }
-      oc += 2;
-    }
-    else {
-      /* far away, but not yet in the another galaxy... */
-      if (len >= 7) {
-        oc += ((len - 7) / 255) + 1;
-      }
-      oc += 4;
-    }
-
-    /* update the hash at match boundary */
-    seq = BLOSCLZ_READU32(ip);
-    HASH_FUNCTION(hval, seq, HASH_LOG2)
-    htab[hval] = (uint16_t)(ip++ - ibase);
-    ip++;
-    /* assuming literal copy */
-    oc++;
-  }
-
-  double ic = (double)(ip - ibase);
-  return ic / (double)oc;
-}
-
-
 int blosclz_compress(const int clevel, const void* input, int length,
                      void* output, int maxout, blosc2_context* ctx) {
   uint8_t* ibase = (uint8_t*)input;
 
-  // Experiments say that checking 1/4 of the buffer is enough to figure out approx cratio
-  // UPDATE: new experiments with ERA5 datasets (float32) say that checking the whole buffer (1)
-  // is better (specially when combined with bitshuffle).
-  // The loss in speed for checking the whole buffer is pretty negligible too.
-  int maxlen = length / 1;
-  // Start probing somewhere inside the buffer
-  int shift = length - maxlen;
-  // Actual entropy probing!
-  double cratio = get_cratio(ibase + shift, maxlen, 3, 3);
+  init_blosclz_implementation();
+
   // discard probes with small compression ratios (too expensive)
   double cratio_[10] = {0, 2, 1.5, 1.2, 1.2, 1.2, 1.2, 1.15, 1.1, 1.0};
-  if (cratio < cratio_[clevel]) {
-      goto out;
-  }
 
   /* When we go back in a match (shift), we obtain quite different compression properties.
    * It looks like 4 is more useful in combination with bitshuffle and small typesizes
@@ -444,7 +362,8 @@ int blosclz_compress(const int clevel, const void* input, int length,
    *
    * In this block we also check cratios for the beginning of the buffers and
    * eventually discard those that are small (take too long to decompress).
-   * This process is called _entropy probing_.
+   * This process is called _entropy probing_.  The probe is the actual compression
+   * of the first PROBE_LENGTH bytes, so its work is not lost when the cratio is good.
    */
   unsigned ipshift = 3;
   // Minimum lengths for encoding (normally it is good to match the shift value)
@@ -457,6 +376,9 @@ int blosclz_compress(const int clevel, const void* input, int length,
   uint8_t* ip = ibase;
   uint8_t* ip_bound = ibase + length - 1;
   uint8_t* ip_limit = ibase + length - 12;
+  // Where the entropy probing stops
+  uint8_t* ip_stop = (length - 12 > (int)PROBE_LENGTH) ? ibase + PROBE_LENGTH : ip_limit;
+  bool probing = true;
   uint8_t* op = (uint8_t*)output;
   const uint8_t* op_limit = op + maxout;
   uint32_t seq;
@@ -481,7 +403,8 @@ int blosclz_compress(const int clevel, const void* input, int length,
   *op++ = *ip++;
 
   /* main loop */
-  while (BLOSCLZ_LIKELY(ip < ip_limit)) {
+  compress:
+  while (BLOSCLZ_LIKELY(ip < ip_stop)) {
     const uint8_t* ref;
     unsigned distance;
     uint8_t* anchor = ip;    /* comparison starting-point */
@@ -580,6 +503,19 @@ int blosclz_compress(const int clevel, const void* input, int length,
     *op++ = MAX_COPY - 1;
   }
 
+  if (probing) {
+    // Actual entropy probing!
+    double cratio = (double)(ip - ibase) / (double)(op - (uint8_t*)output);
+    if (cratio < cratio_[clevel]) {
+      goto out;
+    }
+    probing = false;
+    if (ip_stop < ip_limit) {
+      ip_stop = ip_limit;
+      goto compress;
+    }
+  }
+
   /* left-over as literal copy */
   while (BLOSCLZ_UNLIKELY(ip <= ip_bound)) {
     if (BLOSCLZ_UNLIKELY(op + 2 > op_limit)) goto out;
@@ -606,70 +542,6 @@ int blosclz_compress(const int clevel, const void* input, int length,
   return 0;
 }
 
-// See https://habr.com/en/company/yandex/blog/457612/
-#if defined(__AVX2__)
-
-#if defined(_MSC_VER)
-#define ALIGNED_(x) __declspec(align(x))
-#else
-#if defined(__GNUC__)
-#define ALIGNED_(x) __attribute__ ((aligned(x)))
-#endif
-#endif
-#define ALIGNED_TYPE_(t, x) t ALIGNED_(x)
-
-static unsigned char* copy_match_16(unsigned char *op, const unsigned char *match, int32_t len)
-{
-  size_t offset = op - match;
-  while (len >= 16) {
-
-    static const ALIGNED_TYPE_(uint8_t, 16) masks[] =
-      {
-                0,  1,  2,  1,  4,  1,  4,  2,  8,  7,  6,  5,  4,  3,  2,  1, // offset = 0, not used as mask, but for shift
-                0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // offset = 1
-                0,  1,  0,  1,  0,  1,  0,  1,  0,  1,  0,  1,  0,  1,  0,  1,
-                0,  1,  2,  0,  1,  2,  0,  1,  2,  0,  1,  2,  0,  1,  2,  0,
-                0,  1,  2,  3,  0,  1,  2,  3,  0,  1,  2,  3,  0,  1,  2,  3,
-                0,  1,  2,  3,  4,  0,  1,  2,  3,  4,  0,  1,  2,  3,  4,  0,
-                0,  1,  2,  3,  4,  5,  0,  1,  2,  3,  4,  5,  0,  1,  2,  3,
-                0,  1,  2,  3,  4,  5,  6,  0,  1,  2,  3,  4,  5,  6,  0,  1,
-                0,  1,  2,  3,  4,  5,  6,  7,  0,  1,  2,  3,  4,  5,  6,  7,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  0,  1,  2,  3,  4,  5,  6,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  0,  1,  2,  3,  4,  5,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10,  0,  1,  2,  3,  4,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11,  0,  1,  2,  3,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12,  0,  1,  2,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13,  0,  1,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,  0,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,  15, // offset = 16
-      };
-
-    _mm_storeu_si128((__m128i *)(op),
-                     _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(match)),
-                                      _mm_load_si128((const __m128i *)(masks) + offset)));
-
-    match += masks[offset];
-
-    op += 16;
-    len -= 16;
-  }
-  // Deal with remainders
-  for (; len > 0; len--) {
-    *op++ = *match++;
-  }
-  return op;
-}
-#endif
-
-// LZ4 wildCopy which can reach excellent copy bandwidth (even if insecure)
-static inline void wild_copy(uint8_t *out, const uint8_t* from, uint8_t* end) {
-  uint8_t* d = out;
-  const uint8_t* s = from;
-  uint8_t* const e = end;
-
-  do { memcpy(d,s,8); d+=8; s+=8; } while (d<e);
-}
-
 int blosclz_decompress(const void* input, int length, void* output, int maxout) {
   const uint8_t* ip = (const uint8_t*)input;
   const uint8_t* ip_limit = ip + length;
@@ -679,6 +551,7 @@ int blosclz_decompress(const void* input, int length, void* output, int maxout)
   if (BLOSCLZ_UNLIKELY(length == 0)) {
     return 0;
   }
+  init_blosclz_implementation();
   ctrl = (*ip++) & 31U;
 
   while (1) {
@@ -736,25 +609,23 @@ int blosclz_decompress(const void* input, int length, void* output, int maxout)
         memset(op, *ref, len);
         op += len;
       }
+      else if ((len >= 32) && (op - ref >= 32) && (op_limit - op >= len + 32)) {
+        // long match at a distance of 32 bytes or more
+        host_implementation.wild_copy_32(op, ref, op + len);
+        op += len;
+      }
       else if ((op - ref >= 8) && (op_limit - op >= len + 8)) {
         // copy with an overlap not larger than 8
         wild_copy(op, ref, op + len);
         op += len;
       }
+      else if (op - ref <= 16) {
+        // copy with a short distance, so the match source overlaps
+        op = host_implementation.copy_match_16(op, ref, len);
+      }
       else {
         // general copy with any overlap
-#if defined(__AVX2__)
-        if (op - ref <= 16) {
-          // This is not faster on a combination of compilers (clang, gcc, icc) or machines, but
-          // it is not slower either.  Let's activate here for experimentation.
-          op = copy_match_16(op, ref, len);
-        }
-        else {
-#endif
-          op = copy_match(op, ref, (unsigned) len);
-#if defined(__AVX2__)
-        }
-#endif
+        op = copy_match(op, ref, (unsigned) len);
       }
     }
     else {
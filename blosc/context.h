@@ -34,6 +34,22 @@
   #include <ipps.h>
 #endif /* HAVE_IPP */
 
+/* The blocks of a lazy chunk, read with a single call to the io backend */
+typedef struct {
+  const uint8_t* chunk;  /* The lazy chunk whose blocks are read (NULL if this is unused) */
+  int32_t cbytes;  /* The size of chunk */
+  uint8_t* blocks;  /* Where the blocks are read */
+  int64_t blocks_size;  /* The allocated size of blocks */
+  int64_t* block_pos;  /* Where every block is in blocks; -1 if it is not read */
+  int32_t* block_read;  /* The number of the read of every block in the batch */
+  int32_t npos;  /* The allocated items of block_pos and block_read */
+  blosc2_io_cb* io_cb;
+  void* fp;  /* The file of the chunk, kept open while the reads are in flight */
+  void* request;  /* The reads in flight, if the backend reads asynchronously */
+  int64_t (*read_wait)(void* request, int32_t nread);
+  int64_t (*read_end)(void* request);
+} lazy_read;
+
 struct blosc2_context_s {
   const uint8_t* src;  /* The source buffer */
   uint8_t* dest;  /* The destination buffer */
@@ -72,6 +88,14 @@ struct blosc2_context_s {
   int block_maskout_nitems;  /* The number of items in block_maskout array (must match
                               * the number of blocks in chunk) */
   blosc2_schunk* schunk;  /* Associated super-chunk (if available) */
+  uint64_t plugin_epoch;  /* Bumped when the plugin states of the threads must be created again */
+  lazy_read lazy_reads[2];  /* The blocks of lazy chunks read in a batch (the chunk being
+                            * decompressed and the one read ahead of it) */
+  lazy_read* lazy_current;  /* The batch of the chunk being decompressed (NULL if none) */
+  uint8_t zonemap;  /* The kind of items for zone map statistics (BLOSC2_ZONEMAP_*) */
+  bool zonemap_valid;  /* Whether zonemap_stats describe the chunk being (or last) compressed */
+  blosc2_zonemap_stats* zonemap_stats;  /* The statistics of every block in that chunk */
+  int32_t zonemap_nstats;  /* The allocated items of zonemap_stats */
   struct thread_context* serial_context;  /* Cache for temporaries for serial operation */
   int do_compress;  /* 1 if we are compressing, 0 if decompressing */
   void *btune;  /* Entry point for BTune persistence between runs */
@@ -126,6 +150,17 @@ struct b2nd_context_s {
   //!< The number of metalayers.
 };
 
+/* The state created by the init hook of a user-defined codec or filter */
+struct plugin_state {
+  int id;  /* the codec or filter id (-1 if empty) */
+  uint8_t meta;
+  bool compress;
+  int32_t typesize;
+  uint64_t epoch;  /* the plugin_epoch of the parent context when created */
+  void* state;
+  blosc2_plugin_destroy_cb destroy;
+};
+
 struct thread_context {
   blosc2_context* parent_context;
   int tid;
@@ -137,10 +172,18 @@ struct thread_context {
   size_t tmp_nbytes;   /* keep track of how big the temporary buffers are */
   int32_t zfp_cell_start;  /* cell starter index for ZFP fixed-rate mode */
   int32_t zfp_cell_nitems;  /* number of items to get for ZFP fixed-rate mode */
+  const int64_t *zfp_box_start;  /* start of the box of cells to get in ZFP fixed-rate mode */
+  const int64_t *zfp_box_stop;  /* stop of the box of cells to get in ZFP fixed-rate mode */
+  int32_t codec_item_start;  /* first item to get for codecs with random access (FORPACK) */
+  int32_t codec_item_nitems;  /* number of items to get for codecs with random access (FORPACK) */
+  /* The states for user-defined codecs and filters */
+  struct plugin_state codec_state;
+  struct plugin_state filter_states[BLOSC2_MAX_FILTERS];
 #if defined(HAVE_ZSTD)
   /* The contexts for ZSTD */
   ZSTD_CCtx* zstd_cctx;
   ZSTD_DCtx* zstd_dctx;
+  int32_t zstd_window_nblock;  /* next block for the ZSTD stream in chunk-window mode */
 #endif /* HAVE_ZSTD */
 #ifdef HAVE_IPP
   Ipp8u* lz4_hash_table;
@@ -10,6 +10,7 @@
 
 #include <stdio.h>
 #include "blosc2.h"
+#include "frame.h"
 #include <sys/stat.h>
 
 #if defined(_WIN32) || defined(__MINGW32__)
@@ -140,6 +141,8 @@ int blosc2_remove_urlpath(const char* urlpath){
       BLOSC_TRACE_ERROR("Could not remove %s", urlpath);
       return BLOSC2_ERROR_FILE_REMOVE;
     }
+    // Also the write-ahead record of the durable mode, if any
+    frame_remove_wal(urlpath);
   }
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -18,6 +18,7 @@
 #include "context.h"
 #include "frame.h"
 #include "sframe.h"
+#include "zonemap.h"
 #include <inttypes.h>
 
 #if defined(_WIN32)
@@ -53,6 +54,8 @@ blosc2_frame_s* frame_new(const char* urlpath) {
 
 /* Free memory from a frame. */
 int frame_free(blosc2_frame_s* frame) {
+  // The committer thread uses the frame until it is stopped
+  frame_commit_free(frame);
 
   if (frame->cframe != NULL && !frame->avoid_cframe_free) {
     free(frame->cframe);
@@ -62,10 +65,23 @@ int frame_free(blosc2_frame_s* frame) {
     free(frame->coffsets);
   }
 
+  if (frame->offsets != NULL) {
+    free(frame->offsets);
+  }
+
   if (frame->urlpath != NULL) {
     free(frame->urlpath);
   }
 
+  sframe_close_segment_fp(frame);
+  if (frame->segment_locs != NULL) {
+    free(frame->segment_locs);
+  }
+
+  if (frame->vlmeta_slots != NULL) {
+    free(frame->vlmeta_slots);
+  }
+
   free(frame);
 
   return 0;
@@ -125,8 +141,13 @@ void *new_header_frame(blosc2_schunk *schunk, blosc2_frame_s *frame) {
   }
 
   // Frame type
-  // We only support contiguous and sparse directories frames currently
-  *h2p = frame->sframe ? 1 : 0;
+  // We only support contiguous and sparse directories frames (with or without segment files) currently
+  if (frame->sframe) {
+    *h2p = frame->segment_size > 0 ? FRAME_SEGMENTS_TYPE : FRAME_DIRECTORY_TYPE;
+  }
+  else {
+    *h2p = FRAME_CONTIGUOUS_TYPE;
+  }
   h2p += 1;
   if (h2p - h2 >= FRAME_HEADER_MINLEN) {
     return NULL;
@@ -401,7 +422,7 @@ int get_header_info(blosc2_frame_s *frame, int32_t *header_len, int64_t *frame_l
   // Consistency check for frame type
   uint8_t frame_type = framep[FRAME_TYPE];
   if (frame->sframe) {
-    if (frame_type != FRAME_DIRECTORY_TYPE) {
+    if (frame_type != (frame->segment_size > 0 ? FRAME_SEGMENTS_TYPE : FRAME_DIRECTORY_TYPE)) {
       return BLOSC2_ERROR_FRAME_TYPE;
     }
   } else {
@@ -498,6 +519,25 @@ int get_header_info(blosc2_frame_s *frame, int32_t *header_len, int64_t *frame_l
 }
 
 
+// Keep a copy of some bytes written past the chunk data, so that the commits do not read them back
+static void commit_cache(uint8_t** cache, int64_t* cache_len, const uint8_t* buf, int64_t len) {
+  free(*cache);
+  *cache = malloc((size_t)len);
+  if (*cache == NULL) {
+    *cache_len = 0;
+    return;
+  }
+  memcpy(*cache, buf, (size_t)len);
+  *cache_len = len;
+}
+
+static void commit_cache_coffsets(blosc2_frame_s *frame, const uint8_t* off_chunk, int64_t off_cbytes) {
+  if (frame_is_durable(frame)) {
+    commit_cache(&frame->commit_coffsets, &frame->commit_coffsets_len, off_chunk, off_cbytes);
+  }
+}
+
+
 int64_t get_trailer_offset(blosc2_frame_s *frame, int32_t header_len, bool has_coffsets) {
   if (!has_coffsets) {
     // No data chunks yet
@@ -542,14 +582,59 @@ int update_frame_len(blosc2_frame_s* frame, int64_t len) {
 }
 
 
-int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
-  if (frame != NULL && frame->len == 0) {
-    BLOSC_TRACE_ERROR("The trailer cannot be updated on empty frames.");
+/* Create the trailer for the vlmetalayers of @p schunk; the records of the values are
+ * returned in @p slots.  When @p room is false, values are packed with no room after them. */
+static uint8_t* new_trailer_frame(blosc2_frame_s* frame, blosc2_schunk* schunk, bool room,
+                                  int64_t* trailer_len, frame_vlmeta_slot** slots) {
+  // Now, deal with variable-length metalayers
+  int16_t nvlmetalayers = schunk->nvlmetalayers;
+  if (nvlmetalayers < 0 || nvlmetalayers > BLOSC2_MAX_METALAYERS) {
+    return NULL;
+  }
+
+  // Unless asked for a compact trailer, every vlmetalayer value gets a record with some
+  // room for growing, so that it can be updated in place later on (see
+  // frame_update_vlmetalayer()).  Records that already had enough room keep it.
+  frame_vlmeta_slot* slots_ = malloc(nvlmetalayers * sizeof(frame_vlmeta_slot) + 1);
+  if (slots_ == NULL) {
+    BLOSC_TRACE_ERROR("Cannot allocate the vlmetalayer records.");
+    return NULL;
+  }
+  int64_t index_len = 0;
+  int64_t values_len = 0;
+  for (int nvlmetalayer = 0; nvlmetalayer < nvlmetalayers; nvlmetalayer++) {
+    blosc2_metalayer *vlmetalayer = schunk->vlmetalayers[nvlmetalayer];
+    size_t name_len = strlen(vlmetalayer->name);
+    if (name_len >= (1U << 5U)) {  // metalayer strings cannot be longer than 32 bytes
+      free(slots_);
+      return NULL;
+    }
+    int32_t capacity = vlmetalayer->content_len;
+    if (room) {
+      capacity += vlmetalayer->content_len / 8 + FRAME_VLMETA_SLACK;
+    }
+    if (room && nvlmetalayer < frame->vlmeta_nslots &&
+        frame->vlmeta_slots[nvlmetalayer].capacity >= vlmetalayer->content_len) {
+      capacity = frame->vlmeta_slots[nvlmetalayer].capacity;
+    }
+    slots_[nvlmetalayer].capacity = capacity;
+    index_len += 1 + (int64_t)name_len + 1 + 4;
+    values_len += 1 + 4 + (int64_t)capacity;
+  }
+  // The msgpack header for the metalayers (array_marker, size, map of offsets, list of metalayers)
+  *trailer_len = 2 + 1 + 1 + 2 + 1 + 2 + index_len + 1 + 2 + values_len + 23;
+  if (*trailer_len > INT32_MAX) {
+    free(slots_);
+    return NULL;
   }
 
   // Create the trailer in msgpack (see the frame format document)
-  int64_t trailer_len = FRAME_TRAILER_MINLEN;
-  uint8_t* trailer = (uint8_t*)calloc((size_t)trailer_len, 1);
+  uint8_t* trailer = (uint8_t*)calloc((size_t)*trailer_len, 1);
+  if (trailer == NULL) {
+    BLOSC_TRACE_ERROR("Cannot allocate the trailer.");
+    free(slots_);
+    return NULL;
+  }
   uint8_t* ptrailer = trailer;
   *ptrailer = 0x90 + 4;  // fixarray with 4 elements
   ptrailer += 1;
@@ -557,19 +642,6 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
   *ptrailer = FRAME_TRAILER_VERSION;
   ptrailer += 1;
 
-  int32_t current_trailer_len = (int32_t)(ptrailer - trailer);
-
-  // Now, deal with variable-length metalayers
-  int16_t nvlmetalayers = schunk->nvlmetalayers;
-  if (nvlmetalayers < 0 || nvlmetalayers > BLOSC2_MAX_METALAYERS) {
-    return -1;
-  }
-
-  // Make space for the header of metalayers (array marker, size, map of offsets)
-  trailer = realloc(trailer, (size_t) current_trailer_len + 1 + 1 + 2 + 1 + 2);
-  ptrailer = trailer + current_trailer_len;
-
-  // The msgpack header for the metalayers (array_marker, size, map of offsets, list of metalayers)
   *ptrailer = 0x90 + 3;  // array with 3 elements
   ptrailer += 1;
 
@@ -584,21 +656,17 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
   ptrailer += 1;
   to_big(ptrailer, &nvlmetalayers, sizeof(nvlmetalayers));
   ptrailer += sizeof(nvlmetalayers);
-  current_trailer_len = (int32_t)(ptrailer - trailer);
-  int32_t *offtodata = malloc(nvlmetalayers * sizeof(int32_t));
+  int32_t *offtodata = malloc(nvlmetalayers * sizeof(int32_t) + 1);
+  if (offtodata == NULL) {
+    BLOSC_TRACE_ERROR("Cannot allocate the trailer.");
+    free(slots_);
+    free(trailer);
+    return NULL;
+  }
   for (int nvlmetalayer = 0; nvlmetalayer < nvlmetalayers; nvlmetalayer++) {
-    if (frame == NULL) {
-      return -1;
-    }
     blosc2_metalayer *vlmetalayer = schunk->vlmetalayers[nvlmetalayer];
     uint8_t name_len = (uint8_t) strlen(vlmetalayer->name);
-    trailer = realloc(trailer, (size_t)current_trailer_len + 1 + name_len + 1 + 4);
-    ptrailer = trailer + current_trailer_len;
     // Store the vlmetalayer
-    if (name_len >= (1U << 5U)) {  // metalayer strings cannot be longer than 32 bytes
-      free(offtodata);
-      return -1;
-    }
     *ptrailer = (uint8_t)0xa0 + name_len;  // str
     ptrailer += 1;
     memcpy(ptrailer, vlmetalayer->name, name_len);
@@ -608,63 +676,45 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
     ptrailer += 1;
     offtodata[nvlmetalayer] = (int32_t)(ptrailer - trailer);
     ptrailer += 4;
-    current_trailer_len += 1 + name_len + 1 + 4;
   }
   int32_t tsize2 = (int32_t)(ptrailer - trailer);
-  if (tsize2 != current_trailer_len) {  // sanity check
-    return -1;
-  }
 
   // Map size + int16 size
   if ((uint32_t) (tsize2 - tsize) >= (1U << 16U)) {
-    return -1;
+    free(offtodata);
+    free(slots_);
+    free(trailer);
+    return NULL;
   }
   uint16_t map_size = (uint16_t) (tsize2 - tsize);
   to_big(trailer + 4, &map_size, sizeof(map_size));
 
-  // Make space for an (empty) array
-  tsize = (int32_t)(ptrailer - trailer);
-  trailer = realloc(trailer, (size_t) tsize + 2 + 1 + 2);
-  ptrailer = trailer + tsize;
-
   // Now, store the values in an array
   *ptrailer = 0xdc;  // array 16 with N elements
   ptrailer += 1;
   to_big(ptrailer, &nvlmetalayers, sizeof(nvlmetalayers));
   ptrailer += sizeof(nvlmetalayers);
-  current_trailer_len = (int32_t)(ptrailer - trailer);
   for (int nvlmetalayer = 0; nvlmetalayer < nvlmetalayers; nvlmetalayer++) {
-    if (frame == NULL) {
-      return -1;
-    }
     blosc2_metalayer *vlmetalayer = schunk->vlmetalayers[nvlmetalayer];
-    trailer = realloc(trailer, (size_t)current_trailer_len + 1 + 4 + vlmetalayer->content_len);
-    ptrailer = trailer + current_trailer_len;
+    int32_t current_trailer_len = (int32_t)(ptrailer - trailer);
     // Store the serialized contents for this vlmetalayer
     *ptrailer = 0xc6;  // bin32
     ptrailer += 1;
     to_big(ptrailer, &(vlmetalayer->content_len), sizeof(vlmetalayer->content_len));
     ptrailer += 4;
     memcpy(ptrailer, vlmetalayer->content, vlmetalayer->content_len);  // buffer, no need to swap
-    ptrailer += vlmetalayer->content_len;
+    ptrailer += slots_[nvlmetalayer].capacity;  // the room left is zeroed
     // Update the offset now that we know it
     to_big(trailer + offtodata[nvlmetalayer], &current_trailer_len, sizeof(current_trailer_len));
-    current_trailer_len += 1 + 4 + vlmetalayer->content_len;
+    slots_[nvlmetalayer].offset = current_trailer_len;
   }
   free(offtodata);
-  tsize = (int32_t)(ptrailer - trailer);
-  if (tsize != current_trailer_len) {  // sanity check
-    return -1;
-  }
-
-  trailer = realloc(trailer, (size_t)current_trailer_len + 23);
-  ptrailer = trailer + current_trailer_len;
-  trailer_len = (ptrailer - trailer) + 23;
 
   // Trailer length
   *ptrailer = 0xce;  // uint32
   ptrailer += 1;
-  to_big(ptrailer, &trailer_len, sizeof(uint32_t));
+  uint32_t trailer_len_ = (uint32_t)*trailer_len;
+  to_big(ptrailer, &trailer_len_, sizeof(uint32_t));
   ptrailer += sizeof(uint32_t);
   // Up to 16 bytes for frame fingerprint (using XXH3 included in https://github.com/Cyan4973/xxHash)
   // Maybe someone would need 256-bit in the future, but for the time being 128-bit seems like a good tradeoff
@@ -680,9 +730,31 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
   ptrailer += 16;
 
   // Sanity check
-  if (ptrailer - trailer != trailer_len) {
+  if (ptrailer - trailer != *trailer_len) {
+    free(slots_);
+    free(trailer);
+    return NULL;
+  }
+  *slots = slots_;
+  return trailer;
+}
+
+int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
+  if (frame != NULL && frame->len == 0) {
+    BLOSC_TRACE_ERROR("The trailer cannot be updated on empty frames.");
+  }
+
+  int16_t nvlmetalayers = schunk->nvlmetalayers;
+  int64_t trailer_len;
+  frame_vlmeta_slot* slots;
+  uint8_t* trailer = new_trailer_frame(frame, schunk, true, &trailer_len, &slots);
+  if (trailer == NULL) {
     return BLOSC2_ERROR_DATA;
   }
+  // The records are not where the slots say until the new trailer is written
+  free(frame->vlmeta_slots);
+  frame->vlmeta_slots = NULL;
+  frame->vlmeta_nslots = 0;
 
   int32_t header_len;
   int64_t frame_len;
@@ -697,6 +769,8 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
                             frame->schunk->storage->io);
   if (ret < 0) {
     BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    free(slots);
+    free(trailer);
     return ret;
   }
 
@@ -704,12 +778,16 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
 
   if (trailer_offset < BLOSC_EXTENDED_HEADER_LENGTH) {
     BLOSC_TRACE_ERROR("Unable to get trailer offset in frame.");
+    free(slots);
+    free(trailer);
     return BLOSC2_ERROR_READ_BUFFER;
   }
 
   blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
   if (io_cb == NULL) {
     BLOSC_TRACE_ERROR("Error getting the input/output API");
+    free(slots);
+    free(trailer);
     return BLOSC2_ERROR_PLUGIN_IO;
   }
   // Update the trailer.  As there are no internal offsets to the trailer section,
@@ -719,6 +797,8 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
     frame->cframe = realloc(frame->cframe, (size_t)(trailer_offset + trailer_len));
     if (frame->cframe == NULL) {
       BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
+      free(slots);
+      free(trailer);
       return BLOSC2_ERROR_MEMORY_ALLOC;
     }
     memcpy(frame->cframe + trailer_offset, trailer, trailer_len);
@@ -734,22 +814,33 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
     }
     if (fp == NULL) {
       BLOSC_TRACE_ERROR("Cannot open the frame for reading and writing.");
+      free(slots);
+      free(trailer);
       return BLOSC2_ERROR_FILE_OPEN;
     }
     io_cb->seek(fp, frame->file_offset + trailer_offset, SEEK_SET);
     int64_t wbytes = io_cb->write(trailer, 1, trailer_len, fp);
     if (wbytes != trailer_len) {
       BLOSC_TRACE_ERROR("Cannot write the trailer length in trailer.");
+      free(slots);
+      free(trailer);
       return BLOSC2_ERROR_FILE_WRITE;
     }
     if (io_cb->truncate(fp, trailer_offset + trailer_len) != 0) {
       BLOSC_TRACE_ERROR("Cannot truncate the frame.");
+      free(slots);
+      free(trailer);
       return BLOSC2_ERROR_FILE_TRUNCATE;
     }
     io_cb->close(fp);
 
   }
+  if (frame_is_durable(frame)) {
+    commit_cache(&frame->commit_trailer, &frame->commit_trailer_len, trailer, trailer_len);
+  }
   free(trailer);
+  frame->vlmeta_slots = slots;
+  frame->vlmeta_nslots = nvlmetalayers;
 
   int rc = update_frame_len(frame, trailer_offset + trailer_len);
   if (rc < 0) {
@@ -762,6 +853,551 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
 }
 
 
+/* Write the value of a vlmetalayer in place, without rewriting the rest of the trailer.
+ *
+ * Returns 1 if written, 0 if the value does not fit in its current room (so the whole
+ * trailer has to be updated instead) and a negative value on errors.
+ */
+int frame_update_vlmetalayer(blosc2_frame_s* frame, blosc2_schunk* schunk, int nvlmetalayer) {
+  if (nvlmetalayer < 0 || nvlmetalayer >= frame->vlmeta_nslots || nvlmetalayer >= schunk->nvlmetalayers) {
+    return 0;
+  }
+  frame_vlmeta_slot* slot = &frame->vlmeta_slots[nvlmetalayer];
+  blosc2_metalayer* vlmetalayer = schunk->vlmetalayers[nvlmetalayer];
+  if (vlmetalayer->content_len > slot->capacity) {
+    return 0;
+  }
+
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize, &nchunks,
+                           NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                           frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return rc;
+  }
+  int64_t trailer_offset = get_trailer_offset(frame, header_len, nbytes > 0);
+  int64_t record_offset = trailer_offset + slot->offset;
+  int32_t record_len = 1 + 4 + vlmetalayer->content_len;
+  if (trailer_offset < BLOSC_EXTENDED_HEADER_LENGTH || record_offset + record_len > frame->len) {
+    BLOSC_TRACE_ERROR("Cannot access the trailer out of the frame.");
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+
+  // The bin32 record for the value
+  uint8_t* record = malloc(record_len);
+  BLOSC_ERROR_NULL(record, BLOSC2_ERROR_MEMORY_ALLOC);
+  record[0] = 0xc6;  // bin32
+  to_big(record + 1, &(vlmetalayer->content_len), sizeof(vlmetalayer->content_len));
+  memcpy(record + 1 + 4, vlmetalayer->content, vlmetalayer->content_len);
+
+  if (frame->cframe != NULL) {
+    memcpy(frame->cframe + record_offset, record, record_len);
+  }
+  else {
+    blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+    if (io_cb == NULL) {
+      BLOSC_TRACE_ERROR("Error getting the input/output API");
+      free(record);
+      return BLOSC2_ERROR_PLUGIN_IO;
+    }
+    void* fp = NULL;
+    if (frame->sframe) {
+      fp = sframe_open_index(frame->urlpath, "rb+",
+                             frame->schunk->storage->io);
+    }
+    else {
+      fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
+    }
+    if (fp == NULL) {
+      BLOSC_TRACE_ERROR("Cannot open the frame for reading and writing.");
+      free(record);
+      return BLOSC2_ERROR_FILE_OPEN;
+    }
+    io_cb->seek(fp, frame->file_offset + record_offset, SEEK_SET);
+    int64_t wbytes = io_cb->write(record, 1, record_len, fp);
+    io_cb->close(fp);
+    if (wbytes != record_len) {
+      BLOSC_TRACE_ERROR("Cannot write the vlmetalayer in trailer.");
+      free(record);
+      return BLOSC2_ERROR_FILE_WRITE;
+    }
+    if (frame->commit_trailer != NULL && slot->offset + record_len <= frame->commit_trailer_len) {
+      memcpy(frame->commit_trailer + slot->offset, record, record_len);
+    }
+  }
+  free(record);
+
+  return 1;
+}
+
+
+/*********************************************************************
+  Durable mode (group commit).
+
+  The mutations of a contiguous frame only overwrite its header and the
+  bytes past the chunk data (the offsets and the trailer), so a commit
+  syncs the frame and saves those parts in a write-ahead record next to
+  it.  Mutations after a commit are not synced, and if they are cut short
+  by a crash, the record is used to roll the frame back on re-open.
+
+  The schunk functions take commit_mutex around every mutation, so that
+  concurrent mutations and commits are serialized, and a committer thread
+  makes sure that no mutation waits longer than commit_interval.
+*********************************************************************/
+
+#define FRAME_WAL_MAGIC "b2frwal\1"
+#define FRAME_WAL_HEADER_LEN (8 + 8 + 8 + 4 + 8 + 8)  // magic, offset, len, header_len, tail, checksum
+#define FRAME_COMMIT_POLL_MS (10)  // how often a sleeping committer thread checks whether to stop
+
+bool frame_is_durable(blosc2_frame_s* frame) {
+  return frame->cframe == NULL && frame->urlpath != NULL && !frame->sframe &&
+         (frame->commit_interval > 0 || frame->commit_size > 0);
+}
+
+void frame_lock(blosc2_frame_s* frame) {
+  if (frame != NULL && frame->commit_lock_init) {
+    pthread_mutex_lock(&frame->commit_mutex);
+  }
+}
+
+void frame_unlock(blosc2_frame_s* frame) {
+  if (frame != NULL && frame->commit_lock_init) {
+    pthread_mutex_unlock(&frame->commit_mutex);
+  }
+}
+
+static char* get_wal_path(const char* urlpath) {
+  char* wal_path = malloc(strlen(urlpath) + strlen(FRAME_WAL_SUFFIX) + 1);
+  sprintf(wal_path, "%s%s", urlpath, FRAME_WAL_SUFFIX);
+  return wal_path;
+}
+
+// FNV-1a is enough for detecting torn records
+static uint64_t wal_checksum(const uint8_t* buf, int64_t len) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int64_t i = 0; i < len; i++) {
+    hash = (hash ^ buf[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+
+/* Sync the frame and write a new write-ahead record for its current state.  The caller holds the lock. */
+int frame_commit(blosc2_frame_s* frame) {
+  if (!frame_is_durable(frame) || (frame->commit_valid && !frame->commit_dirty)) {
+    // Nothing to commit (e.g. another thread did it already)
+    return 0;
+  }
+  blosc2_io *io = frame->schunk->storage->io;
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  blosc2_sync_cb sync = get_io_sync_cb(io_cb);
+  if (sync == NULL) {
+    BLOSC_TRACE_ERROR("The input/output backend does not support the durable mode.");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes, &blocksize, &chunksize,
+                           &nchunks, NULL, NULL, NULL, NULL, NULL, NULL, NULL, io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return rc;
+  }
+  // Mutations never write before the end of the chunk data (but in the header)
+  int64_t tail_start = header_len + cbytes;
+  int64_t tail_len = frame->len - tail_start;
+  if (tail_len < 0) {
+    BLOSC_TRACE_ERROR("Unable to get the end of the chunks in frame.");
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+  // The tail is the offsets chunk and the trailer that were written last, unless they are not known
+  bool tail_cached = frame->commit_trailer != NULL &&
+                     ((frame->commit_coffsets != NULL &&
+                       frame->commit_coffsets_len + frame->commit_trailer_len == tail_len) ||
+                      (nchunks == 0 && frame->commit_trailer_len == tail_len));
+
+  int64_t record_len = FRAME_WAL_HEADER_LEN + header_len + tail_len;
+  uint8_t* record = malloc((size_t)record_len);
+  if (record == NULL) {
+    BLOSC_TRACE_ERROR("Error allocating memory for the write-ahead record.");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  uint8_t* header = record + FRAME_WAL_HEADER_LEN;
+  void* fp = io_cb->open(frame->urlpath, "rb+", io->params);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Cannot open the frame for syncing.");
+    free(record);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  io_cb->seek(fp, frame->file_offset, SEEK_SET);
+  int64_t rbytes = io_cb->read(header, 1, header_len, fp);
+  if (tail_cached) {
+    int64_t coffsets_len = tail_len - frame->commit_trailer_len;
+    if (coffsets_len > 0) {
+      memcpy(header + header_len, frame->commit_coffsets, coffsets_len);
+    }
+    memcpy(header + header_len + coffsets_len, frame->commit_trailer, frame->commit_trailer_len);
+    rbytes += tail_len;
+  }
+  else {
+    io_cb->seek(fp, frame->file_offset + tail_start, SEEK_SET);
+    rbytes += io_cb->read(header + header_len, 1, tail_len, fp);
+  }
+  rc = sync(fp);
+  io_cb->close(fp);
+  if (rbytes != header_len + tail_len || rc != 0) {
+    BLOSC_TRACE_ERROR("Cannot sync the frame.");
+    free(record);
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+
+  memcpy(record, FRAME_WAL_MAGIC, 8);
+  to_big(record + 8, &frame->file_offset, sizeof(int64_t));
+  to_big(record + 16, &frame->len, sizeof(int64_t));
+  to_big(record + 24, &header_len, sizeof(int32_t));
+  to_big(record + 28, &tail_start, sizeof(int64_t));
+  uint64_t checksum = wal_checksum(header, header_len + tail_len);
+  to_big(record + 36, &checksum, sizeof(uint64_t));
+
+  char* wal_path = get_wal_path(frame->urlpath);
+  fp = io_cb->open(wal_path, "wb", io->params);
+  free(wal_path);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Cannot open the write-ahead record of the frame.");
+    free(record);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  int64_t wbytes = io_cb->write(record, 1, record_len, fp);
+  rc = sync(fp);
+  io_cb->close(fp);
+  free(record);
+  if (wbytes != record_len || rc != 0) {
+    BLOSC_TRACE_ERROR("Cannot write the write-ahead record of the frame.");
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+
+  frame->commit_valid = true;
+  frame->commit_dirty = false;
+  frame->commit_nbytes = 0;
+  return 0;
+}
+
+
+static void sleep_ms(int32_t ms) {
+#if defined(_WIN32)
+  Sleep(ms);
+#else
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+  nanosleep(&ts, NULL);
+#endif
+}
+
+/* Commit the mutations at most commit_interval milliseconds after the first uncommitted one */
+static void* committer_thread(void* arg) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)arg;
+  pthread_mutex_lock(&frame->commit_mutex);
+  while (!frame->commit_stop) {
+    if (!frame->commit_dirty) {
+      pthread_cond_wait(&frame->commit_cond, &frame->commit_mutex);
+      continue;
+    }
+    blosc_timestamp_t now;
+    blosc_set_timestamp(&now);
+    double left_ms = frame->commit_interval - blosc_elapsed_secs(frame->commit_dirty_time, now) * 1000;
+    if (left_ms > 0) {
+      // There is no portable timed wait, so sleep (without the lock) in short slices
+      pthread_mutex_unlock(&frame->commit_mutex);
+      sleep_ms(left_ms < FRAME_COMMIT_POLL_MS ? (int32_t)left_ms + 1 : FRAME_COMMIT_POLL_MS);
+      pthread_mutex_lock(&frame->commit_mutex);
+      continue;
+    }
+    int rc = frame_commit(frame);
+    if (rc < 0) {
+      // Reported by the next blosc2_schunk_commit(); retry after another interval
+      frame->commit_error = rc;
+      frame->commit_dirty_time = now;
+    }
+  }
+  pthread_mutex_unlock(&frame->commit_mutex);
+  return NULL;
+}
+
+static void stop_committer(blosc2_frame_s* frame) {
+  if (!frame->commit_thread_started) {
+    return;
+  }
+  pthread_mutex_lock(&frame->commit_mutex);
+  frame->commit_stop = true;
+  pthread_cond_signal(&frame->commit_cond);
+  pthread_mutex_unlock(&frame->commit_mutex);
+  pthread_join(frame->commit_thread, NULL);
+  frame->commit_thread_started = false;
+  frame->commit_stop = false;
+}
+
+static void drop_commit_caches(blosc2_frame_s* frame) {
+  free(frame->commit_coffsets);
+  frame->commit_coffsets = NULL;
+  frame->commit_coffsets_len = 0;
+  free(frame->commit_trailer);
+  frame->commit_trailer = NULL;
+  frame->commit_trailer_len = 0;
+}
+
+
+/* Stop the committer thread and release everything that the durable mode uses */
+void frame_commit_free(blosc2_frame_s* frame) {
+  stop_committer(frame);
+  drop_commit_caches(frame);
+  if (frame->commit_lock_init) {
+    pthread_mutex_destroy(&frame->commit_mutex);
+    pthread_cond_destroy(&frame->commit_cond);
+    frame->commit_lock_init = false;
+  }
+}
+
+
+int frame_set_durable(blosc2_frame_s* frame, int32_t commit_interval, int64_t commit_size) {
+  if (commit_interval < 0 || commit_size < 0) {
+    BLOSC_TRACE_ERROR("The commit window cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  bool enable = commit_interval > 0 || commit_size > 0;
+  if (enable && (frame->cframe != NULL || frame->urlpath == NULL || frame->sframe)) {
+    BLOSC_TRACE_ERROR("The durable mode needs a contiguous, on-disk frame.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  if (enable && get_io_sync_cb(io_cb) == NULL) {
+    BLOSC_TRACE_ERROR("The input/output backend does not support the durable mode.");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+
+  // Commit what is pending under the former window
+  int rc = frame_commit_close(frame);
+  if (rc < 0) {
+    return rc;
+  }
+  if (!frame->commit_lock_init) {
+    pthread_mutex_init(&frame->commit_mutex, NULL);
+    pthread_cond_init(&frame->commit_cond, NULL);
+    frame->commit_lock_init = true;
+  }
+  frame->commit_interval = commit_interval;
+  frame->commit_size = commit_size;
+  frame->commit_error = 0;
+  // The caches are only kept up to date in the durable mode
+  drop_commit_caches(frame);
+  if (!enable) {
+    return 0;
+  }
+
+  rc = frame_commit(frame);
+  if (rc < 0) {
+    frame->commit_interval = 0;
+    frame->commit_size = 0;
+    return rc;
+  }
+  if (commit_interval > 0) {
+    if (pthread_create(&frame->commit_thread, NULL, committer_thread, frame) != 0) {
+      BLOSC_TRACE_ERROR("Cannot create the committer thread.");
+      frame_commit_close(frame);
+      frame->commit_interval = 0;
+      frame->commit_size = 0;
+      return BLOSC2_ERROR_THREAD_CREATE;
+    }
+    frame->commit_thread_started = true;
+  }
+  return 0;
+}
+
+
+/* Replace a borrowed cframe with a private copy, so that the one of the caller is never written */
+static int own_cframe(blosc2_frame_s* frame) {
+  uint8_t* cframe = malloc((size_t)frame->len);
+  BLOSC_ERROR_NULL(cframe, BLOSC2_ERROR_MEMORY_ALLOC);
+  memcpy(cframe, frame->cframe, (size_t)frame->len);
+  if (!frame->avoid_cframe_free) {
+    // The caller handed the buffer over (see blosc2_schunk_avoid_cframe_free())
+    free(frame->cframe);
+  }
+  frame->cframe = cframe;
+  frame->avoid_cframe_free = false;
+  frame->cframe_borrowed = false;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Make sure that there is a record of the last commit before mutating the frame */
+int frame_commit_begin(blosc2_frame_s* frame) {
+  // This is where every mutation starts, so views and borrowed buffers are protected here
+  int rc = frame_check_writable(frame);
+  if (rc < 0) {
+    return rc;
+  }
+  if (frame != NULL && frame->cframe_borrowed) {
+    rc = own_cframe(frame);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  if (!frame_is_durable(frame) || frame->commit_valid) {
+    return 0;
+  }
+  return frame_commit(frame);
+}
+
+
+/* Account for a mutation of @p nbytes and commit if the commit size is exceeded */
+int frame_commit_end(blosc2_frame_s* frame, int64_t nbytes) {
+  if (!frame_is_durable(frame)) {
+    return 0;
+  }
+  if (!frame->commit_dirty) {
+    // The window of the committer thread starts now
+    blosc_set_timestamp(&frame->commit_dirty_time);
+    frame->commit_dirty = true;
+    if (frame->commit_thread_started) {
+      pthread_cond_signal(&frame->commit_cond);
+    }
+  }
+  frame->commit_nbytes += nbytes;
+  if (frame->commit_size > 0 && frame->commit_nbytes >= frame->commit_size) {
+    return frame_commit(frame);
+  }
+  return 0;
+}
+
+
+/* Commit the pending mutations and remove the write-ahead record (e.g. when closing) */
+int frame_commit_close(blosc2_frame_s* frame) {
+  stop_committer(frame);
+  int rc = frame->commit_error;
+  frame->commit_error = 0;
+  if (!frame->commit_valid) {
+    return rc;
+  }
+  if (frame->commit_dirty) {
+    int rc_commit = frame_commit(frame);
+    if (rc_commit < 0) {
+      return rc_commit;
+    }
+  }
+  // The record matches the frame, so it does not matter whether the removal reaches the disk
+  frame_remove_wal(frame->urlpath);
+  frame->commit_valid = false;
+  return rc;
+}
+
+
+void frame_remove_wal(const char* urlpath) {
+  char* wal_path = get_wal_path(urlpath);
+  remove(wal_path);
+  free(wal_path);
+}
+
+
+/* Roll back the frame at @p offset in @p urlpath to its last commit, if a crash left a record behind */
+static int frame_recover(const char* urlpath, const blosc2_io *io, int64_t offset) {
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  blosc2_sync_cb sync = get_io_sync_cb(io_cb);
+  if (sync == NULL) {
+    // Records are only written through backends that can sync
+    return 0;
+  }
+  char* wal_path = get_wal_path(urlpath);
+  void* fp = io_cb->open(wal_path, "rb", io->params);
+  free(wal_path);
+  if (fp == NULL) {
+    // No record (the usual case)
+    return 0;
+  }
+  io_cb->seek(fp, 0, SEEK_END);
+  int64_t record_len = io_cb->tell(fp);
+  io_cb->seek(fp, 0, SEEK_SET);
+  if (record_len < FRAME_WAL_HEADER_LEN) {
+    io_cb->close(fp);
+    return 0;
+  }
+  uint8_t* record = malloc((size_t)record_len);
+  if (record == NULL) {
+    io_cb->close(fp);
+    BLOSC_TRACE_ERROR("Error allocating memory for the write-ahead record.");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  int64_t rbytes = io_cb->read(record, 1, record_len, fp);
+  io_cb->close(fp);
+
+  int64_t file_offset;
+  int64_t frame_len;
+  int32_t header_len;
+  int64_t tail_start;
+  uint64_t checksum;
+  to_big(&file_offset, record + 8, sizeof(int64_t));
+  to_big(&frame_len, record + 16, sizeof(int64_t));
+  to_big(&header_len, record + 24, sizeof(int32_t));
+  to_big(&tail_start, record + 28, sizeof(int64_t));
+  to_big(&checksum, record + 36, sizeof(uint64_t));
+  uint8_t* header = record + FRAME_WAL_HEADER_LEN;
+  int64_t tail_len = frame_len - tail_start;
+  // A torn record was being written after syncing the frame, so there is nothing to roll back
+  if (rbytes != record_len || memcmp(record, FRAME_WAL_MAGIC, 8) != 0 || file_offset != offset ||
+      header_len < 0 || tail_len < 0 || FRAME_WAL_HEADER_LEN + header_len + tail_len != record_len ||
+      wal_checksum(header, header_len + tail_len) != checksum) {
+    free(record);
+    return 0;
+  }
+
+  fp = io_cb->open(urlpath, "rb+", io->params);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Cannot open the frame for rolling it back to the last commit.");
+    free(record);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  io_cb->seek(fp, offset, SEEK_SET);
+  int64_t wbytes = io_cb->write(header, 1, header_len, fp);
+  io_cb->seek(fp, offset + tail_start, SEEK_SET);
+  wbytes += io_cb->write(header + header_len, 1, tail_len, fp);
+  int rc = io_cb->truncate(fp, offset + frame_len);
+  if (rc == 0) {
+    rc = sync(fp);
+  }
+  io_cb->close(fp);
+  free(record);
+  if (wbytes != header_len + tail_len || rc != 0) {
+    BLOSC_TRACE_ERROR("Cannot roll back the frame to the last commit.");
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+  frame_remove_wal(urlpath);
+  return 0;
+}
+
 // Remove a file:/// prefix
 // This is a temporary workaround for allowing to use proper URLs for local files/dirs
 static char* normalize_urlpath(const char* urlpath) {
@@ -814,6 +1450,9 @@ blosc2_frame_s* frame_from_file_offset(const char* urlpath, const blosc2_io *io,
         sframe = true;
     }
     else {
+        if (frame_recover(urlpath, io, offset) < 0) {
+            return NULL;
+        }
         urlpath_cpy = malloc(strlen(urlpath) + 1);
         strcpy(urlpath_cpy, urlpath);
         fp = io_cb->open(urlpath, "rb", io->params);
@@ -855,6 +1494,12 @@ blosc2_frame_s* frame_from_file_offset(const char* urlpath, const blosc2_io *io,
     to_big(&trailer_len, trailer + trailer_offset, sizeof(trailer_len));
     frame->trailer_len = trailer_len;
 
+    if (sframe && header[FRAME_TYPE] == FRAME_SEGMENTS_TYPE && sframe_open_segments(frame, io) < 0) {
+        BLOSC_TRACE_ERROR("Cannot read the segments index of '%s'.", urlpath);
+        frame_free(frame);
+        return NULL;
+    }
+
     return frame;
 }
 
@@ -1040,6 +1685,16 @@ int64_t frame_from_schunk(blosc2_schunk *schunk, blosc2_frame_s *frame) {
 }
 
 
+// Drop the cached chunk offsets (both the compressed and the decompressed ones)
+static void invalidate_offsets(blosc2_frame_s *frame) {
+  if (frame->coffsets != NULL) {
+    free(frame->coffsets);
+    frame->coffsets = NULL;
+  }
+  frame->offsets_len = 0;
+}
+
+
 // Get the compressed data offsets
 uint8_t* get_coffsets(blosc2_frame_s *frame, int32_t header_len, int64_t cbytes,
                       int64_t nchunks, int32_t *off_cbytes) {
@@ -1445,7 +2100,6 @@ int frame_get_metalayers(blosc2_frame_s* frame, blosc2_schunk* schunk) {
 static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk, uint8_t* trailer,
                                    int32_t trailer_len) {
 
-  BLOSC_UNUSED_PARAM(frame);
   int64_t trailer_pos = FRAME_TRAILER_VLMETALAYERS + 2;
   uint8_t* idxp = trailer + trailer_pos;
 
@@ -1478,6 +2132,10 @@ static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk,
   if (nmetalayers > BLOSC2_MAX_VLMETALAYERS) {
     return BLOSC2_ERROR_DATA;
   }
+  free(frame->vlmeta_slots);
+  frame->vlmeta_nslots = 0;
+  frame->vlmeta_slots = malloc(nmetalayers * sizeof(frame_vlmeta_slot) + 1);
+  BLOSC_ERROR_NULL(frame->vlmeta_slots, BLOSC2_ERROR_MEMORY_ALLOC);
   schunk->nvlmetalayers = nmetalayers;
 
   // Populate the metalayers and its serialized values
@@ -1550,7 +2208,25 @@ static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk,
     char* content = malloc((size_t)content_len);
     memcpy(content, content_marker + 1 + 4, (size_t)content_len);
     metalayer->content = (uint8_t*)content;
+    frame->vlmeta_slots[nmetalayer].offset = offset;
+    frame->vlmeta_slots[nmetalayer].capacity = content_len;
   }
+
+  // The room of every value goes up to the next one (or to the trailer length marker)
+  for (int nmetalayer = 0; nmetalayer < nmetalayers; nmetalayer++) {
+    frame_vlmeta_slot* slot = &frame->vlmeta_slots[nmetalayer];
+    int64_t end = trailer_len - 23;
+    for (int i = 0; i < nmetalayers; i++) {
+      int32_t offset = frame->vlmeta_slots[i].offset;
+      if (offset > slot->offset && offset < end) {
+        end = offset;
+      }
+    }
+    // Overlapping values cannot be updated in place
+    slot->capacity = (end - slot->offset - 1 - 4 >= slot->capacity) ? (int32_t)(end - slot->offset - 1 - 4) : -1;
+  }
+  frame->vlmeta_nslots = nmetalayers;
+
   return 1;
 }
 
@@ -1677,7 +2353,7 @@ blosc2_schunk* frame_to_schunk(blosc2_frame_s* frame, bool copy, const blosc2_io
   int32_t header_len;
   int64_t frame_len;
   int rc;
-  blosc2_schunk* schunk = calloc(1, sizeof(blosc2_schunk));
+  blosc2_schunk* schunk = calloc(1, sizeof(blosc2_schunk_private));
   schunk->frame = (blosc2_frame*)frame;
   frame->schunk = schunk;
 
@@ -1891,6 +2567,13 @@ blosc2_schunk* frame_to_schunk(blosc2_frame_s* frame, bool copy, const blosc2_io
     return NULL;
   }
 
+  rc = zonemap_load(schunk);
+  if (rc < 0) {
+    blosc2_schunk_free(schunk);
+    BLOSC_TRACE_ERROR("Cannot access the zone map.");
+    return NULL;
+  }
+
   return schunk;
 }
 
@@ -1900,6 +2583,16 @@ void frame_avoid_cframe_free(blosc2_frame_s* frame, bool avoid_cframe_free) {
 }
 
 
+/* Views of frames owned by someone else cannot be modified */
+int frame_check_writable(blosc2_frame_s* frame) {
+  if (frame != NULL && frame->readonly) {
+    BLOSC_TRACE_ERROR("The frame is a read-only view.");
+    return BLOSC2_ERROR_READ_ONLY;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
 struct csize_idx {
     int32_t val;
     int32_t idx;
@@ -1915,24 +2608,50 @@ int sort_offset(const void* a, const void* b) {
 
 int get_coffset(blosc2_frame_s* frame, int32_t header_len, int64_t cbytes,
                 int64_t nchunk, int64_t nchunks, int64_t *offset) {
-  int32_t off_cbytes;
-  // Get the offset to nchunk
-  uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &off_cbytes);
-  if (coffsets == NULL) {
-    BLOSC_TRACE_ERROR("Cannot get the offset for chunk %" PRId64 " for the frame.", nchunk);
-    return BLOSC2_ERROR_DATA;
+  // Offsets are resolved on demand, one block of the offsets chunk at a time, so
+  // that neither opening a frame nor reading nearby chunks decompresses them all
+  if (nchunk < frame->offsets_start || nchunk >= frame->offsets_start + frame->offsets_len) {
+    int32_t off_cbytes;
+    uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &off_cbytes);
+    if (coffsets == NULL) {
+      BLOSC_TRACE_ERROR("Cannot get the offset for chunk %" PRId64 " for the frame.", nchunk);
+      return BLOSC2_ERROR_DATA;
+    }
+    int32_t off_blocksize;
+    int rc = blosc2_cbuffer_sizes(coffsets, NULL, NULL, &off_blocksize);
+    if (rc < 0) {
+      return rc;
+    }
+    int32_t block_noffsets = off_blocksize / (int32_t)sizeof(int64_t);
+    if (block_noffsets <= 0 || block_noffsets > FRAME_OFFSETS_CACHE_MAX) {
+      block_noffsets = FRAME_OFFSETS_CACHE_MAX;
+    }
+    int64_t start = nchunk - nchunk % block_noffsets;
+    int32_t noffsets = (int32_t)(nchunks - start < block_noffsets ? nchunks - start : block_noffsets);
+    if (frame->offsets == NULL) {
+      frame->offsets = malloc(FRAME_OFFSETS_CACHE_MAX * sizeof(int64_t));
+      if (frame->offsets == NULL) {
+        return BLOSC2_ERROR_MEMORY_ALLOC;
+      }
+    }
+    frame->offsets_len = 0;
+    rc = blosc2_getitem(coffsets, off_cbytes, (int32_t)start, noffsets, frame->offsets,
+                        noffsets * (int32_t)sizeof(int64_t));
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Problems retrieving a chunk offset.");
+      return rc;
+    }
+    frame->offsets_start = start;
+    frame->offsets_len = noffsets;
   }
 
-  // Get the 64-bit offset
-  int rc = blosc2_getitem(coffsets, off_cbytes, (int32_t)nchunk, 1, offset, (int32_t)sizeof(int64_t));
-  if (rc < 0) {
-    BLOSC_TRACE_ERROR("Problems retrieving a chunk offset.");
-  } else if (!frame->sframe && *offset > frame->len) {
+  *offset = frame->offsets[nchunk - frame->offsets_start];
+  if (!frame->sframe && *offset > frame->len) {
     BLOSC_TRACE_ERROR("Cannot read chunk %" PRId64 " outside of frame boundary.", nchunk);
-    rc = BLOSC2_ERROR_READ_BUFFER;
+    return BLOSC2_ERROR_READ_BUFFER;
   }
 
-  return rc;
+  return BLOSC2_ERROR_SUCCESS;
 }
 
 
@@ -2171,10 +2890,17 @@ int frame_get_lazychunk(blosc2_frame_s *frame, int64_t nchunk, uint8_t **chunk,
     int32_t chunk_cbytes;
     int32_t chunk_blocksize;
     uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
+    int64_t chunk_file = 0;   // the file where the chunk is (sframes only)
+    int64_t chunk_start = 0;  // and where the chunk starts in it
     if (frame->sframe) {
       // The chunk is not in the frame
-      fp = sframe_open_chunk(frame->urlpath, offset, "rb",
-                             frame->schunk->storage->io);
+      fp = sframe_open_chunk_data(frame, offset, &chunk_file, &chunk_start);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Cannot open the file for chunk %" PRId64 ".", nchunk);
+        rc = BLOSC2_ERROR_FILE_OPEN;
+        goto end;
+      }
+      io_cb->seek(fp, chunk_start, SEEK_SET);
     }
     else {
       fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
@@ -2226,7 +2952,7 @@ int frame_get_lazychunk(blosc2_frame_s *frame, int64_t nchunk, uint8_t **chunk,
 
     // Read just the full header and bstarts section too (lazy partial length)
     if (frame->sframe) {
-      io_cb->seek(fp, 0, SEEK_SET);
+      io_cb->seek(fp, chunk_start, SEEK_SET);
     }
     else {
       io_cb->seek(fp, frame->file_offset + header_len + offset, SEEK_SET);
@@ -2248,7 +2974,12 @@ int frame_get_lazychunk(blosc2_frame_s *frame, int64_t nchunk, uint8_t **chunk,
     *blosc2_flags |= 0x08U;
 
     // Add the trailer (currently, nchunk + offset + block_csizes)
-    if (frame->sframe) {
+    if (frame->sframe && frame->segment_size > 0) {
+      // The segment file and the chunk offset inside it
+      *(int32_t*)(*chunk + trailer_offset) = (int32_t)chunk_file;
+      *(int64_t*)(*chunk + trailer_offset + sizeof(int32_t)) = chunk_start;
+    }
+    else if (frame->sframe) {
       *(int32_t*)(*chunk + trailer_offset) = (int32_t)offset;   // offset is nchunk for sframes
       *(int64_t*)(*chunk + trailer_offset + sizeof(int32_t)) = offset;
     }
@@ -2332,6 +3063,10 @@ int frame_get_lazychunk(blosc2_frame_s *frame, int64_t nchunk, uint8_t **chunk,
 /* Fill an empty frame with special values (fast path). */
 int64_t frame_fill_special(blosc2_frame_s* frame, int64_t nitems, int special_value,
                        int32_t chunksize, blosc2_schunk* schunk) {
+  int rc_commit = frame_commit_begin(frame);
+  if (rc_commit < 0) {
+    return rc_commit;
+  }
   int32_t header_len;
   int64_t frame_len;
   int64_t nbytes;
@@ -2461,10 +3196,8 @@ int64_t frame_fill_special(blosc2_frame_s* frame, int64_t nitems, int special_va
   }
 
   // Invalidate the cache for chunk offsets
-  if (frame->coffsets != NULL) {
-    free(frame->coffsets);
-    frame->coffsets = NULL;
-  }
+  invalidate_offsets(frame);
+  commit_cache_coffsets(frame, off_chunk, new_off_cbytes);
   free(off_chunk);
 
   frame->len = new_frame_len;
@@ -2478,13 +3211,31 @@ int64_t frame_fill_special(blosc2_frame_s* frame, int64_t nitems, int special_va
     return BLOSC2_ERROR_FRAME_SPECIAL;
   }
 
+  rc_commit = frame_commit_end(frame, 0);
+  if (rc_commit < 0) {
+    return rc_commit;
+  }
+
   return frame->len;
 }
 
 
 /* Append an existing chunk into a frame. */
 void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schunk) {
-  int8_t* chunk_ = chunk;
+  void* rframe = frame_append_chunks(frame, (uint8_t**)&chunk, 1, schunk);
+  if (rframe != NULL) {
+    free(chunk);  // chunk has always to be a copy when reaching here...
+  }
+  return rframe;
+}
+
+
+/* Append `nchunks_new` chunks, updating the offsets, header and trailer only once.
+ * The chunks are not freed. */
+void* frame_append_chunks(blosc2_frame_s* frame, uint8_t** chunks, int64_t nchunks_new, blosc2_schunk* schunk) {
+  if (frame_commit_begin(frame) < 0) {
+    return NULL;
+  }
   int32_t header_len;
   int64_t frame_len;
   int64_t nbytes;
@@ -2500,47 +3251,29 @@ void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schu
     return NULL;
   }
 
-  /* The uncompressed and compressed sizes start at byte 4 and 12 */
-  int32_t chunk_nbytes;
-  int32_t chunk_cbytes;
-  rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, &chunk_cbytes, NULL);
-  if (rc < 0) {
-    return NULL;
-  }
-
-  if ((nchunks > 0) && (chunk_nbytes > chunksize)) {
-    BLOSC_TRACE_ERROR("Appending chunks with a larger chunksize than frame is "
-                      "not allowed yet %d != %d.", chunk_nbytes, chunksize);
+  int32_t* chunks_cbytes = malloc(nchunks_new * sizeof(int32_t));
+  if (chunks_cbytes == NULL) {
+    BLOSC_TRACE_ERROR("Cannot allocate memory for the chunk sizes.");
     return NULL;
   }
-
-  // Check that we are not appending a small chunk after another small chunk
-  int32_t chunk_nbytes_last;
-  if (chunksize == 0 && (nchunks > 0) && (chunk_nbytes < chunksize)) {
-    uint8_t* last_chunk;
-    bool needs_free;
-    rc = frame_get_lazychunk(frame, nchunks - 1, &last_chunk, &needs_free);
-    if (rc < 0) {
-      BLOSC_TRACE_ERROR("Cannot get the last chunk (in position %" PRId64 ").", nchunks - 1);
-    } else {
-      rc = blosc2_cbuffer_sizes(last_chunk, &chunk_nbytes_last, NULL, NULL);
-    }
-    if (needs_free) {
-      free(last_chunk);
-    }
+  for (int64_t i = 0; i < nchunks_new; ++i) {
+    /* The uncompressed and compressed sizes start at byte 4 and 12 */
+    int32_t chunk_nbytes;
+    rc = blosc2_cbuffer_sizes(chunks[i], &chunk_nbytes, &chunks_cbytes[i], NULL);
     if (rc < 0) {
+      free(chunks_cbytes);
       return NULL;
     }
-    if ((chunk_nbytes_last < chunksize) && (nbytes < chunksize)) {
-      BLOSC_TRACE_ERROR("Appending two consecutive chunks with a chunksize smaller "
-                        "than the frame chunksize is not allowed yet: %d != %d.",
-                        chunk_nbytes, chunksize);
+    if ((nchunks > 0) && (chunk_nbytes > chunksize)) {
+      BLOSC_TRACE_ERROR("Appending chunks with a larger chunksize than frame is "
+                        "not allowed yet %d != %d.", chunk_nbytes, chunksize);
+      free(chunks_cbytes);
       return NULL;
     }
   }
 
-  // Get the current offsets and add one more
-  int32_t off_nbytes = (int32_t) ((nchunks + 1) * sizeof(int64_t));
+  // Get the current offsets and add the new ones
+  int32_t off_nbytes = (int32_t) ((nchunks + nchunks_new) * sizeof(int64_t));
   int64_t* offsets = (int64_t *) malloc((size_t)off_nbytes);
   if (nchunks > 0) {
     int32_t coffsets_cbytes;
@@ -2548,6 +3281,7 @@ void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schu
     if (coffsets == NULL) {
       BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
       free(offsets);
+      free(chunks_cbytes);
       return NULL;
     }
     if (coffsets_cbytes == 0) {
@@ -2562,47 +3296,56 @@ void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schu
     blosc2_free_ctx(dctx);
     if (prev_nbytes < 0) {
       free(offsets);
+      free(chunks_cbytes);
       BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
       return NULL;
     }
   }
 
-  // Add the new offset
+  // Add the new offsets
   int64_t sframe_chunk_id = -1;
-  int special_value = (chunk_[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
-  uint64_t offset_value = ((uint64_t)1 << 63);
-  switch (special_value) {
-    case BLOSC2_SPECIAL_ZERO:
-      // Zero chunk.  Code it in a special way.
-      offset_value += (uint64_t) BLOSC2_SPECIAL_ZERO << (8 * 7);  // chunk of zeros
-      to_little(offsets + nchunks, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
-      break;
-    case BLOSC2_SPECIAL_UNINIT:
-      // Non initizalized values chunk.  Code it in a special way.
-      offset_value += (uint64_t) BLOSC2_SPECIAL_UNINIT << (8 * 7);  // chunk of uninit values
-      to_little(offsets + nchunks, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
-      break;
-    case BLOSC2_SPECIAL_NAN:
-      // NaN chunk.  Code it in a special way.
-      offset_value += (uint64_t)BLOSC2_SPECIAL_NAN << (8 * 7);  // chunk of NANs
-      to_little(offsets + nchunks, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
-      break;
-    default:
-      if (frame->sframe) {
-        // Compute the sframe_chunk_id value
-        for (int i = 0; i < nchunks; ++i) {
-          if (offsets[i] > sframe_chunk_id) {
-            sframe_chunk_id = offsets[i];
-          }
-        }
-        offsets[nchunks] = ++sframe_chunk_id;
-      }
-      else {
-        offsets[nchunks] = cbytes;
+  if (frame->sframe) {
+    // Compute the first free sframe_chunk_id value
+    for (int i = 0; i < nchunks; ++i) {
+      if (offsets[i] > sframe_chunk_id) {
+        sframe_chunk_id = offsets[i];
       }
+    }
+  }
+  int64_t sframe_first_chunk_id = sframe_chunk_id + 1;
+  int64_t new_cbytes = cbytes;
+  for (int64_t i = 0; i < nchunks_new; ++i) {
+    int8_t* chunk_ = (int8_t*)chunks[i];
+    int special_value = (chunk_[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+    uint64_t offset_value = ((uint64_t)1 << 63);
+    switch (special_value) {
+      case BLOSC2_SPECIAL_ZERO:
+        // Zero chunk.  Code it in a special way.
+        offset_value += (uint64_t) BLOSC2_SPECIAL_ZERO << (8 * 7);  // chunk of zeros
+        to_little(offsets + nchunks + i, &offset_value, sizeof(uint64_t));
+        chunks_cbytes[i] = 0;   // we don't need to store the chunk
+        break;
+      case BLOSC2_SPECIAL_UNINIT:
+        // Non initizalized values chunk.  Code it in a special way.
+        offset_value += (uint64_t) BLOSC2_SPECIAL_UNINIT << (8 * 7);  // chunk of uninit values
+        to_little(offsets + nchunks + i, &offset_value, sizeof(uint64_t));
+        chunks_cbytes[i] = 0;   // we don't need to store the chunk
+        break;
+      case BLOSC2_SPECIAL_NAN:
+        // NaN chunk.  Code it in a special way.
+        offset_value += (uint64_t)BLOSC2_SPECIAL_NAN << (8 * 7);  // chunk of NANs
+        to_little(offsets + nchunks + i, &offset_value, sizeof(uint64_t));
+        chunks_cbytes[i] = 0;   // we don't need to store the chunk
+        break;
+      default:
+        if (frame->sframe) {
+          offsets[nchunks + i] = ++sframe_chunk_id;
+        }
+        else {
+          offsets[nchunks + i] = new_cbytes;
+        }
+    }
+    new_cbytes += chunks_cbytes[i];
   }
 
   // Re-compress the offsets again
@@ -2621,11 +3364,11 @@ void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schu
   free(offsets);
   if (new_off_cbytes < 0) {
     free(off_chunk);
+    free(chunks_cbytes);
     return NULL;
   }
   // printf("%f\n", (double) off_nbytes / new_off_cbytes);
 
-  int64_t new_cbytes = cbytes + chunk_cbytes;
   int64_t new_frame_len;
   if (frame->sframe) {
     new_frame_len = header_len + 0 + new_off_cbytes + frame->trailer_len;
@@ -2637,14 +3380,20 @@ void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schu
   void* fp = NULL;
   if (frame->cframe != NULL) {
     uint8_t* framep = frame->cframe;
-    /* Make space for the new chunk and copy it */
+    /* Make space for the new chunks and copy them */
     frame->cframe = framep = realloc(framep, (size_t)new_frame_len);
     if (framep == NULL) {
       BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
+      free(off_chunk);
+      free(chunks_cbytes);
       return NULL;
     }
-    /* Copy the chunk */
-    memcpy(framep + header_len + cbytes, chunk, (size_t)chunk_cbytes);
+    /* Copy the chunks */
+    int64_t pos = header_len + cbytes;
+    for (int64_t i = 0; i < nchunks_new; ++i) {
+      memcpy(framep + pos, chunks[i], (size_t)chunks_cbytes[i]);
+      pos += chunks_cbytes[i];
+    }
     /* Copy the offsets */
     memcpy(framep + header_len + new_cbytes, off_chunk, (size_t)new_off_cbytes);
   }
@@ -2653,18 +3402,22 @@ void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schu
     blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
     if (io_cb == NULL) {
       BLOSC_TRACE_ERROR("Error getting the input/output API");
+      free(off_chunk);
+      free(chunks_cbytes);
       return NULL;
     }
 
     if (frame->sframe) {
-      // Update the offsets chunk in the chunks frame
-      if (chunk_cbytes != 0) {
-        if (sframe_chunk_id < 0) {
-          BLOSC_TRACE_ERROR("The chunk id (%" PRId64 ") is not correct", sframe_chunk_id);
-          return NULL;
+      // Write the full chunks as separate files (ids were assigned in order)
+      int64_t chunk_id = sframe_first_chunk_id;
+      for (int64_t i = 0; i < nchunks_new; ++i) {
+        if (chunks_cbytes[i] == 0) {
+          continue;
         }
-        if (sframe_create_chunk(frame, chunk, sframe_chunk_id, chunk_cbytes) == NULL) {
+        if (sframe_create_chunk(frame, chunks[i], chunk_id++, chunks_cbytes[i]) == NULL) {
           BLOSC_TRACE_ERROR("Cannot write the full chunk.");
+          free(off_chunk);
+          free(chunks_cbytes);
           return NULL;
         }
       }
@@ -2673,30 +3426,37 @@ void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schu
       io_cb->seek(fp, frame->file_offset + header_len, SEEK_SET);
     }
     else {
-      // Regular frame
+      // Regular frame: write all the new chunks in a row, just after the existing ones
       fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
       io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
-      wbytes = io_cb->write(chunk, 1, chunk_cbytes, fp);  // the new chunk
-      if (wbytes != chunk_cbytes) {
-        BLOSC_TRACE_ERROR("Cannot write the full chunk to frame.");
-        io_cb->close(fp);
-        return NULL;
+      for (int64_t i = 0; i < nchunks_new; ++i) {
+        if (chunks_cbytes[i] == 0) {
+          continue;
+        }
+        wbytes = io_cb->write(chunks[i], 1, chunks_cbytes[i], fp);  // the new chunk
+        if (wbytes != chunks_cbytes[i]) {
+          BLOSC_TRACE_ERROR("Cannot write the full chunk to frame.");
+          io_cb->close(fp);
+          free(off_chunk);
+          free(chunks_cbytes);
+          return NULL;
+        }
       }
     }
     wbytes = io_cb->write(off_chunk, 1, new_off_cbytes, fp);  // the new offsets
     io_cb->close(fp);
     if (wbytes != new_off_cbytes) {
       BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
+      free(off_chunk);
+      free(chunks_cbytes);
       return NULL;
     }
   }
   // Invalidate the cache for chunk offsets
-  if (frame->coffsets != NULL) {
-    free(frame->coffsets);
-    frame->coffsets = NULL;
-  }
-  free(chunk);  // chunk has always to be a copy when reaching here...
+  invalidate_offsets(frame);
+  commit_cache_coffsets(frame, off_chunk, new_off_cbytes);
   free(off_chunk);
+  free(chunks_cbytes);
 
   frame->len = new_frame_len;
   rc = frame_update_header(frame, schunk, false);
@@ -2709,11 +3469,18 @@ void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schu
     return NULL;
   }
 
+  if (frame_commit_end(frame, new_cbytes - cbytes) < 0) {
+    return NULL;
+  }
+
   return frame;
 }
 
 
 void* frame_insert_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blosc2_schunk* schunk) {
+  if (frame_commit_begin(frame) < 0) {
+    return NULL;
+  }
   uint8_t* chunk_ = chunk;
   int32_t header_len;
   int64_t frame_len;
@@ -2891,12 +3658,10 @@ void* frame_insert_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blo
       BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
       return NULL;
     }
-    // Invalidate the cache for chunk offsets
-    if (frame->coffsets != NULL) {
-      free(frame->coffsets);
-      frame->coffsets = NULL;
-    }
   }
+  // Invalidate the cache for chunk offsets
+  invalidate_offsets(frame);
+  commit_cache_coffsets(frame, off_chunk, new_off_cbytes);
   free(chunk);  // chunk has always to be a copy when reaching here...
   free(off_chunk);
 
@@ -2911,11 +3676,18 @@ void* frame_insert_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blo
     return NULL;
   }
 
+  if (frame_commit_end(frame, chunk_cbytes) < 0) {
+    return NULL;
+  }
+
   return frame;
 }
 
 
 void* frame_update_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blosc2_schunk* schunk) {
+  if (frame_commit_begin(frame) < 0) {
+    return NULL;
+  }
   uint8_t *chunk_ = (uint8_t *) chunk;
   int32_t header_len;
   int64_t frame_len;
@@ -3044,7 +3816,8 @@ void* frame_update_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blo
       }
   }
 
-  if (!frame->sframe && chunk_cbytes != 0 && cbytes_old >= chunk_cbytes) {
+  // In the durable mode, chunks are never overwritten in place (it cannot be rolled back)
+  if (!frame->sframe && chunk_cbytes != 0 && cbytes_old >= chunk_cbytes && !frame_is_durable(frame)) {
     offsets[nchunk] = old_offset;
     cbytes = old_offset;
   }
@@ -3130,12 +3903,10 @@ void* frame_update_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blo
       BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
       return NULL;
     }
-    // Invalidate the cache for chunk offsets
-    if (frame->coffsets != NULL) {
-      free(frame->coffsets);
-      frame->coffsets = NULL;
-    }
   }
+  // Invalidate the cache for chunk offsets
+  invalidate_offsets(frame);
+  commit_cache_coffsets(frame, off_chunk, new_off_cbytes);
   free(chunk);  // chunk has always to be a copy when reaching here...
   free(off_chunk);
 
@@ -3150,11 +3921,18 @@ void* frame_update_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blo
     return NULL;
   }
 
+  if (frame_commit_end(frame, chunk_cbytes) < 0) {
+    return NULL;
+  }
+
   return frame;
 }
 
 
 void* frame_delete_chunk(blosc2_frame_s* frame, int64_t nchunk, blosc2_schunk* schunk) {
+  if (frame_commit_begin(frame) < 0) {
+    return NULL;
+  }
   int32_t header_len;
   int64_t frame_len;
   int64_t nbytes;
@@ -3260,7 +4038,7 @@ void* frame_delete_chunk(blosc2_frame_s* frame, int64_t nchunk, blosc2_schunk* s
       }
       if (offset >= 0){
         // Remove the chunk file only if it is not a special value chunk
-        int err = sframe_delete_chunk(frame->urlpath, offset);
+        int err = sframe_delete_chunk(frame, offset);
         if (err != 0) {
           BLOSC_TRACE_ERROR("Unable to delete chunk!");
           return NULL;
@@ -3281,12 +4059,10 @@ void* frame_delete_chunk(blosc2_frame_s* frame, int64_t nchunk, blosc2_schunk* s
       BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
       return NULL;
     }
-    // Invalidate the cache for chunk offsets
-    if (frame->coffsets != NULL) {
-      free(frame->coffsets);
-      frame->coffsets = NULL;
-    }
   }
+  // Invalidate the cache for chunk offsets
+  invalidate_offsets(frame);
+  commit_cache_coffsets(frame, off_chunk, new_off_cbytes);
   free(off_chunk);
 
   frame->len = new_frame_len;
@@ -3300,11 +4076,19 @@ void* frame_delete_chunk(blosc2_frame_s* frame, int64_t nchunk, blosc2_schunk* s
     return NULL;
   }
 
+  if (frame_commit_end(frame, 0) < 0) {
+    return NULL;
+  }
+
   return frame;
 }
 
 
 int frame_reorder_offsets(blosc2_frame_s* frame, const int64_t* offsets_order, blosc2_schunk* schunk) {
+  int rc_commit = frame_commit_begin(frame);
+  if (rc_commit < 0) {
+    return rc_commit;
+  }
   // Get header info
   int32_t header_len;
   int64_t frame_len;
@@ -3423,10 +4207,8 @@ int frame_reorder_offsets(blosc2_frame_s* frame, const int64_t* offsets_order, b
   }
 
   // Invalidate the cache for chunk offsets
-  if (frame->coffsets != NULL) {
-    free(frame->coffsets);
-    frame->coffsets = NULL;
-  }
+  invalidate_offsets(frame);
+  commit_cache_coffsets(frame, off_chunk, new_off_cbytes);
   free(off_chunk);
 
   frame->len = new_frame_len;
@@ -3440,6 +4222,11 @@ int frame_reorder_offsets(blosc2_frame_s* frame, const int64_t* offsets_order, b
     return rc;
   }
 
+  rc_commit = frame_commit_end(frame, 0);
+  if (rc_commit < 0) {
+    return rc_commit;
+  }
+
   return 0;
 }
 
@@ -3489,3 +4276,62 @@ int frame_decompress_chunk(blosc2_context *dctx, blosc2_frame_s* frame, int64_t
   }
   return rc;
 }
+
+
+/* Create the header of a streamed frame for @p schunk.  The sizes that are not known
+ * until the stream ends (frame length, nbytes and cbytes) are set to -1. */
+uint8_t* frame_stream_header(blosc2_schunk* schunk, int32_t* header_len) {
+  blosc2_frame_s frame = {0};
+  frame.len = -1;
+  uint8_t* header = new_header_frame(schunk, &frame);
+  if (header == NULL) {
+    return NULL;
+  }
+  int64_t unknown = -1;
+  to_big(header + FRAME_NBYTES, &unknown, sizeof(unknown));
+  to_big(header + FRAME_CBYTES, &unknown, sizeof(unknown));
+  from_big(header_len, header + FRAME_HEADER_LEN, sizeof(*header_len));
+  return header;
+}
+
+
+/* Create the trailer of a streamed frame for @p schunk.  Values are packed, so that
+ * the trailer can be parsed front to back. */
+uint8_t* frame_stream_trailer(blosc2_schunk* schunk, int64_t* trailer_len) {
+  frame_vlmeta_slot* slots;
+  uint8_t* trailer = new_trailer_frame(NULL, schunk, false, trailer_len, &slots);
+  if (trailer == NULL) {
+    return NULL;
+  }
+  free(slots);
+  return trailer;
+}
+
+
+/* Create an empty in-memory super-chunk with the parameters and metalayers in the
+ * header of a streamed frame and the vlmetalayers in @p trailer */
+blosc2_schunk* frame_stream_to_schunk(const uint8_t* header, int32_t header_len,
+                                      const uint8_t* trailer, int64_t trailer_len) {
+  // This is the frame of a stream with no chunks
+  int64_t len = header_len + trailer_len;
+  uint8_t* cframe = malloc((size_t)len);
+  BLOSC_ERROR_NULL(cframe, NULL);
+  memcpy(cframe, header, header_len);
+  memcpy(cframe + header_len, trailer, (size_t)trailer_len);
+  int64_t zero = 0;
+  to_big(cframe + FRAME_LEN, &len, sizeof(len));
+  to_big(cframe + FRAME_NBYTES, &zero, sizeof(zero));
+  to_big(cframe + FRAME_CBYTES, &zero, sizeof(zero));
+
+  blosc2_schunk* schunk = NULL;
+  blosc2_frame_s* frame = frame_from_cframe(cframe, len, false);
+  if (frame != NULL) {
+    // The copy detaches the super-chunk from the temporary frame
+    schunk = frame_to_schunk(frame, true, &BLOSC2_IO_DEFAULTS);
+    if (schunk != NULL) {
+      frame_free(frame);
+    }
+  }
+  free(cframe);
+  return schunk;
+}
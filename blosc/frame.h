@@ -14,9 +14,16 @@
 #include <stdio.h>
 #include <stdint.h>
 
+#if defined(_WIN32) && !defined(__GNUC__)
+  #include "win32/pthread.h"
+#else
+  #include <pthread.h>
+#endif
+
 // Different types of frames
 #define FRAME_CONTIGUOUS_TYPE 0
 #define FRAME_DIRECTORY_TYPE 1
+#define FRAME_SEGMENTS_TYPE 2  // a directory whose chunks are packed into segment files
 
 
 // Constants for metadata placement in header
@@ -50,19 +57,68 @@
 #define FRAME_TRAILER_MINLEN (25)  // minimum length for the trailer (msgpack overhead)
 #define FRAME_TRAILER_LEN_OFFSET (22)  // offset to trailer length (counting from the end)
 #define FRAME_TRAILER_VLMETALAYERS (2)
+#define FRAME_VLMETA_SLACK (32)  // minimum room left after a vlmetalayer value for updating it in place
+
+#define FRAME_WAL_SUFFIX ".wal"  // for the write-ahead record of the durable mode
+
+#define FRAME_OFFSETS_CACHE_MAX (16 * 1024)  // the maximum number of chunk offsets kept decompressed
+
 
+typedef struct {
+  int32_t offset;           //!< The offset of the vlmetalayer value (bin32 marker) inside the trailer
+  int32_t capacity;         //!< The room for the value, which can be larger than its current length
+} frame_vlmeta_slot;
+
+typedef struct {
+  int32_t segment;          //!< The segment file where the chunk is; -1 if there is no chunk
+  int32_t cbytes;           //!< The compressed size of the chunk
+  int64_t offset;           //!< The offset of the chunk inside the segment file
+} sframe_segment_loc;
 
 typedef struct {
   char* urlpath;            //!< The name of the file or directory if it's an sframe; if NULL, this is in-memory
   uint8_t* cframe;          //!< The in-memory, contiguous frame buffer
   bool avoid_cframe_free;   //!< Whether the cframe can be freed (false) or not (true).
+  bool cframe_borrowed;     //!< Whether the cframe comes from the caller (not copied), so it is copied before the first write
+  bool readonly;            //!< Whether the frame is a view of a buffer that cannot be modified
   uint8_t* coffsets;        //!< Pointers to the (compressed, on-disk) chunk offsets
+  int64_t* offsets;         //!< A decompressed run of chunk offsets (resolved on demand)
+  int64_t offsets_start;    //!< The first chunk whose offset is in `offsets`
+  int32_t offsets_len;      //!< The number of valid entries in `offsets`
   int64_t len;              //!< The current length of the frame in (compressed) bytes
   int64_t maxlen;           //!< The maximum length of the frame; if 0, there is no maximum
   uint32_t trailer_len;     //!< The current length of the trailer in (compressed) bytes
+  frame_vlmeta_slot* vlmeta_slots;  //!< Where every vlmetalayer value lives inside the trailer
+  int16_t vlmeta_nslots;    //!< The number of entries in vlmeta_slots
   bool sframe;              //!< Whether the frame is sparse (true) or not
   blosc2_schunk *schunk;    //!< The schunk associated
   int64_t file_offset;      //!< The offset where the frame starts inside the file
+  int64_t segment_size;     //!< If > 0, the sframe chunks are packed into segment files of this size
+  sframe_segment_loc* segment_locs;  //!< The location of every chunk id inside the segment files
+  int64_t segment_nlocs;    //!< The number of entries in segment_locs
+  int32_t segment_last;     //!< The segment file where chunks are being appended
+  int64_t segment_len;      //!< The length of the last segment file
+  int64_t segment_index_len;  //!< The length of the segments index (a whole number of records)
+  void* segment_fp;         //!< The segment file kept open for reading chunks (NULL if none)
+  int32_t segment_fp_id;    //!< The segment of segment_fp
+  blosc2_io_cb* segment_fp_io_cb;  //!< The io backend that opened segment_fp
+  int32_t commit_interval;  //!< If > 0, the maximum milliseconds that a mutation waits for a commit (durable mode)
+  int64_t commit_size;      //!< If > 0, the chunk bytes that trigger a commit (durable mode)
+  bool commit_valid;        //!< Whether the write-ahead record matches the last commit (durable mode)
+  bool commit_dirty;        //!< Whether the frame has been mutated since the last commit
+  int64_t commit_nbytes;    //!< The chunk bytes written since the last commit
+  blosc_timestamp_t commit_dirty_time;  //!< When the first mutation after the last commit happened
+  int commit_error;         //!< The error of the last failed commit of the committer thread
+  uint8_t* commit_coffsets;  //!< The offsets chunk last written, for building the records without reading it
+  int64_t commit_coffsets_len;
+  uint8_t* commit_trailer;  //!< The trailer last written, likewise
+  int64_t commit_trailer_len;
+  bool commit_lock_init;    //!< Whether commit_mutex and commit_cond are initialized
+  pthread_mutex_t commit_mutex;  //!< Serializes the mutations and the commits
+  pthread_cond_t commit_cond;    //!< Wakes up the committer thread
+  pthread_t commit_thread;
+  bool commit_thread_started;
+  bool commit_stop;
 } blosc2_frame_s;
 
 
@@ -149,6 +205,7 @@ get_new_storage(const blosc2_storage *storage, const blosc2_cparams *cdefaults,
                 const blosc2_io *iodefaults);
 
 void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schunk);
+void* frame_append_chunks(blosc2_frame_s* frame, uint8_t** chunks, int64_t nchunks_new, blosc2_schunk* schunk);
 void* frame_insert_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blosc2_schunk* schunk);
 void* frame_update_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blosc2_schunk* schunk);
 void* frame_delete_chunk(blosc2_frame_s* frame, int64_t nchunk, blosc2_schunk* schunk);
@@ -161,8 +218,26 @@ int frame_decompress_chunk(blosc2_context* dctx, blosc2_frame_s* frame, int64_t
 
 int frame_update_header(blosc2_frame_s* frame, blosc2_schunk* schunk, bool new);
 int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk);
+int frame_update_vlmetalayer(blosc2_frame_s* frame, blosc2_schunk* schunk, int nvlmetalayer);
 
 int64_t frame_fill_special(blosc2_frame_s* frame, int64_t nitems, int special_value,
                        int32_t chunksize, blosc2_schunk* schunk);
 
+bool frame_is_durable(blosc2_frame_s* frame);
+int frame_check_writable(blosc2_frame_s* frame);
+int frame_set_durable(blosc2_frame_s* frame, int32_t commit_interval, int64_t commit_size);
+void frame_lock(blosc2_frame_s* frame);
+void frame_unlock(blosc2_frame_s* frame);
+int frame_commit(blosc2_frame_s* frame);
+int frame_commit_begin(blosc2_frame_s* frame);
+int frame_commit_end(blosc2_frame_s* frame, int64_t nbytes);
+int frame_commit_close(blosc2_frame_s* frame);
+void frame_commit_free(blosc2_frame_s* frame);
+void frame_remove_wal(const char* urlpath);
+
+uint8_t* frame_stream_header(blosc2_schunk* schunk, int32_t* header_len);
+uint8_t* frame_stream_trailer(blosc2_schunk* schunk, int64_t* trailer_len);
+blosc2_schunk* frame_stream_to_schunk(const uint8_t* header, int32_t header_len,
+                                      const uint8_t* trailer, int64_t trailer_len);
+
 #endif //BLOSC_FRAME_H
@@ -0,0 +1,436 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Read-ahead of chunks: when the chunks of a frame-backed super-chunk are
+ * accessed with a constant stride (1 for sequential accesses), a thread reads
+ * the next ones in the background, and optionally decompresses them, so that
+ * the consumer does not have to wait for the storage.
+ *
+ * The accesses through blosc2_schunk_decompress_chunk(), blosc2_schunk_get_chunk()
+ * and blosc2_schunk_get_lazychunk() feed the detector.  After PREFETCH_MIN_STREAK
+ * accesses with the same stride, the next `nslots` chunks in that direction are
+ * scheduled, and the ones that are not ahead anymore are dropped, so that the
+ * buffer never holds more than `nslots` chunks.  A chunk leaves the buffer when
+ * it is handed out.  The reads of the frame are serialized with io_mutex, as
+ * the offsets cache of a frame is not thread-safe, and the mutations of the
+ * super-chunk drop the whole buffer with prefetch_reset().
+ */
+
+#include "prefetch.h"
+#include "frame.h"
+#include "context.h"
+#include "blosc-private.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static void release_slot(prefetch_slot* slot) {
+  if (slot->needs_free) {
+    free(slot->data);
+  }
+  slot->data = NULL;
+  slot->needs_free = false;
+  slot->nchunk = -1;
+  slot->state = PREFETCH_FREE;
+}
+
+
+static prefetch_slot* find_slot(struct blosc2_prefetch* prefetch, int64_t nchunk) {
+  for (int32_t i = 0; i < prefetch->nslots; i++) {
+    prefetch_slot* slot = &prefetch->slots[i];
+    if (slot->state != PREFETCH_FREE && slot->nchunk == nchunk) {
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+
+/* Read a chunk out of the frame, and decompress it in decompress mode */
+static int fetch_chunk(struct blosc2_prefetch* prefetch, int64_t nchunk, uint8_t** data, bool* needs_free) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)prefetch->schunk->frame;
+  uint8_t* chunk;
+  bool chunk_needs_free;
+
+  *data = NULL;
+  *needs_free = false;
+  pthread_mutex_lock(&prefetch->io_mutex);
+  int cbytes = frame_get_chunk(frame, nchunk, &chunk, &chunk_needs_free);
+  pthread_mutex_unlock(&prefetch->io_mutex);
+  if (cbytes < 0) {
+    if (chunk_needs_free) {
+      free(chunk);
+    }
+    return cbytes;
+  }
+  if (!prefetch->decompress) {
+    *data = chunk;
+    *needs_free = chunk_needs_free;
+    return cbytes;
+  }
+
+  int32_t nbytes;
+  int rc = blosc2_cbuffer_sizes(chunk, &nbytes, NULL, NULL);
+  if (rc >= 0) {
+    *data = malloc(nbytes > 0 ? nbytes : 1);
+    if (*data == NULL) {
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    else {
+      *needs_free = true;
+      rc = blosc2_decompress_ctx(prefetch->dctx, chunk, cbytes, *data, nbytes);
+    }
+  }
+  if (chunk_needs_free) {
+    free(chunk);
+  }
+  if (rc < 0) {
+    free(*data);
+    *data = NULL;
+    *needs_free = false;
+  }
+  return rc;
+}
+
+
+/* Fetch the pending chunks, nearest first, until the prefetcher is freed */
+static void* prefetch_thread(void* arg) {
+  struct blosc2_prefetch* prefetch = (struct blosc2_prefetch*)arg;
+  pthread_mutex_lock(&prefetch->mutex);
+  while (!prefetch->stop) {
+    prefetch_slot* slot = NULL;
+    for (int32_t i = 0; i < prefetch->nslots; i++) {
+      prefetch_slot* slot_ = &prefetch->slots[i];
+      if (slot_->state == PREFETCH_PENDING && (slot == NULL || slot_->seq < slot->seq)) {
+        slot = slot_;
+      }
+    }
+    if (slot == NULL) {
+      pthread_cond_wait(&prefetch->cond, &prefetch->mutex);
+      continue;
+    }
+    slot->state = PREFETCH_FETCHING;
+    int64_t nchunk = slot->nchunk;
+    pthread_mutex_unlock(&prefetch->mutex);
+
+    uint8_t* data;
+    bool needs_free;
+    int rc = fetch_chunk(prefetch, nchunk, &data, &needs_free);
+
+    pthread_mutex_lock(&prefetch->mutex);
+    slot->data = data;
+    slot->needs_free = needs_free;
+    slot->rc = rc;
+    slot->state = PREFETCH_READY;
+    pthread_cond_broadcast(&prefetch->cond);
+  }
+  pthread_mutex_unlock(&prefetch->mutex);
+  return NULL;
+}
+
+
+/* Take a chunk out of the buffer, waiting for it if it is being fetched.
+ * Returns false if the chunk has to be read by the caller.  The mutex must be held. */
+static bool take_slot(struct blosc2_prefetch* prefetch, int64_t nchunk,
+                      uint8_t** data, bool* needs_free, int* rc) {
+  prefetch_slot* slot;
+  while ((slot = find_slot(prefetch, nchunk)) != NULL && slot->state == PREFETCH_FETCHING) {
+    pthread_cond_wait(&prefetch->cond, &prefetch->mutex);
+  }
+  if (slot == NULL || slot->state == PREFETCH_PENDING || slot->rc < 0) {
+    // Reading it right now is faster than waiting for the thread (and errors are reported again)
+    if (slot != NULL) {
+      release_slot(slot);
+    }
+    prefetch->nmisses++;
+    return false;
+  }
+  *data = slot->data;
+  *needs_free = slot->needs_free;
+  *rc = slot->rc;
+  slot->needs_free = false;
+  release_slot(slot);
+  prefetch->nhits++;
+  return true;
+}
+
+
+/* Update the access pattern with an access to `nchunk`, and schedule the chunks
+ * that come next.  The mutex must be held. */
+static void schedule(struct blosc2_prefetch* prefetch, int64_t nchunk) {
+  int64_t stride = nchunk - prefetch->last_nchunk;
+  if (stride == 0) {
+    // Accessing the same chunk again does not change the pattern
+    return;
+  }
+  if (prefetch->last_nchunk < 0) {
+    prefetch->streak = 0;
+  }
+  else if (stride == prefetch->stride) {
+    prefetch->streak++;
+  }
+  else {
+    prefetch->streak = 1;
+  }
+  prefetch->stride = stride;
+  prefetch->last_nchunk = nchunk;
+
+  int32_t nahead = prefetch->streak >= PREFETCH_MIN_STREAK ? prefetch->nslots : 0;
+  for (int32_t i = 0; i < prefetch->nslots; i++) {
+    prefetch_slot* slot = &prefetch->slots[i];
+    if (slot->state != PREFETCH_PENDING && slot->state != PREFETCH_READY) {
+      continue;
+    }
+    int64_t distance = slot->nchunk - nchunk;
+    if (distance % stride != 0 || distance / stride < 1 || distance / stride > nahead) {
+      release_slot(slot);
+    }
+  }
+
+  bool scheduled = false;
+  for (int32_t i = 1; i <= nahead; i++) {
+    int64_t nchunk_ = nchunk + i * stride;
+    if (nchunk_ < 0 || nchunk_ >= prefetch->schunk->nchunks) {
+      break;
+    }
+    if (find_slot(prefetch, nchunk_) != NULL) {
+      continue;
+    }
+    prefetch_slot* slot = NULL;
+    for (int32_t j = 0; j < prefetch->nslots && slot == NULL; j++) {
+      if (prefetch->slots[j].state == PREFETCH_FREE) {
+        slot = &prefetch->slots[j];
+      }
+    }
+    if (slot == NULL) {
+      break;
+    }
+    slot->state = PREFETCH_PENDING;
+    slot->nchunk = nchunk_;
+    slot->seq = prefetch->seq++;
+    scheduled = true;
+  }
+  if (scheduled) {
+    pthread_cond_broadcast(&prefetch->cond);
+  }
+}
+
+
+/* Decompress a whole chunk into `dest`, checking that it fits and that it is complete */
+static int decompress_chunk(blosc2_context* dctx, int64_t nchunk, uint8_t* chunk, int32_t cbytes,
+                            void* dest, int32_t nbytes) {
+  int32_t chunk_nbytes;
+  int rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, NULL, NULL);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot get the sizes of the chunk in position %" PRId64 ".", nchunk);
+    return rc;
+  }
+  if (chunk_nbytes > nbytes) {
+    BLOSC_TRACE_ERROR("Not enough space for decompressing in dest.");
+    return BLOSC2_ERROR_WRITE_BUFFER;
+  }
+  dctx->header_overhead = BLOSC_EXTENDED_HEADER_LENGTH;
+  rc = blosc2_decompress_ctx(dctx, chunk, cbytes, dest, nbytes);
+  if (rc < 0 || rc != chunk_nbytes) {
+    BLOSC_TRACE_ERROR("Error in decompressing chunk.");
+    if (rc >= 0) {
+      rc = BLOSC2_ERROR_FAILURE;
+    }
+  }
+  return rc;
+}
+
+
+int prefetch_decompress_chunk(blosc2_schunk* schunk, int64_t nchunk, void* dest, int32_t nbytes) {
+  struct blosc2_prefetch* prefetch = schunk_private(schunk)->prefetch;
+  uint8_t* data;
+  bool needs_free;
+  int rc;
+
+  pthread_mutex_lock(&prefetch->mutex);
+  bool hit = take_slot(prefetch, nchunk, &data, &needs_free, &rc);
+  schedule(prefetch, nchunk);
+  pthread_mutex_unlock(&prefetch->mutex);
+
+  if (!hit) {
+    // Only the read is serialized with the prefetching thread, not the decompression
+    pthread_mutex_lock(&prefetch->io_mutex);
+    rc = frame_get_chunk((blosc2_frame_s*)schunk->frame, nchunk, &data, &needs_free);
+    pthread_mutex_unlock(&prefetch->io_mutex);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot get the chunk in position %" PRId64 ".", nchunk);
+    }
+    else {
+      rc = decompress_chunk(schunk->dctx, nchunk, data, rc, dest, nbytes);
+    }
+  }
+  else if (!prefetch->decompress) {
+    rc = decompress_chunk(schunk->dctx, nchunk, data, rc, dest, nbytes);
+  }
+  else if (nbytes < rc) {
+    BLOSC_TRACE_ERROR("Buffer size is too small for the decompressed buffer "
+                      "('%d' bytes, but '%d' are needed).", nbytes, rc);
+    rc = BLOSC2_ERROR_INVALID_PARAM;
+  }
+  else {
+    memcpy(dest, data, rc);
+  }
+  if (needs_free) {
+    free(data);
+  }
+  return rc;
+}
+
+
+int prefetch_get_chunk(blosc2_schunk* schunk, int64_t nchunk, uint8_t** chunk, bool* needs_free, bool lazy) {
+  struct blosc2_prefetch* prefetch = schunk_private(schunk)->prefetch;
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  int rc;
+
+  pthread_mutex_lock(&prefetch->mutex);
+  bool hit = false;
+  if (!prefetch->decompress) {
+    hit = take_slot(prefetch, nchunk, chunk, needs_free, &rc);
+  }
+  else {
+    // There are no compressed chunks to hand out, but the access still drives the read-ahead
+    prefetch->nmisses++;
+  }
+  schedule(prefetch, nchunk);
+  pthread_mutex_unlock(&prefetch->mutex);
+  if (hit) {
+    // A whole chunk can be used wherever a lazy one can
+    return rc;
+  }
+
+  pthread_mutex_lock(&prefetch->io_mutex);
+  if (lazy) {
+    rc = frame_get_lazychunk(frame, nchunk, chunk, needs_free);
+  }
+  else {
+    rc = frame_get_chunk(frame, nchunk, chunk, needs_free);
+  }
+  pthread_mutex_unlock(&prefetch->io_mutex);
+  return rc;
+}
+
+
+void prefetch_reset(blosc2_schunk* schunk) {
+  struct blosc2_prefetch* prefetch = schunk_private(schunk)->prefetch;
+  if (prefetch == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&prefetch->mutex);
+  for (int32_t i = 0; i < prefetch->nslots; i++) {
+    prefetch_slot* slot = &prefetch->slots[i];
+    while (slot->state == PREFETCH_FETCHING) {
+      pthread_cond_wait(&prefetch->cond, &prefetch->mutex);
+    }
+    release_slot(slot);
+  }
+  prefetch->last_nchunk = -1;
+  prefetch->stride = 0;
+  prefetch->streak = 0;
+  pthread_mutex_unlock(&prefetch->mutex);
+}
+
+
+void prefetch_free(blosc2_schunk* schunk) {
+  struct blosc2_prefetch* prefetch = schunk_private(schunk)->prefetch;
+  if (prefetch == NULL) {
+    return;
+  }
+  if (prefetch->thread_started) {
+    pthread_mutex_lock(&prefetch->mutex);
+    prefetch->stop = true;
+    pthread_cond_broadcast(&prefetch->cond);
+    pthread_mutex_unlock(&prefetch->mutex);
+    pthread_join(prefetch->thread, NULL);
+    pthread_cond_destroy(&prefetch->cond);
+    pthread_mutex_destroy(&prefetch->io_mutex);
+    pthread_mutex_destroy(&prefetch->mutex);
+  }
+  if (prefetch->slots != NULL) {
+    for (int32_t i = 0; i < prefetch->nslots; i++) {
+      release_slot(&prefetch->slots[i]);
+    }
+    free(prefetch->slots);
+  }
+  if (prefetch->dctx != NULL) {
+    blosc2_free_ctx(prefetch->dctx);
+  }
+  free(prefetch);
+  schunk_private(schunk)->prefetch = NULL;
+}
+
+
+int blosc2_schunk_set_prefetch(blosc2_schunk *schunk, int32_t nchunks, bool decompress) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  prefetch_free(schunk);
+  if (nchunks == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (nchunks < 0) {
+    BLOSC_TRACE_ERROR("The number of chunks to read ahead cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (schunk->frame == NULL) {
+    BLOSC_TRACE_ERROR("Prefetching needs a super-chunk backed by a frame.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  struct blosc2_prefetch* prefetch = calloc(1, sizeof(struct blosc2_prefetch));
+  BLOSC_ERROR_NULL(prefetch, BLOSC2_ERROR_MEMORY_ALLOC);
+  schunk_private(schunk)->prefetch = prefetch;
+  prefetch->schunk = schunk;
+  prefetch->decompress = decompress;
+  prefetch->nslots = nchunks;
+  prefetch->last_nchunk = -1;
+  prefetch->slots = malloc(nchunks * sizeof(prefetch_slot));
+  if (prefetch->slots == NULL) {
+    prefetch_free(schunk);
+    BLOSC_ERROR(BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+  for (int32_t i = 0; i < nchunks; i++) {
+    prefetch->slots[i].needs_free = false;
+    release_slot(&prefetch->slots[i]);
+  }
+
+  if (decompress) {
+    blosc2_dparams *dparams;
+    if (blosc2_schunk_get_dparams(schunk, &dparams) < 0) {
+      prefetch_free(schunk);
+      BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+    }
+    prefetch->dctx = blosc2_create_dctx(*dparams);
+    free(dparams);
+    if (prefetch->dctx == NULL) {
+      prefetch_free(schunk);
+      BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+    }
+  }
+
+  pthread_mutex_init(&prefetch->mutex, NULL);
+  pthread_mutex_init(&prefetch->io_mutex, NULL);
+  pthread_cond_init(&prefetch->cond, NULL);
+  if (pthread_create(&prefetch->thread, NULL, prefetch_thread, prefetch) != 0) {
+    pthread_cond_destroy(&prefetch->cond);
+    pthread_mutex_destroy(&prefetch->io_mutex);
+    pthread_mutex_destroy(&prefetch->mutex);
+    prefetch_free(schunk);
+    BLOSC_TRACE_ERROR("Cannot create the prefetching thread");
+    BLOSC_ERROR(BLOSC2_ERROR_THREAD_CREATE);
+  }
+  prefetch->thread_started = true;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
@@ -0,0 +1,69 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#ifndef BLOSC_PREFETCH_H
+#define BLOSC_PREFETCH_H
+
+#include "blosc2.h"
+
+#if defined(_WIN32) && !defined(__GNUC__)
+  #include "win32/pthread.h"
+#else
+  #include <pthread.h>
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The number of accesses with the same stride that trigger the read-ahead */
+#define PREFETCH_MIN_STREAK (2)
+
+enum {
+  PREFETCH_FREE,      // the slot holds nothing
+  PREFETCH_PENDING,   // the chunk is waiting for the prefetching thread
+  PREFETCH_FETCHING,  // the chunk is being read by the prefetching thread
+  PREFETCH_READY,     // the chunk can be handed out
+};
+
+typedef struct {
+  uint8_t state;  // PREFETCH_*
+  int64_t nchunk;
+  int64_t seq;  // the order in which the pending chunks are fetched
+  uint8_t* data;  // the compressed chunk, or the decompressed one in decompress mode
+  bool needs_free;
+  int rc;  // the size of data, or a negative value if the fetch failed
+} prefetch_slot;
+
+struct blosc2_prefetch {
+  blosc2_schunk* schunk;
+  bool decompress;
+  blosc2_context* dctx;  // owned by the prefetching thread
+  int32_t nslots;
+  prefetch_slot* slots;
+  int64_t seq;
+  int64_t last_nchunk;  // the last chunk accessed (-1 if none)
+  int64_t stride;
+  int32_t streak;  // the number of consecutive accesses with the same stride
+  int64_t nhits;
+  int64_t nmisses;
+  pthread_t thread;
+  pthread_mutex_t mutex;  // protects everything above
+  pthread_cond_t cond;
+  pthread_mutex_t io_mutex;  // serializes the reads of the frame
+  bool thread_started;
+  bool stop;
+};
+
+void prefetch_free(blosc2_schunk* schunk);
+void prefetch_reset(blosc2_schunk* schunk);
+int prefetch_decompress_chunk(blosc2_schunk* schunk, int64_t nchunk, void* dest, int32_t nbytes);
+int prefetch_get_chunk(blosc2_schunk* schunk, int64_t nchunk, uint8_t** chunk, bool* needs_free, bool lazy);
+
+#endif //BLOSC_PREFETCH_H
@@ -15,7 +15,10 @@
 #include <sys/stat.h>
 #include "blosc2.h"
 #include "frame.h"
+#include "sframe.h"
 #include "stune.h"
+#include "zonemap.h"
+#include "prefetch.h"
 #include <inttypes.h>
 #include "blosc-private.h"
 
@@ -120,7 +123,7 @@ static bool file_exists (char *filename) {
 
 /* Create a new super-chunk */
 blosc2_schunk* blosc2_schunk_new(blosc2_storage *storage) {
-  blosc2_schunk* schunk = calloc(1, sizeof(blosc2_schunk));
+  blosc2_schunk* schunk = calloc(1, sizeof(blosc2_schunk_private));
   schunk->version = 0;     /* pre-first version */
 
   // Get the storage with proper defaults
@@ -174,6 +177,8 @@ blosc2_schunk* blosc2_schunk_new(blosc2_storage *storage) {
         BLOSC_TRACE_ERROR("You are trying to overwrite an existing frame.  Remove it first!");
         return NULL;
       }
+      // A record left by a removed frame must not roll back this one
+      frame_remove_wal(storage->urlpath);
     }
     blosc2_frame_s* frame = frame_new(storage->urlpath);
     frame->sframe = false;
@@ -191,6 +196,255 @@ blosc2_schunk* blosc2_schunk_new(blosc2_storage *storage) {
 }
 
 
+/* Create the special chunk (zeros, NaNs, uninitialized or a repeated value) that is
+ * equivalent to `chunk` with the new `cparams`, so that copies do not turn special chunks
+ * into dense data.  Returns the size of the new chunk, 0 if `chunk` is not special (or it
+ * cannot stay special with the new cparams), or a negative value if there is an error. */
+static int copy_special_chunk(const uint8_t *chunk, blosc2_cparams *cparams, uint8_t **dest) {
+  *dest = NULL;
+  bool extended = (chunk[BLOSC2_CHUNK_FLAGS] & BLOSC_DOSHUFFLE) && (chunk[BLOSC2_CHUNK_FLAGS] & BLOSC_DOBITSHUFFLE);
+  int special_type = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  if (!extended || special_type == 0) {
+    return 0;
+  }
+  int32_t nbytes;
+  int rc = blosc2_cbuffer_sizes(chunk, &nbytes, NULL, NULL);
+  if (rc < 0) {
+    return rc;
+  }
+  int32_t typesize = chunk[BLOSC2_CHUNK_TYPESIZE];
+  bool same_typesize = typesize == cparams->typesize;
+  if (nbytes % cparams->typesize != 0 ||
+      (special_type == BLOSC2_SPECIAL_NAN && !(same_typesize && (typesize == 4 || typesize == 8))) ||
+      (special_type == BLOSC2_SPECIAL_VALUE && !same_typesize)) {
+    return 0;
+  }
+
+  int32_t destsize = BLOSC_EXTENDED_HEADER_LENGTH + cparams->typesize;
+  *dest = malloc(destsize);
+  BLOSC_ERROR_NULL(*dest, BLOSC2_ERROR_MEMORY_ALLOC);
+  switch (special_type) {
+    case BLOSC2_SPECIAL_ZERO:
+      rc = blosc2_chunk_zeros(*cparams, nbytes, *dest, destsize);
+      break;
+    case BLOSC2_SPECIAL_NAN:
+      rc = blosc2_chunk_nans(*cparams, nbytes, *dest, destsize);
+      break;
+    case BLOSC2_SPECIAL_UNINIT:
+      rc = blosc2_chunk_uninit(*cparams, nbytes, *dest, destsize);
+      break;
+    case BLOSC2_SPECIAL_VALUE:
+      rc = blosc2_chunk_repeatval(*cparams, nbytes, *dest, destsize, chunk + BLOSC_EXTENDED_HEADER_LENGTH);
+      break;
+    default:
+      rc = 0;
+  }
+  if (rc <= 0) {
+    free(*dest);
+    *dest = NULL;
+  }
+  return rc;
+}
+
+
+/* Arguments for each thread that re-encodes chunks during a copy */
+typedef struct {
+  blosc2_cparams *cparams;
+  blosc2_context *cctx;
+  blosc2_context *dctx;
+  uint8_t *buffer;
+  int32_t buffer_size;
+  int tid;
+  int nthreads;
+  int nchunks;
+  uint8_t **src_chunks;
+  int32_t *src_cbytes;
+  uint8_t **dest_chunks;
+  int rc;
+} transcode_thread_s;
+
+
+static void *transcode_worker(void *arg) {
+  transcode_thread_s *th = (transcode_thread_s *) arg;
+  for (int i = th->tid; i < th->nchunks; i += th->nthreads) {
+    int rc = copy_special_chunk(th->src_chunks[i], th->cparams, &th->dest_chunks[i]);
+    if (rc != 0) {
+      if (rc < 0) {
+        th->rc = rc;
+        return NULL;
+      }
+      continue;
+    }
+    // Chunks can be smaller than the chunksize (or it may be unknown)
+    int32_t chunk_nbytes;
+    rc = blosc2_cbuffer_sizes(th->src_chunks[i], &chunk_nbytes, NULL, NULL);
+    if (rc < 0) {
+      th->rc = rc;
+      return NULL;
+    }
+    if (chunk_nbytes > th->buffer_size || th->buffer == NULL) {
+      uint8_t *buffer = realloc(th->buffer, chunk_nbytes > 0 ? chunk_nbytes : 1);
+      if (buffer == NULL) {
+        th->rc = BLOSC2_ERROR_MEMORY_ALLOC;
+        return NULL;
+      }
+      th->buffer = buffer;
+      th->buffer_size = chunk_nbytes;
+    }
+    int nbytes = blosc2_decompress_ctx(th->dctx, th->src_chunks[i], th->src_cbytes[i],
+                                       th->buffer, chunk_nbytes);
+    if (nbytes < 0) {
+      BLOSC_TRACE_ERROR("Can not decompress a `chunk` while copying.");
+      th->rc = nbytes;
+      return NULL;
+    }
+    uint8_t *chunk = malloc((size_t) nbytes + BLOSC2_MAX_OVERHEAD);
+    if (chunk == NULL) {
+      th->rc = BLOSC2_ERROR_MEMORY_ALLOC;
+      return NULL;
+    }
+    int cbytes = blosc2_compress_ctx(th->cctx, th->buffer, nbytes, chunk,
+                                     nbytes + BLOSC2_MAX_OVERHEAD);
+    if (cbytes < 0) {
+      free(chunk);
+      th->rc = cbytes;
+      return NULL;
+    }
+    th->dest_chunks[i] = chunk;
+  }
+  return NULL;
+}
+
+
+/* Re-encode the chunks of `schunk` into `new_schunk`, several at a time.
+ * Chunks are read in batches by the calling thread, decompressed and
+ * compressed again by a pool of single-threaded contexts, and then
+ * appended in order. */
+static int transcode_chunks(blosc2_schunk *schunk, blosc2_schunk *new_schunk,
+                            blosc2_cparams *cparams) {
+  int nthreads = new_schunk->cctx->nthreads;
+  int batch = 4 * nthreads;
+  int rc = BLOSC2_ERROR_SUCCESS;
+
+  transcode_thread_s *ths = calloc(nthreads, sizeof(transcode_thread_s));
+  pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+  uint8_t **src_chunks = calloc(batch, sizeof(uint8_t *));
+  int32_t *src_cbytes = calloc(batch, sizeof(int32_t));
+  bool *src_needs_free = calloc(batch, sizeof(bool));
+  uint8_t **dest_chunks = calloc(batch, sizeof(uint8_t *));
+  if (ths == NULL || threads == NULL || src_chunks == NULL || src_cbytes == NULL ||
+      src_needs_free == NULL || dest_chunks == NULL) {
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto out;
+  }
+
+  blosc2_cparams th_cparams = *cparams;
+  th_cparams.nthreads = 1;
+  th_cparams.schunk = new_schunk;
+  blosc2_dparams th_dparams = BLOSC2_DPARAMS_DEFAULTS;
+  th_dparams.schunk = schunk;
+  for (int tid = 0; tid < nthreads; ++tid) {
+    ths[tid].cparams = &th_cparams;
+    ths[tid].cctx = blosc2_create_cctx(th_cparams);
+    ths[tid].dctx = blosc2_create_dctx(th_dparams);
+    ths[tid].tid = tid;
+    ths[tid].nthreads = nthreads;
+    ths[tid].src_chunks = src_chunks;
+    ths[tid].src_cbytes = src_cbytes;
+    ths[tid].dest_chunks = dest_chunks;
+    if (ths[tid].cctx == NULL || ths[tid].dctx == NULL) {
+      rc = BLOSC2_ERROR_FAILURE;
+      goto out;
+    }
+  }
+
+  for (int64_t base = 0; base < schunk->nchunks; base += batch) {
+    int nchunks = (int) (schunk->nchunks - base < batch ? schunk->nchunks - base : batch);
+    for (int i = 0; i < nchunks; ++i) {
+      src_cbytes[i] = blosc2_schunk_get_chunk(schunk, base + i, &src_chunks[i], &src_needs_free[i]);
+      if (src_cbytes[i] < 0) {
+        BLOSC_TRACE_ERROR("Can not get the `chunk` %" PRId64 ".", base + i);
+        rc = src_cbytes[i];
+        goto out;
+      }
+    }
+
+    // The calling thread acts as the first worker
+    int nstarted = 1;
+    for (int tid = 0; tid < nthreads; ++tid) {
+      ths[tid].nchunks = nchunks;
+      ths[tid].rc = BLOSC2_ERROR_SUCCESS;
+    }
+    for (int tid = 1; tid < nthreads && tid < nchunks; ++tid) {
+      if (pthread_create(&threads[tid], NULL, transcode_worker, &ths[tid]) != 0) {
+        BLOSC_TRACE_ERROR("Can not create a thread for copying chunks.");
+        rc = BLOSC2_ERROR_THREAD_CREATE;
+        break;
+      }
+      nstarted++;
+    }
+    if (rc == BLOSC2_ERROR_SUCCESS) {
+      transcode_worker(&ths[0]);
+    }
+    for (int tid = 1; tid < nstarted; ++tid) {
+      pthread_join(threads[tid], NULL);
+    }
+
+    for (int i = 0; i < nchunks; ++i) {
+      if (src_needs_free[i]) {
+        free(src_chunks[i]);
+      }
+      src_chunks[i] = NULL;
+    }
+    for (int tid = 0; tid < nthreads && rc == BLOSC2_ERROR_SUCCESS; ++tid) {
+      rc = ths[tid].rc;
+    }
+    for (int i = 0; i < nchunks; ++i) {
+      if (rc == BLOSC2_ERROR_SUCCESS && dest_chunks[i] != NULL) {
+        if (blosc2_schunk_append_chunk(new_schunk, dest_chunks[i], false) < 0) {
+          BLOSC_TRACE_ERROR("Can not append the `chunk` into super-chunk.");
+          rc = BLOSC2_ERROR_CHUNK_APPEND;
+        }
+      } else {
+        free(dest_chunks[i]);
+      }
+      dest_chunks[i] = NULL;
+    }
+    if (rc < 0) {
+      goto out;
+    }
+  }
+
+  out:
+  if (ths != NULL) {
+    for (int tid = 0; tid < nthreads; ++tid) {
+      if (ths[tid].cctx != NULL) {
+        blosc2_free_ctx(ths[tid].cctx);
+      }
+      if (ths[tid].dctx != NULL) {
+        blosc2_free_ctx(ths[tid].dctx);
+      }
+      free(ths[tid].buffer);
+    }
+  }
+  if (src_chunks != NULL && src_needs_free != NULL) {
+    for (int i = 0; i < batch; ++i) {
+      if (src_needs_free[i]) {
+        free(src_chunks[i]);
+      }
+    }
+  }
+  free(ths);
+  free(threads);
+  free(src_chunks);
+  free(src_cbytes);
+  free(src_needs_free);
+  free(dest_chunks);
+
+  return rc;
+}
+
+
 /* Create a copy of a super-chunk */
 blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_storage *storage) {
   if (schunk == NULL) {
@@ -271,16 +525,66 @@ blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_storage *storage
         return NULL;
       }
     }
+  } else if (new_schunk->cctx->nthreads > 1 && schunk->nchunks > 1 &&
+             schunk->dctx->postfilter == NULL && cparams.prefilter == NULL) {
+    if (transcode_chunks(schunk, new_schunk, &cparams) < 0) {
+      BLOSC_TRACE_ERROR("Can not transcode the chunks into super-chunk.");
+      return NULL;
+    }
   } else {
-    int32_t chunksize = schunk->chunksize == -1 ? 0 : schunk->chunksize;
-    uint8_t *buffer = malloc(chunksize);
+    // Filters must run for every item, so special chunks are kept only without them
+    bool keep_special = schunk->dctx->postfilter == NULL && cparams.prefilter == NULL;
+    uint8_t *buffer = NULL;
+    int32_t buffer_size = 0;
     for (int nchunk = 0; nchunk < schunk->nchunks; ++nchunk) {
-      if (blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, schunk->chunksize) < 0) {
+      uint8_t *chunk;
+      bool needs_free;
+      if (blosc2_schunk_get_chunk(schunk, nchunk, &chunk, &needs_free) < 0) {
+        BLOSC_TRACE_ERROR("Can not get the `chunk` %d.", nchunk);
+        free(buffer);
+        return NULL;
+      }
+      int32_t chunk_nbytes;
+      int rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, NULL, NULL);
+      uint8_t *special = NULL;
+      if (rc >= 0 && keep_special) {
+        rc = copy_special_chunk(chunk, &cparams, &special);
+      }
+      if (needs_free) {
+        free(chunk);
+      }
+      if (rc < 0) {
+        BLOSC_TRACE_ERROR("Can not copy the `chunk` %d.", nchunk);
+        free(buffer);
+        return NULL;
+      }
+      if (special != NULL) {
+        if (blosc2_schunk_append_chunk(new_schunk, special, false) < 0) {
+          BLOSC_TRACE_ERROR("Can not append the `chunk` into super-chunk.");
+          free(buffer);
+          return NULL;
+        }
+        continue;
+      }
+      // Chunks can be smaller than the chunksize (or it may be unknown)
+      if (chunk_nbytes > buffer_size || buffer == NULL) {
+        uint8_t *buffer_ = realloc(buffer, chunk_nbytes > 0 ? chunk_nbytes : 1);
+        if (buffer_ == NULL) {
+          free(buffer);
+          return NULL;
+        }
+        buffer = buffer_;
+        buffer_size = chunk_nbytes;
+      }
+      int nbytes = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, chunk_nbytes);
+      if (nbytes < 0) {
         BLOSC_TRACE_ERROR("Can not decompress the `chunk` %d.", nchunk);
+        free(buffer);
         return NULL;
       }
-      if (blosc2_schunk_append_buffer(new_schunk, buffer, schunk->chunksize) < 0) {
+      if (blosc2_schunk_append_buffer(new_schunk, buffer, nbytes) < 0) {
         BLOSC_TRACE_ERROR("Can not append the `buffer` into super-chunk.");
+        free(buffer);
         return NULL;
       }
     }
@@ -292,6 +596,10 @@ blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_storage *storage
     uint8_t *content;
     int32_t content_len;
     char* name = schunk->vlmetalayers[nmeta]->name;
+    if (strcmp(name, ZONEMAP_VLMETA_NAME) == 0) {
+      // The zone map is copied below (the stored one may be outdated)
+      continue;
+    }
     if (blosc2_vlmeta_get(schunk, name, &content, &content_len) < 0) {
       BLOSC_TRACE_ERROR("Can not get %s `vlmetalayer`.", name);
     }
@@ -301,6 +609,12 @@ blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_storage *storage
     }
     free(content);
   }
+
+  // Copy the zone map, so that frame copies are ready for being serialized
+  if (zonemap_copy(schunk, new_schunk) < 0 || zonemap_flush(new_schunk) < 0) {
+    BLOSC_TRACE_ERROR("Can not copy the zone map.");
+    return NULL;
+  }
   return new_schunk;
 }
 
@@ -361,6 +675,10 @@ int64_t blosc2_schunk_to_buffer(blosc2_schunk* schunk, uint8_t** dest, bool* nee
   *needs_free = false;
 
   if ((schunk->storage->contiguous == true) && (schunk->storage->urlpath == NULL)) {
+    int rc = zonemap_flush(schunk);
+    if (rc < 0) {
+      return rc;
+    }
     frame =  (blosc2_frame_s*)(schunk->frame);
     *dest = frame->cframe;
     cframe_len = frame->len;
@@ -433,6 +751,7 @@ int64_t blosc2_schunk_to_file(blosc2_schunk* schunk, const char* urlpath) {
 
   // Accelerated path for in-memory frames
   if (schunk->storage->contiguous && schunk->storage->urlpath == NULL) {
+    BLOSC_ERROR(zonemap_flush(schunk));
     int64_t len = frame_to_file((blosc2_frame_s*)(schunk->frame), urlpath);
     if (len <= 0) {
       BLOSC_TRACE_ERROR("Error writing to file");
@@ -464,6 +783,7 @@ int64_t blosc2_schunk_append_file(blosc2_schunk* schunk, const char* urlpath) {
 
     // Accelerated path for in-memory frames
     if (schunk->storage->contiguous && schunk->storage->urlpath == NULL) {
+        BLOSC_ERROR(zonemap_flush(schunk));
         int64_t offset = append_frame_to_file((blosc2_frame_s*)(schunk->frame), urlpath);
         if (offset <= 0) {
             BLOSC_TRACE_ERROR("Error writing to file");
@@ -488,6 +808,18 @@ int64_t blosc2_schunk_append_file(blosc2_schunk* schunk, const char* urlpath) {
 
 /* Free all memory from a super-chunk. */
 int blosc2_schunk_free(blosc2_schunk *schunk) {
+  int rc = BLOSC2_ERROR_SUCCESS;
+  prefetch_free(schunk);
+  if (schunk->frame != NULL) {
+    rc = zonemap_flush(schunk);
+    // Commit the pending mutations (durable mode only)
+    int rc_commit = frame_commit_close((blosc2_frame_s *) schunk->frame);
+    if (rc == BLOSC2_ERROR_SUCCESS) {
+      rc = rc_commit;
+    }
+  }
+  zonemap_free(schunk);
+
   if (schunk->data != NULL) {
     for (int i = 0; i < schunk->nchunks; i++) {
       free(schunk->data[i]);
@@ -545,21 +877,30 @@ int blosc2_schunk_free(blosc2_schunk *schunk) {
   }
   free(schunk);
 
-  return 0;
+  return rc;
+}
+
+
+/* Get a frame over a contiguous frame buffer (which is not copied) */
+static blosc2_frame_s* frame_from_buffer(const uint8_t *cframe, int64_t len) {
+  // Check that the buffer actually comes from a cframe
+  if (len < FRAME_HEADER_MINLEN || strcmp((char *)cframe + FRAME_HEADER_MAGIC, "b2frame\0") != 0) {
+    BLOSC_TRACE_ERROR("The buffer does not contain a contiguous frame.");
+    return NULL;
+  }
+  return frame_from_cframe((uint8_t *)cframe, len, false);
 }
 
 
 /* Create a super-chunk out of a contiguous frame buffer */
 blosc2_schunk* blosc2_schunk_from_buffer(uint8_t *cframe, int64_t len, bool copy) {
-  blosc2_frame_s* frame = frame_from_cframe(cframe, len, false);
+  blosc2_frame_s* frame = frame_from_buffer(cframe, len);
   if (frame == NULL) {
     return NULL;
   }
-  // Check that the buffer actually comes from a cframe
-  char *magic_number = (char *)cframe;
-  magic_number += FRAME_HEADER_MAGIC;
-  if (strcmp(magic_number, "b2frame\0") != 0) {
-    return NULL;
+  if (!copy) {
+    // Chunks and their offsets stay in the buffer, which is copied on the first write
+    frame->cframe_borrowed = true;
   }
   blosc2_schunk* schunk = frame_to_schunk(frame, copy, &BLOSC2_IO_DEFAULTS);
   if (schunk && copy) {
@@ -570,6 +911,18 @@ blosc2_schunk* blosc2_schunk_from_buffer(uint8_t *cframe, int64_t len, bool copy
 }
 
 
+/* Open a read-only super-chunk that is a view of a contiguous frame buffer */
+blosc2_schunk* blosc2_schunk_open_view(const uint8_t *cframe, int64_t len) {
+  // The buffer is never written (nor freed) through the frame
+  blosc2_frame_s* frame = frame_from_buffer(cframe, len);
+  if (frame == NULL) {
+    return NULL;
+  }
+  frame->readonly = true;
+  return frame_to_schunk(frame, false, &BLOSC2_IO_DEFAULTS);
+}
+
+
 /* Create a super-chunk out of a contiguous frame buffer */
 void blosc2_schunk_avoid_cframe_free(blosc2_schunk *schunk, bool avoid_cframe_free) {
   blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
@@ -577,9 +930,34 @@ void blosc2_schunk_avoid_cframe_free(blosc2_schunk *schunk, bool avoid_cframe_fr
 }
 
 
+/* Check that the super-chunk can be modified, and drop the chunks read ahead */
+static int check_writable(blosc2_schunk *schunk) {
+  BLOSC_ERROR(frame_check_writable((blosc2_frame_s*)schunk->frame));
+  prefetch_reset(schunk);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Make the contexts of the super-chunk create the states of their plugins again,
+ * as these are usually derived from the metalayers (e.g. the b2nd one) */
+static void metalayers_changed(blosc2_schunk *schunk) {
+  invalidate_plugin_states(schunk->cctx);
+  invalidate_plugin_states(schunk->dctx);
+  struct blosc2_prefetch* prefetch = schunk_private(schunk)->prefetch;
+  if (prefetch != NULL) {
+    // The prefetching thread is idle since the check_writable() of the caller
+    invalidate_plugin_states(prefetch->dctx);
+  }
+}
+
+
+static int64_t append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool copy, zonemap_entry *entry);
+
+
 /* Fill an empty frame with special values (fast path). */
-int64_t blosc2_schunk_fill_special(blosc2_schunk* schunk, int64_t nitems, int special_value,
-                               int32_t chunksize) {
+static int64_t fill_special(blosc2_schunk* schunk, int64_t nitems, int special_value,
+                            int32_t chunksize) {
+  BLOSC_ERROR(check_writable(schunk));
   if (nitems == 0) {
     return 0;
   }
@@ -633,7 +1011,7 @@ int64_t blosc2_schunk_fill_special(blosc2_schunk* schunk, int64_t nitems, int sp
     }
 
     for (int nchunk = 0; nchunk < nchunks; nchunk++) {
-      int64_t nchunk_ = blosc2_schunk_append_chunk(schunk, chunk, true);
+      int64_t nchunk_ = append_chunk(schunk, chunk, true, NULL);
       if (nchunk_ != nchunk + 1) {
         BLOSC_TRACE_ERROR("Error appending special chunks.");
         return BLOSC2_ERROR_SCHUNK_SPECIAL;
@@ -641,7 +1019,7 @@ int64_t blosc2_schunk_fill_special(blosc2_schunk* schunk, int64_t nitems, int sp
     }
 
     if (leftover_items) {
-      int64_t nchunk_ = blosc2_schunk_append_chunk(schunk, chunk2, true);
+      int64_t nchunk_ = append_chunk(schunk, chunk2, true, NULL);
       if (nchunk_ != nchunks + 1) {
         BLOSC_TRACE_ERROR("Error appending last special chunk.");
         return BLOSC2_ERROR_SCHUNK_SPECIAL;
@@ -657,6 +1035,22 @@ int64_t blosc2_schunk_fill_special(blosc2_schunk* schunk, int64_t nitems, int sp
     if (leftover_items) {
       nchunks += 1;
     }
+    // Special chunks have no statistics
+    BLOSC_ERROR(zonemap_invalidate(schunk));
+    int rc = BLOSC2_ERROR_SUCCESS;
+    int64_t nentries = 0;
+    while (nentries < nchunks && rc == BLOSC2_ERROR_SUCCESS) {
+      rc = zonemap_insert(schunk, nentries, NULL);
+      if (rc == BLOSC2_ERROR_SUCCESS) {
+        nentries++;
+      }
+    }
+    if (rc < 0) {
+      while (nentries-- > 0) {
+        zonemap_delete(schunk, nentries, NULL);
+      }
+      return rc;
+    }
     schunk->chunksize = chunksize;
     schunk->nchunks = nchunks;
     schunk->nbytes = nitems * typesize;
@@ -670,8 +1064,107 @@ int64_t blosc2_schunk_fill_special(blosc2_schunk* schunk, int64_t nitems, int sp
   return schunk->nchunks;
 }
 
-/* Append an existing chunk into a super-chunk. */
-int64_t blosc2_schunk_append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool copy) {
+int64_t blosc2_schunk_fill_special(blosc2_schunk* schunk, int64_t nitems, int special_value,
+                               int32_t chunksize) {
+  // Serialized with the other mutations and the commits (durable mode only)
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int64_t rc = fill_special(schunk, nitems, special_value, chunksize);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
+}
+
+/* Pack the chunks of an empty sparse frame into segment files. */
+int blosc2_schunk_set_segment_size(blosc2_schunk *schunk, int64_t segment_size) {
+  BLOSC_ERROR(check_writable(schunk));
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame == NULL || !frame->sframe) {
+    BLOSC_TRACE_ERROR("Segment files are only for sparse, on-disk frames.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (segment_size <= 0 || schunk->nchunks > 0 || frame->segment_size > 0) {
+    BLOSC_TRACE_ERROR("The segment size can only be set once, before adding chunks.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int rc = sframe_create_segments(frame, segment_size);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Error during the creation of the segments index.");
+    return rc;
+  }
+  // The frame type in the header tells that there is a segments index
+  rc = frame_update_header(frame, schunk, false);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to update the frame type into frame.");
+    return rc;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Enable (or disable) the durable mode of a super-chunk. */
+int blosc2_schunk_set_durable(blosc2_schunk *schunk, int32_t commit_interval, int64_t commit_size) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame == NULL) {
+    if (commit_interval > 0 || commit_size > 0) {
+      BLOSC_TRACE_ERROR("The durable mode needs a contiguous, on-disk frame.");
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  return frame_set_durable(frame, commit_interval, commit_size);
+}
+
+
+/* Make all the mutations of a super-chunk durable (durable mode only). */
+int blosc2_schunk_commit(blosc2_schunk *schunk) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  // The statistics are part of what is committed
+  BLOSC_ERROR(zonemap_flush(schunk));
+  frame_lock(frame);
+  int rc = frame_commit(frame);
+  if (rc == BLOSC2_ERROR_SUCCESS && frame->commit_error < 0) {
+    // A commit of the committer thread failed (and this one made up for it)
+    rc = frame->commit_error;
+    frame->commit_error = 0;
+  }
+  frame_unlock(frame);
+  return rc;
+}
+
+
+/* Get the uncompressed size of the last chunk in the super-chunk (which must have one) */
+static int get_last_nbytes(blosc2_schunk *schunk, int32_t *nbytes) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame == NULL) {
+    return blosc2_cbuffer_sizes(schunk->data[schunk->nchunks - 1], nbytes, NULL, NULL);
+  }
+  uint8_t *last_chunk;
+  bool needs_free;
+  int rc = frame_get_lazychunk(frame, schunk->nchunks - 1, &last_chunk, &needs_free);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot get the last chunk (in position %" PRId64 ").", schunk->nchunks - 1);
+    return rc;
+  }
+  rc = blosc2_cbuffer_sizes(last_chunk, nbytes, NULL, NULL);
+  if (needs_free) {
+    free(last_chunk);
+  }
+  return rc;
+}
+
+
+/* Add the statistics of a chunk that is about to be inserted at `nchunk` */
+static int zonemap_invalidate_insert(blosc2_schunk *schunk, int64_t nchunk, zonemap_entry *entry) {
+  BLOSC_ERROR(zonemap_invalidate(schunk));
+  return zonemap_insert(schunk, nchunk, entry);
+}
+
+
+/* Append an existing chunk into a super-chunk (with the statistics in `entry`, if not NULL). */
+static int64_t append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool copy, zonemap_entry *entry) {
+  BLOSC_ERROR(check_writable(schunk));
   int32_t chunk_nbytes;
   int32_t chunk_cbytes;
   int64_t nchunks = schunk->nchunks;
@@ -681,14 +1174,38 @@ int64_t blosc2_schunk_append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool c
     return rc;
   }
 
+  int32_t old_chunksize = schunk->chunksize;
+  int64_t old_nbytes = schunk->nbytes;
+  int64_t old_cbytes = schunk->cbytes;
+  int64_t old_current_nchunk = schunk->current_nchunk;
   if (schunk->chunksize == -1) {
     schunk->chunksize = chunk_nbytes;  // The super-chunk is initialized now
   }
   if (chunk_nbytes > schunk->chunksize) {
     BLOSC_TRACE_ERROR("Appending chunks that have different lengths in the same schunk "
                       "is not supported yet: %d > %d.", chunk_nbytes, schunk->chunksize);
+    schunk->chunksize = old_chunksize;
     return BLOSC2_ERROR_CHUNK_APPEND;
   }
+  // Check that we are not appending a small chunk after another small chunk
+  if ((nchunks > 0) && (chunk_nbytes < schunk->chunksize)) {
+    int32_t last_nbytes;
+    rc = get_last_nbytes(schunk, &last_nbytes);
+    if (rc < 0) {
+      return rc;
+    }
+    if (last_nbytes < schunk->chunksize) {
+      BLOSC_TRACE_ERROR(
+              "Appending two consecutive chunks with a chunksize smaller than the schunk chunksize "
+              "is not allowed yet: %d != %d.", chunk_nbytes, schunk->chunksize);
+      return BLOSC2_ERROR_CHUNK_APPEND;
+    }
+  }
+  rc = zonemap_invalidate_insert(schunk, nchunks, entry);
+  if (rc < 0) {
+    schunk->chunksize = old_chunksize;
+    return rc;
+  }
 
   /* Update counters */
   schunk->current_nchunk = nchunks;
@@ -720,22 +1237,6 @@ int64_t blosc2_schunk_append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool c
   // Update super-chunk or frame
   blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
   if (frame == NULL) {
-    // Check that we are not appending a small chunk after another small chunk
-    if ((schunk->nchunks > 1) && (chunk_nbytes < schunk->chunksize)) {
-      uint8_t* last_chunk = schunk->data[nchunks - 1];
-      int32_t last_nbytes;
-      rc = blosc2_cbuffer_sizes(last_chunk, &last_nbytes, NULL, NULL);
-      if (rc < 0) {
-        return rc;
-      }
-      if ((last_nbytes < schunk->chunksize) && (chunk_nbytes < schunk->chunksize)) {
-        BLOSC_TRACE_ERROR(
-                "Appending two consecutive chunks with a chunksize smaller than the schunk chunksize "
-                "is not allowed yet: %d != %d.", chunk_nbytes, schunk->chunksize);
-        return BLOSC2_ERROR_CHUNK_APPEND;
-      }
-    }
-
     if (!copy && (chunk_cbytes < chunk_nbytes)) {
       // We still want to do a shrink of the chunk
       chunk = realloc(chunk, chunk_cbytes);
@@ -752,15 +1253,166 @@ int64_t blosc2_schunk_append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool c
   else {
     if (frame_append_chunk(frame, chunk, schunk) == NULL) {
       BLOSC_TRACE_ERROR("Problems appending a chunk.");
+      // The chunk has not been appended, so the super-chunk does not have it
+      if (copy) {
+        free(chunk);
+      }
+      schunk->chunksize = old_chunksize;
+      schunk->nbytes = old_nbytes;
+      schunk->cbytes = old_cbytes;
+      schunk->current_nchunk = old_current_nchunk;
+      schunk->nchunks = nchunks;
+      zonemap_delete(schunk, nchunks, entry);
+      return BLOSC2_ERROR_CHUNK_APPEND;
+    }
+  }
+  return schunk->nchunks;
+}
+
+int64_t blosc2_schunk_append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool copy) {
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int64_t rc = append_chunk(schunk, chunk, copy, NULL);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
+}
+
+
+/* Append several existing chunks to the super-chunk, updating the frame only once
+ * (with the statistics in `entries`, if not NULL). */
+static int64_t append_chunks(blosc2_schunk *schunk, uint8_t **chunks, int64_t nchunks, bool copy,
+                             zonemap_entry *entries) {
+  BLOSC_ERROR(check_writable(schunk));
+  if (nchunks < 0) {
+    BLOSC_TRACE_ERROR("The number of chunks to append cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+
+  // Check the chunk sizes (with the same rules as blosc2_schunk_append_chunk) and
+  // compute the new counters before touching the super-chunk
+  int32_t chunksize = schunk->chunksize;
+  int64_t nbytes = schunk->nbytes;
+  int64_t cbytes = schunk->cbytes;
+  int32_t last_nbytes = chunksize;
+  if (schunk->nchunks > 0) {
+    int rc = get_last_nbytes(schunk, &last_nbytes);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  for (int64_t i = 0; i < nchunks; ++i) {
+    int32_t chunk_nbytes;
+    int32_t chunk_cbytes;
+    int rc = blosc2_cbuffer_sizes(chunks[i], &chunk_nbytes, &chunk_cbytes, NULL);
+    if (rc < 0) {
+      return rc;
+    }
+    if (chunksize == -1) {
+      chunksize = chunk_nbytes;  // The super-chunk is initialized now
+      last_nbytes = chunk_nbytes;
+    }
+    if (chunk_nbytes > chunksize) {
+      BLOSC_TRACE_ERROR("Appending chunks that have different lengths in the same schunk "
+                        "is not supported yet: %d > %d.", chunk_nbytes, chunksize);
       return BLOSC2_ERROR_CHUNK_APPEND;
     }
+    if ((last_nbytes < chunksize) && (chunk_nbytes < chunksize)) {
+      BLOSC_TRACE_ERROR(
+              "Appending two consecutive chunks with a chunksize smaller than the schunk chunksize "
+              "is not allowed yet: %d != %d.", chunk_nbytes, chunksize);
+      return BLOSC2_ERROR_CHUNK_APPEND;
+    }
+    last_nbytes = chunk_nbytes;
+    int special_value = (chunks[i][BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+    nbytes += chunk_nbytes;
+    switch (special_value) {
+      case BLOSC2_SPECIAL_ZERO:
+      case BLOSC2_SPECIAL_NAN:
+      case BLOSC2_SPECIAL_UNINIT:
+        break;
+      default:
+        cbytes += chunk_cbytes;
+    }
+  }
+
+  if (frame == NULL || nchunks == 0) {
+    for (int64_t i = 0; i < nchunks; ++i) {
+      int64_t rc = append_chunk(schunk, chunks[i], copy, entries != NULL ? &entries[i] : NULL);
+      if (rc < 0) {
+        return rc;
+      }
+    }
+    return schunk->nchunks;
+  }
+
+  BLOSC_ERROR(zonemap_invalidate(schunk));
+  int64_t nentries = 0;
+  int rc = BLOSC2_ERROR_SUCCESS;
+  while (nentries < nchunks && rc == BLOSC2_ERROR_SUCCESS) {
+    rc = zonemap_insert(schunk, schunk->nchunks + nentries, entries != NULL ? &entries[nentries] : NULL);
+    if (rc == BLOSC2_ERROR_SUCCESS) {
+      nentries++;
+    }
+  }
+  if (rc < 0) {
+    while (nentries-- > 0) {
+      zonemap_delete(schunk, schunk->nchunks + nentries, entries != NULL ? &entries[nentries] : NULL);
+    }
+    return rc;
+  }
+
+  /* Update counters (the frame header is written out of them) */
+  int32_t old_chunksize = schunk->chunksize;
+  int64_t old_nbytes = schunk->nbytes;
+  int64_t old_cbytes = schunk->cbytes;
+  int64_t old_current_nchunk = schunk->current_nchunk;
+  schunk->chunksize = chunksize;
+  schunk->nbytes = nbytes;
+  schunk->cbytes = cbytes;
+  schunk->current_nchunk = schunk->nchunks + nchunks - 1;
+  schunk->nchunks += nchunks;
+
+  if (frame_append_chunks(frame, chunks, nchunks, schunk) == NULL) {
+    BLOSC_TRACE_ERROR("Problems appending the chunks.");
+    // The chunks have not been appended, so the super-chunk does not have them
+    schunk->chunksize = old_chunksize;
+    schunk->nbytes = old_nbytes;
+    schunk->cbytes = old_cbytes;
+    schunk->current_nchunk = old_current_nchunk;
+    schunk->nchunks -= nchunks;
+    for (int64_t i = nchunks - 1; i >= 0; --i) {
+      zonemap_delete(schunk, schunk->nchunks + i, entries != NULL ? &entries[i] : NULL);
+    }
+    return BLOSC2_ERROR_CHUNK_APPEND;
+  }
+  if (!copy) {
+    // The frame keeps its own copy of the data
+    for (int64_t i = 0; i < nchunks; ++i) {
+      free(chunks[i]);
+    }
   }
   return schunk->nchunks;
 }
 
+int64_t blosc2_schunk_append_chunks(blosc2_schunk *schunk, uint8_t **chunks, int64_t nchunks, bool copy) {
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int64_t rc = append_chunks(schunk, chunks, nchunks, copy, NULL);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
+}
+
+int64_t schunk_append_chunks_stats(blosc2_schunk *schunk, uint8_t **chunks, int64_t nchunks, bool copy,
+                                   zonemap_entry *entries) {
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int64_t rc = append_chunks(schunk, chunks, nchunks, copy, entries);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
+}
+
 
 /* Insert an existing @p chunk in a specified position on a super-chunk */
-int64_t blosc2_schunk_insert_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy) {
+static int64_t insert_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy) {
+  BLOSC_ERROR(check_writable(schunk));
   int32_t chunk_nbytes;
   int32_t chunk_cbytes;
   int64_t nchunks = schunk->nchunks;
@@ -839,6 +1491,7 @@ int64_t blosc2_schunk_insert_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_
     }
 
     // Reorder the offsets and insert the new chunk
+    BLOSC_ERROR(zonemap_insert(schunk, nchunk, NULL));
     for (int64_t i = nchunks; i > nchunk; --i) {
       schunk->data[i] = schunk->data[i-1];
     }
@@ -846,16 +1499,28 @@ int64_t blosc2_schunk_insert_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_
   }
 
   else {
+    BLOSC_ERROR(zonemap_invalidate_insert(schunk, nchunk, NULL));
     if (frame_insert_chunk(frame, nchunk, chunk, schunk) == NULL) {
       BLOSC_TRACE_ERROR("Problems inserting a chunk in a frame.");
+      zonemap_delete(schunk, nchunk, NULL);
       return BLOSC2_ERROR_CHUNK_INSERT;
     }
   }
   return schunk->nchunks;
 }
 
+int64_t blosc2_schunk_insert_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy) {
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int64_t rc = insert_chunk(schunk, nchunk, chunk, copy);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
+}
+
 
-int64_t blosc2_schunk_update_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy) {
+/* Replace a chunk with the statistics in `entry` (which gets the old ones on success). */
+static int64_t update_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy,
+                            zonemap_entry *entry) {
+  BLOSC_ERROR(check_writable(schunk));
   int32_t chunk_nbytes;
   int32_t chunk_cbytes;
 
@@ -936,7 +1601,8 @@ int64_t blosc2_schunk_update_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_
           schunk->cbytes -= chunk_cbytes_old;
         }
         else {
-          if (chunk_cbytes_old >= chunk_cbytes) {
+          // The chunk is overwritten in place (but in the durable mode)
+          if (chunk_cbytes_old >= chunk_cbytes && !frame_is_durable(frame)) {
             schunk->cbytes -= chunk_cbytes;
           }
         }
@@ -955,18 +1621,45 @@ int64_t blosc2_schunk_update_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_
       free(schunk->data[nchunk]);
     }
     schunk->data[nchunk] = chunk;
+    BLOSC_ERROR(zonemap_swap(schunk, nchunk, entry));
   }
   else {
+    BLOSC_ERROR(zonemap_invalidate(schunk));
+    BLOSC_ERROR(zonemap_swap(schunk, nchunk, entry));
     if (frame_update_chunk(frame, nchunk, chunk, schunk) == NULL) {
-        BLOSC_TRACE_ERROR("Problems updating a chunk in a frame.");
-        return BLOSC2_ERROR_CHUNK_UPDATE;
+      BLOSC_TRACE_ERROR("Problems updating a chunk in a frame.");
+      zonemap_swap(schunk, nchunk, entry);
+      return BLOSC2_ERROR_CHUNK_UPDATE;
     }
   }
 
   return schunk->nchunks;
 }
 
-int64_t blosc2_schunk_delete_chunk(blosc2_schunk *schunk, int64_t nchunk) {
+int64_t blosc2_schunk_update_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy) {
+  zonemap_entry entry = {0};
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int64_t rc = update_chunk(schunk, nchunk, chunk, copy, &entry);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  zonemap_entry_free(&entry);
+  return rc;
+}
+
+int64_t schunk_update_chunk_ctx(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy,
+                                blosc2_context *cctx) {
+  zonemap_entry entry = {0};
+  if (schunk_private(schunk)->zonemap != NULL) {
+    BLOSC_ERROR(zonemap_entry_from_ctx(cctx, &entry));
+  }
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int64_t rc = update_chunk(schunk, nchunk, chunk, copy, &entry);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  zonemap_entry_free(&entry);
+  return rc;
+}
+
+static int64_t delete_chunk(blosc2_schunk *schunk, int64_t nchunk) {
+  BLOSC_ERROR(check_writable(schunk));
   int rc;
   if (schunk->nchunks < nchunk) {
     BLOSC_TRACE_ERROR("The schunk has not enough chunks (%" PRId64 ")!", schunk->nchunks);
@@ -1021,20 +1714,34 @@ int64_t blosc2_schunk_delete_chunk(blosc2_schunk *schunk, int64_t nchunk) {
       schunk->data[i] = schunk->data[i + 1];
     }
     schunk->data[schunk->nchunks] = NULL;
-
+    BLOSC_ERROR(zonemap_delete(schunk, nchunk, NULL));
   }
   else {
+    BLOSC_ERROR(zonemap_invalidate(schunk));
+    zonemap_entry entry = {0};
+    BLOSC_ERROR(zonemap_delete(schunk, nchunk, &entry));
     if (frame_delete_chunk(frame, nchunk, schunk) == NULL) {
       BLOSC_TRACE_ERROR("Problems deleting a chunk in a frame.");
+      zonemap_insert(schunk, nchunk, &entry);
+      zonemap_entry_free(&entry);
       return BLOSC2_ERROR_CHUNK_UPDATE;
     }
+    zonemap_entry_free(&entry);
   }
   return schunk->nchunks;
 }
 
+int64_t blosc2_schunk_delete_chunk(blosc2_schunk *schunk, int64_t nchunk) {
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int64_t rc = delete_chunk(schunk, nchunk);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
+}
+
 
 /* Append a data buffer to a super-chunk. */
 int64_t blosc2_schunk_append_buffer(blosc2_schunk *schunk, void *src, int32_t nbytes) {
+  BLOSC_ERROR(check_writable(schunk));
   uint8_t* chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
   schunk->current_nchunk = schunk->nchunks;
   /* Compress the src buffer using super-chunk context */
@@ -1044,8 +1751,19 @@ int64_t blosc2_schunk_append_buffer(blosc2_schunk *schunk, void *src, int32_t nb
     free(chunk);
     return cbytes;
   }
+  zonemap_entry entry = {0};
+  if (schunk_private(schunk)->zonemap != NULL) {
+    int rc = zonemap_entry_from_ctx(schunk->cctx, &entry);
+    if (rc < 0) {
+      free(chunk);
+      return rc;
+    }
+  }
   // We don't need a copy of the chunk, as it will be shrunk if necessary
-  int64_t nchunks = blosc2_schunk_append_chunk(schunk, chunk, false);
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int64_t nchunks = append_chunk(schunk, chunk, false, &entry);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  zonemap_entry_free(&entry);
   if (nchunks < 0) {
     BLOSC_TRACE_ERROR("Error appending a buffer in super-chunk");
     return nchunks;
@@ -1094,6 +1812,11 @@ int blosc2_schunk_decompress_chunk(blosc2_schunk *schunk, int64_t nchunk,
         return chunksize;
       return BLOSC2_ERROR_FAILURE;
     }
+  } else if (schunk_private(schunk)->prefetch != NULL) {
+    chunksize = prefetch_decompress_chunk(schunk, nchunk, dest, nbytes);
+    if (chunksize < 0) {
+      return chunksize;
+    }
   } else {
     chunksize = frame_decompress_chunk(schunk->dctx, frame, nchunk, dest, nbytes);
     if (chunksize < 0) {
@@ -1124,6 +1847,9 @@ int blosc2_schunk_get_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t **chu
     schunk->current_nchunk = nchunk;
   }
   blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (schunk_private(schunk)->prefetch != NULL) {
+    return prefetch_get_chunk(schunk, nchunk, chunk, needs_free, false);
+  }
   if (frame != NULL) {
     return frame_get_chunk(frame, nchunk, chunk, needs_free);
   }
@@ -1170,6 +1896,9 @@ int blosc2_schunk_get_lazychunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *
     schunk->current_nchunk = nchunk;
   }
   blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (schunk_private(schunk)->prefetch != NULL) {
+    return prefetch_get_chunk(schunk, nchunk, chunk, needs_free, true);
+  }
   if (schunk->frame != NULL) {
     return frame_get_lazychunk(frame, nchunk, chunk, needs_free);
   }
@@ -1210,19 +1939,33 @@ int blosc2_schunk_get_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
   }
 
   uint8_t *dst_ptr = (uint8_t *) buffer;
-  bool needs_free;
-  uint8_t *chunk;
+  bool needs_free = false;
+  uint8_t *chunk = NULL;
   int32_t cbytes;
   int64_t nchunk = nchunk_start;
   int64_t nbytes_read = 0;
   int32_t nbytes;
   int32_t chunksize = schunk->chunksize;
+  // The next chunk, when its blocks are read while the current one is decompressed
+  uint8_t *next_chunk = NULL;
+  bool next_needs_free = false;
+  int32_t next_cbytes = 0;
+  int rc = BLOSC2_ERROR_SUCCESS;
 
   while (nbytes_read < ((stop - start) * schunk->typesize)) {
-    cbytes = blosc2_schunk_get_lazychunk(schunk, nchunk, &chunk, &needs_free);
-    if (cbytes < 0) {
-      BLOSC_TRACE_ERROR("Cannot get lazychunk ('%" PRId64 "').", nchunk);
-      return BLOSC2_ERROR_FAILURE;
+    if (next_chunk != NULL) {
+      chunk = next_chunk;
+      needs_free = next_needs_free;
+      cbytes = next_cbytes;
+      next_chunk = NULL;
+    }
+    else {
+      cbytes = blosc2_schunk_get_lazychunk(schunk, nchunk, &chunk, &needs_free);
+      if (cbytes < 0) {
+        BLOSC_TRACE_ERROR("Cannot get lazychunk ('%" PRId64 "').", nchunk);
+        rc = BLOSC2_ERROR_FAILURE;
+        goto out;
+      }
     }
     int32_t blocksize = sw32_(chunk + BLOSC2_CHUNK_BLOCKSIZE);
 
@@ -1236,12 +1979,30 @@ int blosc2_schunk_get_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
       nblocks++;
     }
 
+    // If the next chunk is decompressed as a whole, read its blocks while decompressing this one
+    int64_t next_byte_stop = (nchunk + 2) * schunk->chunksize;
+    if (next_byte_stop > schunk->nbytes) {
+      next_byte_stop = schunk->nbytes;
+    }
+    if (nchunk + 1 < schunk->nchunks && byte_stop >= next_byte_stop) {
+      next_cbytes = blosc2_schunk_get_lazychunk(schunk, nchunk + 1, &next_chunk, &next_needs_free);
+      if (next_cbytes < 0) {
+        // It will be tried again (and the error reported) in the next iteration
+        next_chunk = NULL;
+      }
+      else if (next_chunk != NULL) {
+        // Errors show up when the next chunk is decompressed
+        lazychunk_read_ahead(schunk->dctx, next_chunk, next_cbytes);
+      }
+    }
+
     if (chunk_start == 0 && chunk_stop == chunksize) {
       // Avoid memcpy
       nbytes = blosc2_decompress_ctx(schunk->dctx, chunk, cbytes, dst_ptr, chunksize);
       if (nbytes < 0) {
         BLOSC_TRACE_ERROR("Cannot decompress chunk ('%" PRId64 "').", nchunk);
-        return BLOSC2_ERROR_FAILURE;
+        rc = BLOSC2_ERROR_FAILURE;
+        goto out;
       }
     }
     else {
@@ -1278,7 +2039,8 @@ int blosc2_schunk_get_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
                                     (chunk_stop - chunk_start) / schunk->typesize, dst_ptr, chunksize);
         if (nbytes < 0) {
           BLOSC_TRACE_ERROR("Cannot get item from ('%" PRId64 "') chunk.", nchunk);
-          return BLOSC2_ERROR_FAILURE;
+          rc = BLOSC2_ERROR_FAILURE;
+          goto out;
         }
       }
     }
@@ -1289,6 +2051,7 @@ int blosc2_schunk_get_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
 
     if (needs_free) {
       free(chunk);
+      needs_free = false;
     }
     chunk_start = 0;
     if (byte_stop >= (nchunk + 1) * chunksize) {
@@ -1299,11 +2062,20 @@ int blosc2_schunk_get_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
     }
   }
 
-  return BLOSC2_ERROR_SUCCESS;
+  out:
+  lazychunk_read_ahead_cancel(schunk->dctx);
+  if (needs_free) {
+    free(chunk);
+  }
+  if (next_chunk != NULL && next_needs_free) {
+    free(next_chunk);
+  }
+  return rc;
 }
 
 
 int blosc2_schunk_set_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t stop, void *buffer) {
+  BLOSC_ERROR(check_writable(schunk));
   int64_t byte_start = start * schunk->typesize;
   int64_t byte_stop = stop * schunk->typesize;
   int64_t nchunk_start = byte_start / schunk->chunksize;
@@ -1335,7 +2107,7 @@ int blosc2_schunk_set_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
         BLOSC_TRACE_ERROR("Cannot compress data of chunk ('%" PRId64 "').", nchunk);
         return BLOSC2_ERROR_FAILURE;
       }
-      nchunks = blosc2_schunk_update_chunk(schunk, nchunk, chunk, false);
+      nchunks = schunk_update_chunk_ctx(schunk, nchunk, chunk, false, schunk->cctx);
       if (nchunks != schunk->nchunks) {
         BLOSC_TRACE_ERROR("Cannot update chunk ('%" PRId64 "').", nchunk);
         return BLOSC2_ERROR_CHUNK_UPDATE;
@@ -1353,7 +2125,7 @@ int blosc2_schunk_set_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
         BLOSC_TRACE_ERROR("Cannot compress data of chunk ('%" PRId64 "').", nchunk);
         return BLOSC2_ERROR_FAILURE;
       }
-      nchunks = blosc2_schunk_update_chunk(schunk, nchunk, chunk, false);
+      nchunks = schunk_update_chunk_ctx(schunk, nchunk, chunk, false, schunk->cctx);
       if (nchunks != schunk->nchunks) {
         BLOSC_TRACE_ERROR("Cannot update chunk ('%" PRId64 "').", nchunk);
         return BLOSC2_ERROR_CHUNK_UPDATE;
@@ -1377,7 +2149,8 @@ int blosc2_schunk_set_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
 
 
 /* Reorder the chunk offsets of an existing super-chunk. */
-int blosc2_schunk_reorder_offsets(blosc2_schunk *schunk, int64_t *offsets_order) {
+static int reorder_offsets(blosc2_schunk *schunk, int64_t *offsets_order) {
+  BLOSC_ERROR(check_writable(schunk));
   // Check that the offsets order are correct
   bool *index_check = (bool *) calloc(schunk->nchunks, sizeof(bool));
   for (int i = 0; i < schunk->nchunks; ++i) {
@@ -1399,7 +2172,13 @@ int blosc2_schunk_reorder_offsets(blosc2_schunk *schunk, int64_t *offsets_order)
 
   blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
   if (frame != NULL) {
-    return frame_reorder_offsets(frame, offsets_order, schunk);
+    BLOSC_ERROR(zonemap_invalidate(schunk));
+    BLOSC_ERROR(zonemap_reorder(schunk, offsets_order, false));
+    int rc = frame_reorder_offsets(frame, offsets_order, schunk);
+    if (rc < 0) {
+      zonemap_reorder(schunk, offsets_order, true);
+    }
+    return rc;
   }
   uint8_t **offsets = schunk->data;
 
@@ -1412,7 +2191,14 @@ int blosc2_schunk_reorder_offsets(blosc2_schunk *schunk, int64_t *offsets_order)
   }
   free(offsets_copy);
 
-  return 0;
+  return zonemap_reorder(schunk, offsets_order, false);
+}
+
+int blosc2_schunk_reorder_offsets(blosc2_schunk *schunk, int64_t *offsets_order) {
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int rc = reorder_offsets(schunk, offsets_order);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
 }
 
 
@@ -1450,6 +2236,10 @@ int metalayer_flush(blosc2_schunk* schunk) {
   if (frame == NULL) {
     return rc;
   }
+  rc = frame_commit_begin(frame);
+  if (rc < 0) {
+    return rc;
+  }
   rc = frame_update_header(frame, schunk, true);
   if (rc < 0) {
     BLOSC_TRACE_ERROR("Unable to update metalayers into frame.");
@@ -1460,7 +2250,7 @@ int metalayer_flush(blosc2_schunk* schunk) {
     BLOSC_TRACE_ERROR("Unable to update trailer into frame.");
     return rc;
   }
-  return rc;
+  return frame_commit_end(frame, 0);
 }
 
 
@@ -1468,7 +2258,8 @@ int metalayer_flush(blosc2_schunk* schunk) {
  *
  * If successful, return the index of the new metalayer.  Else, return a negative value.
  */
-int blosc2_meta_add(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len) {
+static int meta_add(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len) {
+  BLOSC_ERROR(check_writable(schunk));
   int nmetalayer = blosc2_meta_exists(schunk, name);
   if (nmetalayer >= 0) {
     BLOSC_TRACE_ERROR("Metalayer \"%s\" already exists.", name);
@@ -1486,6 +2277,7 @@ int blosc2_meta_add(blosc2_schunk *schunk, const char *name, uint8_t *content, i
   metalayer->content_len = content_len;
   schunk->metalayers[schunk->nmetalayers] = metalayer;
   schunk->nmetalayers += 1;
+  metalayers_changed(schunk);
 
   int rc = metalayer_flush(schunk);
   if (rc < 0) {
@@ -1495,12 +2287,20 @@ int blosc2_meta_add(blosc2_schunk *schunk, const char *name, uint8_t *content, i
   return schunk->nmetalayers - 1;
 }
 
+int blosc2_meta_add(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len) {
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int rc = meta_add(schunk, name, content, content_len);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
+}
+
 
 /* Update the content of an existing metalayer.
  *
  * If successful, return the index of the new metalayer.  Else, return a negative value.
  */
-int blosc2_meta_update(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len) {
+static int meta_update(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len) {
+  BLOSC_ERROR(check_writable(schunk));
   int nmetalayer = blosc2_meta_exists(schunk, name);
   if (nmetalayer < 0) {
     BLOSC_TRACE_ERROR("Metalayer \"%s\" not found.", name);
@@ -1515,20 +2315,36 @@ int blosc2_meta_update(blosc2_schunk *schunk, const char *name, uint8_t *content
 
   // Update the contents of the metalayer
   memcpy(metalayer->content, content, content_len);
+  metalayers_changed(schunk);
 
   // Update the metalayers in frame (as size has not changed, we don't need to update the trailer)
   blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
   if (frame != NULL) {
-    int rc = frame_update_header(frame, schunk, false);
+    int rc = frame_commit_begin(frame);
+    if (rc < 0) {
+      return rc;
+    }
+    rc = frame_update_header(frame, schunk, false);
     if (rc < 0) {
       BLOSC_TRACE_ERROR("Unable to update meta info from frame.");
       return rc;
     }
+    rc = frame_commit_end(frame, 0);
+    if (rc < 0) {
+      return rc;
+    }
   }
 
   return nmetalayer;
 }
 
+int blosc2_meta_update(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len) {
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int rc = meta_update(schunk, name, content, content_len);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
+}
+
 
 /* Find whether the schunk has a variable-length metalayer or not.
  *
@@ -1554,6 +2370,10 @@ int vlmetalayer_flush(blosc2_schunk* schunk) {
   if (frame == NULL) {
     return rc;
   }
+  rc = frame_commit_begin(frame);
+  if (rc < 0) {
+    return rc;
+  }
   rc = frame_update_header(frame, schunk, false);
   if (rc < 0) {
     BLOSC_TRACE_ERROR("Unable to update metalayers into frame.");
@@ -1564,25 +2384,39 @@ int vlmetalayer_flush(blosc2_schunk* schunk) {
     BLOSC_TRACE_ERROR("Unable to update trailer into frame.");
     return rc;
   }
-  return rc;
+  return frame_commit_end(frame, 0);
 }
 
-/* Add content into a new variable-length metalayer.
+/* Flush the new content of a single vlmetalayer into a possible attached frame.
  *
- * If successful, return the index of the new variable-length metalayer.  Else, return a negative value.
+ * The value is overwritten in place when it fits in the room that it has in the
+ * trailer; only when it does not, the whole trailer is rebuilt.
  */
-int blosc2_vlmeta_add(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len,
-                      blosc2_cparams *cparams) {
-  int nvlmetalayer = blosc2_vlmeta_exists(schunk, name);
-  if (nvlmetalayer >= 0) {
-    BLOSC_TRACE_ERROR("Variable-length metalayer \"%s\" already exists.", name);
-    return BLOSC2_ERROR_INVALID_PARAM;
+static int vlmetalayer_update_flush(blosc2_schunk* schunk, int nvlmetalayer) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
   }
+  int rc = frame_commit_begin(frame);
+  if (rc < 0) {
+    return rc;
+  }
+  rc = frame_update_vlmetalayer(frame, schunk, nvlmetalayer);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to update the vlmetalayer into frame.");
+    return rc;
+  }
+  if (rc == 0) {
+    return vlmetalayer_flush(schunk);
+  }
+  return frame_commit_end(frame, 0);
+}
 
-  // Add the vlmetalayer
-  blosc2_metalayer *vlmetalayer = malloc(sizeof(blosc2_metalayer));
-  vlmetalayer->name = strdup(name);
+/* Compress `content` into a variable-length metalayer (replacing the previous one). */
+static int vlmetalayer_set_content(blosc2_metalayer *vlmetalayer, uint8_t *content, int32_t content_len,
+                                   blosc2_cparams *cparams) {
   uint8_t* content_buf = malloc((size_t) content_len + BLOSC2_MAX_OVERHEAD);
+  BLOSC_ERROR_NULL(content_buf, BLOSC2_ERROR_MEMORY_ALLOC);
 
   blosc2_context *cctx;
   if (cparams != NULL) {
@@ -1592,19 +2426,46 @@ int blosc2_vlmeta_add(blosc2_schunk *schunk, const char *name, uint8_t *content,
   }
 
   int csize = blosc2_compress_ctx(cctx, content, content_len, content_buf, content_len + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
   if (csize < 0) {
-    BLOSC_TRACE_ERROR("Can not compress the `%s` variable-length metalayer.", name);
+    BLOSC_TRACE_ERROR("Can not compress the `%s` variable-length metalayer.", vlmetalayer->name);
+    free(content_buf);
     return csize;
   }
-  blosc2_free_ctx(cctx);
 
+  free(vlmetalayer->content);
   vlmetalayer->content = realloc(content_buf, csize);
   vlmetalayer->content_len = csize;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Add content into a new variable-length metalayer.
+ *
+ * If successful, return the index of the new variable-length metalayer.  Else, return a negative value.
+ */
+static int vlmeta_add(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len,
+                      blosc2_cparams *cparams) {
+  BLOSC_ERROR(check_writable(schunk));
+  int nvlmetalayer = blosc2_vlmeta_exists(schunk, name);
+  if (nvlmetalayer >= 0) {
+    BLOSC_TRACE_ERROR("Variable-length metalayer \"%s\" already exists.", name);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  // Add the vlmetalayer
+  blosc2_metalayer *vlmetalayer = calloc(1, sizeof(blosc2_metalayer));
+  vlmetalayer->name = strdup(name);
+  int rc = vlmetalayer_set_content(vlmetalayer, content, content_len, cparams);
+  if (rc < 0) {
+    free(vlmetalayer->name);
+    free(vlmetalayer);
+    return rc;
+  }
   schunk->vlmetalayers[schunk->nvlmetalayers] = vlmetalayer;
   schunk->nvlmetalayers += 1;
 
   // Propagate to frames
-  int rc = vlmetalayer_flush(schunk);
+  rc = vlmetalayer_flush(schunk);
   if (rc < 0) {
     BLOSC_TRACE_ERROR("Can not propagate de `%s` variable-length metalayer to a frame.", name);
     return rc;
@@ -1613,6 +2474,14 @@ int blosc2_vlmeta_add(blosc2_schunk *schunk, const char *name, uint8_t *content,
   return schunk->nvlmetalayers - 1;
 }
 
+int blosc2_vlmeta_add(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len,
+                      blosc2_cparams *cparams) {
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int rc = vlmeta_add(schunk, name, content, content_len, cparams);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
+}
+
 
 int blosc2_vlmeta_get(blosc2_schunk *schunk, const char *name, uint8_t **content,
                       int32_t *content_len) {
@@ -1640,37 +2509,22 @@ int blosc2_vlmeta_get(blosc2_schunk *schunk, const char *name, uint8_t **content
   return nvlmetalayer;
 }
 
-int blosc2_vlmeta_update(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len,
+static int vlmeta_update(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len,
                          blosc2_cparams *cparams) {
+  BLOSC_ERROR(check_writable(schunk));
   int nvlmetalayer = blosc2_vlmeta_exists(schunk, name);
   if (nvlmetalayer < 0) {
     BLOSC_TRACE_ERROR("User vlmetalayer \"%s\" not found.", name);
     return nvlmetalayer;
   }
 
-  blosc2_metalayer *vlmetalayer = schunk->vlmetalayers[nvlmetalayer];
-  free(vlmetalayer->content);
-  uint8_t* content_buf = malloc((size_t) content_len + BLOSC2_MAX_OVERHEAD);
-
-  blosc2_context *cctx;
-  if (cparams != NULL) {
-    cctx = blosc2_create_cctx(*cparams);
-  } else {
-    cctx = blosc2_create_cctx(BLOSC2_CPARAMS_DEFAULTS);
-  }
-
-  int csize = blosc2_compress_ctx(cctx, content, content_len, content_buf, content_len + BLOSC2_MAX_OVERHEAD);
-  if (csize < 0) {
-    BLOSC_TRACE_ERROR("Can not compress the `%s` variable-length metalayer.", name);
-    return csize;
+  int rc = vlmetalayer_set_content(schunk->vlmetalayers[nvlmetalayer], content, content_len, cparams);
+  if (rc < 0) {
+    return rc;
   }
-  blosc2_free_ctx(cctx);
-
-  vlmetalayer->content = realloc(content_buf, csize);
-  vlmetalayer->content_len = csize;
 
   // Propagate to frames
-  int rc = vlmetalayer_flush(schunk);
+  rc = vlmetalayer_update_flush(schunk, nvlmetalayer);
   if (rc < 0) {
     BLOSC_TRACE_ERROR("Can not propagate de `%s` variable-length metalayer to a frame.", name);
     return rc;
@@ -1679,7 +2533,41 @@ int blosc2_vlmeta_update(blosc2_schunk *schunk, const char *name, uint8_t *conte
   return nvlmetalayer;
 }
 
-int blosc2_vlmeta_delete(blosc2_schunk *schunk, const char *name) {
+int blosc2_vlmeta_update(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len,
+                         blosc2_cparams *cparams) {
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int rc = vlmeta_update(schunk, name, content, content_len, cparams);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
+}
+
+int vlmeta_stage(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len,
+                 blosc2_cparams *cparams) {
+  int nvlmetalayer = blosc2_vlmeta_exists(schunk, name);
+  if (nvlmetalayer >= 0) {
+    BLOSC_ERROR(vlmetalayer_set_content(schunk->vlmetalayers[nvlmetalayer], content, content_len, cparams));
+    return nvlmetalayer;
+  }
+  if (schunk->nvlmetalayers == BLOSC2_MAX_VLMETALAYERS) {
+    BLOSC_TRACE_ERROR("Cannot add the `%s` variable-length metalayer (too many of them).", name);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  blosc2_metalayer *vlmetalayer = calloc(1, sizeof(blosc2_metalayer));
+  BLOSC_ERROR_NULL(vlmetalayer, BLOSC2_ERROR_MEMORY_ALLOC);
+  vlmetalayer->name = strdup(name);
+  int rc = vlmetalayer_set_content(vlmetalayer, content, content_len, cparams);
+  if (rc < 0) {
+    free(vlmetalayer->name);
+    free(vlmetalayer);
+    return rc;
+  }
+  schunk->vlmetalayers[schunk->nvlmetalayers] = vlmetalayer;
+  schunk->nvlmetalayers += 1;
+  return schunk->nvlmetalayers - 1;
+}
+
+static int vlmeta_delete(blosc2_schunk *schunk, const char *name) {
+  BLOSC_ERROR(check_writable(schunk));
   int nvlmetalayer = blosc2_vlmeta_exists(schunk, name);
   if (nvlmetalayer < 0) {
     BLOSC_TRACE_ERROR("User vlmetalayer \"%s\" not found.", name);
@@ -1690,7 +2578,9 @@ int blosc2_vlmeta_delete(blosc2_schunk *schunk, const char *name) {
   for (int i = nvlmetalayer; i < (schunk->nvlmetalayers - 1); i++) {
     schunk->vlmetalayers[i] = schunk->vlmetalayers[i + 1];
   }
+  free(vlmetalayer->name);
   free(vlmetalayer->content);
+  free(vlmetalayer);
   schunk->nvlmetalayers--;
 
   // Propagate to frames
@@ -1703,6 +2593,13 @@ int blosc2_vlmeta_delete(blosc2_schunk *schunk, const char *name) {
   return schunk->nvlmetalayers;
 }
 
+int blosc2_vlmeta_delete(blosc2_schunk *schunk, const char *name) {
+  frame_lock((blosc2_frame_s*)schunk->frame);
+  int rc = vlmeta_delete(schunk, name);
+  frame_unlock((blosc2_frame_s*)schunk->frame);
+  return rc;
+}
+
 
 int blosc2_vlmeta_get_names(blosc2_schunk *schunk, char **names) {
   int16_t nvlmetalayers = schunk->nvlmetalayers;
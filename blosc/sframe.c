@@ -11,8 +11,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include "blosc2.h"
+#include "blosc-private.h"
 #include "frame.h"
+#include "sframe.h"
 
 
 /* If C11 is supported, use it's built-in aligned allocation. */
@@ -55,8 +58,308 @@ void* sframe_open_chunk(const char* urlpath, int64_t nchunk, const char* mode, c
   return fp;
 }
 
+/* Open directory/nsegment.segment with 8 zeros of padding */
+void* sframe_open_segment(const char* urlpath, int64_t nsegment, const char* mode, const blosc2_io *io) {
+  void* fp = NULL;
+  char* segment_path = malloc(strlen(urlpath) + 1 + 8 + strlen(".segment") + 1);
+  if (segment_path) {
+    sprintf(segment_path, "%s/%08X.segment", urlpath, (unsigned int)nsegment);
+    blosc2_io_cb *io_cb = blosc2_get_io_cb(io->id);
+    if (io_cb == NULL) {
+      BLOSC_TRACE_ERROR("Error getting the input/output API");
+      return NULL;
+    }
+    fp = io_cb->open(segment_path, mode, io->params);
+    free(segment_path);
+  }
+  return fp;
+}
+
+/* Open the log with the locations of the chunks inside the segment files */
+static void* sframe_open_segments_index(const char* urlpath, const char* mode, const blosc2_io *io) {
+  void* fp = NULL;
+  char* index_path = malloc(strlen(urlpath) + strlen("/segments.b2index") + 1);
+  if (index_path) {
+    sprintf(index_path, "%s/segments.b2index", urlpath);
+    blosc2_io_cb *io_cb = blosc2_get_io_cb(io->id);
+    if (io_cb == NULL) {
+      BLOSC_TRACE_ERROR("Error getting the input/output API");
+      return NULL;
+    }
+    fp = io_cb->open(index_path, mode, io->params);
+    free(index_path);
+  }
+  return fp;
+}
+
+/* Set the location of a chunk id in memory */
+static int set_segment_loc(blosc2_frame_s* frame, int64_t nchunk, int32_t segment, int64_t offset,
+                           int32_t cbytes) {
+  if (nchunk < 0) {
+    BLOSC_TRACE_ERROR("The chunk id (%" PRId64 ") is not correct", nchunk);
+    return BLOSC2_ERROR_INVALID_INDEX;
+  }
+  if (nchunk >= frame->segment_nlocs) {
+    if (nchunk >= INT32_MAX) {
+      BLOSC_TRACE_ERROR("The chunk id (%" PRId64 ") is too large", nchunk);
+      return BLOSC2_ERROR_INVALID_INDEX;
+    }
+    // Grow geometrically, but not beyond the room needed for this chunk id
+    int64_t nlocs = frame->segment_nlocs > 0 ? frame->segment_nlocs * 2 : 64;
+    if (nlocs <= nchunk) {
+      nlocs = nchunk + 1;
+    }
+    sframe_segment_loc* locs = realloc(frame->segment_locs, nlocs * sizeof(sframe_segment_loc));
+    BLOSC_ERROR_NULL(locs, BLOSC2_ERROR_MEMORY_ALLOC);
+    for (int64_t i = frame->segment_nlocs; i < nlocs; i++) {
+      locs[i].segment = -1;
+    }
+    frame->segment_locs = locs;
+    frame->segment_nlocs = nlocs;
+  }
+  sframe_segment_loc* loc = &frame->segment_locs[nchunk];
+  loc->segment = segment;
+  loc->offset = offset;
+  loc->cbytes = cbytes;
+
+  // Keep track of the end of the segments; old copies of chunks count too
+  if (segment > frame->segment_last) {
+    frame->segment_last = segment;
+    frame->segment_len = 0;
+  }
+  if (segment == frame->segment_last && offset + cbytes > frame->segment_len) {
+    frame->segment_len = offset + cbytes;
+  }
+  return 0;
+}
+
+/* Append the new location of a chunk id to the segments index */
+static int append_segment_loc(blosc2_frame_s* frame, int64_t nchunk, int32_t segment, int64_t offset,
+                              int32_t cbytes) {
+  uint8_t record[SFRAME_SEGMENT_RECORD_LEN];
+  to_big(record, &nchunk, sizeof(nchunk));
+  to_big(record + 8, &segment, sizeof(segment));
+  to_big(record + 12, &cbytes, sizeof(cbytes));
+  to_big(record + 16, &offset, sizeof(offset));
+
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  void* fp = sframe_open_segments_index(frame->urlpath, "ab", frame->schunk->storage->io);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Cannot open the segments index.");
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  // Records must stay aligned, so the index cannot have grown behind our back
+  io_cb->seek(fp, 0L, SEEK_END);
+  if (io_cb->tell(fp) != frame->segment_index_len) {
+    BLOSC_TRACE_ERROR("The segments index does not end with a whole record.");
+    io_cb->close(fp);
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+  int64_t wbytes = io_cb->write(record, 1, SFRAME_SEGMENT_RECORD_LEN, fp);
+  io_cb->close(fp);
+  if (wbytes != SFRAME_SEGMENT_RECORD_LEN) {
+    BLOSC_TRACE_ERROR("Cannot write to the segments index.");
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+  frame->segment_index_len += SFRAME_SEGMENT_RECORD_LEN;
+
+  return set_segment_loc(frame, nchunk, segment, offset, cbytes);
+}
+
+/* Start an (empty) segments index for a new sparse frame */
+int sframe_create_segments(blosc2_frame_s* frame, int64_t segment_size) {
+  uint8_t header[SFRAME_SEGMENT_HEADER_LEN];
+  memcpy(header, SFRAME_SEGMENT_MAGIC, 8);
+  to_big(header + 8, &segment_size, sizeof(segment_size));
+
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  void* fp = sframe_open_segments_index(frame->urlpath, "wb", frame->schunk->storage->io);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Cannot create the segments index.");
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  int64_t wbytes = io_cb->write(header, 1, SFRAME_SEGMENT_HEADER_LEN, fp);
+  io_cb->close(fp);
+  if (wbytes != SFRAME_SEGMENT_HEADER_LEN) {
+    BLOSC_TRACE_ERROR("Cannot write to the segments index.");
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+  frame->segment_size = segment_size;
+  frame->segment_index_len = SFRAME_SEGMENT_HEADER_LEN;
+
+  return 0;
+}
+
+/* Load the segments index of a sparse frame */
+int sframe_open_segments(blosc2_frame_s* frame, const blosc2_io *io) {
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  void* fp = sframe_open_segments_index(frame->urlpath, "rb", io);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Cannot open the segments index.");
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  io_cb->seek(fp, 0L, SEEK_END);
+  int64_t index_len = io_cb->tell(fp);
+  if (index_len < SFRAME_SEGMENT_HEADER_LEN) {
+    BLOSC_TRACE_ERROR("The segments index is too short.");
+    io_cb->close(fp);
+    return BLOSC2_ERROR_FILE_READ;
+  }
+  uint8_t* index = malloc(index_len);
+  BLOSC_ERROR_NULL(index, BLOSC2_ERROR_MEMORY_ALLOC);
+  io_cb->seek(fp, 0L, SEEK_SET);
+  int64_t rbytes = io_cb->read(index, 1, index_len, fp);
+  io_cb->close(fp);
+  if (rbytes != index_len || memcmp(index, SFRAME_SEGMENT_MAGIC, 8) != 0) {
+    BLOSC_TRACE_ERROR("Cannot read the segments index.");
+    free(index);
+    return BLOSC2_ERROR_FILE_READ;
+  }
+  from_big(&frame->segment_size, index + 8, sizeof(frame->segment_size));
+
+  // A truncated record at the end (an interrupted append) is dropped, so that the
+  // next appends start at a record boundary
+  int64_t nrecords = (index_len - SFRAME_SEGMENT_HEADER_LEN) / SFRAME_SEGMENT_RECORD_LEN;
+  frame->segment_index_len = SFRAME_SEGMENT_HEADER_LEN + nrecords * SFRAME_SEGMENT_RECORD_LEN;
+  if (frame->segment_index_len != index_len) {
+    fp = sframe_open_segments_index(frame->urlpath, "r+b", io);
+    if (fp == NULL || io_cb->truncate(fp, frame->segment_index_len) != 0) {
+      // The frame can still be read, but appends will fail
+      BLOSC_TRACE_WARNING("Cannot drop the truncated record of the segments index.");
+    }
+    if (fp != NULL) {
+      io_cb->close(fp);
+    }
+  }
+
+  // Replay the log; later locations of a chunk id override the former ones
+  int rc = 0;
+  for (int64_t pos = SFRAME_SEGMENT_HEADER_LEN; pos < frame->segment_index_len;
+       pos += SFRAME_SEGMENT_RECORD_LEN) {
+    int64_t nchunk;
+    int32_t segment;
+    int32_t cbytes;
+    int64_t offset;
+    from_big(&nchunk, index + pos, sizeof(nchunk));
+    from_big(&segment, index + pos + 8, sizeof(segment));
+    from_big(&cbytes, index + pos + 12, sizeof(cbytes));
+    from_big(&offset, index + pos + 16, sizeof(offset));
+    // New chunk ids follow the existing ones, so every id is below the number of records
+    if (nchunk >= nrecords) {
+      BLOSC_TRACE_ERROR("The chunk id (%" PRId64 ") in the segments index is not correct", nchunk);
+      rc = BLOSC2_ERROR_INVALID_INDEX;
+      break;
+    }
+    rc = set_segment_loc(frame, nchunk, segment, offset, cbytes);
+    if (rc < 0) {
+      break;
+    }
+  }
+  free(index);
+
+  return rc;
+}
+
+/* Get the location of a chunk id inside the segment files */
+static int get_segment_loc(blosc2_frame_s* frame, int64_t nchunk, sframe_segment_loc* loc) {
+  if (nchunk < 0 || nchunk >= frame->segment_nlocs || frame->segment_locs[nchunk].segment < 0) {
+    BLOSC_TRACE_ERROR("Chunk id %" PRId64 " is not in the segment files.", nchunk);
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  *loc = frame->segment_locs[nchunk];
+  return 0;
+}
+
+/* Open the file with the data of a chunk, and return where the chunk starts in it */
+void* sframe_open_chunk_data(blosc2_frame_s* frame, int64_t nchunk, int64_t* file_id, int64_t* file_offset) {
+  if (frame->segment_size <= 0) {
+    *file_id = nchunk;
+    *file_offset = 0;
+    return sframe_open_chunk(frame->urlpath, nchunk, "rb", frame->schunk->storage->io);
+  }
+  sframe_segment_loc loc;
+  if (get_segment_loc(frame, nchunk, &loc) < 0) {
+    return NULL;
+  }
+  *file_id = loc.segment;
+  *file_offset = loc.offset;
+  return sframe_open_segment(frame->urlpath, loc.segment, "rb", frame->schunk->storage->io);
+}
+
+/* Close the segment file kept open for reading chunks, if any */
+void sframe_close_segment_fp(blosc2_frame_s* frame) {
+  if (frame->segment_fp != NULL) {
+    frame->segment_fp_io_cb->close(frame->segment_fp);
+    frame->segment_fp = NULL;
+  }
+}
+
+/* Get a segment file open for reading, reusing the one of the former read when possible */
+static void* get_segment_fp(blosc2_frame_s* frame, int32_t segment, blosc2_io_cb* io_cb) {
+  if (frame->segment_fp != NULL && frame->segment_fp_id == segment) {
+    return frame->segment_fp;
+  }
+  sframe_close_segment_fp(frame);
+  frame->segment_fp = sframe_open_segment(frame->urlpath, segment, "rb", frame->schunk->storage->io);
+  frame->segment_fp_id = segment;
+  frame->segment_fp_io_cb = io_cb;
+  return frame->segment_fp;
+}
+
+/* Append a chunk to the last segment file, rolling to a new one when it is full */
+static void* sframe_append_segment_chunk(blosc2_frame_s* frame, uint8_t* chunk, int64_t nchunk, int64_t cbytes) {
+  int32_t segment = frame->segment_last;
+  if (frame->segment_len > 0 && frame->segment_len + cbytes > frame->segment_size) {
+    segment++;
+  }
+  if (frame->segment_fp != NULL && frame->segment_fp_id == segment) {
+    // Backends may not see the data appended through another file (e.g. mmap)
+    sframe_close_segment_fp(frame);
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return NULL;
+  }
+  void* fps = sframe_open_segment(frame->urlpath, segment, "ab", frame->schunk->storage->io);
+  if (fps == NULL) {
+    BLOSC_TRACE_ERROR("Cannot open the segment file.");
+    return NULL;
+  }
+  // The actual end of the file, in case a former append was interrupted
+  io_cb->seek(fps, 0L, SEEK_END);
+  int64_t offset = io_cb->tell(fps);
+  int64_t wbytes = io_cb->write(chunk, 1, cbytes, fps);
+  io_cb->close(fps);
+  if (wbytes != cbytes) {
+    BLOSC_TRACE_ERROR("Cannot write the full chunk.");
+    return NULL;
+  }
+  // The chunk is only visible after its location is in the index
+  if (append_segment_loc(frame, nchunk, segment, offset, (int32_t)cbytes) < 0) {
+    return NULL;
+  }
+
+  return frame;
+}
+
 /* Append an existing chunk into a sparse frame. */
 void* sframe_create_chunk(blosc2_frame_s* frame, uint8_t* chunk, int64_t nchunk, int64_t cbytes) {
+  if (frame->segment_size > 0) {
+    return sframe_append_segment_chunk(frame, chunk, nchunk, cbytes);
+  }
   void* fpc = sframe_open_chunk(frame->urlpath, nchunk, "wb", frame->schunk->storage->io);
   if (fpc == NULL) {
     BLOSC_TRACE_ERROR("Cannot open the chunkfile.");
@@ -77,8 +380,13 @@ void* sframe_create_chunk(blosc2_frame_s* frame, uint8_t* chunk, int64_t nchunk,
   return frame;
 }
 
-/* Append an existing chunk into a sparse frame. */
-int sframe_delete_chunk(const char *urlpath, int64_t nchunk) {
+/* Delete a chunk from a sparse frame. */
+int sframe_delete_chunk(blosc2_frame_s* frame, int64_t nchunk) {
+  if (frame->segment_size > 0) {
+    // Just forget its location; the space in the segment file is not reclaimed
+    return append_segment_loc(frame, nchunk, -1, 0, 0);
+  }
+  const char* urlpath = frame->urlpath;
   char* chunk_path = malloc(strlen(urlpath) + 1 + 8 + strlen(".chunk") + 1);
   if (chunk_path) {
     sprintf(chunk_path, "%s/%08X.chunk", urlpath, (unsigned int)nchunk);
@@ -89,8 +397,48 @@ int sframe_delete_chunk(const char *urlpath, int64_t nchunk) {
   return BLOSC2_ERROR_FILE_REMOVE;
 }
 
+/* Get chunk from a segment file; its length is in the index, so no seek to the end is needed. */
+static int32_t sframe_get_segment_chunk(blosc2_frame_s* frame, int64_t nchunk, uint8_t** chunk, bool* needs_free) {
+  sframe_segment_loc loc;
+  int rc = get_segment_loc(frame, nchunk, &loc);
+  if (rc < 0) {
+    return rc;
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  // Consecutive chunks are usually in the same segment, so its file is kept open
+  void *fps = get_segment_fp(frame, loc.segment, io_cb);
+  if (fps == NULL) {
+    BLOSC_TRACE_ERROR("Cannot open the segment file.");
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+
+  *chunk = malloc((size_t)loc.cbytes);
+  if (*chunk == NULL) {
+    BLOSC_TRACE_ERROR("Cannot allocate memory for the chunk.");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  io_cb->seek(fps, loc.offset, SEEK_SET);
+  int64_t rbytes = io_cb->read(*chunk, 1, loc.cbytes, fps);
+  if (rbytes != loc.cbytes) {
+    BLOSC_TRACE_ERROR("Cannot read the chunk out of the segment file.");
+    free(*chunk);
+    sframe_close_segment_fp(frame);
+    return BLOSC2_ERROR_FILE_READ;
+  }
+  *needs_free = true;
+
+  return loc.cbytes;
+}
+
 /* Get chunk from sparse frame. */
 int32_t sframe_get_chunk(blosc2_frame_s* frame, int64_t nchunk, uint8_t** chunk, bool* needs_free){
+  if (frame->segment_size > 0) {
+    return sframe_get_segment_chunk(frame, nchunk, chunk, needs_free);
+  }
   void *fpc = sframe_open_chunk(frame->urlpath, nchunk, "rb", frame->schunk->storage->io);
   if(fpc == NULL){
     BLOSC_TRACE_ERROR("Cannot open the chunkfile.");
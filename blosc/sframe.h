@@ -11,10 +11,20 @@
 #ifndef BLOSC_SFRAME_H
 #define BLOSC_SFRAME_H
 
+/* The log of chunk locations for sframes packed into segment files */
+#define SFRAME_SEGMENT_MAGIC "b2segidx"
+#define SFRAME_SEGMENT_HEADER_LEN (16)  // magic + segment size
+#define SFRAME_SEGMENT_RECORD_LEN (24)  // chunk id + segment + cbytes + offset
+
 void* sframe_open_index(const char* urlpath, const char* mode, const blosc2_io *io);
 void* sframe_open_chunk(const char* urlpath, int64_t nchunk, const char* mode, const blosc2_io *io);
-int sframe_delete_chunk(const char* urlpath, int64_t nchunk);
+void* sframe_open_segment(const char* urlpath, int64_t nsegment, const char* mode, const blosc2_io *io);
+void* sframe_open_chunk_data(blosc2_frame_s* frame, int64_t nchunk, int64_t* file_id, int64_t* file_offset);
+int sframe_create_segments(blosc2_frame_s* frame, int64_t segment_size);
+int sframe_open_segments(blosc2_frame_s* frame, const blosc2_io *io);
+int sframe_delete_chunk(blosc2_frame_s* frame, int64_t nchunk);
 void* sframe_create_chunk(blosc2_frame_s* frame, uint8_t* chunk, int64_t nchunk, int64_t cbytes);
 int32_t sframe_get_chunk(blosc2_frame_s* frame, int64_t nchunk, uint8_t** chunk, bool* needs_free);
+void sframe_close_segment_fp(blosc2_frame_s* frame);
 
 #endif //BLOSC_SFRAME_H
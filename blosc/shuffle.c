@@ -74,14 +74,6 @@ typedef struct shuffle_implementation {
   bitunshuffle_func bitunshuffle;
 } shuffle_implementation_t;
 
-typedef enum {
-  BLOSC_HAVE_NOTHING = 0,
-  BLOSC_HAVE_SSE2 = 1,
-  BLOSC_HAVE_AVX2 = 2,
-  BLOSC_HAVE_NEON = 4,
-  BLOSC_HAVE_ALTIVEC = 8
-} blosc_cpu_features;
-
 /* Detect hardware and set function pointers to the best shuffle/unshuffle
    implementations supported by the host processor. */
 #if defined(SHUFFLE_USE_AVX2) || defined(SHUFFLE_USE_SSE2)    /* Intel/i686 */
@@ -93,7 +85,7 @@ typedef enum {
     https://lists.fedoraproject.org/archives/list/devel@lists.fedoraproject.org/thread/ZM2L65WIZEEQHHLFERZYD5FAG7QY2OGB/
 */
 #if defined(HAVE_CPU_FEAT_INTRIN) && 0
-static blosc_cpu_features blosc_get_cpu_features(void) {
+blosc_cpu_features blosc_get_cpu_features(void) {
   blosc_cpu_features cpu_features = BLOSC_HAVE_NOTHING;
   if (__builtin_cpu_supports("sse2")) {
     cpu_features |= BLOSC_HAVE_SSE2;
@@ -167,7 +159,7 @@ _xgetbv(uint32_t xcr) {
 #define _XCR_XFEATURE_ENABLED_MASK 0x0
 #endif
 
-static blosc_cpu_features blosc_get_cpu_features(void) {
+blosc_cpu_features blosc_get_cpu_features(void) {
   blosc_cpu_features result = BLOSC_HAVE_NOTHING;
   /* Holds the values of eax, ebx, ecx, edx set by the `cpuid` instruction */
   int32_t cpu_info[4];
@@ -202,7 +194,7 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
       extended control register XCR0 to see if the CPU features are enabled. */
   bool xmm_state_enabled = false;
   bool ymm_state_enabled = false;
-  //bool zmm_state_enabled = false;  // commented this out for avoiding an 'unused variable' warning
+  bool zmm_state_enabled = false;
 
 #if defined(_XCR_XFEATURE_ENABLED_MASK)
   if (xsave_available && xsave_enabled_by_os && (
@@ -217,7 +209,7 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
 
     /*  Require support for both the upper 256-bits of zmm0-zmm15 to be
         restored as well as all of zmm16-zmm31 and the opmask registers. */
-    //zmm_state_enabled = (xcr0_contents & 0x70) == 0x70;
+    zmm_state_enabled = (xcr0_contents & 0xe0) == 0xe0;
   }
 #endif /* defined(_XCR_XFEATURE_ENABLED_MASK) */
 
@@ -234,7 +226,7 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
   printf("XSAVE enabled: %s\n", xsave_enabled_by_os ? "True" : "False");
   printf("XMM state enabled: %s\n", xmm_state_enabled ? "True" : "False");
   printf("YMM state enabled: %s\n", ymm_state_enabled ? "True" : "False");
-  //printf("ZMM state enabled: %s\n", zmm_state_enabled ? "True" : "False");
+  printf("ZMM state enabled: %s\n", zmm_state_enabled ? "True" : "False");
 #endif /* defined(BLOSC_DUMP_CPU_INFO) */
 
   /* Using the gathered CPU information, determine which implementation to use. */
@@ -246,12 +238,15 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
   if (xmm_state_enabled && ymm_state_enabled && avx2_available) {
     result |= BLOSC_HAVE_AVX2;
   }
+  if (xmm_state_enabled && ymm_state_enabled && zmm_state_enabled && avx512bw_available) {
+    result |= BLOSC_HAVE_AVX512;
+  }
   return result;
 }
 #endif /* HAVE_CPU_FEAT_INTRIN */
 
 #elif defined(SHUFFLE_USE_NEON) /* ARM-NEON */
-static blosc_cpu_features blosc_get_cpu_features(void) {
+blosc_cpu_features blosc_get_cpu_features(void) {
   blosc_cpu_features cpu_features = BLOSC_HAVE_NOTHING;
 #if defined(__aarch64__)
   /* aarch64 always has NEON */
@@ -264,7 +259,7 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
   return cpu_features;
 }
 #elif defined(SHUFFLE_USE_ALTIVEC) /* POWER9-ALTIVEC preliminary test*/
-static blosc_cpu_features blosc_get_cpu_features(void) {
+blosc_cpu_features blosc_get_cpu_features(void) {
   blosc_cpu_features cpu_features = BLOSC_HAVE_NOTHING;
   cpu_features |= BLOSC_HAVE_ALTIVEC;
   return cpu_features;
@@ -276,7 +271,7 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
     #warning Hardware-acceleration detection not implemented for the target architecture. Only the generic shuffle/unshuffle routines will be available.
   #endif
 
-static blosc_cpu_features blosc_get_cpu_features(void) {
+blosc_cpu_features blosc_get_cpu_features(void) {
 return BLOSC_HAVE_NOTHING;
 }
 
@@ -45,6 +45,20 @@
 extern "C" {
 #endif
 
+typedef enum {
+  BLOSC_HAVE_NOTHING = 0,
+  BLOSC_HAVE_SSE2 = 1,
+  BLOSC_HAVE_AVX2 = 2,
+  BLOSC_HAVE_NEON = 4,
+  BLOSC_HAVE_ALTIVEC = 8,
+  BLOSC_HAVE_AVX512 = 16
+} blosc_cpu_features;
+
+/**
+  Detect the SIMD instruction sets supported by the host processor.
+*/
+BLOSC_NO_EXPORT blosc_cpu_features blosc_get_cpu_features(void);
+
 /**
   Primary shuffle and bitshuffle routines.
   This function dynamically dispatches to the appropriate hardware-accelerated
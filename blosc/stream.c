@@ -0,0 +1,537 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Streamed frames: contiguous frames that are written and read front to back in
+ * a single pass, so that they can go through pipes and sockets.
+ *
+ * The writer emits the header first, with the frame length, nbytes and cbytes
+ * set to -1 (unknown), then every chunk as it comes (special chunks included),
+ * and, when the stream ends, the chunk of offsets and a trailer whose values are
+ * packed.  Patching these three sizes in the header turns the captured stream
+ * into a regular contiguous frame.
+ *
+ * The reader hands out the chunks as soon as they arrive.  As the number of
+ * chunks is not known in advance, the end is detected by looking at what
+ * follows a chunk that may be the chunk of offsets (8-byte items, one per chunk
+ * read so far): a trailer always starts with 0x94, which is never the first byte
+ * (the format version) of a chunk.
+ */
+
+#include "blosc2.h"
+#include "blosc-private.h"
+#include "frame.h"
+#include "zonemap.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The first byte of a trailer (fixarray with 4 elements) */
+#define STREAM_TRAILER_MARKER (0x90 + 4)
+
+
+struct blosc2_stream_writer_s {
+  blosc2_schunk* schunk;
+  blosc2_stream_write_cb write_cb;
+  void* user_data;
+  int32_t header_len;
+  int64_t cbytes;
+  //!< The size of the chunks written so far.
+  int64_t nchunks;
+  int64_t* offsets;
+  //!< The offsets of the chunks, counted from the end of the header.
+  int64_t offsets_cap;
+  uint8_t* buffer;
+  //!< The buffer for compressing new chunks.
+  int32_t buffer_len;
+};
+
+struct blosc2_stream_reader_s {
+  blosc2_stream_read_cb read_cb;
+  void* user_data;
+  uint8_t* header;
+  int32_t header_len;
+  blosc2_schunk* schunk;
+  //!< The empty super-chunk with the params and metalayers of the stream.
+  uint8_t* chunk;
+  int32_t chunk_cap;
+  int64_t nchunks;
+  int pushback;
+  //!< A byte that has been read ahead, or -1.
+  bool end;
+};
+
+
+static int write_stream(blosc2_stream_writer* writer, const void* ptr, int64_t size) {
+  if (writer->write_cb(ptr, size, writer->user_data) != size) {
+    BLOSC_TRACE_ERROR("Cannot write %" PRId64 " bytes to the stream.", size);
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+static void writer_free(blosc2_stream_writer* writer) {
+  free(writer->offsets);
+  free(writer->buffer);
+  free(writer);
+}
+
+
+blosc2_stream_writer* blosc2_stream_writer_new(blosc2_schunk* schunk, blosc2_stream_write_cb write_cb,
+                                               void* user_data) {
+  if (schunk == NULL || write_cb == NULL) {
+    BLOSC_TRACE_ERROR("A super-chunk and a write callback are needed.");
+    return NULL;
+  }
+  blosc2_stream_writer* writer = calloc(1, sizeof(blosc2_stream_writer));
+  BLOSC_ERROR_NULL(writer, NULL);
+  writer->schunk = schunk;
+  writer->write_cb = write_cb;
+  writer->user_data = user_data;
+
+  uint8_t* header = frame_stream_header(schunk, &writer->header_len);
+  if (header == NULL) {
+    BLOSC_TRACE_ERROR("Cannot create the header of the stream.");
+    writer_free(writer);
+    return NULL;
+  }
+  int rc = write_stream(writer, header, writer->header_len);
+  free(header);
+  if (rc < 0) {
+    writer_free(writer);
+    return NULL;
+  }
+
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    uint8_t* chunk;
+    bool needs_free;
+    rc = blosc2_schunk_get_chunk(schunk, nchunk, &chunk, &needs_free);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot get the chunk %" PRId64 ".", nchunk);
+      writer_free(writer);
+      return NULL;
+    }
+    int64_t nchunks = blosc2_stream_writer_append_chunk(writer, chunk);
+    if (needs_free) {
+      free(chunk);
+    }
+    if (nchunks < 0) {
+      writer_free(writer);
+      return NULL;
+    }
+  }
+
+  return writer;
+}
+
+
+int64_t blosc2_stream_writer_append_chunk(blosc2_stream_writer* writer, uint8_t* chunk) {
+  int32_t cbytes;
+  BLOSC_ERROR(blosc2_cbuffer_sizes(chunk, NULL, &cbytes, NULL));
+
+  if (writer->nchunks == writer->offsets_cap) {
+    int64_t offsets_cap = writer->offsets_cap == 0 ? 64 : 2 * writer->offsets_cap;
+    int64_t* offsets = realloc(writer->offsets, offsets_cap * sizeof(int64_t));
+    BLOSC_ERROR_NULL(offsets, BLOSC2_ERROR_MEMORY_ALLOC);
+    writer->offsets = offsets;
+    writer->offsets_cap = offsets_cap;
+  }
+  BLOSC_ERROR(write_stream(writer, chunk, cbytes));
+  writer->offsets[writer->nchunks] = writer->cbytes;
+  writer->cbytes += cbytes;
+  writer->nchunks++;
+
+  return writer->nchunks;
+}
+
+
+int64_t blosc2_stream_writer_append_buffer(blosc2_stream_writer* writer, const void* src, int32_t nbytes) {
+  if (nbytes < 0 || nbytes > BLOSC2_MAX_BUFFERSIZE) {
+    BLOSC_TRACE_ERROR("The buffer is too large for a chunk.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int32_t buffer_len = nbytes + BLOSC2_MAX_OVERHEAD;
+  if (buffer_len > writer->buffer_len) {
+    uint8_t* buffer = realloc(writer->buffer, buffer_len);
+    BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_MEMORY_ALLOC);
+    writer->buffer = buffer;
+    writer->buffer_len = buffer_len;
+  }
+  int cbytes = blosc2_compress_ctx(writer->schunk->cctx, src, nbytes, writer->buffer, buffer_len);
+  if (cbytes < 0) {
+    BLOSC_TRACE_ERROR("Cannot compress the chunk.");
+    return cbytes;
+  }
+  return blosc2_stream_writer_append_chunk(writer, writer->buffer);
+}
+
+
+static int64_t writer_end(blosc2_stream_writer* writer) {
+  int64_t len = writer->header_len + writer->cbytes;
+
+  // The chunk of offsets is compressed the same way than in regular frames
+  if (writer->nchunks > 0) {
+    int32_t off_nbytes = (int32_t)(writer->nchunks * sizeof(int64_t));
+    uint8_t* off_chunk = malloc(off_nbytes + BLOSC2_MAX_OVERHEAD);
+    BLOSC_ERROR_NULL(off_chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+    blosc2_cparams off_cparams = BLOSC2_CPARAMS_DEFAULTS;
+    off_cparams.typesize = sizeof(int64_t);
+    blosc2_context* cctx = blosc2_create_cctx(off_cparams);
+    int off_cbytes = blosc2_compress_ctx(cctx, writer->offsets, off_nbytes, off_chunk,
+                                         off_nbytes + BLOSC2_MAX_OVERHEAD);
+    blosc2_free_ctx(cctx);
+    if (off_cbytes < 0) {
+      free(off_chunk);
+      return off_cbytes;
+    }
+    int rc = write_stream(writer, off_chunk, off_cbytes);
+    free(off_chunk);
+    BLOSC_ERROR(rc);
+    len += off_cbytes;
+  }
+
+  int64_t trailer_len;
+  uint8_t* trailer = frame_stream_trailer(writer->schunk, &trailer_len);
+  if (trailer == NULL) {
+    BLOSC_TRACE_ERROR("Cannot create the trailer of the stream.");
+    return BLOSC2_ERROR_DATA;
+  }
+  int rc = write_stream(writer, trailer, trailer_len);
+  free(trailer);
+  BLOSC_ERROR(rc);
+
+  return len + trailer_len;
+}
+
+
+int64_t blosc2_stream_writer_end(blosc2_stream_writer* writer) {
+  int64_t len = writer_end(writer);
+  writer_free(writer);
+  return len;
+}
+
+
+int64_t blosc2_schunk_to_stream(blosc2_schunk* schunk, blosc2_stream_write_cb write_cb, void* user_data) {
+  blosc2_stream_writer* writer = blosc2_stream_writer_new(schunk, write_cb, user_data);
+  if (writer == NULL) {
+    return BLOSC2_ERROR_FAILURE;
+  }
+  return blosc2_stream_writer_end(writer);
+}
+
+
+/* Read exactly @p size bytes, unless the stream ends before */
+static int read_stream(blosc2_stream_reader* reader, uint8_t* ptr, int64_t size) {
+  if (size > 0 && reader->pushback >= 0) {
+    *ptr = (uint8_t)reader->pushback;
+    reader->pushback = -1;
+    ptr++;
+    size--;
+  }
+  while (size > 0) {
+    int64_t rbytes = reader->read_cb(ptr, size, reader->user_data);
+    if (rbytes <= 0 || rbytes > size) {
+      BLOSC_TRACE_ERROR("Cannot read from the stream.");
+      return BLOSC2_ERROR_FILE_READ;
+    }
+    ptr += rbytes;
+    size -= rbytes;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Read @p size more bytes at the end of the trailer buffer */
+static int read_trailer(blosc2_stream_reader* reader, uint8_t** trailer, int64_t* trailer_len, int64_t size) {
+  if (size < 0 || *trailer_len + size > INT32_MAX) {
+    BLOSC_TRACE_ERROR("The trailer of the stream is not valid.");
+    return BLOSC2_ERROR_INVALID_HEADER;
+  }
+  uint8_t* trailer_ = realloc(*trailer, (size_t)(*trailer_len + size));
+  BLOSC_ERROR_NULL(trailer_, BLOSC2_ERROR_MEMORY_ALLOC);
+  *trailer = trailer_;
+  BLOSC_ERROR(read_stream(reader, trailer_ + *trailer_len, size));
+  *trailer_len += size;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Parse a trailer whose first byte has been read already, and move its vlmetalayers
+ * into the super-chunk of the reader */
+static int reader_end(blosc2_stream_reader* reader) {
+  uint8_t* trailer = malloc(1);
+  BLOSC_ERROR_NULL(trailer, BLOSC2_ERROR_MEMORY_ALLOC);
+  trailer[0] = STREAM_TRAILER_MARKER;
+  int64_t trailer_len = 1;
+  int rc;
+
+  // Version, array marker and size of the map of offsets, counted from its own marker
+  rc = read_trailer(reader, &trailer, &trailer_len, 5);
+  if (rc < 0 || trailer[2] != 0x90 + 3 || trailer[3] != 0xcd) {
+    goto failed;
+  }
+  uint16_t map_size;
+  from_big(&map_size, trailer + 4, sizeof(map_size));
+  rc = read_trailer(reader, &trailer, &trailer_len, 3 + (int64_t)map_size - trailer_len);
+  if (rc < 0) {
+    goto failed;
+  }
+  // The values
+  rc = read_trailer(reader, &trailer, &trailer_len, 3);
+  if (rc < 0 || trailer[trailer_len - 3] != 0xdc) {
+    goto failed;
+  }
+  int16_t nvlmetalayers;
+  from_big(&nvlmetalayers, trailer + trailer_len - 2, sizeof(nvlmetalayers));
+  if (nvlmetalayers < 0 || nvlmetalayers > BLOSC2_MAX_VLMETALAYERS) {
+    goto failed;
+  }
+  for (int nvlmetalayer = 0; nvlmetalayer < nvlmetalayers; nvlmetalayer++) {
+    rc = read_trailer(reader, &trailer, &trailer_len, 5);
+    if (rc < 0 || trailer[trailer_len - 5] != 0xc6) {
+      goto failed;
+    }
+    int32_t content_len;
+    from_big(&content_len, trailer + trailer_len - 4, sizeof(content_len));
+    rc = read_trailer(reader, &trailer, &trailer_len, content_len);
+    if (rc < 0) {
+      goto failed;
+    }
+  }
+  // The trailer length and the fingerprint
+  rc = read_trailer(reader, &trailer, &trailer_len, FRAME_TRAILER_MINLEN - 2);
+  if (rc < 0 || trailer[trailer_len - FRAME_TRAILER_MINLEN + 2] != 0xce) {
+    goto failed;
+  }
+  uint32_t trailer_len_;
+  from_big(&trailer_len_, trailer + trailer_len - FRAME_TRAILER_MINLEN + 3, sizeof(trailer_len_));
+  if (trailer_len_ != trailer_len) {
+    goto failed;
+  }
+
+  blosc2_schunk* schunk = frame_stream_to_schunk(reader->header, reader->header_len, trailer, trailer_len);
+  free(trailer);
+  if (schunk == NULL) {
+    BLOSC_TRACE_ERROR("Cannot read the vlmetalayers of the stream.");
+    return BLOSC2_ERROR_INVALID_HEADER;
+  }
+  for (int nvlmetalayer = 0; nvlmetalayer < schunk->nvlmetalayers; nvlmetalayer++) {
+    reader->schunk->vlmetalayers[nvlmetalayer] = schunk->vlmetalayers[nvlmetalayer];
+    schunk->vlmetalayers[nvlmetalayer] = NULL;
+  }
+  reader->schunk->nvlmetalayers = schunk->nvlmetalayers;
+  schunk->nvlmetalayers = 0;
+  blosc2_schunk_free(schunk);
+  reader->end = true;
+  return BLOSC2_ERROR_SUCCESS;
+
+  failed:
+  free(trailer);
+  BLOSC_TRACE_ERROR("The trailer of the stream is not valid.");
+  return rc < 0 ? rc : BLOSC2_ERROR_INVALID_HEADER;
+}
+
+
+blosc2_stream_reader* blosc2_stream_reader_new(blosc2_stream_read_cb read_cb, void* user_data) {
+  if (read_cb == NULL) {
+    BLOSC_TRACE_ERROR("A read callback is needed.");
+    return NULL;
+  }
+  blosc2_stream_reader* reader = calloc(1, sizeof(blosc2_stream_reader));
+  BLOSC_ERROR_NULL(reader, NULL);
+  reader->read_cb = read_cb;
+  reader->user_data = user_data;
+  reader->pushback = -1;
+
+  // The magic number and the header length come first
+  uint8_t start[FRAME_HEADER_LEN + sizeof(int32_t)];
+  if (read_stream(reader, start, sizeof(start)) < 0 ||
+      memcmp(start + FRAME_HEADER_MAGIC, "b2frame\0", 8) != 0) {
+    BLOSC_TRACE_ERROR("The stream does not start with a frame header.");
+    free(reader);
+    return NULL;
+  }
+  from_big(&reader->header_len, start + FRAME_HEADER_LEN, sizeof(reader->header_len));
+  if (reader->header_len < FRAME_HEADER_MINLEN) {
+    BLOSC_TRACE_ERROR("Header length is zero or smaller than min allowed.");
+    free(reader);
+    return NULL;
+  }
+  reader->header = malloc(reader->header_len);
+  if (reader->header == NULL) {
+    free(reader);
+    return NULL;
+  }
+  memcpy(reader->header, start, sizeof(start));
+  if (read_stream(reader, reader->header + sizeof(start), reader->header_len - (int64_t)sizeof(start)) < 0) {
+    blosc2_stream_reader_free(reader);
+    return NULL;
+  }
+
+  // The vlmetalayers are only known at the end, so start with none
+  blosc2_schunk empty = {0};
+  int64_t trailer_len;
+  uint8_t* trailer = frame_stream_trailer(&empty, &trailer_len);
+  if (trailer == NULL) {
+    blosc2_stream_reader_free(reader);
+    return NULL;
+  }
+  reader->schunk = frame_stream_to_schunk(reader->header, reader->header_len, trailer, trailer_len);
+  free(trailer);
+  if (reader->schunk == NULL) {
+    BLOSC_TRACE_ERROR("The header of the stream is not valid.");
+    blosc2_stream_reader_free(reader);
+    return NULL;
+  }
+
+  return reader;
+}
+
+
+blosc2_schunk* blosc2_stream_reader_schunk(blosc2_stream_reader* reader) {
+  return reader->schunk;
+}
+
+
+int blosc2_stream_reader_next(blosc2_stream_reader* reader, uint8_t** chunk) {
+  *chunk = NULL;
+  if (reader->end) {
+    return 0;
+  }
+  if (reader->chunk_cap < BLOSC_EXTENDED_HEADER_LENGTH) {
+    reader->chunk = malloc(BLOSC_EXTENDED_HEADER_LENGTH);
+    BLOSC_ERROR_NULL(reader->chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+    reader->chunk_cap = BLOSC_EXTENDED_HEADER_LENGTH;
+  }
+
+  BLOSC_ERROR(read_stream(reader, reader->chunk, 1));
+  if (reader->chunk[0] == STREAM_TRAILER_MARKER) {
+    // Only a stream without chunks has no chunk of offsets before the trailer
+    if (reader->nchunks > 0) {
+      BLOSC_TRACE_ERROR("The chunk of offsets of the stream is missing.");
+      return BLOSC2_ERROR_INVALID_HEADER;
+    }
+    BLOSC_ERROR(reader_end(reader));
+    return 0;
+  }
+
+  BLOSC_ERROR(read_stream(reader, reader->chunk + 1, BLOSC_MIN_HEADER_LENGTH - 1));
+  int32_t nbytes;
+  int32_t cbytes;
+  BLOSC_ERROR(blosc2_cbuffer_sizes(reader->chunk, &nbytes, &cbytes, NULL));
+  if (cbytes < BLOSC_MIN_HEADER_LENGTH || cbytes > BLOSC2_MAX_BUFFERSIZE + BLOSC2_MAX_OVERHEAD) {
+    BLOSC_TRACE_ERROR("The chunk %" PRId64 " of the stream is not valid.", reader->nchunks);
+    return BLOSC2_ERROR_INVALID_HEADER;
+  }
+  if (cbytes > reader->chunk_cap) {
+    uint8_t* chunk_ = realloc(reader->chunk, cbytes);
+    BLOSC_ERROR_NULL(chunk_, BLOSC2_ERROR_MEMORY_ALLOC);
+    reader->chunk = chunk_;
+    reader->chunk_cap = cbytes;
+  }
+  BLOSC_ERROR(read_stream(reader, reader->chunk + BLOSC_MIN_HEADER_LENGTH, cbytes - BLOSC_MIN_HEADER_LENGTH));
+
+  // A chunk that looks like the chunk of offsets is the last one if a trailer follows
+  if (reader->nchunks > 0 && reader->chunk[BLOSC2_CHUNK_TYPESIZE] == sizeof(int64_t) &&
+      nbytes == reader->nchunks * (int64_t)sizeof(int64_t)) {
+    uint8_t next;
+    BLOSC_ERROR(read_stream(reader, &next, 1));
+    if (next == STREAM_TRAILER_MARKER) {
+      BLOSC_ERROR(reader_end(reader));
+      return 0;
+    }
+    reader->pushback = next;
+  }
+
+  reader->nchunks++;
+  *chunk = reader->chunk;
+  return cbytes;
+}
+
+
+void blosc2_stream_reader_free(blosc2_stream_reader* reader) {
+  if (reader->schunk != NULL) {
+    blosc2_schunk_free(reader->schunk);
+  }
+  free(reader->header);
+  free(reader->chunk);
+  free(reader);
+}
+
+
+blosc2_schunk* blosc2_schunk_from_stream(blosc2_stream_read_cb read_cb, void* user_data,
+                                         blosc2_storage* storage) {
+  blosc2_stream_reader* reader = blosc2_stream_reader_new(read_cb, user_data);
+  if (reader == NULL) {
+    return NULL;
+  }
+  blosc2_schunk* stream_schunk = reader->schunk;
+
+  blosc2_cparams* cparams;
+  blosc2_dparams* dparams;
+  blosc2_schunk_get_cparams(stream_schunk, &cparams);
+  blosc2_schunk_get_dparams(stream_schunk, &dparams);
+  blosc2_storage storage_ = storage != NULL ? *storage : BLOSC2_STORAGE_DEFAULTS;
+  storage_.cparams = cparams;
+  storage_.dparams = dparams;
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage_);
+  free(cparams);
+  free(dparams);
+  if (schunk == NULL) {
+    blosc2_stream_reader_free(reader);
+    return NULL;
+  }
+
+  for (int nmetalayer = 0; nmetalayer < stream_schunk->nmetalayers; nmetalayer++) {
+    blosc2_metalayer* metalayer = stream_schunk->metalayers[nmetalayer];
+    if (blosc2_meta_add(schunk, metalayer->name, metalayer->content, metalayer->content_len) < 0) {
+      goto failed;
+    }
+  }
+
+  uint8_t* chunk;
+  int cbytes;
+  while ((cbytes = blosc2_stream_reader_next(reader, &chunk)) > 0) {
+    if (blosc2_schunk_append_chunk(schunk, chunk, true) < 0) {
+      goto failed;
+    }
+  }
+  if (cbytes < 0) {
+    goto failed;
+  }
+
+  // The zone map of the stream, if any, does not describe chunks added already compressed
+  for (int nvlmetalayer = 0; nvlmetalayer < stream_schunk->nvlmetalayers; nvlmetalayer++) {
+    char* name = stream_schunk->vlmetalayers[nvlmetalayer]->name;
+    if (strcmp(name, ZONEMAP_VLMETA_NAME) == 0) {
+      continue;
+    }
+    uint8_t* content;
+    int32_t content_len;
+    if (blosc2_vlmeta_get(stream_schunk, name, &content, &content_len) < 0) {
+      goto failed;
+    }
+    int rc = blosc2_vlmeta_add(schunk, name, content, content_len, NULL);
+    free(content);
+    if (rc < 0) {
+      goto failed;
+    }
+  }
+
+  blosc2_stream_reader_free(reader);
+  return schunk;
+
+  failed:
+  BLOSC_TRACE_ERROR("Cannot read the super-chunk from the stream.");
+  blosc2_schunk_free(schunk);
+  blosc2_stream_reader_free(reader);
+  return NULL;
+}
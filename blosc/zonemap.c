@@ -0,0 +1,672 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Zone maps: summary statistics (min, max, sum and NaN count) of the chunks
+ * and blocks of a super-chunk, so that queries can skip the ones that cannot
+ * hold items in a range without decompressing them.
+ *
+ * The statistics of every block are computed by blosc_c() while the block is
+ * being compressed, and the ones of the blocks that were not (memcpyed chunks)
+ * at the end of the compression.  The super-chunk keeps one entry per chunk in
+ * memory, and zonemap_flush() writes all of them to the "b2zonemap"
+ * variable-length metalayer when the super-chunk is freed, serialized or
+ * committed.  Chunk mutations only update the entries; the first one after a
+ * flush also replaces the stored map by a header that matches no chunks (it
+ * goes with the trailer of the mutation), so that a frame that is not closed
+ * properly loses its statistics instead of keeping outdated ones.
+ */
+
+#include "zonemap.h"
+#include "context.h"
+#include "frame.h"
+#include "blosc-private.h"
+
+#include <float.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Largest magnitude below which every 64-bit integer is a double */
+#define ZONEMAP_EXACT_INT (9007199254740992.)
+
+
+bool zonemap_check_kind(uint8_t kind, int32_t typesize) {
+  switch (kind) {
+    case BLOSC2_ZONEMAP_INT:
+    case BLOSC2_ZONEMAP_UINT:
+      return typesize == 1 || typesize == 2 || typesize == 4 || typesize == 8;
+    case BLOSC2_ZONEMAP_FLOAT:
+      return typesize == 4 || typesize == 8;
+    default:
+      return false;
+  }
+}
+
+
+static void stats_init(blosc2_zonemap_stats* stats) {
+  stats->min = INFINITY;
+  stats->max = -INFINITY;
+  stats->sum = 0;
+  stats->nnans = 0;
+  stats->nitems = 0;
+}
+
+
+static void stats_merge(blosc2_zonemap_stats* stats, const blosc2_zonemap_stats* other) {
+  if (other->min < stats->min) {
+    stats->min = other->min;
+  }
+  if (other->max > stats->max) {
+    stats->max = other->max;
+  }
+  stats->sum += other->sum;
+  stats->nnans += other->nnans;
+  stats->nitems += other->nitems;
+}
+
+
+/* Whether the statistics do not rule out items in [min, max] */
+static bool stats_overlap(const blosc2_zonemap_stats* stats, double min, double max) {
+  return stats->nitems > stats->nnans && stats->min <= max && stats->max >= min;
+}
+
+
+/* Items are read with memcpy as blocks of user buffers may not be aligned */
+#define ZONEMAP_KERNEL(name, type, isfloat)                                         \
+static void name(const uint8_t* src, int32_t nitems, blosc2_zonemap_stats* stats) { \
+  type vmin = 0, vmax = 0;                                                          \
+  double sum = 0;                                                                   \
+  int64_t nnans = 0;                                                                \
+  bool empty = true;                                                                \
+  for (int32_t i = 0; i < nitems; i++) {                                            \
+    type v;                                                                         \
+    memcpy(&v, src + (size_t)i * sizeof(type), sizeof(type));                       \
+    if ((isfloat) && v != v) {                                                      \
+      nnans++;                                                                      \
+      continue;                                                                     \
+    }                                                                               \
+    if (empty) {                                                                    \
+      vmin = vmax = v;                                                              \
+      empty = false;                                                                \
+    }                                                                               \
+    else if (v < vmin) {                                                            \
+      vmin = v;                                                                     \
+    }                                                                               \
+    else if (v > vmax) {                                                            \
+      vmax = v;                                                                     \
+    }                                                                               \
+    sum += (double)v;                                                               \
+  }                                                                                 \
+  stats_init(stats);                                                                \
+  if (!empty) {                                                                     \
+    stats->min = (double)vmin;                                                      \
+    stats->max = (double)vmax;                                                      \
+  }                                                                                 \
+  stats->sum = sum;                                                                 \
+  stats->nnans = nnans;                                                             \
+  stats->nitems = nitems;                                                           \
+}
+
+ZONEMAP_KERNEL(stats_int8, int8_t, false)
+ZONEMAP_KERNEL(stats_int16, int16_t, false)
+ZONEMAP_KERNEL(stats_int32, int32_t, false)
+ZONEMAP_KERNEL(stats_int64, int64_t, false)
+ZONEMAP_KERNEL(stats_uint8, uint8_t, false)
+ZONEMAP_KERNEL(stats_uint16, uint16_t, false)
+ZONEMAP_KERNEL(stats_uint32, uint32_t, false)
+ZONEMAP_KERNEL(stats_uint64, uint64_t, false)
+ZONEMAP_KERNEL(stats_float, float, true)
+ZONEMAP_KERNEL(stats_double, double, true)
+
+
+static void compute_stats(uint8_t kind, int32_t typesize, const uint8_t* src, int32_t nbytes,
+                          blosc2_zonemap_stats* stats) {
+  int32_t nitems = nbytes / typesize;
+  switch (kind * 16 + typesize) {
+    case BLOSC2_ZONEMAP_INT * 16 + 1: stats_int8(src, nitems, stats); break;
+    case BLOSC2_ZONEMAP_INT * 16 + 2: stats_int16(src, nitems, stats); break;
+    case BLOSC2_ZONEMAP_INT * 16 + 4: stats_int32(src, nitems, stats); break;
+    case BLOSC2_ZONEMAP_INT * 16 + 8: stats_int64(src, nitems, stats); break;
+    case BLOSC2_ZONEMAP_UINT * 16 + 1: stats_uint8(src, nitems, stats); break;
+    case BLOSC2_ZONEMAP_UINT * 16 + 2: stats_uint16(src, nitems, stats); break;
+    case BLOSC2_ZONEMAP_UINT * 16 + 4: stats_uint32(src, nitems, stats); break;
+    case BLOSC2_ZONEMAP_UINT * 16 + 8: stats_uint64(src, nitems, stats); break;
+    case BLOSC2_ZONEMAP_FLOAT * 16 + 4: stats_float(src, nitems, stats); break;
+    case BLOSC2_ZONEMAP_FLOAT * 16 + 8: stats_double(src, nitems, stats); break;
+    default: stats_init(stats); return;
+  }
+  if (kind != BLOSC2_ZONEMAP_FLOAT && typesize == 8) {
+    // Keep the bounds as bounds when the conversion has rounded them
+    if (fabs(stats->min) > ZONEMAP_EXACT_INT) {
+      stats->min -= fabs(stats->min) * DBL_EPSILON;
+    }
+    if (fabs(stats->max) > ZONEMAP_EXACT_INT) {
+      stats->max += fabs(stats->max) * DBL_EPSILON;
+    }
+  }
+}
+
+
+/* Prepare the context for computing the statistics of the chunk being compressed */
+int zonemap_ctx_start(blosc2_context* context) {
+  context->zonemap_valid = false;
+  if (context->zonemap == BLOSC2_ZONEMAP_NONE) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  // The items seen by the codec are not the ones in src with a prefilter
+  if (context->prefilter != NULL || !zonemap_check_kind(context->zonemap, context->typesize) ||
+      context->sourcesize % context->typesize != 0 || context->blocksize % context->typesize != 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (context->nblocks > context->zonemap_nstats) {
+    blosc2_zonemap_stats* stats = realloc(context->zonemap_stats,
+                                          context->nblocks * sizeof(blosc2_zonemap_stats));
+    BLOSC_ERROR_NULL(stats, BLOSC2_ERROR_MEMORY_ALLOC);
+    context->zonemap_stats = stats;
+    context->zonemap_nstats = context->nblocks;
+  }
+  for (int32_t i = 0; i < context->nblocks; i++) {
+    context->zonemap_stats[i].nitems = -1;
+  }
+  context->zonemap_valid = true;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Compute the statistics of the block at `offset` (called by every thread) */
+void zonemap_block_stats(blosc2_context* context, const uint8_t* src, int32_t offset, int32_t bsize) {
+  if (!context->zonemap_valid) {
+    return;
+  }
+  compute_stats(context->zonemap, context->typesize, src + offset, bsize,
+                &context->zonemap_stats[offset / context->blocksize]);
+}
+
+
+/* Compute the statistics of the blocks that did not go through blosc_c() */
+void zonemap_ctx_finish(blosc2_context* context) {
+  if (!context->zonemap_valid) {
+    return;
+  }
+  for (int32_t i = 0; i < context->nblocks; i++) {
+    if (context->zonemap_stats[i].nitems >= 0) {
+      continue;
+    }
+    int32_t bsize = context->blocksize;
+    if (i == context->nblocks - 1 && context->leftover > 0) {
+      bsize = context->leftover;
+    }
+    zonemap_block_stats(context, context->src, i * context->blocksize, bsize);
+  }
+}
+
+
+int zonemap_entry_from_ctx(blosc2_context* context, zonemap_entry* entry) {
+  memset(entry, 0, sizeof(zonemap_entry));
+  if (!context->zonemap_valid) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  entry->blocks = malloc(context->nblocks * sizeof(blosc2_zonemap_stats));
+  BLOSC_ERROR_NULL(entry->blocks, BLOSC2_ERROR_MEMORY_ALLOC);
+  memcpy(entry->blocks, context->zonemap_stats, context->nblocks * sizeof(blosc2_zonemap_stats));
+  entry->nblocks = context->nblocks;
+  stats_init(&entry->chunk);
+  for (int32_t i = 0; i < entry->nblocks; i++) {
+    stats_merge(&entry->chunk, &entry->blocks[i]);
+  }
+  entry->valid = true;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+void zonemap_entry_free(zonemap_entry* entry) {
+  free(entry->blocks);
+  memset(entry, 0, sizeof(zonemap_entry));
+}
+
+
+int zonemap_new(blosc2_schunk* schunk, uint8_t kind) {
+  struct blosc2_zonemap* zonemap = calloc(1, sizeof(struct blosc2_zonemap));
+  BLOSC_ERROR_NULL(zonemap, BLOSC2_ERROR_MEMORY_ALLOC);
+  zonemap->kind = kind;
+  zonemap->typesize = schunk->typesize;
+  // Chunks that are already there have no statistics
+  zonemap->capacity = schunk->nchunks > 0 ? schunk->nchunks : 1;
+  zonemap->entries = calloc((size_t)zonemap->capacity, sizeof(zonemap_entry));
+  if (zonemap->entries == NULL) {
+    free(zonemap);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  zonemap->nentries = schunk->nchunks;
+  // A map of the previous kind may be stored yet
+  zonemap->stored = blosc2_vlmeta_exists(schunk, ZONEMAP_VLMETA_NAME) >= 0;
+  zonemap_free(schunk);
+  schunk_private(schunk)->zonemap = zonemap;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+void zonemap_free(blosc2_schunk* schunk) {
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  if (zonemap == NULL) {
+    return;
+  }
+  for (int64_t i = 0; i < zonemap->nentries; i++) {
+    zonemap_entry_free(&zonemap->entries[i]);
+  }
+  free(zonemap->entries);
+  free(zonemap);
+  schunk_private(schunk)->zonemap = NULL;
+}
+
+
+static int check_nchunk(struct blosc2_zonemap* zonemap, int64_t nchunk, int64_t nentries) {
+  if (nchunk < 0 || nchunk >= nentries) {
+    BLOSC_TRACE_ERROR("nchunk ('%" PRId64 "') exceeds the zone map entries ('%" PRId64 "')",
+                      nchunk, zonemap->nentries);
+    return BLOSC2_ERROR_INVALID_INDEX;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Add the entry of a new chunk at `nchunk`, moving `entry` (if not NULL) into it */
+int zonemap_insert(blosc2_schunk* schunk, int64_t nchunk, zonemap_entry* entry) {
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  if (zonemap == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  BLOSC_ERROR(check_nchunk(zonemap, nchunk, zonemap->nentries + 1));
+  if (zonemap->nentries == zonemap->capacity) {
+    zonemap_entry* entries = realloc(zonemap->entries, 2 * zonemap->capacity * sizeof(zonemap_entry));
+    BLOSC_ERROR_NULL(entries, BLOSC2_ERROR_MEMORY_ALLOC);
+    zonemap->entries = entries;
+    zonemap->capacity *= 2;
+  }
+  memmove(&zonemap->entries[nchunk + 1], &zonemap->entries[nchunk],
+          (zonemap->nentries - nchunk) * sizeof(zonemap_entry));
+  memset(&zonemap->entries[nchunk], 0, sizeof(zonemap_entry));
+  if (entry != NULL) {
+    zonemap->entries[nchunk] = *entry;
+    memset(entry, 0, sizeof(zonemap_entry));
+  }
+  zonemap->nentries++;
+  zonemap->persisted = false;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Exchange the entry of a chunk that is replaced with `entry` (so that it can be undone) */
+int zonemap_swap(blosc2_schunk* schunk, int64_t nchunk, zonemap_entry* entry) {
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  if (zonemap == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  BLOSC_ERROR(check_nchunk(zonemap, nchunk, zonemap->nentries));
+  zonemap_entry old = zonemap->entries[nchunk];
+  zonemap->entries[nchunk] = *entry;
+  *entry = old;
+  zonemap->persisted = false;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Remove the entry of a chunk, moving it into `entry` (if not NULL) */
+int zonemap_delete(blosc2_schunk* schunk, int64_t nchunk, zonemap_entry* entry) {
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  if (zonemap == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  BLOSC_ERROR(check_nchunk(zonemap, nchunk, zonemap->nentries));
+  if (entry != NULL) {
+    *entry = zonemap->entries[nchunk];
+  }
+  else {
+    zonemap_entry_free(&zonemap->entries[nchunk]);
+  }
+  memmove(&zonemap->entries[nchunk], &zonemap->entries[nchunk + 1],
+          (zonemap->nentries - nchunk - 1) * sizeof(zonemap_entry));
+  zonemap->nentries--;
+  zonemap->persisted = false;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Move the entries the same way as blosc2_schunk_reorder_offsets() moves the chunks
+ * (or the other way around if `undo`) */
+int zonemap_reorder(blosc2_schunk* schunk, const int64_t* order, bool undo) {
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  if (zonemap == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  zonemap_entry* entries = malloc(zonemap->capacity * sizeof(zonemap_entry));
+  BLOSC_ERROR_NULL(entries, BLOSC2_ERROR_MEMORY_ALLOC);
+  for (int64_t i = 0; i < zonemap->nentries; i++) {
+    if (undo) {
+      entries[order[i]] = zonemap->entries[i];
+    }
+    else {
+      entries[i] = zonemap->entries[order[i]];
+    }
+  }
+  free(zonemap->entries);
+  zonemap->entries = entries;
+  zonemap->persisted = false;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Give `new_schunk` (a copy of `schunk`) the statistics of `schunk` */
+int zonemap_copy(blosc2_schunk* schunk, blosc2_schunk* new_schunk) {
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  if (zonemap == NULL || zonemap->typesize != new_schunk->typesize ||
+      zonemap->nentries != new_schunk->nchunks) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  BLOSC_ERROR(zonemap_new(new_schunk, zonemap->kind));
+  struct blosc2_zonemap* new_zonemap = schunk_private(new_schunk)->zonemap;
+  for (int64_t i = 0; i < zonemap->nentries; i++) {
+    zonemap_entry entry = zonemap->entries[i];
+    if (entry.valid) {
+      entry.blocks = malloc(entry.nblocks * sizeof(blosc2_zonemap_stats));
+      BLOSC_ERROR_NULL(entry.blocks, BLOSC2_ERROR_MEMORY_ALLOC);
+      memcpy(entry.blocks, zonemap->entries[i].blocks, entry.nblocks * sizeof(blosc2_zonemap_stats));
+    }
+    new_zonemap->entries[i] = entry;
+  }
+  new_schunk->cctx->zonemap = zonemap->kind;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+static void serialize_stats(uint8_t* dest, const blosc2_zonemap_stats* stats) {
+  to_big(dest, &stats->min, sizeof(double));
+  to_big(dest + 8, &stats->max, sizeof(double));
+  to_big(dest + 16, &stats->sum, sizeof(double));
+  to_big(dest + 24, &stats->nnans, sizeof(int64_t));
+  to_big(dest + 32, &stats->nitems, sizeof(int64_t));
+}
+
+
+static void deserialize_stats(blosc2_zonemap_stats* stats, const uint8_t* src) {
+  from_big(&stats->min, src, sizeof(double));
+  from_big(&stats->max, src + 8, sizeof(double));
+  from_big(&stats->sum, src + 16, sizeof(double));
+  from_big(&stats->nnans, src + 24, sizeof(int64_t));
+  from_big(&stats->nitems, src + 32, sizeof(int64_t));
+}
+
+
+/* Read the statistics out of the frame metalayer (if any) */
+int zonemap_load(blosc2_schunk* schunk) {
+  if (blosc2_vlmeta_exists(schunk, ZONEMAP_VLMETA_NAME) < 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  uint8_t* content;
+  int32_t content_len;
+  BLOSC_ERROR(blosc2_vlmeta_get(schunk, ZONEMAP_VLMETA_NAME, &content, &content_len));
+  if (content_len < ZONEMAP_HEADER_LEN || content[0] != ZONEMAP_VERSION) {
+    BLOSC_TRACE_WARNING("Ignoring an unsupported zone map.");
+    free(content);
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  uint8_t kind = content[1];
+  int32_t typesize;
+  int64_t nchunks;
+  from_big(&typesize, content + 2, sizeof(int32_t));
+  from_big(&nchunks, content + 6, sizeof(int64_t));
+  if (typesize != schunk->typesize || !zonemap_check_kind(kind, typesize)) {
+    BLOSC_TRACE_WARNING("Ignoring a zone map for other kind of items.");
+    free(content);
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int rc = zonemap_new(schunk, kind);
+  if (rc < 0) {
+    free(content);
+    return rc;
+  }
+  if (schunk->cctx != NULL) {
+    schunk->cctx->zonemap = kind;
+  }
+
+  // Statistics that do not match the chunks are dropped, but new chunks will get them
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  bool valid = nchunks == zonemap->nentries;
+  int64_t pos = ZONEMAP_HEADER_LEN;
+  for (int64_t i = 0; i < nchunks && valid; i++) {
+    zonemap_entry* entry = &zonemap->entries[i];
+    if (pos + 5 > content_len) {
+      valid = false;
+      break;
+    }
+    bool has_stats = content[pos] != 0;
+    int32_t nblocks;
+    from_big(&nblocks, content + pos + 1, sizeof(int32_t));
+    pos += 5;
+    if (!has_stats) {
+      continue;
+    }
+    if (nblocks < 0 || pos + (int64_t)(nblocks + 1) * ZONEMAP_STATS_LEN > content_len) {
+      valid = false;
+      break;
+    }
+    entry->blocks = malloc(nblocks * sizeof(blosc2_zonemap_stats));
+    if (entry->blocks == NULL) {
+      free(content);
+      return BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    entry->nblocks = nblocks;
+    deserialize_stats(&entry->chunk, content + pos);
+    pos += ZONEMAP_STATS_LEN;
+    for (int32_t j = 0; j < nblocks; j++) {
+      deserialize_stats(&entry->blocks[j], content + pos);
+      pos += ZONEMAP_STATS_LEN;
+    }
+    entry->valid = true;
+  }
+  free(content);
+  if (!valid) {
+    if (nchunks >= 0) {
+      BLOSC_TRACE_WARNING("Dropping a zone map that does not match the chunks.");
+    }
+    for (int64_t i = 0; i < zonemap->nentries; i++) {
+      zonemap_entry_free(&zonemap->entries[i]);
+    }
+  }
+  zonemap->persisted = valid;
+  zonemap->stored = nchunks >= 0;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Serialize the statistics into the variable-length metalayer of `schunk` (in memory) */
+static int zonemap_store(blosc2_schunk* schunk) {
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  int64_t content_len = ZONEMAP_HEADER_LEN;
+  for (int64_t i = 0; i < zonemap->nentries; i++) {
+    content_len += 5;
+    if (zonemap->entries[i].valid) {
+      content_len += (int64_t)(zonemap->entries[i].nblocks + 1) * ZONEMAP_STATS_LEN;
+    }
+  }
+  int64_t nentries = zonemap->nentries;
+  if (content_len > BLOSC2_MAX_BUFFERSIZE) {
+    // Leave a header that matches no chunks, so that outdated statistics are not loaded
+    BLOSC_TRACE_WARNING("The zone map is too large to be stored.");
+    content_len = ZONEMAP_HEADER_LEN;
+    nentries = -1;
+  }
+  uint8_t* content = malloc(content_len);
+  BLOSC_ERROR_NULL(content, BLOSC2_ERROR_MEMORY_ALLOC);
+  content[0] = ZONEMAP_VERSION;
+  content[1] = zonemap->kind;
+  to_big(content + 2, &zonemap->typesize, sizeof(int32_t));
+  to_big(content + 6, &nentries, sizeof(int64_t));
+  int64_t pos = ZONEMAP_HEADER_LEN;
+  for (int64_t i = 0; i < nentries; i++) {
+    zonemap_entry* entry = &zonemap->entries[i];
+    content[pos] = entry->valid;
+    to_big(content + pos + 1, &entry->nblocks, sizeof(int32_t));
+    pos += 5;
+    if (!entry->valid) {
+      continue;
+    }
+    serialize_stats(content + pos, &entry->chunk);
+    pos += ZONEMAP_STATS_LEN;
+    for (int32_t j = 0; j < entry->nblocks; j++) {
+      serialize_stats(content + pos, &entry->blocks[j]);
+      pos += ZONEMAP_STATS_LEN;
+    }
+  }
+
+  int rc = vlmeta_stage(schunk, ZONEMAP_VLMETA_NAME, content, (int32_t)content_len, NULL);
+  free(content);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot store the zone map.");
+    return rc;
+  }
+  zonemap->persisted = true;
+  zonemap->stored = nentries >= 0;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Drop the statistics stored in the frame before a chunk mutation makes them outdated */
+int zonemap_invalidate(blosc2_schunk* schunk) {
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (zonemap == NULL || !zonemap->stored || frame == NULL || frame->readonly) {
+    // Super-chunks without a frame store them when serialized (see zonemap_flush())
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  uint8_t content[ZONEMAP_HEADER_LEN];
+  int64_t nentries = -1;
+  content[0] = ZONEMAP_VERSION;
+  content[1] = zonemap->kind;
+  to_big(content + 2, &zonemap->typesize, sizeof(int32_t));
+  to_big(content + 6, &nentries, sizeof(int64_t));
+  int rc = vlmeta_stage(schunk, ZONEMAP_VLMETA_NAME, content, ZONEMAP_HEADER_LEN, NULL);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot invalidate the zone map.");
+    return rc;
+  }
+  zonemap->stored = false;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Write the statistics to the frame metalayer (if they changed) */
+int zonemap_flush(blosc2_schunk* schunk) {
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  if (zonemap == NULL || zonemap->persisted) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame != NULL && frame->readonly) {
+    // Views keep the statistics in memory only
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  frame_lock(frame);
+  int rc = zonemap_store(schunk);
+  if (rc == BLOSC2_ERROR_SUCCESS) {
+    rc = vlmetalayer_flush(schunk);
+  }
+  frame_unlock(frame);
+  return rc;
+}
+
+
+int blosc2_schunk_set_zonemap(blosc2_schunk *schunk, uint8_t kind) {
+  BLOSC_ERROR(frame_check_writable((blosc2_frame_s*)schunk->frame));
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  if (kind == BLOSC2_ZONEMAP_NONE) {
+    zonemap_free(schunk);
+    schunk->cctx->zonemap = BLOSC2_ZONEMAP_NONE;
+    if (blosc2_vlmeta_exists(schunk, ZONEMAP_VLMETA_NAME) < 0) {
+      return BLOSC2_ERROR_SUCCESS;
+    }
+    int rc = blosc2_vlmeta_delete(schunk, ZONEMAP_VLMETA_NAME);
+    return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+  }
+  if (!zonemap_check_kind(kind, schunk->typesize)) {
+    BLOSC_TRACE_ERROR("Zone maps are not supported for this kind of items (typesize %d).", schunk->typesize);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (zonemap != NULL && zonemap->kind == kind) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  BLOSC_ERROR(zonemap_new(schunk, kind));
+  schunk->cctx->zonemap = kind;
+  // Re-opening the frame enables the zone map again
+  return zonemap_flush(schunk);
+}
+
+
+int blosc2_schunk_get_zonemap_stats(blosc2_schunk *schunk, int64_t nchunk,
+                                    blosc2_zonemap_stats *stats) {
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  if (zonemap == NULL) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  BLOSC_ERROR(check_nchunk(zonemap, nchunk, zonemap->nentries));
+  if (!zonemap->entries[nchunk].valid) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  *stats = zonemap->entries[nchunk].chunk;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int64_t blosc2_schunk_zonemap_query(blosc2_schunk *schunk, double min, double max,
+                                    int64_t **nchunks) {
+  *nchunks = NULL;
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  if (zonemap == NULL) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  *nchunks = malloc((zonemap->nentries > 0 ? zonemap->nentries : 1) * sizeof(int64_t));
+  BLOSC_ERROR_NULL(*nchunks, BLOSC2_ERROR_MEMORY_ALLOC);
+  int64_t n = 0;
+  for (int64_t i = 0; i < zonemap->nentries; i++) {
+    zonemap_entry* entry = &zonemap->entries[i];
+    if (!entry->valid || stats_overlap(&entry->chunk, min, max)) {
+      (*nchunks)[n++] = i;
+    }
+  }
+  return n;
+}
+
+
+int blosc2_schunk_zonemap_query_blocks(blosc2_schunk *schunk, int64_t nchunk,
+                                       double min, double max,
+                                       bool **maskout, int32_t *nblocks) {
+  *maskout = NULL;
+  *nblocks = 0;
+  struct blosc2_zonemap* zonemap = schunk_private(schunk)->zonemap;
+  if (zonemap == NULL) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  BLOSC_ERROR(check_nchunk(zonemap, nchunk, zonemap->nentries));
+  zonemap_entry* entry = &zonemap->entries[nchunk];
+  if (!entry->valid) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  *maskout = malloc(entry->nblocks > 0 ? entry->nblocks : 1);
+  BLOSC_ERROR_NULL(*maskout, BLOSC2_ERROR_MEMORY_ALLOC);
+  int ncandidates = 0;
+  for (int32_t i = 0; i < entry->nblocks; i++) {
+    bool overlap = stats_overlap(&entry->blocks[i], min, max);
+    (*maskout)[i] = !overlap;
+    ncandidates += overlap;
+  }
+  *nblocks = entry->nblocks;
+  return ncandidates;
+}
@@ -0,0 +1,70 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#ifndef BLOSC_ZONEMAP_H
+#define BLOSC_ZONEMAP_H
+
+#include "blosc2.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The variable-length metalayer where the zone map of a frame is stored */
+#define ZONEMAP_VLMETA_NAME "b2zonemap"
+#define ZONEMAP_VERSION 1
+#define ZONEMAP_HEADER_LEN (14)  // version + kind + typesize + nchunks
+#define ZONEMAP_STATS_LEN (40)  // min + max + sum + nnans + nitems
+
+/* The statistics of a chunk and its blocks */
+typedef struct {
+  bool valid;  // false when the chunk has no statistics
+  blosc2_zonemap_stats chunk;
+  int32_t nblocks;
+  blosc2_zonemap_stats* blocks;
+} zonemap_entry;
+
+struct blosc2_zonemap {
+  uint8_t kind;  // BLOSC2_ZONEMAP_*
+  int32_t typesize;
+  int64_t nentries;
+  int64_t capacity;
+  zonemap_entry* entries;
+  bool persisted;  // whether the vlmetalayer of the super-chunk describes the current chunks
+  bool stored;  // whether the vlmetalayer holds statistics (which mutations must invalidate)
+};
+
+bool zonemap_check_kind(uint8_t kind, int32_t typesize);
+
+/* Compression side (called from the compression context) */
+int zonemap_ctx_start(blosc2_context* context);
+void zonemap_block_stats(blosc2_context* context, const uint8_t* src, int32_t offset, int32_t bsize);
+void zonemap_ctx_finish(blosc2_context* context);
+int zonemap_entry_from_ctx(blosc2_context* context, zonemap_entry* entry);
+void zonemap_entry_free(zonemap_entry* entry);
+
+/* Super-chunk side (chunk mutations must call zonemap_invalidate() before writing the frame) */
+int zonemap_new(blosc2_schunk* schunk, uint8_t kind);
+void zonemap_free(blosc2_schunk* schunk);
+int zonemap_insert(blosc2_schunk* schunk, int64_t nchunk, zonemap_entry* entry);
+int zonemap_swap(blosc2_schunk* schunk, int64_t nchunk, zonemap_entry* entry);
+int zonemap_delete(blosc2_schunk* schunk, int64_t nchunk, zonemap_entry* entry);
+int zonemap_reorder(blosc2_schunk* schunk, const int64_t* order, bool undo);
+int zonemap_copy(blosc2_schunk* schunk, blosc2_schunk* new_schunk);
+int zonemap_load(blosc2_schunk* schunk);
+int zonemap_invalidate(blosc2_schunk* schunk);
+int zonemap_flush(blosc2_schunk* schunk);
+
+/* Chunk mutations (in schunk.c) that write the statistics of the new chunks along with them */
+int64_t schunk_append_chunks_stats(blosc2_schunk* schunk, uint8_t** chunks, int64_t nchunks, bool copy,
+                                   zonemap_entry* entries);
+int64_t schunk_update_chunk_ctx(blosc2_schunk* schunk, int64_t nchunk, uint8_t* chunk, bool copy,
+                                blosc2_context* cctx);
+
+#endif //BLOSC_ZONEMAP_H
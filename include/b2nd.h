@@ -282,6 +282,9 @@ BLOSC_EXPORT int b2nd_save(const b2nd_array_t *array, char *urlpath);
  * @param buffersize The size (in bytes) of the buffer.
  *
  * @return An error code.
+ *
+ * @note The chunks are gathered from @p buffer and compressed concurrently, using
+ * as many threads as specified in the compression params of @p ctx.
  */
 BLOSC_EXPORT int b2nd_from_cbuffer(b2nd_context_t *ctx, b2nd_array_t **array, const void *buffer, int64_t buffersize);
 
@@ -425,6 +428,10 @@ BLOSC_EXPORT int b2nd_insert(b2nd_array_t *array, const void *buffer, int64_t bu
  * @param axis The axis that will be extended to append the data.
  *
  * @return An error code.
+ *
+ * @note When the array ends at a chunk boundary along @p axis and the new data
+ * only adds chunks at the end of the super-chunk, these are compressed directly
+ * from @p buffer (in parallel) and appended, without touching existing chunks.
  */
 BLOSC_EXPORT int b2nd_append(b2nd_array_t *array, const void *buffer, int64_t buffersize,
                              int8_t axis);
@@ -485,6 +492,75 @@ BLOSC_EXPORT int b2nd_set_orthogonal_selection(b2nd_array_t *array, int64_t **se
                                                int64_t *buffershape, int64_t buffersize);
 
 
+// Iteration section
+
+/* Iterate over the chunks of an array */
+#define B2ND_ITER_CHUNKS 0
+/* Iterate over the blocks of an array */
+#define B2ND_ITER_BLOCKS 1
+
+/**
+ * @brief An iterator over the chunks or blocks of a b2nd array.
+ */
+typedef struct b2nd_iter_s b2nd_iter_t;   /* opaque type */
+
+/**
+ * @brief A piece of an array returned by #b2nd_iter_next.
+ */
+typedef struct {
+  int64_t nchunk;
+  //!< The chunk number where the data lives.
+  int32_t nblock;
+  //!< The block number inside the chunk (-1 when iterating over chunks).
+  int64_t start[B2ND_MAX_DIM];
+  //!< The start coordinates of the piece in the array.
+  int64_t stop[B2ND_MAX_DIM];
+  //!< The stop coordinates (not included) of the piece in the array.
+  int64_t shape[B2ND_MAX_DIM];
+  //!< The shape of the buffer pointed by @p data. Only the first `stop - start` items
+  //!< in each dimension are meaningful; the rest is padding.
+  uint8_t *data;
+  //!< The decompressed data in C order. It is valid until the next call to the iterator.
+} b2nd_iter_item_t;
+
+/**
+ * @brief Create an iterator over the chunks or the blocks of an array.
+ *
+ * The next chunk is fetched and decompressed on a background thread while
+ * the caller is processing the current one.
+ *
+ * @param array The array to iterate over.
+ * @param level Either B2ND_ITER_CHUNKS or B2ND_ITER_BLOCKS.
+ * @param iter The pointer where the iterator will be created.
+ *
+ * @return An error code.
+ *
+ * @note The array must not be modified while the iterator is alive.
+ * The iterator must be released with #b2nd_iter_end.
+ */
+BLOSC_EXPORT int b2nd_iter_begin(const b2nd_array_t *array, int8_t level, b2nd_iter_t **iter);
+
+/**
+ * @brief Get the next piece of an array.
+ *
+ * @param iter The iterator.
+ * @param item The piece of the array (output).
+ *
+ * @return 1 if a new item has been returned, 0 if the iteration is over,
+ * or a negative error code.
+ */
+BLOSC_EXPORT int b2nd_iter_next(b2nd_iter_t *iter, b2nd_iter_item_t *item);
+
+/**
+ * @brief Stop the prefetching thread and free an iterator.
+ *
+ * @param iter The iterator.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_iter_end(b2nd_iter_t *iter);
+
+
 /**
  * @brief Create the metainfo for the b2nd metalayer.
  *
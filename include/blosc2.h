@@ -137,13 +137,18 @@ enum {
      3 -> Blosc 2-alpha.x series
      4 -> Blosc 2.x beta.1 series
      5 -> Blosc 2.x stable series
+     6 -> Blosc 2.x chunks whose blocks form a single ZSTD stream (BLOSC2_ZSTD_CHUNK_WINDOW)
      */
   BLOSC1_VERSION_FORMAT_PRE1 = 1,
   BLOSC1_VERSION_FORMAT = 2,
   BLOSC2_VERSION_FORMAT_ALPHA = 3,
   BLOSC2_VERSION_FORMAT_BETA1 = 4,
   BLOSC2_VERSION_FORMAT_STABLE = 5,
+  BLOSC2_VERSION_FORMAT_ZSTD_WINDOW = 6,
   BLOSC2_VERSION_FORMAT = BLOSC2_VERSION_FORMAT_STABLE,
+  //!< the version of the chunks that do not need any newer feature
+  BLOSC2_VERSION_FORMAT_MAX = BLOSC2_VERSION_FORMAT_ZSTD_WINDOW,
+  //!< the newest version of the chunks that can be read
 };
 
 
@@ -254,6 +259,32 @@ enum {
   BLOSC2_INSTR_CODEC = 0x80,     //!< codec is instrumented (mainly for development)
 };
 
+/**
+ * @brief Flags for the @p compcode_meta of the ZSTD codec
+ */
+enum {
+  BLOSC2_ZSTD_CHUNK_WINDOW = 0x1,  //!< compress the blocks of a chunk as a single ZSTD stream
+  //!< This lets ZSTD (with long distance matching) find matches in previous blocks, improving
+  //!< the ratio for data with long-period repetitions.  In exchange, blocks lose random access:
+  //!< these chunks are always (de)compressed serially and getting any item requires decompressing
+  //!< all the previous blocks.  Not compatible with dicts.  These chunks are marked with
+  //!< @ref BLOSC2_VERSION_FORMAT_ZSTD_WINDOW, so that older readers reject them.
+  BLOSC2_ZSTD_WORKERS = 0x2,  //!< let ZSTD use the spare threads for compressing large blocks
+  //!< When a chunk has fewer blocks (of at least 1 MB) than threads, the spare threads are handed
+  //!< to ZSTD as workers.  Only affects compression; the output is still a regular ZSTD stream.
+};
+
+/**
+ * @brief Flags for the @p compcode_meta of the LZ4, LZ4HC, ZLIB and ZSTD codecs
+ */
+enum {
+  BLOSC2_PROBE_INCOMPRESSIBLE = 0x80,  //!< store the streams that look incompressible as is
+  //!< A sample of every stream is checked before calling the codec, and streams with a flat byte
+  //!< histogram and no repeated 4-byte sequences are not handed to it.  This saves a lot of time
+  //!< for encrypted or already compressed data, but data repeating with a long period (that the
+  //!< sample cannot see) may be stored uncompressed.  Only affects compression.
+};
+
 /**
  * @brief Values for different Blosc2 capabilities
  */
@@ -374,6 +405,18 @@ enum {
 };
 #endif // BLOSC_H
 
+/**
+ * @brief How the items are interpreted when computing zone map statistics.
+ *
+ * Integer items can be 1, 2, 4 or 8 bytes long and floating point ones 4 or 8 bytes long.
+ */
+enum {
+  BLOSC2_ZONEMAP_NONE = 0,   //!< no zone map (default)
+  BLOSC2_ZONEMAP_INT = 1,    //!< signed integers
+  BLOSC2_ZONEMAP_UINT = 2,   //!< unsigned integers
+  BLOSC2_ZONEMAP_FLOAT = 3,  //!< IEEE 754 floating point numbers
+};
+
 /**
  * @brief Offsets for fields in Blosc2 chunk header.
  */
@@ -442,6 +485,7 @@ enum {
   BLOSC2_ERROR_NULL_POINTER = -32,    //!< Pointer is null
   BLOSC2_ERROR_INVALID_INDEX = -33,   //!< Invalid index
   BLOSC2_ERROR_METALAYER_NOT_FOUND = -34,   //!< Metalayer has not been found
+  BLOSC2_ERROR_READ_ONLY = -35,       //!< The super-chunk cannot be modified
 };
 
 
@@ -522,6 +566,8 @@ static char *print_error(int rc) {
       return (char *) "Invalid index";
     case BLOSC2_ERROR_METALAYER_NOT_FOUND:
       return (char *) "Metalayer has not been found";
+    case BLOSC2_ERROR_READ_ONLY:
+      return (char *) "The super-chunk cannot be modified";
     default:
       return (char *) "Unknown error";
   }
@@ -975,7 +1021,9 @@ BLOSC_EXPORT const char* blosc2_cbuffer_complib(const void* cbuffer);
 
 enum {
   BLOSC2_IO_FILESYSTEM = 0,
-  BLOSC_IO_LAST_BLOSC_DEFINED = 1,  // sentinel
+  BLOSC2_IO_URING = 1,  //!< io_uring backend (Linux only); blosc2_get_io_cb() returns NULL if not available
+  BLOSC2_IO_DIRECT = 2,  //!< O_DIRECT writes for large appends (Linux only); same as above
+  BLOSC_IO_LAST_BLOSC_DEFINED = 3,  // sentinel
   BLOSC_IO_LAST_REGISTERED = 32,  // sentinel
 };
 
@@ -992,6 +1040,9 @@ typedef int     (*blosc2_seek_cb)(void *stream, int64_t offset, int whence);
 typedef int64_t (*blosc2_write_cb)(const void *ptr, int64_t size, int64_t nitems, void *stream);
 typedef int64_t (*blosc2_read_cb)(void *ptr, int64_t size, int64_t nitems, void *stream);
 typedef int     (*blosc2_truncate_cb)(void *stream, int64_t size);
+typedef int64_t (*blosc2_read_batch_cb)(void *stream, int32_t nreads, void **ptrs,
+                                        const int64_t *offsets, const int64_t *sizes);
+typedef int     (*blosc2_sync_cb)(void *stream);
 
 
 /*
@@ -1044,6 +1095,23 @@ static const blosc2_io BLOSC2_IO_DEFAULTS = {
  */
 BLOSC_EXPORT int blosc2_register_io_cb(const blosc2_io_cb *io);
 
+/**
+ * @brief Register a user-defined input/output callbacks in Blosc, along with the optional
+ * callbacks that do not fit in #blosc2_io_cb.
+ *
+ * @param io The callbacks API to register.
+ * @param read_batch If not NULL, it reads @p nreads (offset, size) ranges of the stream
+ * into @p ptrs at once, returning the total number of bytes read.  All the blocks needed
+ * out of a lazy chunk are then read with a single call before decompressing them.
+ * @param sync If not NULL, it flushes the stream and makes its contents durable (e.g. with
+ * fsync), returning 0 if succeeds.  It is required by the durable mode (see
+ * blosc2_schunk_set_durable()).
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_register_io_cb_ex(const blosc2_io_cb *io, blosc2_read_batch_cb read_batch,
+                                          blosc2_sync_cb sync);
+
 BLOSC_EXPORT blosc2_io_cb *blosc2_get_io_cb(uint8_t id);
 
 /*********************************************************************
@@ -1690,6 +1758,10 @@ BLOSC_EXPORT blosc2_schunk* blosc2_schunk_new(blosc2_storage *storage);
  * @param schunk The super-chunk to be copied.
  * @param storage The storage properties.
  *
+ * @remark When the compression params are the same, the compressed chunks are
+ * copied verbatim.  Otherwise, chunks are re-encoded using as many threads as
+ * set in `storage->cparams->nthreads`, several chunks at a time.
+ *
  * @return The new super-chunk.
  */
 BLOSC_EXPORT blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_storage *storage);
@@ -1707,12 +1779,40 @@ BLOSC_EXPORT blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_sto
  * blosc2_schunk_free() is called.  If the user frees it after the
  * opening, bad things will happen.  Don't do that (or set @p copy).
  *
+ * @remark If copy is false, nothing is copied nor extracted on opening: chunks
+ * and their offsets are resolved on demand when a chunk is accessed, so the cost
+ * of opening only depends on the sizes of the header and the trailer.  The
+ * super-chunk can be modified, but it never writes to @p cframe: the first
+ * modification makes a private copy of the frame.
+ *
  * @param len The length of the buffer (in bytes).
  *
- * @return The new super-chunk.
+ * @return The new super-chunk, or NULL if the buffer is not a valid frame.
  */
 BLOSC_EXPORT blosc2_schunk* blosc2_schunk_from_buffer(uint8_t *cframe, int64_t len, bool copy);
 
+/**
+ * @brief Open a read-only super-chunk that is a view of a contiguous frame buffer.
+ *
+ * Nothing is copied out of @p cframe: chunks are decompressed straight from it, and
+ * their offsets are resolved on demand into a buffer of bounded size, so the memory
+ * used by the view does not grow with the number of chunks (except for the zone map,
+ * if the frame has one).  As the view never writes to @p cframe, the buffer can live in
+ * memory shared by several processes (e.g. POSIX shared memory mapped as read-only),
+ * each of them opening its own view.  A view is not thread-safe, so every thread
+ * reading concurrently should open its own one too, which is cheap.
+ *
+ * Any attempt to modify the view (chunks or metalayers) fails with
+ * #BLOSC2_ERROR_READ_ONLY.
+ *
+ * @param cframe The buffer of the in-memory frame.  It is still owned by the
+ * caller, and it must not be modified or freed until the view is freed.
+ * @param len The length of the buffer (in bytes).
+ *
+ * @return The new super-chunk, or NULL if the buffer is not a valid frame.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_open_view(const uint8_t *cframe, int64_t len);
+
 /**
  * @brief Set the private `avoid_cframe_free` field in a frame.
  *
@@ -1799,6 +1899,64 @@ BLOSC_EXPORT int64_t blosc2_schunk_append_file(blosc2_schunk* schunk, const char
  */
 BLOSC_EXPORT int blosc2_schunk_free(blosc2_schunk *schunk);
 
+/**
+ * @brief Pack the chunks of a sparse frame into append-only segment files.
+ *
+ * Instead of using one file per chunk, the chunks are appended to segment files
+ * of (roughly) @p segment_size bytes, and their locations are kept in a small
+ * `segments.b2index` log.  This is recorded in the frame, so it lasts when the
+ * super-chunk is re-opened.
+ *
+ * @param schunk The super-chunk.  It must be backed by an on-disk sparse frame without
+ * any chunk yet.
+ * @param segment_size The size of the segment files (e.g. 256 MB).
+ *
+ * @return 0 if success. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_segment_size(blosc2_schunk *schunk, int64_t segment_size);
+
+/**
+ * @brief Enable (or disable) the durable mode (group commit) of a super-chunk.
+ *
+ * In the durable mode, the frame is kept crash-safe by a write-ahead record
+ * (`<urlpath>.wal`) and its mutations are made durable in groups: every commit
+ * syncs the frame to disk and replaces the record.  If the process crashes in the
+ * middle of later mutations, the frame is rolled back to the last commit when
+ * re-opened.
+ *
+ * @param schunk The super-chunk.  It must be backed by a contiguous, on-disk frame whose
+ * io backend has a sync callback (see blosc2_register_io_cb_ex()).
+ * @param commit_interval If > 0, a background thread commits the mutations at most this
+ * many milliseconds after the first one that is not committed yet.
+ * @param commit_size If > 0, a commit happens once this many chunk bytes have been
+ * written since the previous one.  If both parameters are 0, the pending mutations are
+ * committed and the durable mode is disabled.
+ *
+ * @remark Mutations of a super-chunk in durable mode can be done from several threads
+ * (e.g. appenders compressing with their own contexts and calling
+ * blosc2_schunk_append_chunk()), as they are serialized with the commits.  This
+ * function must not run concurrently with them.
+ *
+ * @return 0 if success. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_durable(blosc2_schunk *schunk, int32_t commit_interval,
+                                           int64_t commit_size);
+
+/**
+ * @brief Make all the mutations of a super-chunk durable (commit).
+ *
+ * In the durable mode (see blosc2_schunk_set_durable()), commits happen automatically
+ * once the commit window is exceeded and when the super-chunk is freed; this is for
+ * forcing one (e.g. before acknowledging a write).  When several threads call this
+ * at the same time, their mutations are made durable by the same commit.
+ *
+ * @param schunk The super-chunk to be committed.
+ *
+ * @return 0 if success (or not in durable mode). Else a negative code is returned,
+ * which can also come from a failed commit of the background thread.
+ */
+BLOSC_EXPORT int blosc2_schunk_commit(blosc2_schunk *schunk);
+
 /**
  * @brief Append an existing @p chunk to a super-chunk.
  *
@@ -1812,6 +1970,25 @@ BLOSC_EXPORT int blosc2_schunk_free(blosc2_schunk *schunk);
  */
 BLOSC_EXPORT int64_t blosc2_schunk_append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool copy);
 
+/**
+ * @brief Append several existing @p chunks to a super-chunk in one go.
+ *
+ * This is equivalent to calling #blosc2_schunk_append_chunk for each chunk, but
+ * for frame-backed super-chunks the index of chunks, the header and the trailer
+ * are only updated once, and the chunk payloads are written in a row.
+ *
+ * @param schunk The super-chunk where the chunks will be appended.
+ * @param chunks The array of @p chunks to append.
+ * @param nchunks The number of chunks in @p chunks.
+ * @param copy Whether the chunks should be copied internally or can be used as-is.
+ * If false, the chunks are owned (and eventually freed) by the super-chunk.
+ *
+ * @return The number of chunks in super-chunk. If some problem is
+ * detected, this number will be negative.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_append_chunks(blosc2_schunk *schunk, uint8_t **chunks,
+                                                 int64_t nchunks, bool copy);
+
 /**
   * @brief Update a chunk at a specific position in a super-chunk.
   *
@@ -2018,6 +2195,288 @@ BLOSC_EXPORT int64_t blosc2_schunk_fill_special(blosc2_schunk* schunk, int64_t n
                                             int special_value, int32_t chunksize);
 
 
+/*********************************************************************
+  Functions related with zone maps.
+*********************************************************************/
+
+/**
+ * @brief Summary statistics of the items in a chunk or a block.
+ *
+ * Integers are converted to doubles; 8-byte values that cannot be represented
+ * exactly are rounded outwards, so that @p min and @p max remain bounds.
+ */
+typedef struct {
+  double min;
+  //!< The minimum of the items that are not NaN (+inf if there is none).
+  double max;
+  //!< The maximum of the items that are not NaN (-inf if there is none).
+  double sum;
+  //!< The sum of the items that are not NaN.
+  int64_t nnans;
+  //!< The number of NaN items (always 0 for integers).
+  int64_t nitems;
+  //!< The number of items.
+} blosc2_zonemap_stats;
+
+/**
+ * @brief Enable (or disable) the zone map of a super-chunk.
+ *
+ * While enabled, the statistics of every chunk compressed by the super-chunk (e.g.
+ * with #blosc2_schunk_append_buffer) are computed along with it, and they are
+ * stored in the "b2zonemap" variable-length metalayer of its frame when the
+ * super-chunk is freed, serialized or committed (see #blosc2_schunk_commit).  The
+ * frame drops them on its first chunk mutation after that, so that it never has
+ * outdated ones.  The zone map is enabled again when the frame is re-opened.
+ *
+ * @param schunk The super-chunk.
+ * @param kind The kind of items (#BLOSC2_ZONEMAP_NONE disables the zone map and
+ * removes its statistics).  The chunks that the super-chunk has already have no
+ * statistics.
+ *
+ * @remark This function must not run concurrently with the mutations of the super-chunk.
+ *
+ * @return 0 if succeeds, #BLOSC2_ERROR_INVALID_PARAM if the items of the super-chunk
+ * cannot be of @p kind, else another negative value.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_zonemap(blosc2_schunk *schunk, uint8_t kind);
+
+/**
+ * @brief Get the zone map statistics of a chunk.
+ *
+ * Chunks that were added already compressed (e.g. with #blosc2_schunk_append_chunk),
+ * special chunks and chunks compressed with a prefilter have no statistics.
+ *
+ * @param schunk The super-chunk.
+ * @param nchunk The chunk index.
+ * @param stats The statistics of the chunk.
+ *
+ * @return 0 if succeeds, #BLOSC2_ERROR_NOT_FOUND if the chunk has no statistics,
+ * else another negative value.
+ */
+BLOSC_EXPORT int blosc2_schunk_get_zonemap_stats(blosc2_schunk *schunk, int64_t nchunk,
+                                                 blosc2_zonemap_stats *stats);
+
+/**
+ * @brief Find the chunks that may hold items in the [@p min, @p max] range.
+ *
+ * A chunk is discarded only when its statistics prove that none of its items
+ * are in the range, so chunks without statistics are always returned.
+ *
+ * @param schunk The super-chunk.
+ * @param min The lower bound of the range (inclusive).
+ * @param max The upper bound of the range (inclusive).
+ * @param nchunks The pointer to the (sorted) chunk indices.  It must be freed by the user.
+ *
+ * @return The number of chunk indices, or a negative value if there is an error
+ * (#BLOSC2_ERROR_NOT_FOUND if the super-chunk has no zone map).
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_zonemap_query(blosc2_schunk *schunk, double min, double max,
+                                                 int64_t **nchunks);
+
+/**
+ * @brief Find the blocks of a chunk that may hold items in the [@p min, @p max] range.
+ *
+ * The result is a mask that can be passed to #blosc2_set_maskout so that
+ * only the candidate blocks are decompressed.
+ *
+ * @param schunk The super-chunk.
+ * @param nchunk The chunk index.
+ * @param min The lower bound of the range (inclusive).
+ * @param max The upper bound of the range (inclusive).
+ * @param maskout The pointer to the mask (true for the blocks that cannot hold items in
+ * the range).  It must be freed by the user.
+ * @param nblocks The number of blocks in the chunk.
+ *
+ * @return The number of candidate blocks, or a negative value if there is an error
+ * (#BLOSC2_ERROR_NOT_FOUND if the chunk has no statistics).
+ */
+BLOSC_EXPORT int blosc2_schunk_zonemap_query_blocks(blosc2_schunk *schunk, int64_t nchunk,
+                                                    double min, double max,
+                                                    bool **maskout, int32_t *nblocks);
+
+
+/*********************************************************************
+  Functions related with streamed frames.
+*********************************************************************/
+
+/**
+ * @brief Callback that writes @p size bytes from @p ptr to a stream (e.g. a pipe or a socket).
+ *
+ * @return The number of bytes written; anything other than @p size is an error.
+ */
+typedef int64_t (*blosc2_stream_write_cb)(const void *ptr, int64_t size, void *user_data);
+
+/**
+ * @brief Callback that reads up to @p size bytes from a stream into @p ptr.
+ *
+ * @return The number of bytes read (0 at the end of the stream), or a negative value
+ * if there is an error.  Short reads are fine; the reader will call it again.
+ */
+typedef int64_t (*blosc2_stream_read_cb)(void *ptr, int64_t size, void *user_data);
+
+/**
+ * @brief An opaque writer of streamed frames.
+ */
+typedef struct blosc2_stream_writer_s blosc2_stream_writer;
+
+/**
+ * @brief An opaque reader of streamed frames.
+ */
+typedef struct blosc2_stream_reader_s blosc2_stream_reader;
+
+/**
+ * @brief Start writing a super-chunk as a streamed frame.
+ *
+ * A streamed frame is a contiguous frame that is written front to back in a single
+ * pass, without seeking, so the sizes that are only known at the end are marked as
+ * unknown in the header (see README_CFRAME_FORMAT.rst).  The header and the chunks
+ * already in @p schunk are written right away.
+ *
+ * @param schunk The super-chunk providing the compression params and the metalayers.
+ * It is not modified by the writer and it must outlive it.
+ * @param write_cb The callback for writing to the stream.
+ * @param user_data The data passed to @p write_cb.
+ *
+ * @return The new writer, or NULL if there is an error.
+ */
+BLOSC_EXPORT blosc2_stream_writer* blosc2_stream_writer_new(blosc2_schunk *schunk,
+                                                            blosc2_stream_write_cb write_cb,
+                                                            void *user_data);
+
+/**
+ * @brief Compress a buffer and write it to the stream as a new chunk.
+ *
+ * @param writer The stream writer.
+ * @param src The buffer of data to compress.
+ * @param nbytes The size of the @p src buffer.
+ *
+ * @return The number of chunks written so far, or a negative value if there is an error.
+ */
+BLOSC_EXPORT int64_t blosc2_stream_writer_append_buffer(blosc2_stream_writer *writer,
+                                                        const void *src, int32_t nbytes);
+
+/**
+ * @brief Write an already compressed chunk to the stream.
+ *
+ * @param writer The stream writer.
+ * @param chunk The chunk to write.
+ *
+ * @return The number of chunks written so far, or a negative value if there is an error.
+ */
+BLOSC_EXPORT int64_t blosc2_stream_writer_append_chunk(blosc2_stream_writer *writer, uint8_t *chunk);
+
+/**
+ * @brief Finish the stream and free the writer.
+ *
+ * The index of chunk offsets and the trailer (with the current variable-length
+ * metalayers of the super-chunk) are written, so that the stream can be parsed
+ * as a whole.  The writer is freed even if there is an error.
+ *
+ * @param writer The stream writer.
+ *
+ * @return The total number of bytes written to the stream, or a negative value
+ * if there is an error.
+ */
+BLOSC_EXPORT int64_t blosc2_stream_writer_end(blosc2_stream_writer *writer);
+
+/**
+ * @brief Write a whole super-chunk as a streamed frame.
+ *
+ * @param schunk The super-chunk.
+ * @param write_cb The callback for writing to the stream.
+ * @param user_data The data passed to @p write_cb.
+ *
+ * @return The number of bytes written to the stream, or a negative value if there is an error.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_to_stream(blosc2_schunk *schunk, blosc2_stream_write_cb write_cb,
+                                             void *user_data);
+
+/**
+ * @brief Start reading a streamed frame.
+ *
+ * The header is read right away, so that the compression params and the
+ * fixed-length metalayers are available before any chunk.
+ *
+ * @param read_cb The callback for reading from the stream.
+ * @param user_data The data passed to @p read_cb.
+ *
+ * @return The new reader, or NULL if the stream does not start with a frame header.
+ */
+BLOSC_EXPORT blosc2_stream_reader* blosc2_stream_reader_new(blosc2_stream_read_cb read_cb, void *user_data);
+
+/**
+ * @brief Get the empty super-chunk with the params and metalayers of the stream.
+ *
+ * The variable-length metalayers are only added to it once the end of the stream
+ * has been reached (i.e. blosc2_stream_reader_next() has returned 0).
+ *
+ * @param reader The stream reader.
+ *
+ * @return The super-chunk.  It is owned by the reader.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_stream_reader_schunk(blosc2_stream_reader *reader);
+
+/**
+ * @brief Read the next chunk from the stream.
+ *
+ * @param reader The stream reader.
+ * @param chunk The pointer to the chunk.  It is owned by the reader and it is only
+ * valid until the next call.
+ *
+ * @return The size of the chunk, 0 at the end of the stream, or a negative value
+ * if there is an error.
+ */
+BLOSC_EXPORT int blosc2_stream_reader_next(blosc2_stream_reader *reader, uint8_t **chunk);
+
+/**
+ * @brief Free a stream reader.
+ *
+ * @param reader The stream reader.
+ */
+BLOSC_EXPORT void blosc2_stream_reader_free(blosc2_stream_reader *reader);
+
+/**
+ * @brief Read a whole streamed frame into a new super-chunk.
+ *
+ * @param read_cb The callback for reading from the stream.
+ * @param user_data The data passed to @p read_cb.
+ * @param storage The storage of the new super-chunk (NULL for an in-memory one).  Its
+ * compression params are taken from the stream.
+ *
+ * @return The new super-chunk, or NULL if there is an error.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_from_stream(blosc2_stream_read_cb read_cb, void *user_data,
+                                                      blosc2_storage *storage);
+
+
+/*********************************************************************
+  Functions related with the read-ahead of chunks.
+*********************************************************************/
+
+/**
+ * @brief Enable the read-ahead of chunks for sequential or strided accesses.
+ *
+ * The accesses to the chunks through #blosc2_schunk_decompress_chunk,
+ * #blosc2_schunk_get_chunk and #blosc2_schunk_get_lazychunk are tracked, and once
+ * a few of them in a row have the same stride (1 for sequential accesses, but it can
+ * be any other, including negative ones), a thread reads the next @p nchunks chunks
+ * in that direction in the background.  At most @p nchunks chunks are kept in memory,
+ * and they are dropped when the pattern changes or the super-chunk is modified.
+ *
+ * @param schunk The super-chunk.  It must be backed by a frame (either in memory or
+ * on disk).
+ * @param nchunks The number of chunks to read ahead (0 disables the read-ahead).
+ * @param decompress Whether the thread decompresses the chunks too.  In that case only
+ * #blosc2_schunk_decompress_chunk benefits from the read-ahead.
+ *
+ * @return 0 if succeeds, else a negative value.
+ *
+ * @note As for the rest of functions, a super-chunk must not be used from several
+ * threads at the same time.  The read-ahead is stopped when the super-chunk is freed.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_prefetch(blosc2_schunk *schunk, int32_t nchunks, bool decompress);
+
+
 /*********************************************************************
   Functions related with fixed-length metalayers.
 *********************************************************************/
@@ -2338,11 +2797,37 @@ BLOSC_EXPORT int64_t* blosc2_frame_get_offsets(blosc2_schunk *schunk);
   Structures and functions related with compression codecs.
 *********************************************************************/
 
+/**
+ * @brief Hook creating the state of a codec or filter registered with
+ * blosc2_register_codec_ex() or blosc2_register_filter_ex().
+ *
+ * It is called once per thread context (and not per block) the first time the plugin
+ * is run with a given @p meta, and again after the metalayers of the super-chunk of the
+ * context change.  Exactly one of @p cparams (when compressing) or @p dparams (when
+ * decompressing) is not NULL.  The state stored in @p state is passed afterwards to the
+ * encoder/forward or decoder/backward functions of the plugin.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+typedef int (* blosc2_plugin_init_cb) (uint8_t meta, blosc2_cparams *cparams, blosc2_dparams *dparams,
+                                       void **state);
+
+/**
+ * @brief Hook releasing a state created by a #blosc2_plugin_init_cb.
+ */
+typedef void (* blosc2_plugin_destroy_cb) (void *state);
+
 typedef int (* blosc2_codec_encoder_cb) (const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
             uint8_t meta, blosc2_cparams *cparams, const void* chunk);
 typedef int (* blosc2_codec_decoder_cb) (const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
             uint8_t meta, blosc2_dparams *dparams, const void* chunk);
 
+/* The codec functions receiving the state created by a #blosc2_plugin_init_cb */
+typedef int (* blosc2_codec_encoder_ex_cb) (const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+            uint8_t meta, blosc2_cparams *cparams, const void* chunk, void *state);
+typedef int (* blosc2_codec_decoder_ex_cb) (const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+            uint8_t meta, blosc2_dparams *dparams, const void* chunk, void *state);
+
 typedef struct {
   uint8_t compcode;
   //!< The codec identifier.
@@ -2367,6 +2852,25 @@ typedef struct {
  */
 BLOSC_EXPORT int blosc2_register_codec(blosc2_codec *codec);
 
+/**
+ * @brief Register locally a user-defined codec that keeps a state per thread context.
+ *
+ * The state is created by @p init the first time the codec is run in a thread context
+ * and is passed to @p encoder and @p decoder, which are used instead of the ones
+ * in @p codec (these can be NULL).  It is released with @p destroy.
+ *
+ * @param codec The codec to register.
+ * @param init The hook creating the state.
+ * @param destroy The hook releasing the state (NULL if not needed).
+ * @param encoder The codec encoder that is used during compression.
+ * @param decoder The codec decoder that is used during decompression.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_register_codec_ex(blosc2_codec *codec, blosc2_plugin_init_cb init,
+                                          blosc2_plugin_destroy_cb destroy, blosc2_codec_encoder_ex_cb encoder,
+                                          blosc2_codec_decoder_ex_cb decoder);
+
 
 /*********************************************************************
   Structures and functions related with filters plugins.
@@ -2377,6 +2881,12 @@ typedef int (* blosc2_filter_forward_cb)  (const uint8_t *, uint8_t *, int32_t,
 typedef int (* blosc2_filter_backward_cb) (const uint8_t *, uint8_t *, int32_t, uint8_t, blosc2_dparams *,
                                            uint8_t);
 
+/* The filter functions receiving the state created by a #blosc2_plugin_init_cb */
+typedef int (* blosc2_filter_forward_ex_cb)  (const uint8_t *, uint8_t *, int32_t, uint8_t, blosc2_cparams *,
+                                              uint8_t, void *);
+typedef int (* blosc2_filter_backward_ex_cb) (const uint8_t *, uint8_t *, int32_t, uint8_t, blosc2_dparams *,
+                                              uint8_t, void *);
+
 /**
  * @brief The parameters for a user-defined filter.
  */
@@ -2398,6 +2908,25 @@ typedef struct {
  */
 BLOSC_EXPORT int blosc2_register_filter(blosc2_filter *filter);
 
+/**
+ * @brief Register locally a user-defined filter that keeps a state per thread context.
+ *
+ * The state is created by @p init the first time the filter is run in a thread context
+ * and is passed to @p forward and @p backward, which are used instead of the ones
+ * in @p filter (these can be NULL).  It is released with @p destroy.
+ *
+ * @param filter The filter to register.
+ * @param init The hook creating the state.
+ * @param destroy The hook releasing the state (NULL if not needed).
+ * @param forward The filter function that is used during compression.
+ * @param backward The filter function that is used during decompression.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_register_filter_ex(blosc2_filter *filter, blosc2_plugin_init_cb init,
+                                           blosc2_plugin_destroy_cb destroy, blosc2_filter_forward_ex_cb forward,
+                                           blosc2_filter_backward_ex_cb backward);
+
 /*********************************************************************
   Directory utilities.
 *********************************************************************/
@@ -0,0 +1,43 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+  The direct I/O backend (BLOSC2_IO_DIRECT).  Large writes (i.e. chunks)
+  bypass the page cache with O_DIRECT, while the small, unaligned ones
+  (headers, trailers, indexes and the edges of large writes) are regular
+  buffered writes.  Only available on Linux.
+**********************************************************************/
+
+#ifndef BLOSC_BLOSC2_IO_DIRECT_H
+#define BLOSC_BLOSC2_IO_DIRECT_H
+
+#include <stdint.h>
+#include "blosc2-export.h"
+
+typedef struct {
+  int fd;           // for buffered reads and writes
+  int dfd;          // opened with O_DIRECT; -1 if not supported by the filesystem
+  int64_t pos;
+  int append;
+  uint32_t mem_align;     // the alignment of the memory for direct writes
+  uint32_t offset_align;  // the alignment of the offsets and sizes of direct writes
+  uint8_t *stage;   // aligned buffer for staging writes out of memory not aligned to mem_align
+} blosc2_direct_file;
+
+BLOSC_EXPORT void *blosc2_direct_open(const char *urlpath, const char *mode, void* params);
+BLOSC_EXPORT int blosc2_direct_close(void *stream);
+BLOSC_EXPORT int64_t blosc2_direct_tell(void *stream);
+BLOSC_EXPORT int blosc2_direct_seek(void *stream, int64_t offset, int whence);
+BLOSC_EXPORT int64_t blosc2_direct_write(const void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int64_t blosc2_direct_read(void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int blosc2_direct_truncate(void *stream, int64_t size);
+BLOSC_EXPORT int blosc2_direct_sync(void *stream);
+
+#endif //BLOSC_BLOSC2_IO_DIRECT_H
@@ -0,0 +1,52 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+  The io_uring input/output backend (BLOSC2_IO_URING).  Files are read
+  and written with positional I/O, and batched reads are submitted to
+  an io_uring ring taken from a pool shared by all the streams.  Only
+  available on Linux.
+**********************************************************************/
+
+#ifndef BLOSC_BLOSC2_IO_URING_H
+#define BLOSC_BLOSC2_IO_URING_H
+
+#include <stdint.h>
+#include "blosc2-export.h"
+
+typedef struct {
+  int fd;
+  int64_t pos;
+  int append;
+} blosc2_uring_file;
+
+BLOSC_EXPORT void *blosc2_uring_open(const char *urlpath, const char *mode, void* params);
+BLOSC_EXPORT int blosc2_uring_close(void *stream);
+BLOSC_EXPORT int64_t blosc2_uring_tell(void *stream);
+BLOSC_EXPORT int blosc2_uring_seek(void *stream, int64_t offset, int whence);
+BLOSC_EXPORT int64_t blosc2_uring_write(const void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int64_t blosc2_uring_read(void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int blosc2_uring_truncate(void *stream, int64_t size);
+BLOSC_EXPORT int blosc2_uring_sync(void *stream);
+BLOSC_EXPORT int64_t blosc2_uring_read_batch(void *stream, int32_t nreads, void **ptrs,
+                                             const int64_t *offsets, const int64_t *sizes);
+
+/* Asynchronous batched reads: submit them, wait for any of them (returning the bytes it read)
+   and wait for the rest before releasing the request (returning the total bytes read).  The
+   stream must stay open until blosc2_uring_read_end() returns.  A negative result from it
+   means that reads may still be in flight, so their buffers must not be freed. */
+BLOSC_EXPORT void *blosc2_uring_read_submit(void *stream, int32_t nreads, void **ptrs,
+                                            const int64_t *offsets, const int64_t *sizes);
+BLOSC_EXPORT int64_t blosc2_uring_read_wait(void *request, int32_t nread);
+BLOSC_EXPORT int64_t blosc2_uring_read_end(void *request);
+/* Free the rings kept for reuse */
+BLOSC_EXPORT void blosc2_uring_destroy(void);
+
+#endif //BLOSC_BLOSC2_IO_URING_H
@@ -13,6 +13,10 @@ enum {
     BLOSC_CODEC_ZFP_FIXED_ACCURACY = 33,
     BLOSC_CODEC_ZFP_FIXED_PRECISION = 34,
     BLOSC_CODEC_ZFP_FIXED_RATE = 35,
+    BLOSC_CODEC_FORPACK = 36,
 };
 
+/* Flag for the meta of FORPACK: pack the values themselves instead of their deltas */
+#define FORPACK_NODELTA 0x1U
+
 void register_codecs(void);
@@ -8,6 +8,7 @@
 #include "blosc2/codecs-registry.h"
 #include "ndlz/ndlz.h"
 #include "zfp/blosc2-zfp.h"
+#include "forpack/forpack.h"
 
 void register_codecs(void) {
 
@@ -24,26 +25,35 @@ void register_codecs(void) {
   zfp_acc.compcode = BLOSC_CODEC_ZFP_FIXED_ACCURACY;
   zfp_acc.compver = 1;
   zfp_acc.complib = BLOSC_CODEC_ZFP_FIXED_ACCURACY;
-  zfp_acc.encoder = zfp_acc_compress;
-  zfp_acc.decoder = zfp_acc_decompress;
+  zfp_acc.encoder = NULL;
+  zfp_acc.decoder = NULL;
   zfp_acc.compname = "zfp_acc";
-  register_codec_private(&zfp_acc);
+  register_codec_ex_private(&zfp_acc, zfp_init, zfp_destroy, zfp_acc_compress, zfp_acc_decompress);
 
   blosc2_codec zfp_prec;
   zfp_prec.compcode = BLOSC_CODEC_ZFP_FIXED_PRECISION;
   zfp_prec.compver = 1;
   zfp_prec.complib = BLOSC_CODEC_ZFP_FIXED_PRECISION;
-  zfp_prec.encoder = zfp_prec_compress;
-  zfp_prec.decoder = zfp_prec_decompress;
+  zfp_prec.encoder = NULL;
+  zfp_prec.decoder = NULL;
   zfp_prec.compname = "zfp_prec";
-  register_codec_private(&zfp_prec);
+  register_codec_ex_private(&zfp_prec, zfp_init, zfp_destroy, zfp_prec_compress, zfp_prec_decompress);
 
   blosc2_codec zfp_rate;
   zfp_rate.compcode = BLOSC_CODEC_ZFP_FIXED_RATE;
   zfp_rate.compver = 1;
   zfp_rate.complib = BLOSC_CODEC_ZFP_FIXED_RATE;
-  zfp_rate.encoder = zfp_rate_compress;
-  zfp_rate.decoder = zfp_rate_decompress;
+  zfp_rate.encoder = NULL;
+  zfp_rate.decoder = NULL;
   zfp_rate.compname = "zfp_rate";
-  register_codec_private(&zfp_rate);
+  register_codec_ex_private(&zfp_rate, zfp_init, zfp_destroy, zfp_rate_compress, zfp_rate_decompress);
+
+  blosc2_codec forpack;
+  forpack.compcode = BLOSC_CODEC_FORPACK;
+  forpack.compver = 1;
+  forpack.complib = BLOSC_CODEC_FORPACK;
+  forpack.encoder = forpack_compress;
+  forpack.decoder = forpack_decompress;
+  forpack.compname = "forpack";
+  register_codec_private(&forpack);
 }
@@ -0,0 +1,435 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+  FORPACK: frame-of-reference + bitpacking codec for 4 and 8 byte integers.
+
+  The items of a block are split in miniblocks of FORPACK_MINIBLOCK items.
+  For every miniblock, the minimum of the values (or of their deltas, which
+  is the default) is taken as the reference, and the differences with it are
+  packed with the bits needed by the largest one.  The packed values are
+  interleaved in the lanes of 128-bit words, so that compilers can vectorize
+  the (un)packing loops with SIMD instructions.
+
+  Stream format:
+    flags (1 byte): the typesize and FORPACK_DELTA_FLAG when delta-encoded
+    miniblocks (the last one may be partial), each made of:
+      first item (typesize bytes), only when delta-encoded
+      reference (typesize bytes)
+      width (1 byte): the number of bits per packed value
+      packed values (FORPACK_MINIBLOCK * width / 8 bytes)
+    the trailing bytes that do not make an item, as they are
+**********************************************************************/
+
+#include "forpack.h"
+#include "blosc2/blosc2-common.h"
+#include "blosc2/codecs-registry.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define FORPACK_MINIBLOCK 128
+#define FORPACK_LANES 4    /* lanes of 32-bit words (128 bits) */
+#define FORPACK_LANES64 2  /* lanes of 64-bit words (128 bits) */
+#define FORPACK_DELTA_FLAG 0x80U
+#define FORPACK_TYPESIZE_MASK 0x0FU
+
+
+static inline uint64_t load_item(const uint8_t *ip, int32_t typesize) {
+  if (typesize == 4) {
+    uint32_t value;
+    memcpy(&value, ip, sizeof(value));
+    return value;
+  }
+  uint64_t value;
+  memcpy(&value, ip, sizeof(value));
+  return value;
+}
+
+static inline void store_item(uint8_t *op, uint64_t value, int32_t typesize) {
+  if (typesize == 4) {
+    uint32_t value32 = (uint32_t) value;
+    memcpy(op, &value32, sizeof(value32));
+  }
+  else {
+    memcpy(op, &value, sizeof(value));
+  }
+}
+
+/* The signed value of an item, for getting the references of signed data right */
+static inline int64_t signed_item(uint64_t value, int32_t typesize) {
+  if (typesize == 4) {
+    return (int64_t) (int32_t) (uint32_t) value;
+  }
+  return (int64_t) value;
+}
+
+/* Number of bits needed for representing a value */
+static int bit_width(uint64_t value) {
+  int width = 0;
+  while (value != 0) {
+    width++;
+    value >>= 1;
+  }
+  return width;
+}
+
+
+/* Pack FORPACK_MINIBLOCK values with width bits each.  Value i goes to the lane i % FORPACK_LANES. */
+static void pack32(const uint32_t *values, int width, uint8_t *op) {
+  uint32_t words[FORPACK_LANES * 32] = {0};
+  for (int i = 0; i < FORPACK_MINIBLOCK / FORPACK_LANES; i++) {
+    int bit = i * width;
+    int w = bit / 32;
+    int shift = bit % 32;
+    for (int l = 0; l < FORPACK_LANES; l++) {
+      uint32_t value = values[i * FORPACK_LANES + l];
+      words[w * FORPACK_LANES + l] |= value << shift;
+      if (shift + width > 32) {
+        words[(w + 1) * FORPACK_LANES + l] |= value >> (32 - shift);
+      }
+    }
+  }
+  memcpy(op, words, FORPACK_LANES * width * sizeof(uint32_t));
+}
+
+static void unpack32(const uint8_t *ip, int width, uint32_t *values) {
+  if (width == 0) {
+    memset(values, 0, FORPACK_MINIBLOCK * sizeof(uint32_t));
+    return;
+  }
+  uint32_t words[FORPACK_LANES * 32];
+  memcpy(words, ip, FORPACK_LANES * width * sizeof(uint32_t));
+  uint32_t mask = (width == 32) ? UINT32_MAX : (1U << width) - 1;
+  for (int i = 0; i < FORPACK_MINIBLOCK / FORPACK_LANES; i++) {
+    int bit = i * width;
+    int w = bit / 32;
+    int shift = bit % 32;
+    for (int l = 0; l < FORPACK_LANES; l++) {
+      uint32_t value = words[w * FORPACK_LANES + l] >> shift;
+      if (shift + width > 32) {
+        value |= words[(w + 1) * FORPACK_LANES + l] << (32 - shift);
+      }
+      values[i * FORPACK_LANES + l] = value & mask;
+    }
+  }
+}
+
+static void pack64(const uint64_t *values, int width, uint8_t *op) {
+  uint64_t words[FORPACK_LANES64 * 64] = {0};
+  for (int i = 0; i < FORPACK_MINIBLOCK / FORPACK_LANES64; i++) {
+    int bit = i * width;
+    int w = bit / 64;
+    int shift = bit % 64;
+    for (int l = 0; l < FORPACK_LANES64; l++) {
+      uint64_t value = values[i * FORPACK_LANES64 + l];
+      words[w * FORPACK_LANES64 + l] |= value << shift;
+      if (shift + width > 64) {
+        words[(w + 1) * FORPACK_LANES64 + l] |= value >> (64 - shift);
+      }
+    }
+  }
+  memcpy(op, words, FORPACK_LANES64 * width * sizeof(uint64_t));
+}
+
+static void unpack64(const uint8_t *ip, int width, uint64_t *values) {
+  if (width == 0) {
+    memset(values, 0, FORPACK_MINIBLOCK * sizeof(uint64_t));
+    return;
+  }
+  uint64_t words[FORPACK_LANES64 * 64];
+  memcpy(words, ip, FORPACK_LANES64 * width * sizeof(uint64_t));
+  uint64_t mask = (width == 64) ? UINT64_MAX : (UINT64_C(1) << width) - 1;
+  for (int i = 0; i < FORPACK_MINIBLOCK / FORPACK_LANES64; i++) {
+    int bit = i * width;
+    int w = bit / 64;
+    int shift = bit % 64;
+    for (int l = 0; l < FORPACK_LANES64; l++) {
+      uint64_t value = words[w * FORPACK_LANES64 + l] >> shift;
+      if (shift + width > 64) {
+        value |= words[(w + 1) * FORPACK_LANES64 + l] << (64 - shift);
+      }
+      values[i * FORPACK_LANES64 + l] = value & mask;
+    }
+  }
+}
+
+
+/* Encode nitems (up to FORPACK_MINIBLOCK) items.  Returns the size of the
+   miniblock or 0 if it does not fit in maxout. */
+static int32_t encode_miniblock(const uint8_t *ip, int32_t nitems, int32_t typesize, bool delta,
+                                uint8_t *op, int32_t maxout) {
+  uint64_t mask = (typesize == 4) ? UINT32_MAX : UINT64_MAX;
+  uint64_t values[FORPACK_MINIBLOCK];
+  uint64_t first = load_item(ip, typesize);
+  uint64_t prev = first;
+  for (int32_t i = 0; i < nitems; i++) {
+    uint64_t value = load_item(ip + i * typesize, typesize);
+    values[i] = delta ? (value - prev) & mask : value;
+    prev = value;
+  }
+
+  // The reference is the minimum value; the first delta (always 0) is not taken into account
+  int32_t ifirst = delta ? 1 : 0;
+  int64_t min = 0;
+  int64_t max = 0;
+  if (ifirst < nitems) {
+    min = max = signed_item(values[ifirst], typesize);
+  }
+  for (int32_t i = ifirst + 1; i < nitems; i++) {
+    int64_t value = signed_item(values[i], typesize);
+    if (value < min) {
+      min = value;
+    }
+    if (value > max) {
+      max = value;
+    }
+  }
+  uint64_t ref = (uint64_t) min & mask;
+  int width = bit_width(((uint64_t) max - (uint64_t) min) & mask);
+
+  int32_t csize = (delta ? typesize : 0) + typesize + 1 + FORPACK_MINIBLOCK * width / 8;
+  if (csize > maxout) {
+    return 0;
+  }
+  if (delta) {
+    store_item(op, first, typesize);
+    op += typesize;
+  }
+  store_item(op, ref, typesize);
+  op += typesize;
+  *op++ = (uint8_t) width;
+
+  // The values outside the miniblock are packed as zeros
+  for (int32_t i = 0; i < FORPACK_MINIBLOCK; i++) {
+    values[i] = (i >= ifirst && i < nitems) ? (values[i] - ref) & mask : 0;
+  }
+  if (typesize == 4) {
+    uint32_t values32[FORPACK_MINIBLOCK];
+    for (int i = 0; i < FORPACK_MINIBLOCK; i++) {
+      values32[i] = (uint32_t) values[i];
+    }
+    pack32(values32, width, op);
+  }
+  else {
+    pack64(values, width, op);
+  }
+
+  return csize;
+}
+
+/* The size of the miniblock at ip, or a negative value if it is out of the input */
+static int32_t miniblock_size(const uint8_t *ip, int32_t maxin, int32_t typesize, bool delta) {
+  int32_t header_len = (delta ? typesize : 0) + typesize + 1;
+  if (header_len > maxin) {
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+  int width = ip[header_len - 1];
+  if (width > typesize * 8) {
+    BLOSC_TRACE_ERROR("Invalid width in FORPACK miniblock: %d", width);
+    return BLOSC2_ERROR_DATA;
+  }
+  int32_t csize = header_len + FORPACK_MINIBLOCK * width / 8;
+  if (csize > maxin) {
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+  return csize;
+}
+
+/* Decode the items [start, stop) of the miniblock at ip.  Returns the size of the
+   miniblock or a negative value in case of errors. */
+static int32_t decode_miniblock(const uint8_t *ip, int32_t maxin, int32_t typesize, bool delta,
+                                int32_t start, int32_t stop, uint8_t *op) {
+  int32_t csize = miniblock_size(ip, maxin, typesize, delta);
+  if (csize < 0) {
+    return csize;
+  }
+  uint64_t first = 0;
+  if (delta) {
+    first = load_item(ip, typesize);
+    ip += typesize;
+  }
+  uint64_t ref = load_item(ip, typesize);
+  ip += typesize;
+  int width = *ip++;
+
+  if (typesize == 4) {
+    uint32_t values[FORPACK_MINIBLOCK];
+    unpack32(ip, width, values);
+    uint32_t ref32 = (uint32_t) ref;
+    if (delta) {
+      uint32_t value = (uint32_t) first;
+      values[0] = value;
+      for (int32_t i = 1; i < stop; i++) {
+        value += values[i] + ref32;
+        values[i] = value;
+      }
+    }
+    else {
+      for (int32_t i = start; i < stop; i++) {
+        values[i] += ref32;
+      }
+    }
+    memcpy(op, values + start, (stop - start) * sizeof(uint32_t));
+  }
+  else {
+    uint64_t values[FORPACK_MINIBLOCK];
+    unpack64(ip, width, values);
+    if (delta) {
+      uint64_t value = first;
+      values[0] = value;
+      for (int32_t i = 1; i < stop; i++) {
+        value += values[i] + ref;
+        values[i] = value;
+      }
+    }
+    else {
+      for (int32_t i = start; i < stop; i++) {
+        values[i] += ref;
+      }
+    }
+    memcpy(op, values + start, (stop - start) * sizeof(uint64_t));
+  }
+
+  return csize;
+}
+
+
+int forpack_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                     uint8_t meta, blosc2_cparams *cparams, const void *chunk) {
+  BLOSC_UNUSED_PARAM(chunk);
+
+  int32_t typesize = cparams->typesize;
+  if ((typesize != 4) && (typesize != 8)) {
+    // Let Blosc store the data as is, as for any other incompressible stream
+    BLOSC_TRACE_WARNING("FORPACK is only available for typesizes 4 and 8, not %d", typesize);
+    return 0;
+  }
+  bool delta = !(meta & FORPACK_NODELTA);
+  int32_t nitems = input_len / typesize;
+  int32_t leftover = input_len % typesize;
+
+  if (output_len < 1) {
+    return 0;
+  }
+  uint8_t *op = output;
+  uint8_t *op_limit = output + output_len;
+  *op++ = (uint8_t) typesize | (delta ? FORPACK_DELTA_FLAG : 0);
+
+  for (int32_t i = 0; i < nitems; i += FORPACK_MINIBLOCK) {
+    int32_t n = (nitems - i < FORPACK_MINIBLOCK) ? nitems - i : FORPACK_MINIBLOCK;
+    int32_t csize = encode_miniblock(input + i * typesize, n, typesize, delta, op, (int32_t) (op_limit - op));
+    if (csize == 0) {
+      // Not compressible
+      return 0;
+    }
+    op += csize;
+  }
+
+  if (op_limit - op < leftover) {
+    return 0;
+  }
+  memcpy(op, input + nitems * typesize, leftover);
+  op += leftover;
+
+  return (int) (op - output);
+}
+
+
+/* Read the flags of a stream */
+static int read_flags(const uint8_t *input, int32_t input_len, int32_t *typesize, bool *delta) {
+  if (input_len < 1) {
+    BLOSC_TRACE_ERROR("Empty FORPACK stream");
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+  *typesize = input[0] & FORPACK_TYPESIZE_MASK;
+  *delta = input[0] & FORPACK_DELTA_FLAG;
+  if ((*typesize != 4) && (*typesize != 8)) {
+    BLOSC_TRACE_ERROR("Invalid typesize in FORPACK stream: %d", *typesize);
+    return BLOSC2_ERROR_DATA;
+  }
+  return 1;
+}
+
+int forpack_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                       uint8_t meta, blosc2_dparams *dparams, const void *chunk) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(chunk);
+
+  int32_t typesize;
+  bool delta;
+  int rc = read_flags(input, input_len, &typesize, &delta);
+  if (rc < 0) {
+    return rc;
+  }
+  int32_t nitems = output_len / typesize;
+  int32_t leftover = output_len % typesize;
+  const uint8_t *ip = input + 1;
+  const uint8_t *ip_limit = input + input_len;
+
+  for (int32_t i = 0; i < nitems; i += FORPACK_MINIBLOCK) {
+    int32_t n = (nitems - i < FORPACK_MINIBLOCK) ? nitems - i : FORPACK_MINIBLOCK;
+    int32_t csize = decode_miniblock(ip, (int32_t) (ip_limit - ip), typesize, delta, 0, n,
+                                     output + i * typesize);
+    if (csize < 0) {
+      return csize;
+    }
+    ip += csize;
+  }
+
+  if (ip_limit - ip != leftover) {
+    BLOSC_TRACE_ERROR("FORPACK stream does not match the output size");
+    return BLOSC2_ERROR_DATA;
+  }
+  memcpy(output + nitems * typesize, ip, leftover);
+
+  return output_len;
+}
+
+
+int forpack_getitem(const uint8_t *input, int32_t input_len, uint8_t *output,
+                    int32_t start, int32_t nitems) {
+  int32_t typesize;
+  bool delta;
+  int rc = read_flags(input, input_len, &typesize, &delta);
+  if (rc < 0) {
+    return rc;
+  }
+  const uint8_t *ip = input + 1;
+  const uint8_t *ip_limit = input + input_len;
+
+  // Skip the miniblocks before start (only their headers are read)
+  for (int32_t i = 0; i < start / FORPACK_MINIBLOCK; i++) {
+    int32_t csize = miniblock_size(ip, (int32_t) (ip_limit - ip), typesize, delta);
+    if (csize < 0) {
+      return csize;
+    }
+    ip += csize;
+  }
+
+  int32_t item = start;
+  uint8_t *op = output;
+  while (item < start + nitems) {
+    int32_t mstart = item % FORPACK_MINIBLOCK;
+    int32_t mstop = mstart + (start + nitems - item);
+    if (mstop > FORPACK_MINIBLOCK) {
+      mstop = FORPACK_MINIBLOCK;
+    }
+    int32_t csize = decode_miniblock(ip, (int32_t) (ip_limit - ip), typesize, delta, mstart, mstop, op);
+    if (csize < 0) {
+      return csize;
+    }
+    ip += csize;
+    op += (mstop - mstart) * typesize;
+    item += mstop - mstart;
+  }
+
+  return nitems * typesize;
+}
@@ -0,0 +1,36 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+
+
+#ifndef FORPACK_H
+#define FORPACK_H
+#include "blosc2.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+int forpack_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                     uint8_t meta, blosc2_cparams *cparams, const void* chunk);
+
+int forpack_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                       uint8_t meta, blosc2_dparams *dparams, const void* chunk);
+
+/* Decode nitems items, starting at item start, out of a compressed stream.  Only the
+   miniblocks containing them are unpacked. */
+int forpack_getitem(const uint8_t *input, int32_t input_len, uint8_t *output,
+                    int32_t start, int32_t nitems);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* FORPACK_H */
@@ -0,0 +1,220 @@
+/*********************************************************************
+    Blosc - Blocked Shuffling and Compression Library
+
+    Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+    https://blosc.org
+    License: BSD 3-Clause (see LICENSE.txt)
+
+    See LICENSE.txt for details about copyright and rights to use.
+
+    Test program demonstrating use of the FORPACK codec from C code.
+    To compile this program:
+
+    $ gcc -O test_forpack.c -o test_forpack -lblosc2
+
+    To run:
+
+    $ ./test_forpack
+    timestamps: Successful roundtrip!
+    Compression: 800024 -> 88623 (9.0x), shuffle + lz4: 131285 (6.1x)
+    ids: Successful roundtrip!
+    Compression: 400012 -> 94771 (4.2x), shuffle + lz4: 96298 (4.2x)
+    ...
+
+**********************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "blosc2.h"
+#include "blosc2/codecs-registry.h"
+#include <inttypes.h>
+#include "forpack.h"
+
+#define NITEMS (100 * 1000 + 3)
+#define NGETITEMS 200
+
+
+static int compress(const void *data, int32_t nbytes, int32_t typesize, uint8_t compcode, uint8_t meta,
+                    uint8_t filter, uint8_t *chunk) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  cparams.compcode = compcode;
+  cparams.compcode_meta = meta;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = filter;
+  cparams.clevel = 5;
+  cparams.nthreads = 1;
+  cparams.blocksize = 32 * 1024;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  return csize;
+}
+
+/* Check a roundtrip of data through FORPACK, as well as getting items out of it */
+static int test_forpack(const char *name, const void *data, int32_t nbytes, int32_t typesize, uint8_t meta) {
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  uint8_t *chunk_lz4 = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  uint8_t *dest = malloc(nbytes);
+  uint8_t *items = malloc(nbytes);
+  printf("%s: ", name);
+
+  int csize = compress(data, nbytes, typesize, BLOSC_CODEC_FORPACK, meta, BLOSC_NOFILTER, chunk);
+  if (csize <= 0) {
+    printf("Compression error.  Error code: %d\n", csize);
+    return -1;
+  }
+  int csize_lz4 = compress(data, nbytes, typesize, BLOSC_LZ4, 0, BLOSC_SHUFFLE, chunk_lz4);
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = 1;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, chunk, csize, dest, nbytes);
+  if (dsize != nbytes) {
+    printf("Decompression error.  Error code: %d\n", dsize);
+    return -1;
+  }
+  if (memcmp(data, dest, nbytes) != 0) {
+    printf("Decompressed data differs from original!\n");
+    return -1;
+  }
+
+  // Get single items and ranges crossing miniblocks and blocks
+  int32_t nitems = nbytes / typesize;
+  srand(1);
+  for (int i = 0; i < NGETITEMS; i++) {
+    int32_t start = rand() % nitems;
+    int32_t n = (i % 2) ? 1 : 1 + rand() % 20000;
+    if (start + n > nitems) {
+      n = nitems - start;
+    }
+    dsize = blosc2_getitem_ctx(dctx, chunk, csize, start, n, items, nbytes);
+    if (dsize != n * typesize) {
+      printf("Error getting items.  Error code: %d\n", dsize);
+      return -1;
+    }
+    if (memcmp((const uint8_t *) data + start * typesize, items, n * typesize) != 0) {
+      printf("Items [%d, %d) differ from original!\n", start, start + n);
+      return -1;
+    }
+  }
+  blosc2_free_ctx(dctx);
+
+  printf("Successful roundtrip!\n");
+  printf("Compression: %d -> %d (%.1fx), shuffle + lz4: %d (%.1fx)\n", nbytes, csize,
+         (1. * nbytes) / csize, csize_lz4, (1. * nbytes) / csize_lz4);
+  free(chunk);
+  free(chunk_lz4);
+  free(dest);
+  free(items);
+  return csize;
+}
+
+/* Check the streams of the codec directly, for all the sizes of the last miniblock */
+static int test_streams(void) {
+  int64_t input[300];
+  uint8_t output[3000];
+  int64_t dest[300];
+  uint8_t meta[] = {0, FORPACK_NODELTA};
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  for (int32_t typesize = 4; typesize <= 8; typesize += 4) {
+    cparams.typesize = typesize;
+    for (int m = 0; m < 2; m++) {
+      for (int32_t len = 1; len < (int32_t) sizeof(input); len += 7) {
+        uint64_t value = 1u << 30;
+        for (int i = 0; i < 300; i++) {
+          // Decreasing values, with some negative ones
+          value -= (uint64_t) (i * 7919 % 101);
+          if (typesize == 4) {
+            ((int32_t *) input)[i] = (int32_t) value;
+          }
+          else {
+            input[i] = (int64_t) value << 20;
+          }
+        }
+        int csize = forpack_compress((uint8_t *) input, len, output, sizeof(output), meta[m], &cparams, NULL);
+        if (csize <= 0) {
+          printf("Error compressing a stream of %d bytes: %d\n", len, csize);
+          return -1;
+        }
+        int dsize = forpack_decompress(output, csize, (uint8_t *) dest, len, meta[m], NULL, NULL);
+        if (dsize != len || memcmp(input, dest, len) != 0) {
+          printf("Error decompressing a stream of %d bytes: %d\n", len, dsize);
+          return -1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+
+int main(void) {
+  blosc2_init();
+  int result = test_streams();
+  if (result < 0) {
+    return result;
+  }
+
+  // Timestamps (in ms) taken at irregular intervals
+  int64_t *timestamps = malloc(NITEMS * sizeof(int64_t));
+  int64_t t = 1650000000000;
+  srand(0);
+  for (int i = 0; i < NITEMS; i++) {
+    t += 1000 + rand() % 50;
+    timestamps[i] = t;
+  }
+  result = test_forpack("timestamps", timestamps, NITEMS * sizeof(int64_t), sizeof(int64_t), 0);
+  if (result < 0) {
+    return result;
+  }
+  if (result > NITEMS) {
+    printf("Timestamps should compress better\n");
+    return -1;
+  }
+
+  // Sorted ids, with gaps
+  int32_t *ids = malloc(NITEMS * sizeof(int32_t));
+  int32_t id = -5000;
+  for (int i = 0; i < NITEMS; i++) {
+    id += 1 + (rand() % 4 == 0) * (rand() % 100);
+    ids[i] = id;
+  }
+  result = test_forpack("ids", ids, NITEMS * sizeof(int32_t), sizeof(int32_t), 0);
+  if (result < 0) {
+    return result;
+  }
+
+  // The same ids without deltas, plus some trailing bytes
+  result = test_forpack("small_range", ids, NITEMS * sizeof(int32_t) - 2, sizeof(int32_t), FORPACK_NODELTA);
+  if (result < 0) {
+    return result;
+  }
+  for (int i = 0; i < NITEMS; i++) {
+    ids[i] = rand() % 3000;
+  }
+  result = test_forpack("unsorted", ids, NITEMS * sizeof(int32_t), sizeof(int32_t), FORPACK_NODELTA);
+  if (result < 0) {
+    return result;
+  }
+
+  // Other typesizes are stored as is
+  result = test_forpack("int16", ids, NITEMS * sizeof(int32_t), sizeof(int16_t), 0);
+  if (result < 0) {
+    return result;
+  }
+
+  // Random data is incompressible
+  for (int i = 0; i < NITEMS; i++) {
+    timestamps[i] = ((int64_t) rand() << 40) ^ ((int64_t) rand() << 20) ^ rand();
+  }
+  result = test_forpack("random", timestamps, NITEMS * sizeof(int64_t), sizeof(int64_t), 0);
+  if (result < 0) {
+    return result;
+  }
+
+  free(timestamps);
+  free(ids);
+  blosc2_destroy();
+
+  return BLOSC2_ERROR_SUCCESS;
+}
@@ -27,6 +27,25 @@ extern "C" {
     }                                \
   } while (0)
 
+/* Set in the ndim byte of a block header when a typesize byte follows the blockshape */
+#define NDLZ_TYPESIZE_FLAG 0x80U
+
+/* Length of a block header: ndim byte, blockshape and (optional) typesize byte */
+#define NDLZ_HEADER_LEN(ndim, typesize) (1 + (ndim) * (int) sizeof(int32_t) + ((typesize) > 1 ? 1 : 0))
+
+/*
+  A block is compressed as a sequence of 2-dim planes made of the last two
+  dims of the blockshape: one plane per position in the leading dims and
+  per byte of the type (the planes of a shuffled block).
+*/
+int ndlz_block_geometry(blosc2_cparams *cparams, int32_t input_len, int8_t *ndim, int32_t *blockshape,
+                        int32_t *typesize);
+
+int ndlz_write_header(uint8_t *op, int8_t ndim, const int32_t *blockshape, int32_t typesize);
+
+int ndlz_read_header(const uint8_t *ip, int32_t input_len, int8_t *ndim, int32_t *blockshape,
+                     int32_t *typesize);
+
 
 #if defined (__cplusplus)
 }
@@ -21,6 +21,81 @@
 #include "ndlz-private.h"
 #include "ndlz4x4.h"
 #include "ndlz8x8.h"
+#include "../plugins/plugin_utils.h"
+
+int ndlz_block_geometry(blosc2_cparams *cparams, int32_t input_len, int8_t *ndim, int32_t *blockshape,
+                        int32_t *typesize) {
+  int64_t shape[8];
+  int32_t chunkshape[8];
+  if (get_b2nd_meta(cparams->schunk, NULL, ndim, shape, chunkshape, blockshape) < 0) {
+    return BLOSC2_ERROR_FAILURE;
+  }
+  if (*ndim < 2) {
+    BLOSC_TRACE_ERROR("This codec only works for ndim >= 2");
+    return BLOSC2_ERROR_FAILURE;
+  }
+
+  int64_t nitems = 1;
+  for (int i = 0; i < *ndim; i++) {
+    nitems *= blockshape[i];
+  }
+  // Split blocks come as single byte planes, non-split ones carry all the bytes of the type
+  if (input_len == nitems) {
+    *typesize = 1;
+  } else if (cparams->typesize > 1 && cparams->typesize <= UINT8_MAX &&
+             input_len == nitems * cparams->typesize) {
+    *typesize = cparams->typesize;
+  } else {
+    BLOSC_TRACE_ERROR("Length not equal to blocksize");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+int ndlz_write_header(uint8_t *op, int8_t ndim, const int32_t *blockshape, int32_t typesize) {
+  uint8_t *obase = op;
+  // Blocks of 1-byte items keep the original 2-dim header
+  *op++ = (uint8_t) (typesize > 1 ? (uint8_t) ndim | NDLZ_TYPESIZE_FLAG : (uint8_t) ndim);
+  for (int i = 0; i < ndim; i++) {
+    memcpy(op, &blockshape[i], sizeof(int32_t));
+    op += sizeof(int32_t);
+  }
+  if (typesize > 1) {
+    *op++ = (uint8_t) typesize;
+  }
+  return (int) (op - obase);
+}
+
+int ndlz_read_header(const uint8_t *ip, int32_t input_len, int8_t *ndim, int32_t *blockshape,
+                     int32_t *typesize) {
+  if (input_len < 1) {
+    return BLOSC2_ERROR_FAILURE;
+  }
+  bool has_typesize = (ip[0] & NDLZ_TYPESIZE_FLAG) != 0;
+  *ndim = (int8_t) (ip[0] & ~NDLZ_TYPESIZE_FLAG);
+  if (*ndim < 2 || *ndim > 8) {
+    BLOSC_TRACE_ERROR("This codec only works for 2 <= ndim <= 8");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  int header_len = NDLZ_HEADER_LEN(*ndim, has_typesize ? 2 : 1);
+  if (input_len < header_len) {
+    BLOSC_TRACE_ERROR("Header exceeds input length");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  memcpy(blockshape, ip + 1, *ndim * sizeof(int32_t));
+  *typesize = has_typesize ? ip[header_len - 1] : 1;
+  if (has_typesize && *typesize < 2) {
+    BLOSC_TRACE_ERROR("Invalid typesize in header");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  for (int i = 0; i < *ndim; i++) {
+    if (blockshape[i] <= 0) {
+      BLOSC_TRACE_ERROR("Invalid blockshape in header");
+      return BLOSC2_ERROR_FAILURE;
+    }
+  }
+  return header_len;
+}
 
 int ndlz_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
                   uint8_t meta, blosc2_cparams *cparams, const void *chunk) {
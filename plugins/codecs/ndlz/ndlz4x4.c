@@ -20,7 +20,6 @@
 #include "ndlz4x4.h"
 #include "ndlz.h"
 #include "xxhash.h"
-#include "../plugins/plugin_utils.h"
 
 
 /*
@@ -59,32 +58,18 @@
 int ndlz4_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
                    uint8_t meta, blosc2_cparams *cparams) {
   BLOSC_UNUSED_PARAM(meta);
-  uint8_t *smeta;
-  int32_t smeta_len;
-
-  if (blosc2_meta_get(cparams->schunk, "b2nd", &smeta, &smeta_len) < 0) {
-    BLOSC_TRACE_ERROR("b2nd layer not found!");
-    return BLOSC2_ERROR_FAILURE;
-  }
 
   int8_t ndim;
-  int64_t *shape = malloc(8 * sizeof(int64_t));
-  int32_t *chunkshape = malloc(8 * sizeof(int32_t));
-  int32_t *blockshape = malloc(8 * sizeof(int32_t));
-  deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape);
-  free(smeta);
-
-  if (ndim != 2) {
-    BLOSC_TRACE_ERROR("This codec only works for ndim = 2");
-    return BLOSC2_ERROR_FAILURE;
-  }
-
-  if (input_len != (blockshape[0] * blockshape[1])) {
-    BLOSC_TRACE_ERROR("Length not equal to blocksize");
+  int32_t blockshape[8];
+  int32_t typesize;
+  if (ndlz_block_geometry(cparams, input_len, &ndim, blockshape, &typesize) < 0) {
     return BLOSC2_ERROR_FAILURE;
   }
+  // The cells are taken from 2-dim planes, which share the hash tables
+  int32_t plane[2] = {blockshape[ndim - 2], blockshape[ndim - 1]};
+  int32_t nplanes = input_len / (plane[0] * plane[1]);
 
-  if (NDLZ_UNEXPECT_CONDITIONAL(output_len < (int) (1 + ndim * sizeof(int32_t)))) {
+  if (NDLZ_UNEXPECT_CONDITIONAL(output_len < NDLZ_HEADER_LEN(ndim, typesize))) {
     BLOSC_TRACE_ERROR("Output too small");
     return BLOSC2_ERROR_FAILURE;
   }
@@ -117,7 +102,7 @@ int ndlz4_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int
   }
 
   /* input and output buffer cannot be less than 16 and 66 bytes or we can get into trouble */
-  int overhead = 17 + (blockshape[0] * blockshape[1] / 16 - 1) * 2;
+  int overhead = 17 + (input_len / 16 - 1) * 2;
   if (input_len < 16 || output_len < overhead) {
     BLOSC_TRACE_ERROR("Incorrect length or maxout");
     return 0;
@@ -126,328 +111,321 @@ int ndlz4_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int
   uint8_t *obase = op;
 
   /* we start with literal copy */
-  *op++ = ndim;
-  memcpy(op, &blockshape[0], 4);
-  op += 4;
-  memcpy(op, &blockshape[1], 4);
-  op += 4;
+  op += ndlz_write_header(op, ndim, blockshape, typesize);
 
   uint32_t i_stop[2];
   for (int i = 0; i < 2; ++i) {
-    i_stop[i] = (blockshape[i] + 3) / 4;
+    i_stop[i] = (plane[i] + 3) / 4;
   }
 
   /* main loop */
   uint32_t padding[2];
   uint32_t ii[2];
-  for (ii[0] = 0; ii[0] < i_stop[0]; ++ii[0]) {
-    for (ii[1] = 0; ii[1] < i_stop[1]; ++ii[1]) {      // for each cell
-      uint8_t token;
-      for (int h = 0; h < 2; h++) {         // new cell -> new possible references
-        update_triple[h] = 0;
-        update_pair[h] = 0;
-      }
-      update_pair[2] = 0;
-
-      if (NDLZ_UNEXPECT_CONDITIONAL(op + 16 + 1 > op_limit)) {
-        free(shape);
-        free(chunkshape);
-        free(blockshape);
-        return 0;
-      }
-
-      uint32_t orig = ii[0] * 4 * blockshape[1] + ii[1] * 4;
-      if (((blockshape[0] % 4 != 0) && (ii[0] == i_stop[0] - 1)) ||
-          ((blockshape[1] % 4 != 0) && (ii[1] == i_stop[1] - 1))) {
-        token = 0;                                   // padding -> literal copy
-        *op++ = token;
-        if (ii[0] == i_stop[0] - 1) {
-          padding[0] = (blockshape[0] % 4 == 0) ? 4 : blockshape[0] % 4;
-        } else {
-          padding[0] = 4;
-        }
-        if (ii[1] == i_stop[1] - 1) {
-          padding[1] = (blockshape[1] % 4 == 0) ? 4 : blockshape[1] % 4;
-        } else {
-          padding[1] = 4;
+  for (int32_t iplane = 0; iplane < nplanes; iplane++) {
+    ip = (uint8_t *) input + iplane * plane[0] * plane[1];
+    for (ii[0] = 0; ii[0] < i_stop[0]; ++ii[0]) {
+      for (ii[1] = 0; ii[1] < i_stop[1]; ++ii[1]) {      // for each cell
+        uint8_t token;
+        for (int h = 0; h < 2; h++) {         // new cell -> new possible references
+          update_triple[h] = 0;
+          update_pair[h] = 0;
         }
-        for (uint32_t i = 0; i < padding[0]; i++) {
-          memcpy(op, &ip[orig + i * blockshape[1]], padding[1]);
-          op += padding[1];
-        }
-      } else {
-        for (uint64_t i = 0; i < 4; i++) {           // fill cell buffer
-          uint64_t ind = orig + i * blockshape[1];
-          memcpy(buf_cell, &ip[ind], 4);
-          buf_cell += 4;
-        }
-        buf_cell -= 16;
-
-        const uint8_t *ref;
-        uint32_t distance;
-        uint8_t *anchor = op;    /* comparison starting-point */
+        update_pair[2] = 0;
 
-        /* find potential match */
-        hash_cell = XXH32(buf_cell, 16, 1);        // calculate cell hash
-        hash_cell >>= 32U - 12U;
-        ref = obase + tab_cell[hash_cell];
+        if (NDLZ_UNEXPECT_CONDITIONAL(op + 16 + 1 > op_limit)) {
+          return 0;
+        }
 
-        /* calculate distance to the match */
-        if (tab_cell[hash_cell] == 0) {
-          distance = 0;
-        } else {
-          bool same = true;
-          buf_aux = obase + tab_cell[hash_cell];
-          for (int i = 0; i < 16; i++) {
-            if (buf_cell[i] != buf_aux[i]) {
-              same = false;
-              break;
-            }
+        uint32_t orig = ii[0] * 4 * plane[1] + ii[1] * 4;
+        if (((plane[0] % 4 != 0) && (ii[0] == i_stop[0] - 1)) ||
+            ((plane[1] % 4 != 0) && (ii[1] == i_stop[1] - 1))) {
+          token = 0;                                   // padding -> literal copy
+          *op++ = token;
+          if (ii[0] == i_stop[0] - 1) {
+            padding[0] = (plane[0] % 4 == 0) ? 4 : plane[0] % 4;
+          } else {
+            padding[0] = 4;
           }
-          if (same) {
-            distance = (int32_t) (anchor - ref);
+          if (ii[1] == i_stop[1] - 1) {
+            padding[1] = (plane[1] % 4 == 0) ? 4 : plane[1] % 4;
           } else {
-            distance = 0;
+            padding[1] = 4;
           }
-        }
-
-        bool alleq = true;
-        for (int i = 1; i < 16; i++) {
-          if (buf_cell[i] != buf_cell[0]) {
-            alleq = false;
-            break;
+          for (uint32_t i = 0; i < padding[0]; i++) {
+            memcpy(op, &ip[orig + i * plane[1]], padding[1]);
+            op += padding[1];
           }
-        }
-        if (alleq) {                              // all elements of the cell equal
-          token = (uint8_t) (1U << 6U);
-          *op++ = token;
-          *op++ = buf_cell[0];
-
-        } else if (distance == 0 || (distance >= MAX_DISTANCE)) {   // no cell match
-          bool literal = true;
-
-          // 2 rows pairs matches
-          for (int j = 1; j < 4; j++) {
-            memcpy(buf_pair, buf_cell, 4);
-            memcpy(&buf_pair[4], &buf_cell[j * 4], 4);
-            hval = XXH32(buf_pair, 8, 1);        // calculate rows pair hash
-            hval >>= 32U - 12U;
-            ref = obase + tab_pair[hval];
-            /* calculate distance to the match */
+        } else {
+          for (uint64_t i = 0; i < 4; i++) {           // fill cell buffer
+            uint64_t ind = orig + i * plane[1];
+            memcpy(buf_cell, &ip[ind], 4);
+            buf_cell += 4;
+          }
+          buf_cell -= 16;
+
+          const uint8_t *ref;
+          uint32_t distance;
+          uint8_t *anchor = op;    /* comparison starting-point */
+
+          /* find potential match */
+          hash_cell = XXH32(buf_cell, 16, 1);        // calculate cell hash
+          hash_cell >>= 32U - 12U;
+          ref = obase + tab_cell[hash_cell];
+
+          /* calculate distance to the match */
+          if (tab_cell[hash_cell] == 0) {
+            distance = 0;
+          } else {
             bool same = true;
-            uint16_t offset;
-            if (tab_pair[hval] != 0) {
-              buf_aux = obase + tab_pair[hval];
-              for (int k = 0; k < 8; k++) {
-                if (buf_pair[k] != buf_aux[k]) {
-                  same = false;
-                  break;
-                }
+            buf_aux = obase + tab_cell[hash_cell];
+            for (int i = 0; i < 16; i++) {
+              if (buf_cell[i] != buf_aux[i]) {
+                same = false;
+                break;
               }
-              offset = (uint16_t) (anchor - obase - tab_pair[hval]);
-            } else {
-              same = false;
             }
             if (same) {
               distance = (int32_t) (anchor - ref);
             } else {
               distance = 0;
             }
-            if ((distance != 0) && (distance < MAX_DISTANCE)) {     /* rows pair match */
-              int k, m, l = -1;
-              for (k = 1; k < 4; k++) {
-                if (k != j) {
-                  if (l == -1) {
-                    l = k;
-                  } else {
-                    m = k;
-                  }
-                }
-              }
-              memcpy(buf_pair, &buf_cell[l * 4], 4);
-              memcpy(&buf_pair[4], &buf_cell[m * 4], 4);
+          }
+
+          bool alleq = true;
+          for (int i = 1; i < 16; i++) {
+            if (buf_cell[i] != buf_cell[0]) {
+              alleq = false;
+              break;
+            }
+          }
+          if (alleq) {                              // all elements of the cell equal
+            token = (uint8_t) (1U << 6U);
+            *op++ = token;
+            *op++ = buf_cell[0];
+
+          } else if (distance == 0 || (distance >= MAX_DISTANCE)) {   // no cell match
+            bool literal = true;
+
+            // 2 rows pairs matches
+            for (int j = 1; j < 4; j++) {
+              memcpy(buf_pair, buf_cell, 4);
+              memcpy(&buf_pair[4], &buf_cell[j * 4], 4);
               hval = XXH32(buf_pair, 8, 1);        // calculate rows pair hash
               hval >>= 32U - 12U;
               ref = obase + tab_pair[hval];
-              same = true;
+              /* calculate distance to the match */
+              bool same = true;
+              uint16_t offset;
               if (tab_pair[hval] != 0) {
                 buf_aux = obase + tab_pair[hval];
-                for (k = 0; k < 8; k++) {
+                for (int k = 0; k < 8; k++) {
                   if (buf_pair[k] != buf_aux[k]) {
                     same = false;
                     break;
                   }
                 }
+                offset = (uint16_t) (anchor - obase - tab_pair[hval]);
               } else {
                 same = false;
               }
               if (same) {
-                distance = (int32_t) (anchor + l * 4 - ref);
+                distance = (int32_t) (anchor - ref);
               } else {
                 distance = 0;
               }
-              if ((distance != 0) && (distance < MAX_DISTANCE)) {   /* 2 pair matches */
-                literal = false;
-                token = (uint8_t) ((1U << 5U) | (j << 3U));
-                *op++ = token;
-                uint16_t offset_2 = (uint16_t) (anchor - obase - tab_pair[hval]);
-                *(uint16_t *) op = offset;
-                op += sizeof(offset);
-                *(uint16_t *) op = offset_2;
-                op += sizeof(offset_2);
-                goto match;
+              if ((distance != 0) && (distance < MAX_DISTANCE)) {     /* rows pair match */
+                int k, m, l = -1;
+                for (k = 1; k < 4; k++) {
+                  if (k != j) {
+                    if (l == -1) {
+                      l = k;
+                    } else {
+                      m = k;
+                    }
+                  }
+                }
+                memcpy(buf_pair, &buf_cell[l * 4], 4);
+                memcpy(&buf_pair[4], &buf_cell[m * 4], 4);
+                hval = XXH32(buf_pair, 8, 1);        // calculate rows pair hash
+                hval >>= 32U - 12U;
+                ref = obase + tab_pair[hval];
+                same = true;
+                if (tab_pair[hval] != 0) {
+                  buf_aux = obase + tab_pair[hval];
+                  for (k = 0; k < 8; k++) {
+                    if (buf_pair[k] != buf_aux[k]) {
+                      same = false;
+                      break;
+                    }
+                  }
+                } else {
+                  same = false;
+                }
+                if (same) {
+                  distance = (int32_t) (anchor + l * 4 - ref);
+                } else {
+                  distance = 0;
+                }
+                if ((distance != 0) && (distance < MAX_DISTANCE)) {   /* 2 pair matches */
+                  literal = false;
+                  token = (uint8_t) ((1U << 5U) | (j << 3U));
+                  *op++ = token;
+                  uint16_t offset_2 = (uint16_t) (anchor - obase - tab_pair[hval]);
+                  *(uint16_t *) op = offset;
+                  op += sizeof(offset);
+                  *(uint16_t *) op = offset_2;
+                  op += sizeof(offset_2);
+                  goto match;
+                }
+              }
+            }
+
+            // rows triples
+            for (int i = 0; i < 2; i++) {
+              memcpy(buf_triple, &buf_cell[i * 4], 4);
+              for (int j = i + 1; j < 3; j++) {
+                memcpy(&buf_triple[4], &buf_cell[j * 4], 4);
+                for (int k = j + 1; k < 4; k++) {
+                  memcpy(&buf_triple[8], &buf_cell[k * 4], 4);
+                  hval = XXH32(buf_triple, 12, 1);        // calculate triple hash
+                  hval >>= 32U - 12U;
+                  /* calculate distance to the match */
+                  bool same = true;
+                  uint16_t offset;
+                  if (tab_triple[hval] != 0) {
+                    buf_aux = obase + tab_triple[hval];
+                    for (int l = 0; l < 12; l++) {
+                      if (buf_triple[l] != buf_aux[l]) {
+                        same = false;
+                        break;
+                      }
+                    }
+                    offset = (uint16_t) (anchor - obase - tab_triple[hval]);
+                  } else {
+                    same = false;
+                    if ((j - i == 1) && (k - j == 1)) {
+                      update_triple[i] = (uint32_t) (anchor + 1 + i * 4 - obase);     /* update hash table */
+                      hash_triple[i] = hval;
+                    }
+                  }
+                  ref = obase + tab_triple[hval];
+
+                  if (same) {
+                    distance = (int32_t) (anchor + i * 4 - ref);
+                  } else {
+                    distance = 0;
+                  }
+                  if ((distance != 0) && (distance < MAX_DISTANCE)) {
+                    literal = false;
+                    if (i == 1) {
+                      token = (uint8_t) (7U << 5U);
+                    } else {
+                      token = (uint8_t) ((7U << 5U) | ((j + k - 2) << 3U));
+                    }
+                    *op++ = token;
+                    memcpy(op, &offset, 2);
+                    op += 2;
+                    for (int l = 0; l < 4; l++) {
+                      if ((l != i) && (l != j) && (l != k)) {
+                        memcpy(op, &buf_cell[4 * l], 4);
+                        op += 4;
+                        goto match;
+                      }
+                    }
+                  }
+                }
               }
             }
-          }
 
-          // rows triples
-          for (int i = 0; i < 2; i++) {
-            memcpy(buf_triple, &buf_cell[i * 4], 4);
-            for (int j = i + 1; j < 3; j++) {
-              memcpy(&buf_triple[4], &buf_cell[j * 4], 4);
-              for (int k = j + 1; k < 4; k++) {
-                memcpy(&buf_triple[8], &buf_cell[k * 4], 4);
-                hval = XXH32(buf_triple, 12, 1);        // calculate triple hash
+            // rows pairs
+            for (int i = 0; i < 3; i++) {
+              memcpy(buf_pair, &buf_cell[i * 4], 4);
+              for (int j = i + 1; j < 4; j++) {
+                memcpy(&buf_pair[4], &buf_cell[j * 4], 4);
+                hval = XXH32(buf_pair, 8, 1);        // calculate rows pair hash
                 hval >>= 32U - 12U;
+                ref = obase + tab_pair[hval];
                 /* calculate distance to the match */
                 bool same = true;
                 uint16_t offset;
-                if (tab_triple[hval] != 0) {
-                  buf_aux = obase + tab_triple[hval];
-                  for (int l = 0; l < 12; l++) {
-                    if (buf_triple[l] != buf_aux[l]) {
+                if (tab_pair[hval] != 0) {
+                  buf_aux = obase + tab_pair[hval];
+                  for (int k = 0; k < 8; k++) {
+                    if (buf_pair[k] != buf_aux[k]) {
                       same = false;
                       break;
                     }
                   }
-                  offset = (uint16_t) (anchor - obase - tab_triple[hval]);
+                  offset = (uint16_t) (anchor - obase - tab_pair[hval]);
                 } else {
                   same = false;
-                  if ((j - i == 1) && (k - j == 1)) {
-                    update_triple[i] = (uint32_t) (anchor + 1 + i * 4 - obase);     /* update hash table */
-                    hash_triple[i] = hval;
+                  if (j - i == 1) {
+                    update_pair[i] = (uint32_t) (anchor + 1 + i * 4 - obase);     /* update hash table */
+                    hash_pair[i] = hval;
                   }
                 }
-                ref = obase + tab_triple[hval];
-
                 if (same) {
                   distance = (int32_t) (anchor + i * 4 - ref);
                 } else {
                   distance = 0;
                 }
-                if ((distance != 0) && (distance < MAX_DISTANCE)) {
+                if ((distance != 0) && (distance < MAX_DISTANCE)) {     /* rows pair match */
                   literal = false;
-                  if (i == 1) {
-                    token = (uint8_t) (7U << 5U);
+                  if (i == 2) {
+                    token = (uint8_t) (1U << 7U);
                   } else {
-                    token = (uint8_t) ((7U << 5U) | ((j + k - 2) << 3U));
+                    token = (uint8_t) ((1U << 7U) | (i << 5U) | (j << 3U));
                   }
                   *op++ = token;
                   memcpy(op, &offset, 2);
                   op += 2;
-                  for (int l = 0; l < 4; l++) {
-                    if ((l != i) && (l != j) && (l != k)) {
-                      memcpy(op, &buf_cell[4 * l], 4);
+                  for (int k = 0; k < 4; k++) {
+                    if ((k != i) && (k != j)) {
+                      memcpy(op, &buf_cell[4 * k], 4);
                       op += 4;
-                      goto match;
                     }
                   }
+                  goto match;
                 }
               }
             }
-          }
 
-          // rows pairs
-          for (int i = 0; i < 3; i++) {
-            memcpy(buf_pair, &buf_cell[i * 4], 4);
-            for (int j = i + 1; j < 4; j++) {
-              memcpy(&buf_pair[4], &buf_cell[j * 4], 4);
-              hval = XXH32(buf_pair, 8, 1);        // calculate rows pair hash
-              hval >>= 32U - 12U;
-              ref = obase + tab_pair[hval];
-              /* calculate distance to the match */
-              bool same = true;
-              uint16_t offset;
-              if (tab_pair[hval] != 0) {
-                buf_aux = obase + tab_pair[hval];
-                for (int k = 0; k < 8; k++) {
-                  if (buf_pair[k] != buf_aux[k]) {
-                    same = false;
-                    break;
-                  }
-                }
-                offset = (uint16_t) (anchor - obase - tab_pair[hval]);
-              } else {
-                same = false;
-                if (j - i == 1) {
-                  update_pair[i] = (uint32_t) (anchor + 1 + i * 4 - obase);     /* update hash table */
-                  hash_pair[i] = hval;
+            match:
+            if (literal) {
+              tab_cell[hash_cell] = (uint32_t) (anchor + 1 - obase);     /* update hash tables */
+              if (update_triple[0] != 0) {
+                for (int h = 0; h < 2; h++) {
+                  tab_triple[hash_triple[h]] = update_triple[h];
                 }
               }
-              if (same) {
-                distance = (int32_t) (anchor + i * 4 - ref);
-              } else {
-                distance = 0;
-              }
-              if ((distance != 0) && (distance < MAX_DISTANCE)) {     /* rows pair match */
-                literal = false;
-                if (i == 2) {
-                  token = (uint8_t) (1U << 7U);
-                } else {
-                  token = (uint8_t) ((1U << 7U) | (i << 5U) | (j << 3U));
+              if (update_pair[0] != 0) {
+                for (int h = 0; h < 3; h++) {
+                  tab_pair[hash_pair[h]] = update_pair[h];
                 }
-                *op++ = token;
-                memcpy(op, &offset, 2);
-                op += 2;
-                for (int k = 0; k < 4; k++) {
-                  if ((k != i) && (k != j)) {
-                    memcpy(op, &buf_cell[4 * k], 4);
-                    op += 4;
-                  }
-                }
-                goto match;
               }
+              token = 0;
+              *op++ = token;
+              memcpy(op, buf_cell, 16);
+              op += 16;
             }
-          }
 
-          match:
-          if (literal) {
-            tab_cell[hash_cell] = (uint32_t) (anchor + 1 - obase);     /* update hash tables */
-            if (update_triple[0] != 0) {
-              for (int h = 0; h < 2; h++) {
-                tab_triple[hash_triple[h]] = update_triple[h];
-              }
-            }
-            if (update_pair[0] != 0) {
-              for (int h = 0; h < 3; h++) {
-                tab_pair[hash_pair[h]] = update_pair[h];
-              }
-            }
-            token = 0;
+          } else {   // cell match
+            token = (uint8_t) ((1U << 7U) | (1U << 6U));
             *op++ = token;
-            memcpy(op, buf_cell, 16);
-            op += 16;
+            uint16_t offset = (uint16_t) (anchor - obase - tab_cell[hash_cell]);
+            memcpy(op, &offset, 2);
+            op += 2;
           }
 
-        } else {   // cell match
-          token = (uint8_t) ((1U << 7U) | (1U << 6U));
-          *op++ = token;
-          uint16_t offset = (uint16_t) (anchor - obase - tab_cell[hash_cell]);
-          memcpy(op, &offset, 2);
-          op += 2;
         }
-
-      }
-      if ((op - obase) > input_len) {
-        BLOSC_TRACE_ERROR("Compressed data is bigger than input!");
-        return 0;
+        if ((op - obase) > input_len) {
+          BLOSC_TRACE_ERROR("Compressed data is bigger than input!");
+          return 0;
+        }
       }
     }
   }
 
-  free(shape);
-  free(chunkshape);
-  free(blockshape);
 
   return (int) (op - obase);
 }
@@ -517,8 +495,6 @@ int ndlz4_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, i
   uint8_t *ip = (uint8_t *) input;
   uint8_t *ip_limit = ip + input_len;
   uint8_t *op = (uint8_t *) output;
-  uint8_t ndim;
-  uint32_t blockshape[2];
   uint32_t eshape[2];
   uint8_t *buffercpy;
   uint8_t local_buffer[16];
@@ -528,23 +504,27 @@ int ndlz4_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, i
   }
 
   /* we start with literal copy */
-  ndim = *ip;
-  ip++;
-  if (ndim != 2) {
-    BLOSC_TRACE_ERROR("This codec only works for ndim = 2");
+  int8_t ndim;
+  int32_t blockshape[8];
+  int32_t typesize;
+  int header_len = ndlz_read_header(ip, input_len, &ndim, blockshape, &typesize);
+  if (header_len < 0) {
     return BLOSC2_ERROR_FAILURE;
   }
-  memcpy(&blockshape[0], ip, 4);
-  ip += 4;
-  memcpy(&blockshape[1], ip, 4);
-  ip += 4;
-  eshape[0] = ((blockshape[0] + 3) / 4) * 4;
-  eshape[1] = ((blockshape[1] + 3) / 4) * 4;
-
-  if (NDLZ_UNEXPECT_CONDITIONAL(output_len < (int32_t) (blockshape[0] * blockshape[1]))) {
+  ip += header_len;
+  uint32_t plane[2] = {(uint32_t) blockshape[ndim - 2], (uint32_t) blockshape[ndim - 1]};
+  int64_t nplanes = typesize;
+  for (int i = 0; i < ndim - 2; i++) {
+    nplanes *= blockshape[i];
+  }
+  eshape[0] = ((plane[0] + 3) / 4) * 4;
+  eshape[1] = ((plane[1] + 3) / 4) * 4;
+
+  int64_t nbytes = nplanes * plane[0] * plane[1];
+  if (NDLZ_UNEXPECT_CONDITIONAL(output_len < nbytes)) {
     return 0;
   }
-  memset(op, 0, blockshape[0] * blockshape[1]);
+  memset(op, 0, nbytes);
 
   uint32_t i_stop[2];
   for (int i = 0; i < 2; ++i) {
@@ -556,145 +536,144 @@ int ndlz4_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, i
   uint32_t padding[2] = {0};
   uint32_t ind = 0;
   uint8_t cell_aux[16];
-  for (ii[0] = 0; ii[0] < i_stop[0]; ++ii[0]) {
-    for (ii[1] = 0; ii[1] < i_stop[1]; ++ii[1]) {      // for each cell
-      if (NDLZ_UNEXPECT_CONDITIONAL(ip > ip_limit)) {
-        BLOSC_TRACE_ERROR("Exceeding input length");
-        return BLOSC2_ERROR_FAILURE;
-      }
-      if (ii[0] == i_stop[0] - 1) {
-        padding[0] = (blockshape[0] % 4 == 0) ? 4 : blockshape[0] % 4;
-      } else {
-        padding[0] = 4;
-      }
-      if (ii[1] == i_stop[1] - 1) {
-        padding[1] = (blockshape[1] % 4 == 0) ? 4 : blockshape[1] % 4;
-      } else {
-        padding[1] = 4;
-      }
-      token = *ip++;
-      if (token == 0) {    // no match
-        buffercpy = ip;
-        ip += padding[0] * padding[1];
-      } else if (token == (uint8_t) ((1U << 7U) | (1U << 6U))) {  // cell match
-        uint16_t offset = *((uint16_t *) ip);
-        buffercpy = ip - offset - 1;
-        ip += 2;
-      } else if (token == (uint8_t) (1U << 6U)) { // whole cell of same element
-        buffercpy = cell_aux;
-        memset(buffercpy, *ip, 16);
-        ip++;
-      } else if (token >= 224) { // three rows match
-        buffercpy = local_buffer;
-        uint16_t offset = *((uint16_t *) ip);
-        offset += 3;
-        ip += 2;
-        int i, j, k;
-        if ((token >> 3U) == 28) {
-          i = 1;
-          j = 2;
-          k = 3;
+  for (int64_t iplane = 0; iplane < nplanes; iplane++) {
+    op = (uint8_t *) output + iplane * plane[0] * plane[1];
+    for (ii[0] = 0; ii[0] < i_stop[0]; ++ii[0]) {
+      for (ii[1] = 0; ii[1] < i_stop[1]; ++ii[1]) {      // for each cell
+        if (NDLZ_UNEXPECT_CONDITIONAL(ip > ip_limit)) {
+          BLOSC_TRACE_ERROR("Exceeding input length");
+          return BLOSC2_ERROR_FAILURE;
+        }
+        if (ii[0] == i_stop[0] - 1) {
+          padding[0] = (plane[0] % 4 == 0) ? 4 : plane[0] % 4;
         } else {
-          i = 0;
-          if ((token >> 3U) < 30) {
-            j = 1;
-            k = 2;
-          } else {
+          padding[0] = 4;
+        }
+        if (ii[1] == i_stop[1] - 1) {
+          padding[1] = (plane[1] % 4 == 0) ? 4 : plane[1] % 4;
+        } else {
+          padding[1] = 4;
+        }
+        token = *ip++;
+        if (token == 0) {    // no match
+          buffercpy = ip;
+          ip += padding[0] * padding[1];
+        } else if (token == (uint8_t) ((1U << 7U) | (1U << 6U))) {  // cell match
+          uint16_t offset = *((uint16_t *) ip);
+          buffercpy = ip - offset - 1;
+          ip += 2;
+        } else if (token == (uint8_t) (1U << 6U)) { // whole cell of same element
+          buffercpy = cell_aux;
+          memset(buffercpy, *ip, 16);
+          ip++;
+        } else if (token >= 224) { // three rows match
+          buffercpy = local_buffer;
+          uint16_t offset = *((uint16_t *) ip);
+          offset += 3;
+          ip += 2;
+          int i, j, k;
+          if ((token >> 3U) == 28) {
+            i = 1;
+            j = 2;
             k = 3;
-            if ((token >> 3U) == 30) {
+          } else {
+            i = 0;
+            if ((token >> 3U) < 30) {
               j = 1;
+              k = 2;
             } else {
-              j = 2;
+              k = 3;
+              if ((token >> 3U) == 30) {
+                j = 1;
+              } else {
+                j = 2;
+              }
             }
           }
-        }
-        memcpy(&buffercpy[i * 4], ip - offset, 4);
-        memcpy(&buffercpy[j * 4], ip - offset + 4, 4);
-        memcpy(&buffercpy[k * 4], ip - offset + 8, 4);
-        for (int l = 0; l < 4; l++) {
-          if ((l != i) && (l != j) && (l != k)) {
-            memcpy(&buffercpy[l * 4], ip, 4);
-            ip += 4;
-            break;
+          memcpy(&buffercpy[i * 4], ip - offset, 4);
+          memcpy(&buffercpy[j * 4], ip - offset + 4, 4);
+          memcpy(&buffercpy[k * 4], ip - offset + 8, 4);
+          for (int l = 0; l < 4; l++) {
+            if ((l != i) && (l != j) && (l != k)) {
+              memcpy(&buffercpy[l * 4], ip, 4);
+              ip += 4;
+              break;
+            }
           }
-        }
 
-      } else if ((token >= 128) && (token <= 191)) { // rows pair match
-        buffercpy = local_buffer;
-        uint16_t offset = *((uint16_t *) ip);
-        offset += 3;
-        ip += 2;
-        int i, j;
-        if (token == 128) {
-          i = 2;
-          j = 3;
-        } else {
-          i = (token - 128) >> 5U;
-          j = ((token - 128) >> 3U) - (i << 2U);
-        }
-        memcpy(&buffercpy[i * 4], ip - offset, 4);
-        memcpy(&buffercpy[j * 4], ip - offset + 4, 4);
-        for (int k = 0; k < 4; k++) {
-          if ((k != i) && (k != j)) {
-            memcpy(&buffercpy[k * 4], ip, 4);
-            ip += 4;
+        } else if ((token >= 128) && (token <= 191)) { // rows pair match
+          buffercpy = local_buffer;
+          uint16_t offset = *((uint16_t *) ip);
+          offset += 3;
+          ip += 2;
+          int i, j;
+          if (token == 128) {
+            i = 2;
+            j = 3;
+          } else {
+            i = (token - 128) >> 5U;
+            j = ((token - 128) >> 3U) - (i << 2U);
           }
-        }
-      } else if ((token >= 40) && (token <= 63)) {  // 2 rows pair matches
-        buffercpy = local_buffer;
-        uint16_t offset_1 = *((uint16_t *) ip);
-        offset_1 += 5;
-        ip += 2;
-        uint16_t offset_2 = *((uint16_t *) ip);
-        offset_2 += 5;
-        ip += 2;
-        int i, j, k, l, m;
-        i = 0;
-        j = ((token - 32) >> 3U);
-        l = -1;
-        for (k = 1; k < 4; k++) {
-          if ((k != i) && (k != j)) {
-            if (l == -1) {
-              l = k;
-            } else {
-              m = k;
+          memcpy(&buffercpy[i * 4], ip - offset, 4);
+          memcpy(&buffercpy[j * 4], ip - offset + 4, 4);
+          for (int k = 0; k < 4; k++) {
+            if ((k != i) && (k != j)) {
+              memcpy(&buffercpy[k * 4], ip, 4);
+              ip += 4;
+            }
+          }
+        } else if ((token >= 40) && (token <= 63)) {  // 2 rows pair matches
+          buffercpy = local_buffer;
+          uint16_t offset_1 = *((uint16_t *) ip);
+          offset_1 += 5;
+          ip += 2;
+          uint16_t offset_2 = *((uint16_t *) ip);
+          offset_2 += 5;
+          ip += 2;
+          int i, j, k, l, m;
+          i = 0;
+          j = ((token - 32) >> 3U);
+          l = -1;
+          for (k = 1; k < 4; k++) {
+            if ((k != i) && (k != j)) {
+              if (l == -1) {
+                l = k;
+              } else {
+                m = k;
+              }
             }
           }
+          memcpy(&buffercpy[i * 4], ip - offset_1, 4);
+          memcpy(&buffercpy[j * 4], ip - offset_1 + 4, 4);
+          memcpy(&buffercpy[l * 4], ip - offset_2, 4);
+          memcpy(&buffercpy[m * 4], ip - offset_2 + 4, 4);
+
+        } else {
+          BLOSC_TRACE_ERROR("Invalid token: %u at cell [%d, %d]\n", token, ii[0], ii[1]);
+          return BLOSC2_ERROR_FAILURE;
         }
-        memcpy(&buffercpy[i * 4], ip - offset_1, 4);
-        memcpy(&buffercpy[j * 4], ip - offset_1 + 4, 4);
-        memcpy(&buffercpy[l * 4], ip - offset_2, 4);
-        memcpy(&buffercpy[m * 4], ip - offset_2 + 4, 4);
-
-      } else {
-        BLOSC_TRACE_ERROR("Invalid token: %u at cell [%d, %d]\n", token, ii[0], ii[1]);
-        return BLOSC2_ERROR_FAILURE;
-      }
-      // fill op with buffercpy
-      uint32_t orig = ii[0] * 4 * blockshape[1] + ii[1] * 4;
-      for (uint32_t i = 0; i < 4; i++) {
-        if (i < padding[0]) {
-          ind = orig + i * blockshape[1];
-          memcpy(&op[ind], buffercpy, padding[1]);
+        // fill op with buffercpy
+        uint32_t orig = ii[0] * 4 * plane[1] + ii[1] * 4;
+        for (uint32_t i = 0; i < 4; i++) {
+          if (i < padding[0]) {
+            ind = orig + i * plane[1];
+            memcpy(&op[ind], buffercpy, padding[1]);
+          }
+          buffercpy += padding[1];
+        }
+        if (ind > (uint32_t) output_len) {
+          BLOSC_TRACE_ERROR("Exceeding output size");
+          return BLOSC2_ERROR_FAILURE;
         }
-        buffercpy += padding[1];
-      }
-      if (ind > (uint32_t) output_len) {
-        BLOSC_TRACE_ERROR("Exceeding output size");
-        return BLOSC2_ERROR_FAILURE;
       }
     }
-  }
-  ind += padding[1];
+    ind += padding[1];
 
-  if (ind != (blockshape[0] * blockshape[1])) {
-    BLOSC_TRACE_ERROR("Output size is not compatible with embedded blockshape");
-    return BLOSC2_ERROR_FAILURE;
-  }
-  if (ind > (uint32_t) output_len) {
-    BLOSC_TRACE_ERROR("Exceeding output size");
-    return BLOSC2_ERROR_FAILURE;
+    if (ind != (plane[0] * plane[1])) {
+      BLOSC_TRACE_ERROR("Output size is not compatible with embedded blockshape");
+      return BLOSC2_ERROR_FAILURE;
+    }
   }
 
-  return (int) ind;
+  return (int) nbytes;
 }
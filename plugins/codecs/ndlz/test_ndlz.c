@@ -194,6 +194,71 @@ static int test_ndlz_8(blosc2_schunk *schunk) {
   return (int) (chunksize - csize_f);
 }
 
+/* Roundtrip without splitting, so that the codec gets all the byte planes of a block */
+static int test_ndlz_planes(blosc2_schunk *schunk, uint8_t cellsize) {
+
+  int64_t nchunks = schunk->nchunks;
+  int32_t chunksize = (int32_t) (schunk->chunksize);
+  uint8_t *data_in = malloc(chunksize);
+  int64_t csize;
+  int64_t dsize;
+  int64_t csize_f = 0;
+  uint8_t *data_out = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  uint8_t *data_dest = malloc(chunksize);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.splitmode = BLOSC_NEVER_SPLIT;
+  cparams.typesize = schunk->typesize;
+  cparams.compcode = BLOSC_CODEC_NDLZ;
+  cparams.compcode_meta = cellsize;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_SHUFFLE;
+  cparams.clevel = 5;
+  cparams.nthreads = 1;
+  cparams.blocksize = schunk->blocksize;
+  cparams.schunk = schunk;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = 1;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+
+  for (int ci = 0; ci < nchunks; ci++) {
+    if (blosc2_schunk_decompress_chunk(schunk, ci, data_in, chunksize) < 0) {
+      printf("Error decompressing chunk \n");
+      return -1;
+    }
+
+    csize = blosc2_compress_ctx(cctx, data_in, chunksize, data_out, chunksize + BLOSC2_MAX_OVERHEAD);
+    if (csize <= 0 || csize >= chunksize) {
+      printf("Compression error.  Error code: %" PRId64 "\n", csize);
+      return -1;
+    }
+    csize_f += csize;
+
+    dsize = blosc2_decompress_ctx(dctx, data_out, chunksize + BLOSC2_MAX_OVERHEAD, data_dest, chunksize);
+    if (dsize <= 0) {
+      printf("Decompression error.  Error code: %" PRId64 "\n", dsize);
+      return (int) dsize;
+    }
+
+    if (memcmp(data_in, data_dest, chunksize) != 0) {
+      printf("\n Decompressed data differs from original!\n");
+      return -1;
+    }
+  }
+  csize_f = csize_f / nchunks;
+
+  free(data_in);
+  free(data_out);
+  free(data_dest);
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+
+  printf("Successful roundtrip!\n");
+  printf("Compression: %d -> %" PRId64 " (%.1fx)\n", chunksize, csize_f, (1. * chunksize) / (double) csize_f);
+  return (int) (chunksize - csize_f);
+}
+
 
 int rand_() {
   int ndim = 2;
@@ -304,6 +369,48 @@ int some_matches() {
   return result;
 }
 
+int volume() {
+  int ndim = 3;
+  int typesize = 2;
+  int64_t shape[] = {20, 34, 40};
+  int32_t chunkshape[] = {10, 34, 40};
+  int32_t blockshape[] = {5, 16, 20};
+  int64_t nelem = 1;
+  for (int i = 0; i < ndim; ++i) {
+    nelem *= (int) (shape[i]);
+  }
+  int64_t size = typesize * nelem;
+  uint16_t *data = malloc(size);
+  // Noisy slices that repeat along the first dim, so that cells only match the previous slices
+  for (int64_t i = 0; i < shape[0]; i++) {
+    for (int64_t j = 0; j < shape[1] * shape[2]; j++) {
+      data[i * shape[1] * shape[2] + j] = (uint16_t) ((i / 10) * 1000 + (j * 7919) % 997);
+    }
+  }
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams};
+  b2_storage.contiguous = true;
+
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, shape, chunkshape, blockshape, NULL, 0,
+                                        NULL, 0);
+
+  b2nd_array_t *arr;
+  BLOSC_ERROR(b2nd_from_cbuffer(ctx, &arr, data, size));
+  blosc2_schunk *schunk = arr->sc;
+
+  /* Run the test. */
+  int result = test_ndlz_planes(schunk, 4);
+  if (result >= 0) {
+    result = test_ndlz_planes(schunk, 8);
+  }
+  BLOSC_ERROR(b2nd_free_ctx(ctx));
+  BLOSC_ERROR(b2nd_free(arr));
+  free(data);
+  return result;
+}
+
 
 int main(void) {
 
@@ -321,6 +428,10 @@ int main(void) {
   if (result < 0)
     return result;
   printf("some_matches: %d obtained \n \n", result);
+  result = volume();
+  if (result < 0)
+    return result;
+  printf("volume: %d obtained \n \n", result);
   blosc2_destroy();
 
   return BLOSC2_ERROR_SUCCESS;
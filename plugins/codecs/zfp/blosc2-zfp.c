@@ -14,207 +14,168 @@
 #include "context.h"
 #include "assert.h"
 #include "../plugins/plugin_utils.h"
+#include "b2nd_utils.h"
 
 
-int zfp_acc_compress(const uint8_t *input, int32_t input_len, uint8_t *output,
-                     int32_t output_len, uint8_t meta, blosc2_cparams *cparams, const void *chunk) {
-  BLOSC_UNUSED_PARAM(chunk);
-  ZFP_ERROR_NULL(input);
-  ZFP_ERROR_NULL(output);
-  ZFP_ERROR_NULL(cparams);
-
-  double tol = (int8_t) meta;
+/* The state shared by all the ZFP codecs, created once per thread context in zfp_init */
+typedef struct {
   int8_t ndim;
-  int64_t *shape = malloc(8 * sizeof(int64_t));
-  int32_t *chunkshape = malloc(8 * sizeof(int32_t));
-  int32_t *blockshape = malloc(8 * sizeof(int32_t));
+  int32_t blockshape[B2ND_MAX_DIM];
+  zfp_type type;
+  zfp_field *field;  /* array meta data (the pointer is set for every block) */
+  zfp_stream *zfp;  /* compressed stream (the mode is set for every block) */
+  bitstream *stream;  /* bit stream of zfp (it is pointed to the buffer of every block) */
+  uint8_t *aux_out;  /* auxiliary buffer for compressing */
+  size_t aux_out_len;
+} zfp_state;
+
+
+/* Fill a ZFP state from the b2nd metalayer of the super-chunk */
+static int zfp_state_fill(zfp_state *state, blosc2_schunk *schunk, int32_t typesize) {
+  memset(state, 0, sizeof(zfp_state));
   uint8_t *smeta;
   int32_t smeta_len;
-  if (blosc2_meta_get(cparams->schunk, "b2nd", &smeta, &smeta_len) < 0) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
+  if (schunk == NULL || blosc2_meta_get(schunk, "b2nd", &smeta, &smeta_len) < 0) {
     BLOSC_TRACE_ERROR("b2nd layer not found!");
     return BLOSC2_ERROR_FAILURE;
   }
-  deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape);
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  deserialize_meta(smeta, smeta_len, &state->ndim, shape, chunkshape, state->blockshape);
   free(smeta);
 
-  zfp_type type;     /* array scalar type */
-  zfp_field *field;  /* array meta data */
-  zfp_stream *zfp;   /* stream containing the real output buffer */
-  zfp_stream *zfp_aux;   /* auxiliary compressed stream */
-  bitstream *stream; /* bit stream to write to or read from */
-  bitstream *stream_aux; /* auxiliary bit stream to write to or read from */
-  size_t zfpsize;    /* byte size of compressed stream */
-  double tolerance = pow(10, tol);
-
-  int32_t typesize = cparams->typesize;
-
   switch (typesize) {
     case sizeof(float):
-      type = zfp_type_float;
+      state->type = zfp_type_float;
       break;
     case sizeof(double):
-      type = zfp_type_double;
+      state->type = zfp_type_double;
       break;
     default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
       BLOSC_TRACE_ERROR("ZFP is not available for typesize: %d", typesize);
       return BLOSC2_ERROR_FAILURE;
   }
 
-  zfp = zfp_stream_open(NULL);
-  zfp_stream_set_accuracy(zfp, tolerance);
-  stream = stream_open(output, output_len);
-  zfp_stream_set_bit_stream(zfp, stream);
-  zfp_stream_rewind(zfp);
-
-  switch (ndim) {
+  int32_t *blockshape = state->blockshape;
+  switch (state->ndim) {
     case 1:
-      field = zfp_field_1d((void *) input, type, blockshape[0]);
+      state->field = zfp_field_1d(NULL, state->type, blockshape[0]);
       break;
     case 2:
-      field = zfp_field_2d((void *) input, type, blockshape[1], blockshape[0]);
+      state->field = zfp_field_2d(NULL, state->type, blockshape[1], blockshape[0]);
       break;
     case 3:
-      field = zfp_field_3d((void *) input, type, blockshape[2], blockshape[1], blockshape[0]);
+      state->field = zfp_field_3d(NULL, state->type, blockshape[2], blockshape[1], blockshape[0]);
       break;
     case 4:
-      field = zfp_field_4d((void *) input, type, blockshape[3], blockshape[2], blockshape[1], blockshape[0]);
+      state->field = zfp_field_4d(NULL, state->type, blockshape[3], blockshape[2], blockshape[1], blockshape[0]);
       break;
     default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
-      BLOSC_TRACE_ERROR("ZFP is not available for ndims: %d", ndim);
+      BLOSC_TRACE_ERROR("ZFP is not available for ndims: %d", state->ndim);
       return BLOSC2_ERROR_FAILURE;
   }
 
-  int zfp_maxout = (int) zfp_stream_maximum_size(zfp, field);
-  zfp_stream_close(zfp);
-  stream_close(stream);
-  uint8_t *aux_out = malloc(zfp_maxout);
-  zfp_aux = zfp_stream_open(NULL);
-  zfp_stream_set_accuracy(zfp_aux, tolerance);
-  stream_aux = stream_open(aux_out, zfp_maxout);
-  zfp_stream_set_bit_stream(zfp_aux, stream_aux);
-  zfp_stream_rewind(zfp_aux);
+  state->stream = stream_open(NULL, 0);
+  state->zfp = zfp_stream_open(state->stream);
+  if (state->field == NULL || state->stream == NULL || state->zfp == NULL) {
+    BLOSC_TRACE_ERROR("Error allocating memory!");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
 
-  zfpsize = zfp_compress(zfp_aux, field);
+  return BLOSC2_ERROR_SUCCESS;
+}
 
-  /* clean up */
-  zfp_field_free(field);
-  zfp_stream_close(zfp_aux);
-  stream_close(stream_aux);
-  free(shape);
-  free(chunkshape);
-  free(blockshape);
 
-  if (zfpsize == 0) {
-    BLOSC_TRACE_ERROR("\n ZFP: Compression failed\n");
-    free(aux_out);
-    return (int) zfpsize;
+static void zfp_state_clear(zfp_state *state) {
+  if (state->field != NULL) {
+    zfp_field_free(state->field);
   }
-  if ((int32_t) zfpsize >= input_len) {
-    BLOSC_TRACE_ERROR("\n ZFP: Compressed data is bigger than input! \n");
-    free(aux_out);
-    return 0;
+  if (state->zfp != NULL) {
+    zfp_stream_close(state->zfp);
+  }
+  if (state->stream != NULL) {
+    stream_close(state->stream);
   }
+  free(state->aux_out);
+}
 
-  memcpy(output, aux_out, zfpsize);
-  free(aux_out);
 
-  return (int) zfpsize;
+int zfp_init(uint8_t meta, blosc2_cparams *cparams, blosc2_dparams *dparams, void **state) {
+  BLOSC_UNUSED_PARAM(meta);
+  blosc2_schunk *schunk;
+  int32_t typesize;
+  if (cparams != NULL) {
+    schunk = cparams->schunk;
+    typesize = cparams->typesize;
+  }
+  else {
+    schunk = dparams->schunk;
+    typesize = schunk != NULL ? schunk->typesize : 0;
+  }
+
+  zfp_state *zstate = malloc(sizeof(zfp_state));
+  BLOSC_ERROR_NULL(zstate, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = zfp_state_fill(zstate, schunk, typesize);
+  if (rc < 0) {
+    zfp_state_clear(zstate);
+    free(zstate);
+    return rc;
+  }
+  *state = zstate;
+
+  return BLOSC2_ERROR_SUCCESS;
 }
 
-int zfp_acc_decompress(const uint8_t *input, int32_t input_len, uint8_t *output,
-                       int32_t output_len, uint8_t meta, blosc2_dparams *dparams, const void *chunk) {
-  ZFP_ERROR_NULL(input);
-  ZFP_ERROR_NULL(output);
-  ZFP_ERROR_NULL(dparams);
-  BLOSC_UNUSED_PARAM(chunk);
 
-  blosc2_schunk *sc = dparams->schunk;
-  int32_t typesize = sc->typesize;
+void zfp_destroy(void *state) {
+  zfp_state_clear(state);
+  free(state);
+}
 
-  double tol = (int8_t) meta;
-  int8_t ndim;
-  int64_t *shape = malloc(8 * sizeof(int64_t));
-  int32_t *chunkshape = malloc(8 * sizeof(int32_t));
-  int32_t *blockshape = malloc(8 * sizeof(int32_t));
-  uint8_t *smeta;
-  int32_t smeta_len;
-  if (blosc2_meta_get(sc, "b2nd", &smeta, &smeta_len) < 0) {
-    BLOSC_TRACE_ERROR("Cannot access b2nd meta info");
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
-    return BLOSC2_ERROR_FAILURE;
+
+/* Compress a block with the stream of the state, whose mode is already set */
+static int zfp_block_compress(zfp_state *state, const uint8_t *input, int32_t input_len, uint8_t *output) {
+  zfp_stream *zfp = state->zfp;
+  zfp_field_set_pointer(state->field, (void *) input);
+  size_t zfp_maxout = zfp_stream_maximum_size(zfp, state->field);
+  if (state->aux_out_len < zfp_maxout) {
+    free(state->aux_out);
+    state->aux_out = malloc(zfp_maxout);
+    state->aux_out_len = state->aux_out != NULL ? zfp_maxout : 0;
+    if (state->aux_out == NULL) {
+      BLOSC_TRACE_ERROR("Error allocating memory!");
+      return BLOSC2_ERROR_MEMORY_ALLOC;
+    }
   }
-  deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape);
-  free(smeta);
+  stream_reopen(state->stream, state->aux_out, zfp_maxout);
+  zfp_stream_rewind(zfp);
 
-  zfp_type type;     /* array scalar type */
-  zfp_field *field;  /* array meta data */
-  zfp_stream *zfp;   /* compressed stream */
-  bitstream *stream; /* bit stream to write to or read from */
-  size_t zfpsize;    /* byte size of compressed stream */
-  double tolerance = pow(10, tol);
+  size_t zfpsize = zfp_compress(zfp, state->field);
 
-  switch (typesize) {
-    case sizeof(float):
-      type = zfp_type_float;
-      break;
-    case sizeof(double):
-      type = zfp_type_double;
-      break;
-    default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
-      BLOSC_TRACE_ERROR("ZFP is not available for typesize: %d", typesize);
-      return BLOSC2_ERROR_FAILURE;
+  if (zfpsize == 0) {
+    BLOSC_TRACE_ERROR("\n ZFP: Compression failed\n");
+    return (int) zfpsize;
+  }
+  if ((int32_t) zfpsize >= input_len) {
+    BLOSC_TRACE_ERROR("\n ZFP: Compressed data is bigger than input! \n");
+    return 0;
   }
 
-  zfp = zfp_stream_open(NULL);
-  zfp_stream_set_accuracy(zfp, tolerance);
-  stream = stream_open((void *) input, input_len);
-  zfp_stream_set_bit_stream(zfp, stream);
-  zfp_stream_rewind(zfp);
+  memcpy(output, state->aux_out, zfpsize);
 
-  switch (ndim) {
-    case 1:
-      field = zfp_field_1d((void *) output, type, blockshape[0]);
-      break;
-    case 2:
-      field = zfp_field_2d((void *) output, type, blockshape[1], blockshape[0]);
-      break;
-    case 3:
-      field = zfp_field_3d((void *) output, type, blockshape[2], blockshape[1], blockshape[0]);
-      break;
-    case 4:
-      field = zfp_field_4d((void *) output, type, blockshape[3], blockshape[2], blockshape[1], blockshape[0]);
-      break;
-    default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
-      BLOSC_TRACE_ERROR("ZFP is not available for ndims: %d", ndim);
-      return BLOSC2_ERROR_FAILURE;
-  }
+  return (int) zfpsize;
+}
 
-  zfpsize = zfp_decompress(zfp, field);
 
-  /* clean up */
-  zfp_field_free(field);
-  zfp_stream_close(zfp);
-  stream_close(stream);
-  free(shape);
-  free(chunkshape);
-  free(blockshape);
+/* Decompress a block with the stream of the state, whose mode is already set */
+static int zfp_block_decompress(zfp_state *state, const uint8_t *input, int32_t input_len,
+                                uint8_t *output, int32_t output_len) {
+  zfp_stream *zfp = state->zfp;
+  zfp_field_set_pointer(state->field, (void *) output);
+  stream_reopen(state->stream, (void *) input, input_len);
+  zfp_stream_rewind(zfp);
+
+  size_t zfpsize = zfp_decompress(zfp, state->field);
 
   if (zfpsize == 0) {
     BLOSC_TRACE_ERROR("\n ZFP: Decompression failed\n");
@@ -224,514 +185,310 @@ int zfp_acc_decompress(const uint8_t *input, int32_t input_len, uint8_t *output,
   return (int) output_len;
 }
 
-int zfp_prec_compress(const uint8_t *input, int32_t input_len, uint8_t *output,
-                      int32_t output_len, uint8_t meta, blosc2_cparams *cparams, const void *chunk) {
-  BLOSC_UNUSED_PARAM(chunk);
-  ZFP_ERROR_NULL(input);
-  ZFP_ERROR_NULL(output);
-  ZFP_ERROR_NULL(cparams);
-
-  int8_t ndim;
-  int64_t *shape = malloc(8 * sizeof(int64_t));
-  int32_t *chunkshape = malloc(8 * sizeof(int32_t));
-  int32_t *blockshape = malloc(8 * sizeof(int32_t));
-  uint8_t *smeta;
-  int32_t smeta_len;
-  if (blosc2_meta_get(cparams->schunk, "b2nd", &smeta, &smeta_len) < 0) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
-    BLOSC_TRACE_ERROR("b2nd layer not found!");
-    return BLOSC2_ERROR_FAILURE;
-  }
-  deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape);
-  free(smeta);
-
-  zfp_type type;     /* array scalar type */
-  zfp_field *field;  /* array meta data */
-  zfp_stream *zfp;   /* stream containing the real output buffer */
-  zfp_stream *zfp_aux;   /* auxiliary compressed stream */
-  bitstream *stream; /* bit stream to write to or read from */
-  bitstream *stream_aux; /* auxiliary bit stream to write to or read from */
-  size_t zfpsize;    /* byte size of compressed stream */
-
-  uint prec;
-  switch (ndim) {
-    case 1:
-      prec = meta + 5;
-      break;
-    case 2:
-      prec = meta + 7;
-      break;
-    case 3:
-      prec = meta + 9;
-      break;
-    case 4:
-      prec = meta + 11;
-      break;
-    default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
-      BLOSC_TRACE_ERROR("ZFP is not available for ndims: %d", ndim);
-      return BLOSC2_ERROR_FAILURE;
-  }
 
+static uint zfp_precision(int8_t ndim, uint8_t meta) {
+  // ndim has already been checked when filling the state
+  uint prec = meta + 3 + 2 * ndim;
   if (prec > ZFP_MAX_PREC) {
     BLOSC_TRACE_ERROR("Max precision for this codecs is %d", ZFP_MAX_PREC);
     prec = ZFP_MAX_PREC;
   }
+  return prec;
+}
 
-  int32_t typesize = cparams->typesize;
-  switch (typesize) {
-    case sizeof(float):
-      type = zfp_type_float;
-      break;
-    case sizeof(double):
-      type = zfp_type_double;
-      break;
-    default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
-      BLOSC_TRACE_ERROR("ZFP is not available for typesize: %d", typesize);
-      return BLOSC2_ERROR_FAILURE;
-  }
 
-  zfp = zfp_stream_open(NULL);
-  zfp_stream_set_precision(zfp, prec);
-  stream = stream_open(output, output_len);
-  zfp_stream_set_bit_stream(zfp, stream);
-  zfp_stream_rewind(zfp);
+int zfp_acc_compress(const uint8_t *input, int32_t input_len, uint8_t *output,
+                     int32_t output_len, uint8_t meta, blosc2_cparams *cparams, const void *chunk,
+                     void *plugin_state) {
+  BLOSC_UNUSED_PARAM(chunk);
+  BLOSC_UNUSED_PARAM(output_len);
+  ZFP_ERROR_NULL(input);
+  ZFP_ERROR_NULL(output);
+  ZFP_ERROR_NULL(cparams);
 
-  switch (ndim) {
-    case 1:
-      field = zfp_field_1d((void *) input, type, blockshape[0]);
-      break;
-    case 2:
-      field = zfp_field_2d((void *) input, type, blockshape[1], blockshape[0]);
-      break;
-    case 3:
-      field = zfp_field_3d((void *) input, type, blockshape[2], blockshape[1], blockshape[0]);
-      break;
-    case 4:
-      field = zfp_field_4d((void *) input, type, blockshape[3], blockshape[2], blockshape[1], blockshape[0]);
-      break;
-    default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
-      BLOSC_TRACE_ERROR("ZFP is not available for ndims: %d", ndim);
+  // Without a state from zfp_init (e.g. direct calls), parse the b2nd metalayer here
+  zfp_state local_state;
+  zfp_state *state = plugin_state;
+  if (state == NULL) {
+    state = &local_state;
+    if (zfp_state_fill(state, cparams->schunk, cparams->typesize) < 0) {
+      zfp_state_clear(state);
       return BLOSC2_ERROR_FAILURE;
+    }
   }
 
-  int zfp_maxout = (int) zfp_stream_maximum_size(zfp, field);
-  zfp_stream_close(zfp);
-  stream_close(stream);
-  uint8_t *aux_out = malloc(zfp_maxout);
-  zfp_aux = zfp_stream_open(NULL);
-  zfp_stream_set_precision(zfp_aux, prec);
-  stream_aux = stream_open(aux_out, zfp_maxout);
-  zfp_stream_set_bit_stream(zfp_aux, stream_aux);
-  zfp_stream_rewind(zfp_aux);
-
-  zfpsize = zfp_compress(zfp_aux, field);
-
-  /* clean up */
-  zfp_field_free(field);
-  zfp_stream_close(zfp_aux);
-  stream_close(stream_aux);
-  free(shape);
-  free(chunkshape);
-  free(blockshape);
+  double tol = (int8_t) meta;
+  zfp_stream *zfp = state->zfp;
+  zfp_stream_set_accuracy(zfp, pow(10, tol));
+  int zfpsize = zfp_block_compress(state, input, input_len, output);
 
-  if (zfpsize == 0) {
-    BLOSC_TRACE_ERROR("\n ZFP: Compression failed\n");
-    free(aux_out);
-    return (int) zfpsize;
+  if (state == &local_state) {
+    zfp_state_clear(state);
   }
-  if ((int32_t) zfpsize >= input_len) {
-    BLOSC_TRACE_ERROR("\n ZFP: Compressed data is bigger than input! \n");
-    free(aux_out);
-    return 0;
-  }
-
-  memcpy(output, aux_out, zfpsize);
-  free(aux_out);
-
-  return (int) zfpsize;
+  return zfpsize;
 }
 
-int zfp_prec_decompress(const uint8_t *input, int32_t input_len, uint8_t *output,
-                        int32_t output_len, uint8_t meta, blosc2_dparams *dparams, const void *chunk) {
+int zfp_acc_decompress(const uint8_t *input, int32_t input_len, uint8_t *output,
+                       int32_t output_len, uint8_t meta, blosc2_dparams *dparams, const void *chunk,
+                       void *plugin_state) {
   ZFP_ERROR_NULL(input);
   ZFP_ERROR_NULL(output);
   ZFP_ERROR_NULL(dparams);
   BLOSC_UNUSED_PARAM(chunk);
 
-  blosc2_schunk *sc = dparams->schunk;
-  int32_t typesize = sc->typesize;
-  int8_t ndim;
-  int64_t *shape = malloc(8 * sizeof(int64_t));
-  int32_t *chunkshape = malloc(8 * sizeof(int32_t));
-  int32_t *blockshape = malloc(8 * sizeof(int32_t));
-  uint8_t *smeta;
-  int32_t smeta_len;
-  if (blosc2_meta_get(sc, "b2nd", &smeta, &smeta_len) < 0) {
-    BLOSC_TRACE_ERROR("Cannot access b2nd meta info");
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
-    return BLOSC2_ERROR_FAILURE;
+  zfp_state local_state;
+  zfp_state *state = plugin_state;
+  if (state == NULL) {
+    state = &local_state;
+    blosc2_schunk *sc = dparams->schunk;
+    if (zfp_state_fill(state, sc, sc != NULL ? sc->typesize : 0) < 0) {
+      zfp_state_clear(state);
+      return BLOSC2_ERROR_FAILURE;
+    }
   }
-  deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape);
-  free(smeta);
 
-  zfp_type type;     /* array scalar type */
-  zfp_field *field;  /* array meta data */
-  zfp_stream *zfp;   /* compressed stream */
-  bitstream *stream; /* bit stream to write to or read from */
-  size_t zfpsize;    /* byte size of compressed stream */
+  double tol = (int8_t) meta;
+  zfp_stream *zfp = state->zfp;
+  zfp_stream_set_accuracy(zfp, pow(10, tol));
+  int nbytes = zfp_block_decompress(state, input, input_len, output, output_len);
 
-  uint prec;
-  switch (ndim) {
-    case 1:
-      prec = meta + 5;
-      break;
-    case 2:
-      prec = meta + 7;
-      break;
-    case 3:
-      prec = meta + 9;
-      break;
-    case 4:
-      prec = meta + 11;
-      break;
-    default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
-      BLOSC_TRACE_ERROR("ZFP is not available for ndims: %d", ndim);
-      return BLOSC2_ERROR_FAILURE;
+  if (state == &local_state) {
+    zfp_state_clear(state);
   }
+  return nbytes;
+}
 
-  if (prec > ZFP_MAX_PREC) {
-    BLOSC_TRACE_ERROR("Max precision for this codecs is %d", ZFP_MAX_PREC);
-    prec = ZFP_MAX_PREC;
-  }
+int zfp_prec_compress(const uint8_t *input, int32_t input_len, uint8_t *output,
+                      int32_t output_len, uint8_t meta, blosc2_cparams *cparams, const void *chunk,
+                      void *plugin_state) {
+  BLOSC_UNUSED_PARAM(chunk);
+  BLOSC_UNUSED_PARAM(output_len);
+  ZFP_ERROR_NULL(input);
+  ZFP_ERROR_NULL(output);
+  ZFP_ERROR_NULL(cparams);
 
-  switch (typesize) {
-    case sizeof(float):
-      type = zfp_type_float;
-      break;
-    case sizeof(double):
-      type = zfp_type_double;
-      break;
-    default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
-      BLOSC_TRACE_ERROR("ZFP is not available for typesize: %d", typesize);
+  zfp_state local_state;
+  zfp_state *state = plugin_state;
+  if (state == NULL) {
+    state = &local_state;
+    if (zfp_state_fill(state, cparams->schunk, cparams->typesize) < 0) {
+      zfp_state_clear(state);
       return BLOSC2_ERROR_FAILURE;
+    }
   }
 
-  zfp = zfp_stream_open(NULL);
-  zfp_stream_set_precision(zfp, prec);
-  stream = stream_open((void *) input, input_len);
-  zfp_stream_set_bit_stream(zfp, stream);
-  zfp_stream_rewind(zfp);
+  zfp_stream *zfp = state->zfp;
+  zfp_stream_set_precision(zfp, zfp_precision(state->ndim, meta));
+  int zfpsize = zfp_block_compress(state, input, input_len, output);
 
-  switch (ndim) {
-    case 1:
-      field = zfp_field_1d((void *) output, type, blockshape[0]);
-      break;
-    case 2:
-      field = zfp_field_2d((void *) output, type, blockshape[1], blockshape[0]);
-      break;
-    case 3:
-      field = zfp_field_3d((void *) output, type, blockshape[2], blockshape[1], blockshape[0]);
-      break;
-    case 4:
-      field = zfp_field_4d((void *) output, type, blockshape[3], blockshape[2], blockshape[1], blockshape[0]);
-      break;
-    default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
-      BLOSC_TRACE_ERROR("ZFP is not available for ndims: %d", ndim);
-      return BLOSC2_ERROR_FAILURE;
+  if (state == &local_state) {
+    zfp_state_clear(state);
   }
+  return zfpsize;
+}
 
-  zfpsize = zfp_decompress(zfp, field);
-
-  /* clean up */
-  zfp_field_free(field);
-  zfp_stream_close(zfp);
-  stream_close(stream);
-  free(shape);
-  free(chunkshape);
-  free(blockshape);
+int zfp_prec_decompress(const uint8_t *input, int32_t input_len, uint8_t *output,
+                        int32_t output_len, uint8_t meta, blosc2_dparams *dparams, const void *chunk,
+                        void *plugin_state) {
+  ZFP_ERROR_NULL(input);
+  ZFP_ERROR_NULL(output);
+  ZFP_ERROR_NULL(dparams);
+  BLOSC_UNUSED_PARAM(chunk);
 
-  if (zfpsize == 0) {
-    BLOSC_TRACE_ERROR("\n ZFP: Decompression failed\n");
-    return (int) zfpsize;
+  zfp_state local_state;
+  zfp_state *state = plugin_state;
+  if (state == NULL) {
+    state = &local_state;
+    blosc2_schunk *sc = dparams->schunk;
+    if (zfp_state_fill(state, sc, sc != NULL ? sc->typesize : 0) < 0) {
+      zfp_state_clear(state);
+      return BLOSC2_ERROR_FAILURE;
+    }
   }
 
-  return (int) output_len;
+  zfp_stream *zfp = state->zfp;
+  zfp_stream_set_precision(zfp, zfp_precision(state->ndim, meta));
+  int nbytes = zfp_block_decompress(state, input, input_len, output, output_len);
+
+  if (state == &local_state) {
+    zfp_state_clear(state);
+  }
+  return nbytes;
 }
 
 int zfp_rate_compress(const uint8_t *input, int32_t input_len, uint8_t *output,
-                      int32_t output_len, uint8_t meta, blosc2_cparams *cparams, const void *chunk) {
+                      int32_t output_len, uint8_t meta, blosc2_cparams *cparams, const void *chunk,
+                      void *plugin_state) {
   BLOSC_UNUSED_PARAM(chunk);
+  BLOSC_UNUSED_PARAM(output_len);
   ZFP_ERROR_NULL(input);
   ZFP_ERROR_NULL(output);
   ZFP_ERROR_NULL(cparams);
 
-  double ratio = (double) meta / 100.0;
-  int8_t ndim;
-  int64_t *shape = malloc(8 * sizeof(int64_t));
-  int32_t *chunkshape = malloc(8 * sizeof(int32_t));
-  int32_t *blockshape = malloc(8 * sizeof(int32_t));
-  uint8_t *smeta;
-  int32_t smeta_len;
-  if (blosc2_meta_get(cparams->schunk, "b2nd", &smeta, &smeta_len) < 0) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
-    BLOSC_TRACE_ERROR("b2nd layer not found!");
-    return BLOSC2_ERROR_FAILURE;
+  zfp_state local_state;
+  zfp_state *state = plugin_state;
+  if (state == NULL) {
+    state = &local_state;
+    if (zfp_state_fill(state, cparams->schunk, cparams->typesize) < 0) {
+      zfp_state_clear(state);
+      return BLOSC2_ERROR_FAILURE;
+    }
   }
-  deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape);
-  free(smeta);
-
-  zfp_type type;     /* array scalar type */
-  zfp_field *field;  /* array meta data */
-  zfp_stream *zfp;   /* stream containing the real output buffer */
-  zfp_stream *zfp_aux;   /* auxiliary compressed stream */
-  bitstream *stream; /* bit stream to write to or read from */
-  bitstream *stream_aux; /* auxiliary bit stream to write to or read from */
-  size_t zfpsize;    /* byte size of compressed stream */
 
+  double ratio = (double) meta / 100.0;
   int32_t typesize = cparams->typesize;
-
-  switch (typesize) {
-    case sizeof(float):
-      type = zfp_type_float;
-      break;
-    case sizeof(double):
-      type = zfp_type_double;
-      break;
-    default:
-      BLOSC_TRACE_ERROR("ZFP is not available for typesize: %d", typesize);
-      return BLOSC2_ERROR_FAILURE;
-  }
   double rate = ratio * typesize * 8;     // convert from output size / input size to output bits per input value
-  uint cellsize = 1u << (2 * ndim);
+  uint cellsize = 1u << (2 * state->ndim);
   double min_rate;
-  if (type == zfp_type_float) {
+  if (state->type == zfp_type_float) {
     min_rate = (double) (1 + 8u) / cellsize;
-    if (rate < min_rate) {
-      BLOSC_TRACE_ERROR("ZFP minimum rate for this item type is %f. Compression will be done using this one.\n",
-                        min_rate);
-    }
   }
   else {
     min_rate = (double) (1 + 11u) / cellsize;
-    if (rate < min_rate) {
-      BLOSC_TRACE_ERROR("ZFP minimum rate for this item type is %f. Compression will be done using this one.\n",
-                        min_rate);
-    }
   }
-  zfp = zfp_stream_open(NULL);
-  stream = stream_open(output, output_len);
-  zfp_stream_set_bit_stream(zfp, stream);
-  zfp_stream_rewind(zfp);
-
-  switch (ndim) {
-    case 1:
-      field = zfp_field_1d((void *) input, type, blockshape[0]);
-      break;
-    case 2:
-      field = zfp_field_2d((void *) input, type, blockshape[1], blockshape[0]);
-      break;
-    case 3:
-      field = zfp_field_3d((void *) input, type, blockshape[2], blockshape[1], blockshape[0]);
-      break;
-    case 4:
-      field = zfp_field_4d((void *) input, type, blockshape[3], blockshape[2], blockshape[1], blockshape[0]);
-      break;
-    default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
-      BLOSC_TRACE_ERROR("ZFP is not available for ndims: %d", ndim);
-      return BLOSC2_ERROR_FAILURE;
+  if (rate < min_rate) {
+    BLOSC_TRACE_ERROR("ZFP minimum rate for this item type is %f. Compression will be done using this one.\n",
+                      min_rate);
   }
 
-  int zfp_maxout = (int) zfp_stream_maximum_size(zfp, field);
-  zfp_stream_close(zfp);
-  stream_close(stream);
-  uint8_t *aux_out = malloc(zfp_maxout);
-  zfp_aux = zfp_stream_open(NULL);
-  stream_aux = stream_open(aux_out, zfp_maxout);
-  zfp_stream_set_bit_stream(zfp_aux, stream_aux);
-  zfp_stream_rewind(zfp_aux);
-  zfp_stream_set_rate(zfp_aux, rate, type, ndim, zfp_false);
+  zfp_stream *zfp = state->zfp;
+  zfp_stream_set_rate(zfp, rate, state->type, state->ndim, zfp_false);
+  int zfpsize = zfp_block_compress(state, input, input_len, output);
 
-  zfpsize = zfp_compress(zfp_aux, field);
-
-  /* clean up */
-  zfp_field_free(field);
-  zfp_stream_close(zfp_aux);
-  stream_close(stream_aux);
-  free(shape);
-  free(chunkshape);
-  free(blockshape);
-
-  if (zfpsize == 0) {
-    BLOSC_TRACE_ERROR("\n ZFP: Compression failed\n");
-    free(aux_out);
-    return (int) zfpsize;
+  if (state == &local_state) {
+    zfp_state_clear(state);
   }
-  if ((int32_t) zfpsize >= input_len) {
-    BLOSC_TRACE_ERROR("\n ZFP: Compressed data is bigger than input! \n");
-    free(aux_out);
-    return 0;
-  }
-
-  memcpy(output, aux_out, zfpsize);
-  free(aux_out);
-
-  return (int) zfpsize;
+  return zfpsize;
 }
 
 int zfp_rate_decompress(const uint8_t *input, int32_t input_len, uint8_t *output,
-                        int32_t output_len, uint8_t meta, blosc2_dparams *dparams, const void *chunk) {
+                        int32_t output_len, uint8_t meta, blosc2_dparams *dparams, const void *chunk,
+                        void *plugin_state) {
   ZFP_ERROR_NULL(input);
   ZFP_ERROR_NULL(output);
   ZFP_ERROR_NULL(dparams);
   BLOSC_UNUSED_PARAM(chunk);
 
   blosc2_schunk *sc = dparams->schunk;
-  int32_t typesize = sc->typesize;
+  zfp_state local_state;
+  zfp_state *state = plugin_state;
+  if (state == NULL) {
+    state = &local_state;
+    if (zfp_state_fill(state, sc, sc != NULL ? sc->typesize : 0) < 0) {
+      zfp_state_clear(state);
+      return BLOSC2_ERROR_FAILURE;
+    }
+  }
 
   double ratio = (double) meta / 100.0;
-  int8_t ndim;
-  int64_t *shape = malloc(8 * sizeof(int64_t));
-  int32_t *chunkshape = malloc(8 * sizeof(int32_t));
-  int32_t *blockshape = malloc(8 * sizeof(int32_t));
-  uint8_t *smeta;
-  int32_t smeta_len;
-  if (blosc2_meta_get(sc, "b2nd", &smeta, &smeta_len) < 0) {
-    BLOSC_TRACE_ERROR("Cannot access b2nd meta info");
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
-    return BLOSC2_ERROR_FAILURE;
+  double rate =
+      ratio * (double) sc->typesize * 8;     // convert from output size / input size to output bits per input value
+  zfp_stream *zfp = state->zfp;
+  zfp_stream_set_rate(zfp, rate, state->type, state->ndim, zfp_false);
+  int nbytes = zfp_block_decompress(state, input, input_len, output, output_len);
+
+  if (state == &local_state) {
+    zfp_state_clear(state);
   }
-  deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape);
-  free(smeta);
+  return nbytes;
+}
 
-  zfp_type type;     /* array scalar type */
-  zfp_field *field;  /* array meta data */
-  zfp_stream *zfp;   /* compressed stream */
-  bitstream *stream; /* bit stream to write to or read from */
-  size_t zfpsize;    /* byte size of compressed stream */
+/* Make sure that the blockshape of the super-chunk is filled, using the b2nd metalayer */
+static int fill_blockshape(blosc2_schunk *schunk) {
+  if (schunk->blockshape != NULL) {
+    return 0;
+  }
+  bool meta = false;
+  int8_t ndim = ZFP_MAX_DIM + 1;
+  int32_t blockmeta[ZFP_MAX_DIM];
+  for (int nmetalayer = 0; nmetalayer < schunk->nmetalayers; nmetalayer++) {
+    if (strcmp("b2nd", schunk->metalayers[nmetalayer]->name) == 0) {
+      meta = true;
+      uint8_t *pmeta = schunk->metalayers[nmetalayer]->content;
+      ndim = (int8_t) pmeta[2];
+      assert(ndim <= ZFP_MAX_DIM);
+      pmeta += (6 + ndim * 9 + ndim * 5);
+      for (int8_t i = 0; (uint8_t) i < ndim; i++) {
+        pmeta += 1;
+        swap_store(blockmeta + i, pmeta, sizeof(int32_t));
+        pmeta += sizeof(int32_t);
+      }
+    }
+  }
+  if (!meta) {
+    return -1;
+  }
+  schunk->ndim = ndim;
+  schunk->blockshape = malloc(sizeof(int64_t) * ndim);
+  for (int i = 0; i < ndim; ++i) {
+    schunk->blockshape[i] = (int64_t) blockmeta[i];
+  }
+  return 0;
+}
 
-  switch (typesize) {
-    case sizeof(float):
-      type = zfp_type_float;
-      break;
-    case sizeof(double):
-      type = zfp_type_double;
-      break;
-    default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
-      BLOSC_TRACE_ERROR("ZFP is not available for typesize: %d", typesize);
-      return BLOSC2_ERROR_FAILURE;
+/* Get the state for reading the cells of a block, filling `local_state` when there is no plugin state */
+static zfp_state *get_cells_state(void *plugin_state, blosc2_context *context, zfp_state *local_state) {
+  if (plugin_state != NULL) {
+    return plugin_state;
   }
-  double rate =
-      ratio * (double) typesize * 8;     // convert from output size / input size to output bits per input value
-  zfp = zfp_stream_open(NULL);
-  zfp_stream_set_rate(zfp, rate, type, ndim, zfp_false);
+  if (zfp_state_fill(local_state, context->schunk, context->typesize) < 0) {
+    zfp_state_clear(local_state);
+    return NULL;
+  }
+  return local_state;
+}
 
-  stream = stream_open((void *) input, input_len);
-  zfp_stream_set_bit_stream(zfp, stream);
+/* Point the stream of the state to a compressed block, for reading its cells in fixed-rate mode */
+static zfp_stream *open_rate_stream(zfp_state *state, blosc2_context *context, const uint8_t *block,
+                                    int32_t cbytes) {
+  zfp_stream *zfp = state->zfp;
+  uint8_t compmeta = context->compcode_meta;   // access to compressed chunk header
+  double rate = (double) (compmeta * context->typesize * 8) /
+                100.0;     // convert from output size / input size to output bits per input value
+  zfp_stream_set_rate(zfp, rate, state->type, state->ndim, zfp_false);
+
+  stream_reopen(state->stream, (void *) block, cbytes);
   zfp_stream_rewind(zfp);
+  return zfp;
+}
 
+/* Decode the cell at the current position of the stream; returns 0 on errors */
+static size_t decode_cell(zfp_stream *zfp, zfp_type type, int8_t ndim, uint8_t *cell) {
   switch (ndim) {
     case 1:
-      field = zfp_field_1d((void *) output, type, blockshape[0]);
-      break;
+      if (type == zfp_type_float) {
+        return zfp_decode_block_float_1(zfp, (float *) cell);
+      }
+      return zfp_decode_block_double_1(zfp, (double *) cell);
     case 2:
-      field = zfp_field_2d((void *) output, type, blockshape[1], blockshape[0]);
-      break;
+      if (type == zfp_type_float) {
+        return zfp_decode_block_float_2(zfp, (float *) cell);
+      }
+      return zfp_decode_block_double_2(zfp, (double *) cell);
     case 3:
-      field = zfp_field_3d((void *) output, type, blockshape[2], blockshape[1], blockshape[0]);
-      break;
+      if (type == zfp_type_float) {
+        return zfp_decode_block_float_3(zfp, (float *) cell);
+      }
+      return zfp_decode_block_double_3(zfp, (double *) cell);
     case 4:
-      field = zfp_field_4d((void *) output, type, blockshape[3], blockshape[2], blockshape[1], blockshape[0]);
-      break;
+      if (type == zfp_type_float) {
+        return zfp_decode_block_float_4(zfp, (float *) cell);
+      }
+      return zfp_decode_block_double_4(zfp, (double *) cell);
     default:
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
       BLOSC_TRACE_ERROR("ZFP is not available for ndims: %d", ndim);
-      return BLOSC2_ERROR_FAILURE;
-  }
-
-  zfpsize = zfp_decompress(zfp, field);
-
-  /* clean up */
-  zfp_field_free(field);
-  zfp_stream_close(zfp);
-  stream_close(stream);
-  free(shape);
-  free(chunkshape);
-  free(blockshape);
-
-  if (zfpsize == 0) {
-    BLOSC_TRACE_ERROR("\n ZFP: Decompression failed\n");
-    return (int) zfpsize;
+      return 0;
   }
-
-  return (int) output_len;
 }
 
-int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint8_t *dest, int32_t destsize) {
+int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint8_t *dest, int32_t destsize,
+                void *plugin_state) {
   struct thread_context *thread_ctx = thread_context;
   blosc2_context *context = thread_ctx->parent_context;
-  bool meta = false;
-  int8_t ndim = ZFP_MAX_DIM + 1;
-  int32_t blockmeta[ZFP_MAX_DIM];
-  if (context->schunk->blockshape == NULL) {
-    // blockshape is not filled yet.  Use the Blosc2 NDim layer to populate it.
-    for (int nmetalayer = 0; nmetalayer < context->schunk->nmetalayers; nmetalayer++) {
-      if (strcmp("b2nd", context->schunk->metalayers[nmetalayer]->name) == 0) {
-        meta = true;
-        uint8_t *pmeta = context->schunk->metalayers[nmetalayer]->content;
-        ndim = (int8_t) pmeta[2];
-        assert(ndim <= ZFP_MAX_DIM);
-        pmeta += (6 + ndim * 9 + ndim * 5);
-        for (int8_t i = 0; (uint8_t) i < ndim; i++) {
-          pmeta += 1;
-          swap_store(blockmeta + i, pmeta, sizeof(int32_t));
-          pmeta += sizeof(int32_t);
-        }
-      }
-    }
-    if (!meta) {
-      return -1;
-    }
-    context->schunk->ndim = ndim;
-    context->schunk->blockshape = malloc(sizeof(int64_t) * ndim);
-    for (int i = 0; i < ndim; ++i) {
-      context->schunk->blockshape[i] = (int64_t) blockmeta[i];
-    }
+  if (fill_blockshape(context->schunk) < 0) {
+    return -1;
   }
-  ndim = context->schunk->ndim;
+  int8_t ndim = context->schunk->ndim;
   int64_t *blockshape = context->schunk->blockshape;
 
   // Compute the coordinates of the cell
@@ -760,35 +517,20 @@ int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint
   }
 
   // Get the ZFP stream
-  zfp_type type;     /* array scalar type */
-  zfp_stream *zfp;   /* compressed stream */
-  bitstream *stream; /* bit stream to write to or read from */
   int32_t typesize = context->typesize;
-  zfp = zfp_stream_open(NULL);
-
-  switch (typesize) {
-    case sizeof(float):
-      type = zfp_type_float;
-      break;
-    case sizeof(double):
-      type = zfp_type_double;
-      break;
-    default:
-      BLOSC_TRACE_ERROR("ZFP is not available for typesize: %d", typesize);
-      return BLOSC2_ERROR_FAILURE;
+  zfp_state local_state;
+  zfp_state *state = get_cells_state(plugin_state, context, &local_state);
+  if (state == NULL) {
+    return BLOSC2_ERROR_FAILURE;
   }
-  uint8_t compmeta = context->compcode_meta;   // access to compressed chunk header
-  double rate = (double) (compmeta * typesize * 8) /
-                100.0;     // convert from output size / input size to output bits per input value
-  zfp_stream_set_rate(zfp, rate, type, ndim, zfp_false);
-
-  stream = stream_open((void *) block, cbytes);
-  zfp_stream_set_bit_stream(zfp, stream);
-  zfp_stream_rewind(zfp);
+  zfp_stream *zfp = open_rate_stream(state, context, block, cbytes);
 
   // Check that ncell is a valid index
   int ncells = (int) ((cbytes * 8) / zfp->maxbits);
   if (ncell >= ncells) {
+    if (state == &local_state) {
+      zfp_state_clear(state);
+    }
     BLOSC_TRACE_ERROR("Invalid cell index");
     return -1;
   }
@@ -797,48 +539,12 @@ int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint
   stream_rseek(zfp->stream, (size_t) (ncell * zfp->maxbits));
 
   // Get the cell
-  size_t zfpsize;
   uint8_t *cell = malloc(cell_nitems * typesize);
-  switch (ndim) {
-    case 1:
-      if (type == zfp_type_float) {
-        zfpsize = zfp_decode_block_float_1(zfp, (float *) cell);
-      }
-      else {
-        zfpsize = zfp_decode_block_double_1(zfp, (double *) cell);
-      }
-      break;
-    case 2:
-      if (type == zfp_type_float) {
-        zfpsize = zfp_decode_block_float_2(zfp, (float *) cell);
-      }
-      else {
-        zfpsize = zfp_decode_block_double_2(zfp, (double *) cell);
-      }
-      break;
-    case 3:
-      if (type == zfp_type_float) {
-        zfpsize = zfp_decode_block_float_3(zfp, (float *) cell);
-      }
-      else {
-        zfpsize = zfp_decode_block_double_3(zfp, (double *) cell);
-      }
-      break;
-    case 4:
-      if (type == zfp_type_float) {
-        zfpsize = zfp_decode_block_float_4(zfp, (float *) cell);
-      }
-      else {
-        zfpsize = zfp_decode_block_double_4(zfp, (double *) cell);
-      }
-      break;
-    default:
-      BLOSC_TRACE_ERROR("ZFP is not available for ndims: %d", ndim);
-      return BLOSC2_ERROR_FAILURE;
-  }
+  size_t zfpsize = decode_cell(zfp, state->type, ndim, cell);
   memcpy(dest, &cell[cell_ind * typesize], thread_ctx->zfp_cell_nitems * typesize);
-  zfp_stream_close(zfp);
-  stream_close(stream);
+  if (state == &local_state) {
+    zfp_state_clear(state);
+  }
   free(cell);
 
   if ((zfpsize == 0) || ((int32_t) zfpsize > (destsize * 8)) ||
@@ -850,3 +556,93 @@ int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint
 
   return (int) (thread_ctx->zfp_cell_nitems * typesize);
 }
+
+int zfp_getcells(void *thread_context, const uint8_t *block, int32_t cbytes, uint8_t *dest, int32_t destsize,
+                 void *plugin_state) {
+  struct thread_context *thread_ctx = thread_context;
+  blosc2_context *context = thread_ctx->parent_context;
+  if (fill_blockshape(context->schunk) < 0) {
+    return -1;
+  }
+  int8_t ndim = context->schunk->ndim;
+  int64_t *blockshape = context->schunk->blockshape;
+  const int64_t *start = thread_ctx->zfp_box_start;
+  const int64_t *stop = thread_ctx->zfp_box_stop;
+  int32_t typesize = context->typesize;
+
+  int64_t block_nitems = 1;
+  for (int i = 0; i < ndim; ++i) {
+    block_nitems *= blockshape[i];
+  }
+  if (block_nitems * typesize > destsize) {
+    BLOSC_TRACE_ERROR("Small destsize for getting ZFP cells");
+    return -1;
+  }
+
+  // The range of cells intersecting the box
+  int64_t cell_strides[ZFP_MAX_DIM];
+  int64_t first_cell[ZFP_MAX_DIM];
+  int64_t box_cells[ZFP_MAX_DIM];
+  int64_t nbox_cells = 1;
+  cell_strides[ndim - 1] = 1;
+  for (int i = ndim - 2; i >= 0; --i) {
+    cell_strides[i] = ((blockshape[i + 1] - 1) / ZFP_MAX_DIM + 1) * cell_strides[i + 1];
+  }
+  for (int i = 0; i < ndim; ++i) {
+    if (start[i] < 0 || stop[i] > blockshape[i] || start[i] >= stop[i]) {
+      BLOSC_TRACE_ERROR("Invalid box for getting ZFP cells");
+      return -1;
+    }
+    first_cell[i] = start[i] / ZFP_MAX_DIM;
+    box_cells[i] = (stop[i] - 1) / ZFP_MAX_DIM + 1 - first_cell[i];
+    nbox_cells *= box_cells[i];
+  }
+
+  zfp_state local_state;
+  zfp_state *state = get_cells_state(plugin_state, context, &local_state);
+  if (state == NULL) {
+    return BLOSC2_ERROR_FAILURE;
+  }
+  zfp_stream *zfp = open_rate_stream(state, context, block, cbytes);
+  int rc = (int) (block_nitems * typesize);
+  int64_t ncells = (int64_t) cbytes * 8 / zfp->maxbits;
+
+  // Decode every cell and copy its valid part (the ones in the block edges are partial) to dest
+  uint8_t cell[(1u << (2 * ZFP_MAX_DIM)) * sizeof(double)];
+  int64_t cell_shape[ZFP_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    cell_shape[i] = ZFP_MAX_DIM;
+  }
+  for (int64_t i = 0; i < nbox_cells; ++i) {
+    int64_t box_ndim[ZFP_MAX_DIM];
+    blosc2_unidim_to_multidim(ndim, box_cells, i, box_ndim);
+    int64_t ncell = 0;
+    int64_t cell_start[ZFP_MAX_DIM] = {0};
+    int64_t cell_stop[ZFP_MAX_DIM];
+    int64_t origin[ZFP_MAX_DIM];
+    for (int j = 0; j < ndim; ++j) {
+      int64_t c = first_cell[j] + box_ndim[j];
+      ncell += c * cell_strides[j];
+      origin[j] = c * ZFP_MAX_DIM;
+      cell_stop[j] = blockshape[j] - origin[j] < ZFP_MAX_DIM ? blockshape[j] - origin[j] : ZFP_MAX_DIM;
+    }
+    if (ncell >= ncells) {
+      BLOSC_TRACE_ERROR("Invalid cell index");
+      rc = -1;
+      break;
+    }
+    stream_rseek(zfp->stream, (size_t) (ncell * zfp->maxbits));
+    if (decode_cell(zfp, state->type, ndim, cell) == 0) {
+      BLOSC_TRACE_ERROR("ZFP error decoding a cell");
+      rc = -1;
+      break;
+    }
+    b2nd_copy_buffer(ndim, (uint8_t) typesize, cell, cell_shape, cell_start, cell_stop,
+                     dest, blockshape, origin);
+  }
+  if (state == &local_state) {
+    zfp_state_clear(state);
+  }
+
+  return rc;
+}
@@ -21,25 +21,35 @@ extern "C" {
 #endif
 
 
+int zfp_init(uint8_t meta, blosc2_cparams *cparams, blosc2_dparams *dparams, void **state);
+
+void zfp_destroy(void *state);
+
 int zfp_acc_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
-                     uint8_t meta, blosc2_cparams *cparams, const void *chunk);
+                     uint8_t meta, blosc2_cparams *cparams, const void *chunk, void *plugin_state);
 
 int zfp_acc_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
-                       uint8_t meta, blosc2_dparams *dparams, const void *chunk);
+                       uint8_t meta, blosc2_dparams *dparams, const void *chunk, void *plugin_state);
 
 int zfp_prec_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
-                      uint8_t meta, blosc2_cparams *cparams, const void *chunk);
+                      uint8_t meta, blosc2_cparams *cparams, const void *chunk, void *plugin_state);
 
 int zfp_prec_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
-                        uint8_t meta, blosc2_dparams *dparams, const void *chunk);
+                        uint8_t meta, blosc2_dparams *dparams, const void *chunk, void *plugin_state);
 
 int zfp_rate_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
-                      uint8_t meta, blosc2_cparams *cparams, const void *chunk);
+                      uint8_t meta, blosc2_cparams *cparams, const void *chunk, void *plugin_state);
 
 int zfp_rate_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
-                        uint8_t meta, blosc2_dparams *dparams, const void *chunk);
+                        uint8_t meta, blosc2_dparams *dparams, const void *chunk, void *plugin_state);
+
+int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint8_t *dest, int32_t destsize,
+                void *plugin_state);
 
-int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint8_t *dest, int32_t destsize);
+/* Decode only the cells intersecting the box set in the thread context.  The cells are written
+   in dest with the layout of the whole block. */
+int zfp_getcells(void *thread_context, const uint8_t *block, int32_t cbytes, uint8_t *dest, int32_t destsize,
+                 void *plugin_state);
 
 
 #if defined (__cplusplus)
@@ -21,6 +21,9 @@ bitstream* stream_open(void* buffer, size_t bytes);
 /* close and deallocate bit stream */
 void stream_close(bitstream* stream);
 
+/* point an open bit stream to another buffer (blosc2 addition, for reusing streams) */
+void stream_reopen(bitstream* stream, void* buffer, size_t bytes);
+
 /* make a copy of bit stream to shared memory buffer */
 bitstream* stream_clone(const bitstream* stream);
 
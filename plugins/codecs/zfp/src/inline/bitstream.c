@@ -451,6 +451,18 @@ stream_close(bitstream* s)
   free(s);
 }
 
+/* point an open bit stream to another buffer (blosc2 addition, for reusing streams) */
+inline_ void
+stream_reopen(bitstream* s, void* buffer, size_t bytes)
+{
+  s->begin = (word*)buffer;
+  s->end = s->begin + bytes / sizeof(word);
+#ifdef BIT_STREAM_STRIDED
+  stream_set_stride(s, 0, 0);
+#endif
+  stream_rewind(s);
+}
+
 /* make a copy of bit stream to shared memory buffer */
 inline_ bitstream*
 stream_clone(const bitstream* s)
@@ -0,0 +1,228 @@
+/*********************************************************************
+    Blosc - Blocked Shuffling and Compression Library
+
+    Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+    https://blosc.org
+    License: BSD 3-Clause (see LICENSE.txt)
+
+    See LICENSE.txt for details about copyright and rights to use.
+
+    Test for getting slices and orthogonal selections out of ZFP
+    fixed-rate arrays, which only decode the cells intersecting them.
+    To compile this program:
+
+    $ gcc -O test_zfp_rate_getcells.c -o test_zfp_rate_getcells -lblosc2
+
+
+**********************************************************************/
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blosc2.h"
+#include "blosc2/codecs-registry.h"
+#include "b2nd.h"
+
+#define NSLICES 50
+
+
+static int64_t buffer_index(int8_t ndim, const int64_t *shape, const int64_t *index) {
+  int64_t ind = 0;
+  for (int i = 0; i < ndim; ++i) {
+    ind = ind * shape[i] + index[i];
+  }
+  return ind;
+}
+
+/* Check the slice [start, stop) out of the array against the fully decompressed one */
+static int check_slice(b2nd_array_t *arr, const uint8_t *full, const int64_t *start, const int64_t *stop) {
+  int8_t ndim = arr->ndim;
+  int32_t typesize = arr->sc->typesize;
+  int64_t slice_shape[B2ND_MAX_DIM] = {0};
+  int64_t slice_nitems = 1;
+  for (int i = 0; i < ndim; ++i) {
+    slice_shape[i] = stop[i] - start[i];
+    slice_nitems *= slice_shape[i];
+  }
+  uint8_t *slice = malloc(slice_nitems * typesize);
+  int rc = b2nd_get_slice_cbuffer(arr, start, stop, slice, slice_shape, slice_nitems * typesize);
+  if (rc < 0) {
+    printf("Error getting slice\n");
+    free(slice);
+    return rc;
+  }
+  for (int64_t i = 0; i < slice_nitems; ++i) {
+    int64_t index[B2ND_MAX_DIM];
+    int64_t rem = i;
+    for (int j = ndim - 1; j >= 0; --j) {
+      index[j] = start[j] + rem % slice_shape[j];
+      rem /= slice_shape[j];
+    }
+    int64_t ind = buffer_index(ndim, arr->shape, index);
+    if (memcmp(&slice[i * typesize], &full[ind * typesize], typesize) != 0) {
+      printf("Different item %" PRId64 " in slice\n", i);
+      free(slice);
+      return -1;
+    }
+  }
+  free(slice);
+  return 0;
+}
+
+/* Check an orthogonal selection with nsel random coordinates per dimension */
+static int check_selection(b2nd_array_t *arr, const uint8_t *full, int nsel) {
+  int8_t ndim = arr->ndim;
+  int32_t typesize = arr->sc->typesize;
+  int64_t sel[B2ND_MAX_DIM][4];
+  int64_t *selection[B2ND_MAX_DIM];
+  int64_t selection_size[B2ND_MAX_DIM];
+  int64_t sel_nitems = 1;
+  for (int i = 0; i < ndim; ++i) {
+    // Close coordinates, so that they fall in a few cells
+    int64_t first = rand() % (arr->shape[i] - 3);
+    for (int j = 0; j < nsel; ++j) {
+      sel[i][j] = first + rand() % 3;
+    }
+    selection[i] = sel[i];
+    selection_size[i] = nsel;
+    sel_nitems *= nsel;
+  }
+  uint8_t *buffer = malloc(sel_nitems * typesize);
+  int rc = b2nd_get_orthogonal_selection(arr, selection, selection_size, buffer, selection_size,
+                                         sel_nitems * typesize);
+  if (rc < 0) {
+    printf("Error getting orthogonal selection\n");
+    free(buffer);
+    return rc;
+  }
+  for (int64_t i = 0; i < sel_nitems; ++i) {
+    int64_t index[B2ND_MAX_DIM];
+    int64_t rem = i;
+    for (int j = ndim - 1; j >= 0; --j) {
+      index[j] = sel[j][rem % nsel];
+      rem /= nsel;
+    }
+    int64_t ind = buffer_index(ndim, arr->shape, index);
+    if (memcmp(&buffer[i * typesize], &full[ind * typesize], typesize) != 0) {
+      printf("Different item %" PRId64 " in orthogonal selection\n", i);
+      free(buffer);
+      return -1;
+    }
+  }
+  free(buffer);
+  return 0;
+}
+
+static int test_getcells(int8_t ndim, const int64_t *shape, const int32_t *chunkshape,
+                         const int32_t *blockshape, int32_t typesize, const char *urlpath) {
+  int64_t nelem = 1;
+  for (int i = 0; i < ndim; ++i) {
+    nelem *= shape[i];
+  }
+  int64_t size = nelem * typesize;
+  uint8_t *data = malloc(size);
+  for (int64_t i = 0; i < nelem; ++i) {
+    double value = (double) (i % 101) / 7. + (double) (i / 13);
+    if (typesize == sizeof(float)) {
+      ((float *) data)[i] = (float) value;
+    } else {
+      ((double *) data)[i] = value;
+    }
+  }
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  cparams.compcode = BLOSC_CODEC_ZFP_FIXED_RATE;
+  cparams.compcode_meta = 50;
+  cparams.splitmode = BLOSC_NEVER_SPLIT;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_NOFILTER;
+  cparams.nthreads = 1;
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=true, .urlpath=(char *) urlpath};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, shape, chunkshape, blockshape, NULL, 0,
+                                        NULL, 0);
+  blosc2_remove_urlpath(urlpath);
+  b2nd_array_t *arr;
+  BLOSC_ERROR(b2nd_from_cbuffer(ctx, &arr, data, size));
+  if (urlpath != NULL) {
+    // Reopen it, so that the chunks are lazy
+    BLOSC_ERROR(b2nd_free(arr));
+    BLOSC_ERROR(b2nd_open(urlpath, &arr));
+  }
+
+  // The whole array decompresses all the cells of every block
+  uint8_t *full = malloc(size);
+  BLOSC_ERROR(b2nd_to_cbuffer(arr, full, size));
+
+  srand(1);
+  int rc = 0;
+  for (int n = 0; n < NSLICES && rc == 0; ++n) {
+    // Points and small boxes
+    int64_t start[B2ND_MAX_DIM];
+    int64_t stop[B2ND_MAX_DIM];
+    for (int i = 0; i < ndim; ++i) {
+      start[i] = rand() % shape[i];
+      stop[i] = start[i] + 1 + (n % 2) * (rand() % 6);
+      if (stop[i] > shape[i]) {
+        stop[i] = shape[i];
+      }
+    }
+    rc = check_slice(arr, full, start, stop);
+    if (rc == 0) {
+      rc = check_selection(arr, full, 1 + n % 4);
+    }
+  }
+
+  free(data);
+  free(full);
+  BLOSC_ERROR(b2nd_free(arr));
+  BLOSC_ERROR(b2nd_free_ctx(ctx));
+  blosc2_remove_urlpath(urlpath);
+  return rc;
+}
+
+int float_2d(void) {
+  int64_t shape[] = {50, 70};
+  int32_t chunkshape[] = {25, 40};
+  int32_t blockshape[] = {10, 22};
+  return test_getcells(2, shape, chunkshape, blockshape, sizeof(float), NULL);
+}
+
+int double_3d(void) {
+  int64_t shape[] = {20, 30, 40};
+  int32_t chunkshape[] = {12, 20, 24};
+  int32_t blockshape[] = {6, 10, 12};
+  return test_getcells(3, shape, chunkshape, blockshape, sizeof(double), NULL);
+}
+
+int float_3d_frame(void) {
+  int64_t shape[] = {20, 30, 40};
+  int32_t chunkshape[] = {12, 20, 24};
+  int32_t blockshape[] = {6, 10, 12};
+  return test_getcells(3, shape, chunkshape, blockshape, sizeof(float), "test_zfp_rate_getcells.b2nd");
+}
+
+
+int main(void) {
+
+  int result;
+  blosc2_init();   // this is mandatory for initiallizing the plugin mechanism
+  printf("float_2d: ");
+  result = float_2d();
+  if (result < 0)
+    return result;
+  printf("Successful getcells!\n");
+  printf("double_3d: ");
+  result = double_3d();
+  if (result < 0)
+    return result;
+  printf("Successful getcells!\n");
+  printf("float_3d_frame: ");
+  result = float_3d_frame();
+  if (result < 0)
+    return result;
+  printf("Successful getcells!\n");
+  blosc2_destroy();
+
+  return BLOSC2_ERROR_SUCCESS;
+}
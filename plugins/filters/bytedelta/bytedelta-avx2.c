@@ -0,0 +1,67 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "bytedelta-avx2.h"
+
+/* Make sure AVX2 is available for the compilation target and compiler. */
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+
+void bytedelta_encode_avx2(const uint8_t *input, uint8_t *output, int32_t len) {
+  __m256i prev = _mm256_setzero_si256();
+  int32_t ip = 0;
+  for (; ip < len - 31; ip += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(input + ip));
+    // The previous byte for every byte, crossing the 128-bit lanes
+    __m256i shifted = _mm256_alignr_epi8(v, _mm256_permute2x128_si256(prev, v, 0x21), 15);
+    _mm256_storeu_si256((__m256i *)(output + ip), _mm256_sub_epi8(v, shifted));
+    prev = v;
+  }
+  // Leftovers
+  uint8_t last = (ip > 0) ? input[ip - 1] : 0;
+  for (; ip < len; ip++) {
+    output[ip] = input[ip] - last;
+    last = input[ip];
+  }
+}
+
+
+void bytedelta_decode_avx2(const uint8_t *input, uint8_t *output, int32_t len) {
+  const __m256i lane_last = _mm256_set1_epi8(15);
+  const __m256i qword_last = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 7, 7, 7, 7, 7, 7, 7, 7,
+                                              -1, -1, -1, -1, -1, -1, -1, -1, 7, 7, 7, 7, 7, 7, 7, 7);
+  // The last decoded byte, broadcast
+  __m256i carry = _mm256_setzero_si256();
+  int32_t ip = 0;
+  for (; ip < len - 31; ip += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(input + ip));
+    // Prefix sum within each 128-bit lane (see bytedelta.c)
+    x = _mm256_add_epi8(x, _mm256_slli_epi64(x, 8));
+    x = _mm256_add_epi8(x, _mm256_slli_epi64(x, 16));
+    x = _mm256_add_epi8(x, _mm256_slli_epi64(x, 32));
+    x = _mm256_add_epi8(x, _mm256_shuffle_epi8(x, qword_last));
+    // Add the sum of the low lane to the high one
+    __m256i sums = _mm256_shuffle_epi8(x, lane_last);
+    x = _mm256_add_epi8(x, _mm256_permute2x128_si256(sums, sums, 0x08));
+    x = _mm256_add_epi8(x, carry);
+    _mm256_storeu_si256((__m256i *)(output + ip), x);
+    carry = _mm256_shuffle_epi8(_mm256_permute2x128_si256(x, x, 0x11), lane_last);
+  }
+  // Leftovers
+  uint8_t last = (ip > 0) ? output[ip - 1] : 0;
+  for (; ip < len; ip++) {
+    last += input[ip];
+    output[ip] = last;
+  }
+}
+
+#endif /* defined(__AVX2__) */
@@ -0,0 +1,71 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "bytedelta-avx512.h"
+
+/* Make sure AVX512BW is available for the compilation target and compiler. */
+#if defined(__AVX512BW__)
+
+#include <immintrin.h>
+
+
+void bytedelta_encode_avx512(const uint8_t *input, uint8_t *output, int32_t len) {
+  __m512i prev = _mm512_setzero_si512();
+  int32_t ip = 0;
+  for (; ip < len - 63; ip += 64) {
+    __m512i v = _mm512_loadu_si512((const void *)(input + ip));
+    // The previous byte for every byte, crossing the 128-bit lanes
+    __m512i shifted = _mm512_alignr_epi8(v, _mm512_alignr_epi64(v, prev, 6), 15);
+    _mm512_storeu_si512((void *)(output + ip), _mm512_sub_epi8(v, shifted));
+    prev = v;
+  }
+  // Leftovers
+  uint8_t last = (ip > 0) ? input[ip - 1] : 0;
+  for (; ip < len; ip++) {
+    output[ip] = input[ip] - last;
+    last = input[ip];
+  }
+}
+
+
+void bytedelta_decode_avx512(const uint8_t *input, uint8_t *output, int32_t len) {
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i lane_last = _mm512_set1_epi8(15);
+  const __m512i qword_last = _mm512_broadcast_i32x4(
+          _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 7, 7, 7, 7, 7, 7, 7, 7));
+  // The last decoded byte, broadcast
+  __m512i carry = zero;
+  int32_t ip = 0;
+  for (; ip < len - 63; ip += 64) {
+    __m512i x = _mm512_loadu_si512((const void *)(input + ip));
+    // Prefix sum within each 128-bit lane (see bytedelta.c)
+    x = _mm512_add_epi8(x, _mm512_slli_epi64(x, 8));
+    x = _mm512_add_epi8(x, _mm512_slli_epi64(x, 16));
+    x = _mm512_add_epi8(x, _mm512_slli_epi64(x, 32));
+    x = _mm512_add_epi8(x, _mm512_shuffle_epi8(x, qword_last));
+    // Add the sums of the previous lanes: [0, t0, t1, t2] and then [0, 0, t0, t0 + t1]
+    __m512i sums = _mm512_shuffle_epi8(x, lane_last);
+    __m512i sums1 = _mm512_alignr_epi64(sums, zero, 6);
+    x = _mm512_add_epi8(x, sums1);
+    sums = _mm512_add_epi8(sums, sums1);
+    x = _mm512_add_epi8(x, _mm512_alignr_epi64(sums, zero, 4));
+    x = _mm512_add_epi8(x, carry);
+    _mm512_storeu_si512((void *)(output + ip), x);
+    carry = _mm512_shuffle_epi8(_mm512_shuffle_i64x2(x, x, 0xff), lane_last);
+  }
+  // Leftovers
+  uint8_t last = (ip > 0) ? output[ip - 1] : 0;
+  for (; ip < len; ip++) {
+    last += input[ip];
+    output[ip] = last;
+  }
+}
+
+#endif /* defined(__AVX512BW__) */
@@ -0,0 +1,36 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* AVX512-accelerated routines for the ByteDelta filter. */
+
+#ifndef BYTEDELTA_AVX512_H
+#define BYTEDELTA_AVX512_H
+
+#include "blosc2/blosc2-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+  Compute the delta of every byte in a stream of `len` bytes with the previous one.
+*/
+BLOSC_NO_EXPORT void bytedelta_encode_avx512(const uint8_t *input, uint8_t *output, int32_t len);
+
+/**
+  Undo bytedelta_encode_avx512() via a prefix sum.
+*/
+BLOSC_NO_EXPORT void bytedelta_decode_avx512(const uint8_t *input, uint8_t *output, int32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BYTEDELTA_AVX512_H */
@@ -17,6 +17,15 @@
 #include <stdio.h>
 #include "../plugins/plugin_utils.h"
 #include "../include/blosc2/filters-registry.h"
+#include "shuffle.h"
+
+/* Toggle the wider implementations based on BYTEDELTA_*_ENABLED macros */
+#if defined(BYTEDELTA_AVX2_ENABLED)
+#include "bytedelta-avx2.h"
+#endif
+#if defined(BYTEDELTA_AVX512_ENABLED)
+#include "bytedelta-avx512.h"
+#endif
 
 #if defined __i386__ || defined _M_IX86 || defined __x86_64__ || defined _M_X64
 // SSSE3 code path for x64/x64
@@ -73,7 +82,73 @@ bytes16 simd_prefix_sum(bytes16 x)
 #endif
 
 
-// Fetch 16b from N streams, compute SIMD delta
+// The part of each stream that is processed with the vectorized delta.  The scalar leftover
+// starts again from 0, so this must be the same for all the implementations.
+#if defined(CPU_HAS_SIMD)
+#define VECTOR_LEN(stream_len) ((stream_len) / 16 * 16)
+#else
+#define VECTOR_LEN(stream_len) 0
+#endif
+
+#if defined(CPU_HAS_SIMD)
+// Fetch 16b from a stream, compute SIMD delta
+static void bytedelta_encode_simd(const uint8_t *input, uint8_t *output, int32_t len) {
+  bytes16 v2 = {0};
+  for (int ip = 0; ip < len; ip += 16) {
+    bytes16 v = simd_load(input + ip);
+    bytes16 delta = simd_sub(v, simd_concat(v, v2));
+    simd_store(output + ip, delta);
+    v2 = v;
+  }
+}
+
+// Fetch 16b from a stream, sum SIMD undelta
+static void bytedelta_decode_simd(const uint8_t *input, uint8_t *output, int32_t len) {
+  bytes16 v2 = {0};
+  for (int ip = 0; ip < len; ip += 16) {
+    bytes16 v = simd_load(input + ip);
+    // un-delta via prefix sum
+    v2 = simd_add(simd_prefix_sum(v), simd_duplane15(v2));
+    simd_store(output + ip, v2);
+  }
+}
+#endif // #if defined(CPU_HAS_SIMD)
+
+typedef void (*bytedelta_func)(const uint8_t *input, uint8_t *output, int32_t len);
+
+/* The vectorized implementations chosen at run-time (NULL when there are none) */
+static bytedelta_func encode_stream = NULL;
+static bytedelta_func decode_stream = NULL;
+static int32_t implementation_initialized = 0;
+
+/* As for shuffle, concurrent initializations are harmless because they get the same result */
+static void init_bytedelta_implementation(void) {
+  if (implementation_initialized) {
+    return;
+  }
+  blosc_cpu_features cpu_features = blosc_get_cpu_features();
+  BLOSC_UNUSED_PARAM(cpu_features);
+#if defined(CPU_HAS_SIMD)
+  encode_stream = bytedelta_encode_simd;
+  decode_stream = bytedelta_decode_simd;
+#endif
+#if defined(BYTEDELTA_AVX2_ENABLED) && defined(CPU_HAS_SIMD)
+  if (cpu_features & BLOSC_HAVE_AVX2) {
+    encode_stream = bytedelta_encode_avx2;
+    decode_stream = bytedelta_decode_avx2;
+  }
+#endif
+#if defined(BYTEDELTA_AVX512_ENABLED) && defined(CPU_HAS_SIMD)
+  if (cpu_features & BLOSC_HAVE_AVX512) {
+    encode_stream = bytedelta_encode_avx512;
+    decode_stream = bytedelta_decode_avx512;
+  }
+#endif
+  implementation_initialized = 1;
+}
+
+
+// Compute the delta of N streams
 int bytedelta_encoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_t meta,
                       blosc2_cparams *cparams, uint8_t id) {
   BLOSC_UNUSED_PARAM(id);
@@ -87,22 +162,19 @@ int bytedelta_encoder(const uint8_t *input, uint8_t *output, int32_t length, uin
     blosc2_schunk* schunk = (blosc2_schunk*)(cparams->schunk);
     typesize = schunk->typesize;
   }
+  init_bytedelta_implementation();
 
   const int stream_len = length / typesize;
+  const int vector_len = VECTOR_LEN(stream_len);
   for (int ich = 0; ich < typesize; ++ich) {
     int ip = 0;
     // SIMD delta within each channel, store
-#if defined(CPU_HAS_SIMD)
-    bytes16 v2 = {0};
-    for (; ip < stream_len - 15; ip += 16) {
-      bytes16 v = simd_load(input);
-      input += 16;
-      bytes16 delta = simd_sub(v, simd_concat(v, v2));
-      simd_store(output, delta);
-      output += 16;
-      v2 = v;
+    if (vector_len > 0) {
+      encode_stream(input, output, vector_len);
+      input += vector_len;
+      output += vector_len;
+      ip = vector_len;
     }
-#endif // #if defined(CPU_HAS_SIMD)
     // scalar leftover
     uint8_t _v2 = 0;
     for (; ip < stream_len ; ip++) {
@@ -117,7 +189,7 @@ int bytedelta_encoder(const uint8_t *input, uint8_t *output, int32_t length, uin
   return BLOSC2_ERROR_SUCCESS;
 }
 
-// Fetch 16b from N streams, sum SIMD undelta
+// Undo the delta of N streams
 int bytedelta_decoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_t meta,
                       blosc2_dparams *dparams, uint8_t id) {
   BLOSC_UNUSED_PARAM(id);
@@ -131,22 +203,19 @@ int bytedelta_decoder(const uint8_t *input, uint8_t *output, int32_t length, uin
     blosc2_schunk* schunk = (blosc2_schunk*)(dparams->schunk);
     typesize = schunk->typesize;
   }
+  init_bytedelta_implementation();
 
   const int stream_len = length / typesize;
+  const int vector_len = VECTOR_LEN(stream_len);
   for (int ich = 0; ich < typesize; ++ich) {
     int ip = 0;
-    // SIMD fetch 16 bytes from each channel, prefix-sum un-delta
-#if defined(CPU_HAS_SIMD)
-    bytes16 v2 = {0};
-    for (; ip < stream_len - 15; ip += 16) {
-      bytes16 v = simd_load(input);
-      input += 16;
-      // un-delta via prefix sum
-      v2 = simd_add(simd_prefix_sum(v), simd_duplane15(v2));
-      simd_store(output, v2);
-      output += 16;
+    // SIMD prefix-sum un-delta within each channel
+    if (vector_len > 0) {
+      decode_stream(input, output, vector_len);
+      input += vector_len;
+      output += vector_len;
+      ip = vector_len;
     }
-#endif // #if defined(CPU_HAS_SIMD)
     // scalar leftover
     uint8_t _v2 = 0;
     for (; ip < stream_len; ip++) {
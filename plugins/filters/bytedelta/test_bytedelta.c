@@ -33,6 +33,7 @@
 #include <inttypes.h>
 #include "blosc2/filters-registry.h"
 #include "b2nd.h"
+#include "bytedelta.h"
 
 static int test_bytedelta(blosc2_schunk *schunk) {
 
@@ -234,10 +235,68 @@ int arange_like() {
 }
 
 
+/* Check the encoded streams against a scalar reference for every SIMD width.
+   The delta runs over the 16-byte aligned part of a stream, and the
+   leftover restarts from 0, so the format does not depend on the CPU. */
+int stream_format() {
+  int typesize = 4;
+  int32_t maxlen = 300 * typesize;
+  uint8_t *src = malloc(maxlen);
+  uint8_t *ref = malloc(maxlen);
+  uint8_t *enc = malloc(maxlen);
+  uint8_t *dec = malloc(maxlen);
+  for (int i = 0; i < maxlen; i++) {
+    src[i] = (uint8_t) (rand() % 256);
+  }
+
+  for (int32_t stream_len = 1; stream_len <= maxlen / typesize; stream_len++) {
+    int32_t length = stream_len * typesize;
+    int32_t vector_len = stream_len / 16 * 16;
+    for (int ich = 0; ich < typesize; ich++) {
+      const uint8_t *ip = src + ich * stream_len;
+      uint8_t *op = ref + ich * stream_len;
+      uint8_t prev = 0;
+      for (int i = 0; i < stream_len; i++) {
+        if (i == vector_len) {
+          prev = 0;
+        }
+        op[i] = ip[i] - prev;
+        prev = ip[i];
+      }
+    }
+
+    if (bytedelta_encoder(src, enc, length, (uint8_t) typesize, NULL, BLOSC_FILTER_BYTEDELTA) < 0 ||
+        bytedelta_decoder(enc, dec, length, (uint8_t) typesize, NULL, BLOSC_FILTER_BYTEDELTA) < 0) {
+      printf("Error running the filter\n");
+      return -1;
+    }
+    if (memcmp(enc, ref, length) != 0) {
+      printf("Encoded stream of length %d differs from the reference!\n", stream_len);
+      return -1;
+    }
+    if (memcmp(dec, src, length) != 0) {
+      printf("Decoded stream of length %d differs from the original!\n", stream_len);
+      return -1;
+    }
+  }
+
+  free(src);
+  free(ref);
+  free(enc);
+  free(dec);
+  printf("Successful stream format check!\n");
+  return 0;
+}
+
+
 int main(void) {
   int result;
   blosc2_init();
 
+  result = stream_format();
+  if (result < 0)
+    return result;
+
   result = rand_();
   printf("rand: saved %d bytes \n \n", result);
   if (result < 0)
@@ -9,20 +9,21 @@
 #include "ndmean/ndmean.h"
 #include "ndcell/ndcell.h"
 #include "bytedelta/bytedelta.h"
+#include "../plugin_utils.h"
 
 void register_filters(void) {
 
   blosc2_filter ndcell;
   ndcell.id = BLOSC_FILTER_NDCELL;
-  ndcell.forward = (blosc2_filter_forward_cb) ndcell_encoder;
-  ndcell.backward = (blosc2_filter_backward_cb) ndcell_decoder;
-  register_filter_private(&ndcell);
+  ndcell.forward = NULL;
+  ndcell.backward = NULL;
+  register_filter_ex_private(&ndcell, b2nd_meta_init, b2nd_meta_destroy, ndcell_encoder, ndcell_decoder);
 
   blosc2_filter ndmean;
   ndmean.id = BLOSC_FILTER_NDMEAN;
-  ndmean.forward = (blosc2_filter_forward_cb) ndmean_encoder;
-  ndmean.backward = (blosc2_filter_backward_cb) ndmean_decoder;
-  register_filter_private(&ndmean);
+  ndmean.forward = NULL;
+  ndmean.backward = NULL;
+  register_filter_ex_private(&ndmean, b2nd_meta_init, b2nd_meta_destroy, ndmean_encoder, ndmean_decoder);
 
   blosc2_filter bytedelta;
   bytedelta.id = BLOSC_FILTER_BYTEDELTA;
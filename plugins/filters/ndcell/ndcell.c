@@ -17,20 +17,15 @@
 
 
 int ndcell_encoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_t meta, blosc2_cparams *cparams,
-                   uint8_t id) {
+                   uint8_t id, void *plugin_state) {
   BLOSC_UNUSED_PARAM(id);
-  uint8_t *smeta;
-  int32_t smeta_len;
-  if (blosc2_meta_get(cparams->schunk, "b2nd", &smeta, &smeta_len) < 0) {
-    BLOSC_TRACE_ERROR("b2nd layer not found!");
+  int8_t ndim;
+  int64_t shape[8];
+  int32_t chunkshape[8];
+  int32_t blockshape[8];
+  if (get_b2nd_meta(cparams->schunk, plugin_state, &ndim, shape, chunkshape, blockshape) < 0) {
     return BLOSC2_ERROR_FAILURE;
   }
-  int8_t ndim;
-  int64_t *shape = malloc(8 * sizeof(int64_t));
-  int32_t *chunkshape = malloc(8 * sizeof(int32_t));
-  int32_t *blockshape = malloc(8 * sizeof(int32_t));
-  deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape);
-  free(smeta);
   int typesize = cparams->typesize;
 
   int8_t cell_shape = (int8_t) meta;
@@ -42,9 +37,6 @@ int ndcell_encoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
   }
 
   if (length != blocksize) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
     BLOSC_TRACE_ERROR("Length not equal to blocksize %d %d \n", length, blocksize);
     return BLOSC2_ERROR_FAILURE;
   }
@@ -54,9 +46,6 @@ int ndcell_encoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
   uint8_t *op_limit = op + length;
 
   if (length < cell_size * typesize) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
     BLOSC_TRACE_ERROR("input or output buffer cannot be smaller than cell size");
     return BLOSC2_ERROR_FAILURE;
   }
@@ -110,49 +99,32 @@ int ndcell_encoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
     }
 
     if (op > op_limit) {
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
       BLOSC_TRACE_ERROR("Exceeding output buffer limits!");
       return BLOSC2_ERROR_FAILURE;
     }
   }
 
   if ((op - obase) != length) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
     BLOSC_TRACE_ERROR("Output size must be equal to input size");
     return BLOSC2_ERROR_FAILURE;
   }
 
-  free(shape);
-  free(chunkshape);
-  free(blockshape);
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
 int ndcell_decoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_t meta, blosc2_dparams *dparams,
-                   uint8_t id) {
+                   uint8_t id, void *plugin_state) {
   BLOSC_UNUSED_PARAM(id);
   blosc2_schunk *schunk = dparams->schunk;
   int8_t ndim;
-  int64_t *shape = malloc(8 * sizeof(int64_t));
-  int32_t *chunkshape = malloc(8 * sizeof(int32_t));
-  int32_t *blockshape = malloc(8 * sizeof(int32_t));
-  uint8_t *smeta;
-  int32_t smeta_len;
-  if (blosc2_meta_get(schunk, "b2nd", &smeta, &smeta_len) < 0) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
-    BLOSC_TRACE_ERROR("b2nd layer not found!");
+  int64_t shape[8];
+  int32_t chunkshape[8];
+  int32_t blockshape[8];
+  if (get_b2nd_meta(schunk, plugin_state, &ndim, shape, chunkshape, blockshape) < 0) {
     return BLOSC2_ERROR_FAILURE;
   }
-  deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape);
-  free(smeta);
 
   int8_t cell_shape = (int8_t) meta;
   int cell_size = (int) pow(cell_shape, ndim);
@@ -166,17 +138,11 @@ int ndcell_decoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
   }
 
   if (length != blocksize) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
     BLOSC_TRACE_ERROR("Length not equal to blocksize");
     return BLOSC2_ERROR_FAILURE;
   }
 
   if (length < cell_size * typesize) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
     BLOSC_TRACE_ERROR("input and output buffer cannot be smaller than cell size");
     return BLOSC2_ERROR_FAILURE;
   }
@@ -198,9 +164,6 @@ int ndcell_decoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
   for (int cell_ind = 0; cell_ind < ncells; cell_ind++) {      // for each cell
 
     if (ip > ip_limit) {
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
       BLOSC_TRACE_ERROR("Exceeding input length!");
       return BLOSC2_ERROR_FAILURE;
     }
@@ -241,17 +204,11 @@ int ndcell_decoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
 
 
   if (ind != (int32_t) (blocksize / typesize)) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
     BLOSC_TRACE_ERROR("Output size is not compatible with embedded blockshape ind %d %d \n",
                       ind, (blocksize / typesize));
     return BLOSC2_ERROR_FAILURE;
   }
 
-  free(shape);
-  free(chunkshape);
-  free(blockshape);
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -12,29 +12,18 @@
 #include "../include/blosc2/filters-registry.h"
 
 int ndmean_encoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_t meta, blosc2_cparams *cparams,
-                   uint8_t id) {
+                   uint8_t id, void *plugin_state) {
   BLOSC_UNUSED_PARAM(id);
   int8_t ndim;
-  int64_t *shape = malloc(8 * sizeof(int64_t));
-  int32_t *chunkshape = malloc(8 * sizeof(int32_t));
-  int32_t *blockshape = malloc(8 * sizeof(int32_t));
-  uint8_t *smeta;
-  int32_t smeta_len;
-  if (blosc2_meta_get(cparams->schunk, "b2nd", &smeta, &smeta_len) < 0) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
-    BLOSC_TRACE_ERROR("b2nd layer not found!");
+  int64_t shape[8];
+  int32_t chunkshape[8];
+  int32_t blockshape[8];
+  if (get_b2nd_meta(cparams->schunk, plugin_state, &ndim, shape, chunkshape, blockshape) < 0) {
     return BLOSC2_ERROR_FAILURE;
   }
-  deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape);
-  free(smeta);
   int typesize = cparams->typesize;
 
   if ((typesize != 4) && (typesize != 8)) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
     BLOSC_TRACE_ERROR("This filter only works for float or double");
     return BLOSC2_ERROR_FAILURE;
   }
@@ -58,9 +47,6 @@ int ndmean_encoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
   }
 
   if (length != blocksize) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
     BLOSC_TRACE_ERROR("Length not equal to blocksize %d %d \n", length, blocksize);
     return BLOSC2_ERROR_FAILURE;
   }
@@ -76,9 +62,6 @@ int ndmean_encoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
 
 
   if (length < cell_size * typesize) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
     BLOSC_TRACE_ERROR("input and output buffer cannot be smaller than cell size");
     return BLOSC2_ERROR_FAILURE;
   }
@@ -168,17 +151,11 @@ int ndmean_encoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
     }
 
     if (op > op_limit) {
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
       BLOSC_TRACE_ERROR("Exceeding output buffer limits!");
       return BLOSC2_ERROR_FAILURE;
     }
   }
 
-  free(shape);
-  free(chunkshape);
-  free(blockshape);
   if ((op - obase) != length) {
     BLOSC_TRACE_ERROR("Output size must be equal to input size");
     return BLOSC2_ERROR_FAILURE;
@@ -189,24 +166,16 @@ int ndmean_encoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
 
 
 int ndmean_decoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_t meta, blosc2_dparams *dparams,
-                   uint8_t id) {
+                   uint8_t id, void *plugin_state) {
   BLOSC_UNUSED_PARAM(id);
   blosc2_schunk *schunk = dparams->schunk;
   int8_t ndim;
-  int64_t *shape = malloc(8 * sizeof(int64_t));
-  int32_t *chunkshape = malloc(8 * sizeof(int32_t));
-  int32_t *blockshape = malloc(8 * sizeof(int32_t));
-  uint8_t *smeta;
-  int32_t smeta_len;
-  if (blosc2_meta_get(schunk, "b2nd", &smeta, &smeta_len) < 0) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
-    BLOSC_TRACE_ERROR("b2nd layer not found!");
+  int64_t shape[8];
+  int32_t chunkshape[8];
+  int32_t blockshape[8];
+  if (get_b2nd_meta(schunk, plugin_state, &ndim, shape, chunkshape, blockshape) < 0) {
     return BLOSC2_ERROR_FAILURE;
   }
-  deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape);
-  free(smeta);
 
   int8_t cellshape[8];
   int cell_size = 1;
@@ -232,17 +201,11 @@ int ndmean_decoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
   }
 
   if (length != blocksize) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
     BLOSC_TRACE_ERROR("Length not equal to blocksize");
     return BLOSC2_ERROR_FAILURE;
   }
 
   if (length < cell_size * typesize) {
-    free(shape);
-    free(chunkshape);
-    free(blockshape);
     BLOSC_TRACE_ERROR("input and output buffer cannot be smaller than cell size");
     return BLOSC2_ERROR_FAILURE;
   }
@@ -264,9 +227,6 @@ int ndmean_decoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
   for (int cell_ind = 0; cell_ind < ncells; cell_ind++) {      // for each cell
 
     if (ip > ip_limit) {
-      free(shape);
-      free(chunkshape);
-      free(blockshape);
       BLOSC_TRACE_ERROR("Exceeding input length!");
       return BLOSC2_ERROR_FAILURE;
     }
@@ -305,9 +265,6 @@ int ndmean_decoder(const uint8_t *input, uint8_t *output, int32_t length, uint8_
   }
   ind += (int32_t) pad_shape[ndim - 1];
 
-  free(shape);
-  free(chunkshape);
-  free(blockshape);
 
   if (ind != (int32_t) (blocksize / typesize)) {
     BLOSC_TRACE_ERROR("Output size is not compatible with embedded blockshape ind %d %d \n",
@@ -62,3 +62,48 @@ int32_t deserialize_meta(uint8_t *smeta, int32_t smeta_len, int8_t *ndim, int64_
   int32_t slen = (int32_t) (pmeta - smeta);
   return slen;
 }
+
+
+/* Init hook for the plugins that only need the b2nd layout of the super-chunk */
+int b2nd_meta_init(uint8_t meta, blosc2_cparams *cparams, blosc2_dparams *dparams, void **state) {
+  BLOSC_UNUSED_PARAM(meta);
+  blosc2_schunk *schunk = cparams != NULL ? cparams->schunk : dparams->schunk;
+  b2nd_meta_state *mstate = malloc(sizeof(b2nd_meta_state));
+  BLOSC_ERROR_NULL(mstate, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = get_b2nd_meta(schunk, NULL, &mstate->ndim, mstate->shape, mstate->chunkshape, mstate->blockshape);
+  if (rc < 0) {
+    free(mstate);
+    return rc;
+  }
+  *state = mstate;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+void b2nd_meta_destroy(void *state) {
+  free(state);
+}
+
+
+/* Get the b2nd layout from the cached state or, if NULL, from the metalayer of the super-chunk */
+int get_b2nd_meta(blosc2_schunk *schunk, void *state, int8_t *ndim, int64_t *shape,
+                  int32_t *chunkshape, int32_t *blockshape) {
+  if (state != NULL) {
+    b2nd_meta_state *mstate = (b2nd_meta_state *) state;
+    *ndim = mstate->ndim;
+    memcpy(shape, mstate->shape, sizeof(mstate->shape));
+    memcpy(chunkshape, mstate->chunkshape, sizeof(mstate->chunkshape));
+    memcpy(blockshape, mstate->blockshape, sizeof(mstate->blockshape));
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  uint8_t *smeta;
+  int32_t smeta_len;
+  if (schunk == NULL || blosc2_meta_get(schunk, "b2nd", &smeta, &smeta_len) < 0) {
+    BLOSC_TRACE_ERROR("b2nd layer not found!");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  deserialize_meta(smeta, smeta_len, ndim, shape, chunkshape, blockshape);
+  free(smeta);
+  return BLOSC2_ERROR_SUCCESS;
+}
@@ -4,5 +4,27 @@
   License: BSD 3-Clause (see LICENSE.txt)
 */
 
+#ifndef BLOSC_PLUGIN_UTILS_H
+#define BLOSC_PLUGIN_UTILS_H
+
+#include "blosc2.h"
+
 int32_t deserialize_meta(uint8_t *smeta, int32_t smeta_len, int8_t *ndim, int64_t *shape,
                          int32_t *chunkshape, int32_t *blockshape);
+
+/* The b2nd layout of a super-chunk, as cached by b2nd_meta_init */
+typedef struct {
+  int8_t ndim;
+  int64_t shape[8];
+  int32_t chunkshape[8];
+  int32_t blockshape[8];
+} b2nd_meta_state;
+
+int b2nd_meta_init(uint8_t meta, blosc2_cparams *cparams, blosc2_dparams *dparams, void **state);
+
+void b2nd_meta_destroy(void *state);
+
+int get_b2nd_meta(blosc2_schunk *schunk, void *state, int8_t *ndim, int64_t *shape,
+                  int32_t *chunkshape, int32_t *blockshape);
+
+#endif /* BLOSC_PLUGIN_UTILS_H */
@@ -45,6 +45,10 @@ CUTEST_TEST_SETUP(append) {
       {2, {18, 6}, {6, 6}, {3, 3}, {18, 12}, 1},
       {3, {12, 10, 14}, {3, 5, 9}, {3, 4, 4}, {12, 10, 18}, 2},
       {4, {10, 10, 5, 5}, {5, 7, 3, 3}, {2, 2, 1, 1}, {10, 10, 5, 30}, 3},
+      // Appends that only add new chunks at the end
+      {1, {6}, {3}, {2}, {10}, 0},
+      {2, {6, 18}, {6, 6}, {3, 3}, {6, 12}, 1},
+      {3, {12, 10, 14}, {3, 5, 9}, {3, 4, 4}, {7, 10, 14}, 0},
 
   ));
 }
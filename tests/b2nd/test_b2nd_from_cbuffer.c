@@ -0,0 +1,130 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+
+/* Build an array out of `buffer`, encoding its chunks with `nthreads` threads */
+static b2nd_array_t *from_cbuffer(_test_backend backend, _test_shapes shapes, uint8_t typesize, int16_t nthreads,
+                                  char *urlpath, uint8_t *buffer, int64_t buffersize) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = nthreads;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams};
+  if (backend.persistent) {
+    b2_storage.urlpath = urlpath;
+  }
+  b2_storage.contiguous = backend.contiguous;
+
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape,
+                                        shapes.chunkshape, shapes.blockshape, NULL, 0, NULL, 0);
+  if (ctx == NULL) {
+    return NULL;
+  }
+  b2nd_array_t *array = NULL;
+  if (b2nd_from_cbuffer(ctx, &array, buffer, buffersize) < 0) {
+    array = NULL;
+  }
+  b2nd_free_ctx(ctx);
+  return array;
+}
+
+
+CUTEST_TEST_SETUP(from_cbuffer) {
+  blosc2_init();
+
+  // Add parametrizations
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(1, 4, 8));
+  // More chunks than a batch of the encoding threads, with a partial last chunk in every dimension
+  CUTEST_PARAMETRIZE(shapes, _test_shapes, CUTEST_DATA(
+      {1, {1003}, {10}, {4}},
+      {2, {103, 67}, {10, 10}, {5, 4}},
+      {3, {41, 23, 17}, {8, 7, 5}, {4, 3, 5}},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(2, 3, 8));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {true, true},
+  ));
+}
+
+
+CUTEST_TEST_TEST(from_cbuffer) {
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+  CUTEST_GET_PARAMETER(shapes, _test_shapes);
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+
+  char *urlpath = "test_from_cbuffer.b2frame";
+  char *urlpath2 = "test_from_cbuffer2.b2frame";
+  blosc2_remove_urlpath(urlpath);
+  blosc2_remove_urlpath(urlpath2);
+
+  /* Create original data */
+  int64_t buffersize = typesize;
+  for (int i = 0; i < shapes.ndim; ++i) {
+    buffersize *= shapes.shape[i];
+  }
+  uint8_t *buffer = malloc(buffersize);
+  CUTEST_ASSERT("Buffer filled incorrectly", fill_buf(buffer, typesize, buffersize / typesize));
+
+  /* Encode it serially and concurrently */
+  b2nd_array_t *serial = from_cbuffer(backend, shapes, typesize, 1, urlpath, buffer, buffersize);
+  CUTEST_ASSERT("Serial conversion failed", serial != NULL);
+  b2nd_array_t *parallel = from_cbuffer(backend, shapes, typesize, nthreads, urlpath2, buffer, buffersize);
+  CUTEST_ASSERT("Parallel conversion failed", parallel != NULL);
+
+  /* Testing */
+  CUTEST_ASSERT("Not enough chunks for several batches",
+                parallel->sc->nchunks > 4 * nthreads && parallel->shape[0] % parallel->chunkshape[0] != 0);
+  CUTEST_ASSERT("Different number of chunks", serial->sc->nchunks == parallel->sc->nchunks);
+  CUTEST_ASSERT("Different sizes", serial->sc->nbytes == parallel->sc->nbytes &&
+                                   serial->sc->cbytes == parallel->sc->cbytes);
+  for (int64_t nchunk = 0; nchunk < serial->sc->nchunks; ++nchunk) {
+    uint8_t *chunk;
+    uint8_t *chunk2;
+    bool needs_free;
+    bool needs_free2;
+    int cbytes = blosc2_schunk_get_chunk(serial->sc, nchunk, &chunk, &needs_free);
+    int cbytes2 = blosc2_schunk_get_chunk(parallel->sc, nchunk, &chunk2, &needs_free2);
+    CUTEST_ASSERT("Cannot get the chunks", cbytes > 0 && cbytes2 > 0);
+    CUTEST_ASSERT("Different chunks", cbytes == cbytes2 && memcmp(chunk, chunk2, cbytes) == 0);
+    if (needs_free) {
+      free(chunk);
+    }
+    if (needs_free2) {
+      free(chunk2);
+    }
+  }
+
+  uint8_t *buffer_dest = malloc(buffersize);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(parallel, buffer_dest, buffersize));
+  B2ND_TEST_ASSERT_BUFFER(buffer, buffer_dest, (int) buffersize);
+
+  /* Free mallocs */
+  free(buffer);
+  free(buffer_dest);
+  B2ND_TEST_ASSERT(b2nd_free(serial));
+  B2ND_TEST_ASSERT(b2nd_free(parallel));
+  blosc2_remove_urlpath(urlpath);
+  blosc2_remove_urlpath(urlpath2);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+CUTEST_TEST_TEARDOWN(from_cbuffer) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(from_cbuffer);
+}
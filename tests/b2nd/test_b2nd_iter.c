@@ -0,0 +1,110 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+#include "b2nd_utils.h"
+
+
+CUTEST_TEST_SETUP(iter) {
+  blosc2_init();
+
+  // Add parametrizations
+  b2nd_default_parameters();
+  CUTEST_PARAMETRIZE(level, int8_t, CUTEST_DATA(B2ND_ITER_CHUNKS, B2ND_ITER_BLOCKS));
+}
+
+
+CUTEST_TEST_TEST(iter) {
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+  CUTEST_GET_PARAMETER(shapes, _test_shapes);
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+  CUTEST_GET_PARAMETER(level, int8_t);
+
+  char *urlpath = "test_iter.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams};
+  if (backend.persistent) {
+    b2_storage.urlpath = urlpath;
+  }
+  b2_storage.contiguous = backend.contiguous;
+
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape,
+                                        shapes.chunkshape, shapes.blockshape, NULL, 0, NULL, 0);
+
+  /* Create original data */
+  size_t buffersize = (size_t) typesize;
+  for (int i = 0; i < shapes.ndim; ++i) {
+    buffersize *= (size_t) shapes.shape[i];
+  }
+  uint8_t *buffer = malloc(buffersize);
+  CUTEST_ASSERT("Buffer filled incorrectly", fill_buf(buffer, typesize, buffersize / typesize));
+
+  b2nd_array_t *src;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &src, buffer, buffersize));
+
+  /* Rebuild the data from the pieces returned by the iterator */
+  uint8_t *buffer_dest = calloc(buffersize > 0 ? buffersize : 1, 1);
+  int64_t array_shape[B2ND_MAX_DIM] = {0};
+  for (int i = 0; i < shapes.ndim; ++i) {
+    array_shape[i] = shapes.shape[i];
+  }
+
+  b2nd_iter_t *iter;
+  B2ND_TEST_ASSERT(b2nd_iter_begin(src, level, &iter));
+  b2nd_iter_item_t item;
+  int64_t nitems = 0;
+  int rc;
+  while ((rc = b2nd_iter_next(iter, &item)) > 0) {
+    int64_t item_start[B2ND_MAX_DIM] = {0};
+    int64_t item_stop[B2ND_MAX_DIM] = {0};
+    int64_t item_nitems = 1;
+    for (int i = 0; i < shapes.ndim; ++i) {
+      item_stop[i] = item.stop[i] - item.start[i];
+      item_nitems *= item_stop[i];
+    }
+    nitems += item_nitems;
+    if (shapes.ndim == 0) {
+      memcpy(buffer_dest, item.data, typesize);
+      continue;
+    }
+    B2ND_TEST_ASSERT(b2nd_copy_buffer(shapes.ndim, typesize,
+                                      item.data, item.shape, item_start, item_stop,
+                                      buffer_dest, array_shape, item.start));
+  }
+  B2ND_TEST_ASSERT(rc);
+  CUTEST_ASSERT("Iterator is not exhausted", b2nd_iter_next(iter, &item) == 0);
+  B2ND_TEST_ASSERT(b2nd_iter_end(iter));
+
+  /* Testing */
+  CUTEST_ASSERT("Wrong number of items", nitems * typesize == (int64_t) buffersize);
+  B2ND_TEST_ASSERT_BUFFER(buffer, buffer_dest, (int) buffersize);
+
+  /* Free mallocs */
+  free(buffer);
+  free(buffer_dest);
+  B2ND_TEST_ASSERT(b2nd_free(src));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  blosc2_remove_urlpath(urlpath);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+CUTEST_TEST_TEARDOWN(iter) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(iter);
+}
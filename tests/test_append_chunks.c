@@ -0,0 +1,242 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+
+#define CHUNKSIZE (50 * 1000)
+#define NTHREADS (2)
+
+/* Global vars */
+int tests_run = 0;
+
+
+typedef struct {
+  int nchunks;
+  int nappends;
+  char* urlpath;
+  bool contiguous;
+  bool copy;
+} test_data;
+
+test_data tdata;
+
+typedef struct {
+  int nchunks;
+  int nappends;
+} test_ndata;
+
+test_ndata tndata[] = {
+    {10, 1},
+    {5,  3},
+    {0, 12},
+    {3, 0},
+    {0, 0},
+};
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+}test_storage;
+
+test_storage tstorage[] = {
+    {false, NULL},  // memory - schunk
+    {true, NULL},  // memory - cframe
+    {true, "test_append_chunks.b2frame"}, // disk - cframe
+    {false, "test_append_chunks_s.b2frame"}, // disk - sframe
+};
+
+bool tcopy[] = {
+    true,
+    false
+};
+
+static char* test_append_chunks(void) {
+  /* Free resources */
+  blosc2_remove_urlpath(tdata.urlpath);
+
+  int32_t *data = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t *data_dest = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t isize = CHUNKSIZE * sizeof(int32_t);
+  int dsize;
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_schunk* schunk;
+
+  /* Initialize the Blosc compressor */
+  blosc2_init();
+
+  /* Create a super-chunk container */
+  cparams.typesize = sizeof(int32_t);
+  cparams.nthreads = NTHREADS;
+  dparams.nthreads = NTHREADS;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams,
+                            .urlpath=tdata.urlpath, .contiguous=tdata.contiguous};
+  schunk = blosc2_schunk_new(&storage);
+
+  // Feed it with data
+  for (int nchunk = 0; nchunk < tdata.nchunks; nchunk++) {
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      data[i] = i + nchunk * CHUNKSIZE;
+    }
+    int64_t nchunks_ = blosc2_schunk_append_buffer(schunk, data, isize);
+    mu_assert("ERROR: bad append", nchunks_ > 0);
+  }
+
+  // Compress the chunks to be appended; every third one is a chunk of zeros
+  uint8_t **chunks = malloc((tdata.nappends + 1) * sizeof(uint8_t *));
+  for (int n = 0; n < tdata.nappends; ++n) {
+    int nchunk = tdata.nchunks + n;
+    chunks[n] = malloc(isize + BLOSC2_MAX_OVERHEAD);
+    int csize;
+    if (n % 3 == 2) {
+      csize = blosc2_chunk_zeros(cparams, isize, chunks[n], isize + BLOSC2_MAX_OVERHEAD);
+    } else {
+      for (int i = 0; i < CHUNKSIZE; i++) {
+        data[i] = i + nchunk * CHUNKSIZE;
+      }
+      csize = blosc2_compress_ctx(schunk->cctx, data, isize, chunks[n], isize + BLOSC2_MAX_OVERHEAD);
+    }
+    mu_assert("ERROR: chunk cannot be compressed", csize >= 0);
+  }
+  int64_t nchunks_ = blosc2_schunk_append_chunks(schunk, chunks, tdata.nappends, tdata.copy);
+  mu_assert("ERROR: chunks cannot be appended", nchunks_ == tdata.nchunks + tdata.nappends);
+  if (tdata.copy) {
+    for (int n = 0; n < tdata.nappends; ++n) {
+      free(chunks[n]);
+    }
+  }
+  free(chunks);
+
+  // Re-open persistent super-chunks so that the index is read back from disk
+  if (tdata.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tdata.urlpath);
+    mu_assert("ERROR: cannot reopen the super-chunk", schunk != NULL);
+  }
+  mu_assert("ERROR: bad number of chunks", schunk->nchunks == tdata.nchunks + tdata.nappends);
+  mu_assert("ERROR: bad nbytes", schunk->nbytes == (int64_t) isize * schunk->nchunks);
+
+  // Check that all the chunks can be decompressed correctly
+  for (int nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, (void *) data_dest, isize);
+    mu_assert("ERROR: chunk cannot be decompressed correctly", dsize == isize);
+    bool zeros = nchunk >= tdata.nchunks && (nchunk - tdata.nchunks) % 3 == 2;
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      mu_assert("ERROR: bad roundtrip", data_dest[i] == (zeros ? 0 : i + nchunk * CHUNKSIZE));
+    }
+  }
+
+  // A regular append after the bulk one must still work
+  int64_t nchunks_last = blosc2_schunk_append_buffer(schunk, data, isize);
+  mu_assert("ERROR: bad append", nchunks_last == tdata.nchunks + tdata.nappends + 1);
+
+  /* Free resources */
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tdata.urlpath);
+  /* Destroy the Blosc environment */
+  blosc2_destroy();
+
+  free(data);
+  free(data_dest);
+
+  return EXIT_SUCCESS;
+}
+
+/* Small and oversized chunks are rejected like blosc2_schunk_append_chunk does */
+static char* test_append_small_chunks(void) {
+  blosc2_remove_urlpath(tdata.urlpath);
+
+  int32_t *data = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t isize = CHUNKSIZE * sizeof(int32_t);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=tdata.urlpath, .contiguous=tdata.contiguous};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    data[i] = i;
+  }
+  mu_assert("ERROR: bad append", blosc2_schunk_append_buffer(schunk, data, isize / 2) == 1);
+
+  uint8_t *chunks[2];
+  for (int n = 0; n < 2; ++n) {
+    chunks[n] = malloc(isize + BLOSC2_MAX_OVERHEAD);
+    int csize = blosc2_compress_ctx(schunk->cctx, data, n == 0 ? isize / 4 : isize,
+                                    chunks[n], isize + BLOSC2_MAX_OVERHEAD);
+    mu_assert("ERROR: chunk cannot be compressed", csize >= 0);
+  }
+
+  // An oversized chunk makes the whole call fail without touching the super-chunk
+  int64_t nbytes = schunk->nbytes;
+  int64_t cbytes = schunk->cbytes;
+  int64_t rc = blosc2_schunk_append_chunks(schunk, chunks, 2, true);
+  mu_assert("ERROR: oversized chunk appended", rc == BLOSC2_ERROR_CHUNK_APPEND);
+  mu_assert("ERROR: counters changed", schunk->nchunks == 1 && schunk->chunksize == isize / 2 &&
+                                       schunk->nbytes == nbytes && schunk->cbytes == cbytes);
+
+  // A small chunk after another small one is rejected by both functions alike
+  mu_assert("ERROR: bad append", blosc2_schunk_append_chunk(schunk, chunks[0], true) == 2);
+  nbytes = schunk->nbytes;
+  cbytes = schunk->cbytes;
+  rc = blosc2_schunk_append_chunks(schunk, chunks, 1, true);
+  mu_assert("ERROR: small chunk appended", rc == BLOSC2_ERROR_CHUNK_APPEND);
+  rc = blosc2_schunk_append_chunk(schunk, chunks[0], true);
+  mu_assert("ERROR: small chunk appended", rc == BLOSC2_ERROR_CHUNK_APPEND);
+  mu_assert("ERROR: counters changed", schunk->nchunks == 2 && schunk->nbytes == nbytes &&
+                                       schunk->cbytes == cbytes);
+  free(chunks[0]);
+  free(chunks[1]);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tdata.urlpath);
+  free(data);
+
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+
+  for (int i = 0; i < (int) (sizeof(tstorage) / sizeof(test_storage)); ++i) {
+    for (int j = 0; j < (int) (sizeof(tndata) / sizeof(test_ndata)); ++j) {
+      for (int k = 0; k < (int) (sizeof(tcopy) / sizeof(bool)); ++k) {
+
+        tdata.contiguous = tstorage[i].contiguous;
+        tdata.urlpath = tstorage[i].urlpath;
+        tdata.nchunks = tndata[j].nchunks;
+        tdata.nappends = tndata[j].nappends;
+        tdata.copy = tcopy[k];
+        mu_run_test(test_append_chunks);
+      }
+    }
+    mu_run_test(test_append_small_chunks);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
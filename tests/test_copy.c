@@ -132,16 +132,39 @@ CUTEST_TEST_TEST(copy) {
 
   /* Append the chunks */
   for (int nchunk = 0; nchunk < nchunks; nchunk++) {
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      data_buffer[i] = i * nchunk;
+    }
     int64_t nc = blosc2_schunk_append_buffer(schunk, data_buffer, isize);
     CUTEST_ASSERT("Error appending chunk", nc >= 0);
   }
+  // Special chunks, and a last chunk smaller than the rest
+  int32_t nextra = 0;
+  if (nchunks > 0) {
+    uint8_t special[BLOSC_EXTENDED_HEADER_LENGTH + sizeof(int32_t)];
+    int32_t value = REPEATED_VALUE;
+    CUTEST_ASSERT("Error creating a zeros chunk",
+                  blosc2_chunk_zeros(data->cparams, isize, special, sizeof(special)) > 0);
+    CUTEST_ASSERT("Error appending chunk", blosc2_schunk_append_chunk(schunk, special, true) > 0);
+    CUTEST_ASSERT("Error creating a repeatval chunk",
+                  blosc2_chunk_repeatval(data->cparams, isize, special, sizeof(special), &value) > 0);
+    CUTEST_ASSERT("Error appending chunk", blosc2_schunk_append_chunk(schunk, special, true) > 0);
+    for (int i = 0; i < CHUNKSIZE / 2; i++) {
+      data_buffer[i] = -i;
+    }
+    CUTEST_ASSERT("Error appending chunk", blosc2_schunk_append_buffer(schunk, data_buffer, isize / 2) > 0);
+    nextra = 3;
+  }
 
   /* Copy schunk */
   blosc2_storage storage2 = {.contiguous=backend2.contiguous, .urlpath = backend2.urlpath};
   if (backend2.urlpath != NULL) {
     remove(backend2.urlpath);
   }
-  storage2.cparams = different_cparams ? &data->cparams2 : &data->cparams;
+  // Exercise both the serial and the parallel re-encoding of chunks
+  blosc2_cparams cparams2 = data->cparams2;
+  cparams2.nthreads = nchunks == 10 ? 1 : NTHREADS;
+  storage2.cparams = different_cparams ? &cparams2 : &data->cparams;
   blosc2_schunk * schunk_copy = blosc2_schunk_copy(schunk, &storage2);
   CUTEST_ASSERT("Error copying a schunk", schunk_copy != NULL);
 
@@ -168,6 +191,39 @@ CUTEST_TEST_TEST(copy) {
     dsize = blosc2_schunk_decompress_chunk(schunk_copy, nchunk, rec_buffer, isize);
     CUTEST_ASSERT("Decompression error", dsize >= 0);
     CUTEST_ASSERT("Decompression size is not equal to input size", dsize == (int) isize);
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      CUTEST_ASSERT("Copied data is not equal to the original", rec_buffer[i] == data_buffer[i]);
+    }
+  }
+  CUTEST_ASSERT("Wrong number of chunks", schunk_copy->nchunks == nchunks + nextra);
+  for (int nchunk = nchunks; nchunk < nchunks + nextra; nchunk++) {
+    uint8_t *chunk;
+    bool needs_free;
+    int cbytes = blosc2_schunk_get_chunk(schunk_copy, nchunk, &chunk, &needs_free);
+    if (needs_free) {
+      free(chunk);
+    }
+    int dsize = blosc2_schunk_decompress_chunk(schunk_copy, nchunk, rec_buffer, isize);
+    if (nchunk == nchunks) {
+      CUTEST_ASSERT("Zeros chunk is not special", cbytes == BLOSC_EXTENDED_HEADER_LENGTH);
+      CUTEST_ASSERT("Decompression size is not equal to input size", dsize == (int) isize);
+      for (int i = 0; i < CHUNKSIZE; i++) {
+        CUTEST_ASSERT("Copied zeros are not equal to the original", rec_buffer[i] == 0);
+      }
+    }
+    else if (nchunk == nchunks + 1) {
+      CUTEST_ASSERT("Repeatval chunk is not special", cbytes == BLOSC_EXTENDED_HEADER_LENGTH + itemsize);
+      CUTEST_ASSERT("Decompression size is not equal to input size", dsize == (int) isize);
+      for (int i = 0; i < CHUNKSIZE; i++) {
+        CUTEST_ASSERT("Copied values are not equal to the original", rec_buffer[i] == REPEATED_VALUE);
+      }
+    }
+    else {
+      CUTEST_ASSERT("Decompression size is not equal to input size", dsize == (int) isize / 2);
+      for (int i = 0; i < CHUNKSIZE / 2; i++) {
+        CUTEST_ASSERT("Copied data is not equal to the original", rec_buffer[i] == -i);
+      }
+    }
   }
 
   /* Free resources */
@@ -0,0 +1,346 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Test for the durable mode (group commit) of contiguous frames.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+#include "frame.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define CHUNKSIZE (50 * 1000)
+#define NCHUNKS (10)
+#define NTHREADS (4)
+
+/* Global vars */
+int tests_run = 0;
+
+typedef struct {
+  int32_t commit_interval;
+  int64_t commit_size;
+  bool update;
+} test_data;
+
+test_data tdata;
+
+test_data tndata[] = {
+    {0, 1, false},  // commit every mutation
+    {0, 1000 * 1000 * 1000, false},  // commit only when asked for
+    {1000 * 1000, 0, false},
+    {0, 1000 * 1000 * 1000, true},
+};
+
+static char *urlpath = "test_durable.b2frame";
+static char *crash_urlpath = "test_durable_crash.b2frame";
+
+
+/* Copy a file, possibly cutting it short, as a crash could leave it */
+static int copy_file(const char *src, const char *dest, int64_t cut) {
+  FILE *fsrc = fopen(src, "rb");
+  if (fsrc == NULL) {
+    return -1;
+  }
+  fseek(fsrc, 0, SEEK_END);
+  int64_t len = ftell(fsrc) - cut;
+  fseek(fsrc, 0, SEEK_SET);
+  uint8_t *buf = malloc(len);
+  int64_t rbytes = (int64_t) fread(buf, 1, len, fsrc);
+  fclose(fsrc);
+  FILE *fdest = fopen(dest, "wb");
+  int64_t wbytes = (int64_t) fwrite(buf, 1, rbytes, fdest);
+  fclose(fdest);
+  free(buf);
+  return rbytes == len && wbytes == len ? 0 : -1;
+}
+
+static int file_exists(const char *path) {
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return 0;
+  }
+  fclose(fp);
+  return 1;
+}
+
+static char *check_chunks(blosc2_schunk *schunk, int nchunks, int updated) {
+  int32_t *data_dest = malloc(CHUNKSIZE * sizeof(int32_t));
+  mu_assert("Wrong number of chunks", schunk->nchunks == nchunks);
+  for (int i = 0; i < nchunks; i++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, i, data_dest, CHUNKSIZE * sizeof(int32_t));
+    mu_assert("Decompression error", dsize == CHUNKSIZE * sizeof(int32_t));
+    int32_t seed = (i == updated) ? -i : i;
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      mu_assert("Wrong chunk contents", data_dest[j] == seed * CHUNKSIZE + j);
+    }
+  }
+  free(data_dest);
+  return EXIT_SUCCESS;
+}
+
+static char* test_durable(void) {
+  int32_t *data = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t isize = CHUNKSIZE * sizeof(int32_t);
+  char crash_wal[64];
+  sprintf(crash_wal, "%s.wal", crash_urlpath);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.clevel = 5;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=urlpath, .contiguous=true};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  mu_assert("ERROR: bad set_durable", blosc2_schunk_set_durable(schunk, -1, 0) == BLOSC2_ERROR_INVALID_PARAM);
+  mu_assert("ERROR: bad set_durable",
+            blosc2_schunk_set_durable(schunk, tdata.commit_interval, tdata.commit_size) == 0);
+
+  // Committed chunks
+  for (int i = 0; i < NCHUNKS / 2; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data[j] = i * CHUNKSIZE + j;
+    }
+    int64_t nchunks_ = blosc2_schunk_append_buffer(schunk, data, isize);
+    mu_assert("ERROR: bad append", nchunks_ == i + 1);
+  }
+  mu_assert("ERROR: bad commit", blosc2_schunk_commit(schunk) == 0);
+
+  // Mutations after the commit
+  for (int i = NCHUNKS / 2; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data[j] = i * CHUNKSIZE + j;
+    }
+    int64_t nchunks_ = blosc2_schunk_append_buffer(schunk, data, isize);
+    mu_assert("ERROR: bad append", nchunks_ == i + 1);
+  }
+  int updated = -1;
+  if (tdata.update) {
+    // An update that would fit in place
+    updated = 1;
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data[j] = -updated * CHUNKSIZE + j;
+    }
+    uint8_t *chunk = malloc(isize + BLOSC2_MAX_OVERHEAD);
+    int csize = blosc2_compress_ctx(schunk->cctx, data, isize, chunk, isize + BLOSC2_MAX_OVERHEAD);
+    mu_assert("Compression error", csize > 0);
+    mu_assert("ERROR: bad update", blosc2_schunk_update_chunk(schunk, updated, chunk, false) == NCHUNKS);
+  }
+
+  // Crash in the middle of the last mutation (the end of the frame never reached the disk)
+  bool all_committed = tdata.commit_size == 1;  // even the last mutation
+  char wal[64];
+  sprintf(wal, "%s.wal", urlpath);
+  mu_assert("ERROR: no write-ahead record", file_exists(wal));
+  mu_assert("ERROR: cannot copy the frame", copy_file(urlpath, crash_urlpath, 100) == 0);
+  mu_assert("ERROR: cannot copy the record", copy_file(wal, crash_wal, 0) == 0);
+  blosc2_schunk *crashed = blosc2_schunk_open(crash_urlpath);
+  mu_assert("Cannot open the crashed schunk", crashed != NULL);
+  mu_assert("ERROR: the record has not been used", !file_exists(crash_wal));
+  // Rolled back to the last commit
+  char *msg = all_committed ? check_chunks(crashed, NCHUNKS, updated) : check_chunks(crashed, NCHUNKS / 2, -1);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  blosc2_schunk_free(crashed);
+  blosc2_remove_urlpath(crash_urlpath);
+  mu_assert("ERROR: the record has not been removed", !file_exists(crash_wal));
+
+  // A clean close commits everything
+  mu_assert("ERROR: bad free", blosc2_schunk_free(schunk) == 0);
+  mu_assert("ERROR: the record has not been removed", !file_exists(wal));
+  schunk = blosc2_schunk_open(urlpath);
+  mu_assert("Cannot open the schunk", schunk != NULL);
+  msg = check_chunks(schunk, NCHUNKS, updated);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  blosc2_schunk_free(schunk);
+
+  /* Free resources */
+  blosc2_remove_urlpath(urlpath);
+  free(data);
+
+  return EXIT_SUCCESS;
+}
+
+static void sleep_ms(int ms) {
+#if defined(_WIN32)
+  Sleep(ms);
+#else
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+  nanosleep(&ts, NULL);
+#endif
+}
+
+static bool is_dirty(blosc2_schunk *schunk) {
+  blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
+  frame_lock(frame);
+  bool dirty = frame->commit_dirty;
+  frame_unlock(frame);
+  return dirty;
+}
+
+/* The committer thread makes the mutations durable without any further call */
+static char* test_committer(void) {
+  int32_t *data = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t isize = CHUNKSIZE * sizeof(int32_t);
+  char wal[64];
+  char crash_wal[64];
+  sprintf(wal, "%s.wal", urlpath);
+  sprintf(crash_wal, "%s.wal", crash_urlpath);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=urlpath, .contiguous=true};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  mu_assert("ERROR: bad set_durable", blosc2_schunk_set_durable(schunk, 20, 0) == 0);
+
+  for (int i = 0; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data[j] = i * CHUNKSIZE + j;
+    }
+    int64_t nchunks_ = blosc2_schunk_append_buffer(schunk, data, isize);
+    mu_assert("ERROR: bad append", nchunks_ == i + 1);
+  }
+  for (int i = 0; i < 500 && is_dirty(schunk); i++) {
+    sleep_ms(10);
+  }
+  mu_assert("ERROR: the mutations have not been committed", !is_dirty(schunk));
+
+  // A crash now loses nothing
+  mu_assert("ERROR: cannot copy the frame", copy_file(urlpath, crash_urlpath, 100) == 0);
+  mu_assert("ERROR: cannot copy the record", copy_file(wal, crash_wal, 0) == 0);
+  blosc2_schunk *crashed = blosc2_schunk_open(crash_urlpath);
+  mu_assert("Cannot open the crashed schunk", crashed != NULL);
+  char *msg = check_chunks(crashed, NCHUNKS, -1);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  blosc2_schunk_free(crashed);
+  blosc2_remove_urlpath(crash_urlpath);
+
+  // Disabling the durable mode commits and removes the record
+  mu_assert("ERROR: bad set_durable", blosc2_schunk_set_durable(schunk, 0, 0) == 0);
+  mu_assert("ERROR: the record has not been removed", !file_exists(wal));
+  mu_assert("ERROR: bad free", blosc2_schunk_free(schunk) == 0);
+  blosc2_remove_urlpath(urlpath);
+  free(data);
+
+  return EXIT_SUCCESS;
+}
+
+typedef struct {
+  blosc2_schunk *schunk;
+  int nthread;
+  int rc;
+} appender_data;
+
+/* Append chunks (compressed with a private context) and commit after each one */
+static void* appender(void *arg) {
+  appender_data *adata = (appender_data *) arg;
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int32_t *data = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t isize = CHUNKSIZE * sizeof(int32_t);
+  adata->rc = 0;
+  for (int i = 0; i < NCHUNKS; i++) {
+    int32_t seed = adata->nthread * NCHUNKS + i;
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data[j] = seed * CHUNKSIZE + j;
+    }
+    uint8_t *chunk = malloc(isize + BLOSC2_MAX_OVERHEAD);
+    int csize = blosc2_compress_ctx(cctx, data, isize, chunk, isize + BLOSC2_MAX_OVERHEAD);
+    if (csize < 0 || blosc2_schunk_append_chunk(adata->schunk, chunk, false) < 0 ||
+        blosc2_schunk_commit(adata->schunk) < 0) {
+      adata->rc = -1;
+      free(chunk);
+      break;
+    }
+  }
+  free(data);
+  blosc2_free_ctx(cctx);
+  return NULL;
+}
+
+/* Concurrent appenders are serialized with the commits */
+static char* test_appenders(void) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=urlpath, .contiguous=true};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  mu_assert("ERROR: bad set_durable", blosc2_schunk_set_durable(schunk, 5, 1000 * 1000) == 0);
+
+  pthread_t threads[NTHREADS];
+  appender_data adata[NTHREADS];
+  for (int i = 0; i < NTHREADS; i++) {
+    adata[i].schunk = schunk;
+    adata[i].nthread = i;
+    mu_assert("ERROR: cannot create thread", pthread_create(&threads[i], NULL, appender, &adata[i]) == 0);
+  }
+  for (int i = 0; i < NTHREADS; i++) {
+    pthread_join(threads[i], NULL);
+    mu_assert("ERROR: bad append or commit", adata[i].rc == 0);
+  }
+  mu_assert("ERROR: bad free", blosc2_schunk_free(schunk) == 0);
+
+  // Every chunk is there once, in any order
+  schunk = blosc2_schunk_open(urlpath);
+  mu_assert("Cannot open the schunk", schunk != NULL);
+  mu_assert("Wrong number of chunks", schunk->nchunks == NTHREADS * NCHUNKS);
+  int32_t *data_dest = malloc(CHUNKSIZE * sizeof(int32_t));
+  bool seen[NTHREADS * NCHUNKS] = {false};
+  for (int i = 0; i < NTHREADS * NCHUNKS; i++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, i, data_dest, CHUNKSIZE * sizeof(int32_t));
+    mu_assert("Decompression error", dsize == CHUNKSIZE * sizeof(int32_t));
+    int32_t seed = data_dest[0] / CHUNKSIZE;
+    mu_assert("Wrong chunk contents", seed >= 0 && seed < NTHREADS * NCHUNKS && !seen[seed]);
+    seen[seed] = true;
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      mu_assert("Wrong chunk contents", data_dest[j] == seed * CHUNKSIZE + j);
+    }
+  }
+  free(data_dest);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(urlpath);
+
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+  for (int i = 0; i < (int) (sizeof(tndata) / sizeof(test_data)); ++i) {
+    tdata = tndata[i];
+    mu_run_test(test_durable);
+  }
+  mu_run_test(test_committer);
+  mu_run_test(test_appenders);
+
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
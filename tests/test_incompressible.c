@@ -0,0 +1,150 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+
+  Test for the detection of incompressible streams, which are not
+  handed to the codecs when BLOSC2_PROBE_INCOMPRESSIBLE is set.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+
+#define NBYTES (256 * 1024)
+#define PERIOD (1024)
+/* Long enough for the sample windows of a block to see different parts of it */
+#define LONG_PERIOD (100 * 1024)
+
+/* Global vars */
+int tests_run = 0;
+uint8_t *random_data;
+uint8_t *repeated_data;
+uint8_t *long_period_data;
+uint8_t *data_dest;
+uint8_t *chunk;
+
+typedef struct {
+  int compcode;
+  int filter;
+} test_params;
+
+test_params tparams[] = {
+    {BLOSC_LZ4, BLOSC_NOSHUFFLE},
+    {BLOSC_LZ4HC, BLOSC_SHUFFLE},
+    {BLOSC_ZLIB, BLOSC_SHUFFLE},
+    {BLOSC_ZSTD, BLOSC_NOSHUFFLE},
+    {BLOSC_ZSTD, BLOSC_BITSHUFFLE},
+    {BLOSC_BLOSCLZ, BLOSC_SHUFFLE},
+};
+
+test_params tdata;
+
+
+static int roundtrip(uint8_t *data, uint8_t compcode_meta, int32_t blocksize) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.compcode = (uint8_t) tdata.compcode;
+  cparams.compcode_meta = compcode_meta;
+  cparams.clevel = 5;
+  cparams.typesize = 4;
+  cparams.nthreads = 2;
+  cparams.blocksize = blocksize;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = (uint8_t) tdata.filter;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data, NBYTES, chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  if (csize <= 0) {
+    return -1;
+  }
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, chunk, csize, data_dest, NBYTES);
+  blosc2_free_ctx(dctx);
+  if (dsize != NBYTES || memcmp(data, data_dest, NBYTES) != 0) {
+    return -1;
+  }
+  return csize;
+}
+
+
+static char* test_incompressible(void) {
+  int csize = roundtrip(random_data, BLOSC2_PROBE_INCOMPRESSIBLE, 32 * 1024);
+  mu_assert("ERROR: bad roundtrip of random data", csize > 0);
+  mu_assert("ERROR: random data should be stored as is", csize >= NBYTES);
+
+  // Random data repeated with a short period must still be compressed
+  csize = roundtrip(repeated_data, BLOSC2_PROBE_INCOMPRESSIBLE, 32 * 1024);
+  mu_assert("ERROR: bad roundtrip of repeated data", csize > 0);
+  mu_assert("ERROR: repeated data has not been compressed", csize < NBYTES / 4);
+
+  return EXIT_SUCCESS;
+}
+
+
+static char* test_long_period(void) {
+  // The sample cannot see repetitions with a long period, so probing is opt-in
+  tdata.compcode = BLOSC_ZSTD;
+  tdata.filter = BLOSC_NOSHUFFLE;
+  int csize = roundtrip(long_period_data, 0, NBYTES);
+  mu_assert("ERROR: bad roundtrip of long-period data", csize > 0);
+  mu_assert("ERROR: long-period data has not been compressed", csize < NBYTES / 2);
+
+  csize = roundtrip(long_period_data, BLOSC2_PROBE_INCOMPRESSIBLE, NBYTES);
+  mu_assert("ERROR: bad roundtrip of long-period data", csize > 0);
+  mu_assert("ERROR: long-period data should be stored as is when probing", csize >= NBYTES);
+
+  return EXIT_SUCCESS;
+}
+
+
+static char *all_tests(void) {
+  for (int i = 0; i < (int) (sizeof(tparams) / sizeof(test_params)); ++i) {
+    tdata = tparams[i];
+    mu_run_test(test_incompressible);
+  }
+  mu_run_test(test_long_period);
+
+  return EXIT_SUCCESS;
+}
+
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  random_data = malloc(NBYTES);
+  repeated_data = malloc(NBYTES);
+  long_period_data = malloc(NBYTES);
+  data_dest = malloc(NBYTES);
+  chunk = malloc(NBYTES + BLOSC2_MAX_OVERHEAD);
+  uint32_t seed = 1;
+  for (int i = 0; i < NBYTES; i++) {
+    seed = seed * 1103515245u + 12345u;
+    random_data[i] = (uint8_t) (seed >> 16);
+    repeated_data[i] = random_data[i % PERIOD];
+    long_period_data[i] = random_data[i % LONG_PERIOD];
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  free(random_data);
+  free(repeated_data);
+  free(long_period_data);
+  free(data_dest);
+  free(chunk);
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
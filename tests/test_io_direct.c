@@ -0,0 +1,206 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Test for the O_DIRECT backend.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+#include "blosc2/blosc2-io-direct.h"
+
+#define CHUNKSIZE (200 * 1000)
+#define NCHUNKS (8)
+
+/* Global vars */
+int tests_run = 0;
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+  int64_t segment_size;
+} test_data;
+
+test_data tdata;
+
+test_data tndata[] = {
+    {true, "test_io_direct.b2frame", 0},
+    {false, "test_io_direct_s.b2frame", 0},
+    {false, "test_io_direct_s.b2frame", 1024 * 1024},
+};
+
+/* Hardly compressible data, so that chunks are large writes */
+static void fill_chunk(int32_t *data, int32_t seed) {
+  uint32_t x = (uint32_t) seed * 2654435761u + 1;
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    data[j] = (int32_t) (x & 0xffffff);
+  }
+}
+
+static char *check_chunks(blosc2_schunk *schunk, const int32_t *seeds, int nchunks) {
+  int32_t *data = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t *data_dest = malloc(CHUNKSIZE * sizeof(int32_t));
+  mu_assert("Wrong number of chunks", schunk->nchunks == nchunks);
+  for (int i = 0; i < nchunks; i++) {
+    fill_chunk(data, seeds[i]);
+    int dsize = blosc2_schunk_decompress_chunk(schunk, i, data_dest, CHUNKSIZE * sizeof(int32_t));
+    mu_assert("Decompression error", dsize == CHUNKSIZE * sizeof(int32_t));
+    mu_assert("Wrong chunk contents", memcmp(data, data_dest, dsize) == 0);
+  }
+  free(data);
+  free(data_dest);
+  return EXIT_SUCCESS;
+}
+
+static char* test_io_direct(void) {
+  blosc2_remove_urlpath(tdata.urlpath);
+
+  int32_t *data = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t isize = CHUNKSIZE * sizeof(int32_t);
+  int32_t seeds[NCHUNKS + 1];
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  blosc2_io io = {.id = BLOSC2_IO_DIRECT, .params = NULL};
+
+  cparams.typesize = sizeof(int32_t);
+  cparams.clevel = 1;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=tdata.urlpath, .contiguous=tdata.contiguous,
+                            .io=&io};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  if (tdata.segment_size > 0) {
+    mu_assert("Cannot set the segment size", blosc2_schunk_set_segment_size(schunk, tdata.segment_size) == 0);
+  }
+  int nchunks = 0;
+  for (int i = 0; i < NCHUNKS; i++) {
+    seeds[nchunks] = i;
+    fill_chunk(data, seeds[nchunks]);
+    int64_t nchunks_ = blosc2_schunk_append_buffer(schunk, data, isize);
+    mu_assert("ERROR: bad append", nchunks_ == ++nchunks);
+  }
+  mu_assert("Chunks should be large", schunk->cbytes > NCHUNKS * 256 * 1024);
+
+  // Update and insert some chunks
+  uint8_t *chunk = malloc(isize + BLOSC2_MAX_OVERHEAD);
+  seeds[2] = 100;
+  fill_chunk(data, seeds[2]);
+  int csize = blosc2_compress_ctx(schunk->cctx, data, isize, chunk, isize + BLOSC2_MAX_OVERHEAD);
+  mu_assert("Compression error", csize > 0);
+  mu_assert("ERROR: bad update", blosc2_schunk_update_chunk(schunk, 2, chunk, true) == nchunks);
+  memmove(seeds + 5, seeds + 4, (nchunks - 4) * sizeof(int32_t));
+  seeds[4] = 200;
+  fill_chunk(data, seeds[4]);
+  csize = blosc2_compress_ctx(schunk->cctx, data, isize, chunk, isize + BLOSC2_MAX_OVERHEAD);
+  mu_assert("Compression error", csize > 0);
+  mu_assert("ERROR: bad insert", blosc2_schunk_insert_chunk(schunk, 4, chunk, true) == ++nchunks);
+  char *msg = check_chunks(schunk, seeds, nchunks);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  blosc2_schunk_free(schunk);
+
+  // What has been written must be readable with the default backend
+  schunk = blosc2_schunk_open(tdata.urlpath);
+  mu_assert("Cannot open the schunk", schunk != NULL);
+  msg = check_chunks(schunk, seeds, nchunks);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open_udio(tdata.urlpath, &io);
+  mu_assert("Cannot open the schunk", schunk != NULL);
+  msg = check_chunks(schunk, seeds, nchunks);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  blosc2_schunk_free(schunk);
+
+  /* Free resources */
+  blosc2_remove_urlpath(tdata.urlpath);
+  free(data);
+  free(chunk);
+
+  return EXIT_SUCCESS;
+}
+
+/* Aligned memory is written straight through; only misaligned memory is staged */
+static char* test_stage(void) {
+  char *urlpath = "test_io_direct.bin";
+  int64_t size = 1024 * 1024 + 100;
+  uint8_t *buffer;
+  mu_assert("Cannot allocate", posix_memalign((void **) &buffer, 4096, size + 1) == 0);
+  for (int64_t i = 0; i < size + 1; i++) {
+    buffer[i] = (uint8_t) (i * 7);
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(BLOSC2_IO_DIRECT);
+  blosc2_direct_file *fp = io_cb->open(urlpath, "wb", NULL);
+  mu_assert("Cannot open the file", fp != NULL);
+  if (fp->dfd < 0) {
+    // The filesystem does not support O_DIRECT
+    io_cb->close(fp);
+    blosc2_remove_urlpath(urlpath);
+    free(buffer);
+    return EXIT_SUCCESS;
+  }
+  mu_assert("Bad write", io_cb->write(buffer, 1, size, fp) == size);
+  mu_assert("Aligned memory should not be staged", fp->stage == NULL);
+  mu_assert("Bad write", io_cb->write(buffer + 1, 1, size, fp) == size);
+  if (fp->mem_align > 1) {
+    mu_assert("Misaligned memory should be staged", fp->stage != NULL);
+  }
+  io_cb->close(fp);
+
+  uint8_t *content = malloc(2 * size);
+  FILE *f = fopen(urlpath, "rb");
+  mu_assert("Cannot reopen the file", f != NULL);
+  mu_assert("Bad file size", fread(content, 1, 2 * size, f) == (size_t) (2 * size));
+  fclose(f);
+  mu_assert("Wrong aligned write", memcmp(content, buffer, size) == 0);
+  mu_assert("Wrong misaligned write", memcmp(content + size, buffer + 1, size) == 0);
+
+  blosc2_remove_urlpath(urlpath);
+  free(content);
+  free(buffer);
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+  mu_run_test(test_stage);
+
+  for (int i = 0; i < (int) (sizeof(tndata) / sizeof(test_data)); ++i) {
+    tdata = tndata[i];
+    mu_run_test(test_io_direct);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  if (blosc2_get_io_cb(BLOSC2_IO_DIRECT) == NULL) {
+    printf("O_DIRECT backend not available; skipping\n");
+    blosc2_destroy();
+    return 0;
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Test for the io_uring backend and the batched reads of lazy chunks.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+
+#define CHUNKSIZE (100 * 1000)
+#define BLOCKSIZE (16 * 1024)
+#define NCHUNKS (10)
+#define COUNTING_IO_ID (250)
+
+/* Global vars */
+int tests_run = 0;
+int32_t nbatches = 0;
+int32_t nbatch_reads = 0;
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+  int64_t segment_size;
+  int nthreads;
+} test_data;
+
+test_data tdata;
+
+test_data tndata[] = {
+    {true, "test_io_uring.b2frame", 0, 1},
+    {true, "test_io_uring.b2frame", 0, 2},
+    {false, "test_io_uring_s.b2frame", 0, 2},
+    {false, "test_io_uring_s.b2frame", 64 * 1024, 1},
+};
+
+blosc2_io_cb *uring;
+
+/* Count the batches and read them through the io_uring backend one by one */
+static int64_t counting_read_batch(void *stream, int32_t nreads, void **ptrs, const int64_t *offsets,
+                                   const int64_t *sizes) {
+  nbatches++;
+  nbatch_reads += nreads;
+  int64_t nread = 0;
+  for (int32_t i = 0; i < nreads; i++) {
+    if (uring->seek(stream, offsets[i], SEEK_SET) < 0) {
+      return -1;
+    }
+    nread += uring->read(ptrs[i], 1, sizes[i], stream);
+  }
+  return nread;
+}
+
+static char* test_io_uring(void) {
+  blosc2_remove_urlpath(tdata.urlpath);
+
+  int32_t *data = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t *data_dest = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t isize = CHUNKSIZE * sizeof(int32_t);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_io io = {.id = BLOSC2_IO_URING, .params = NULL};
+
+  cparams.typesize = sizeof(int32_t);
+  cparams.nthreads = tdata.nthreads;
+  cparams.blocksize = BLOCKSIZE;
+  dparams.nthreads = tdata.nthreads;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=tdata.urlpath,
+                            .contiguous=tdata.contiguous, .io=&io};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  if (tdata.segment_size > 0) {
+    mu_assert("Cannot set the segment size", blosc2_schunk_set_segment_size(schunk, tdata.segment_size) == 0);
+  }
+  for (int i = 0; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data[j] = i * CHUNKSIZE + j * (i + 1);
+    }
+    int64_t nchunks = blosc2_schunk_append_buffer(schunk, data, isize);
+    mu_assert("ERROR: bad append", nchunks == i + 1);
+  }
+  blosc2_schunk_free(schunk);
+
+  // Read the chunks back through the counting backend
+  io.id = COUNTING_IO_ID;
+  nbatches = 0;
+  nbatch_reads = 0;
+  schunk = blosc2_schunk_open_udio(tdata.urlpath, &io);
+  mu_assert("Cannot open the schunk", schunk != NULL);
+  int32_t nblocks = (isize + BLOCKSIZE - 1) / BLOCKSIZE;
+  for (int i = 0; i < NCHUNKS; i++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, i, data_dest, isize);
+    mu_assert("Decompression error", dsize == isize);
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      mu_assert("Wrong chunk contents", data_dest[j] == i * CHUNKSIZE + j * (i + 1));
+    }
+  }
+  mu_assert("Blocks should be read in one batch per chunk", nbatches == NCHUNKS);
+  mu_assert("All the blocks should be read", nbatch_reads == NCHUNKS * nblocks);
+
+  // Only the blocks not masked out are read
+  uint8_t *lazy_chunk;
+  bool needs_free;
+  int cbytes = blosc2_schunk_get_lazychunk(schunk, 3, &lazy_chunk, &needs_free);
+  mu_assert("Cannot get the lazy chunk", cbytes > 0);
+  bool *maskout = malloc(nblocks * sizeof(bool));
+  for (int i = 0; i < nblocks; i++) {
+    maskout[i] = (i % 3) != 0;
+  }
+  memset(data_dest, 0, isize);
+  mu_assert("Cannot set the maskout", blosc2_set_maskout(schunk->dctx, maskout, nblocks) == 0);
+  nbatch_reads = 0;
+  int dsize = blosc2_decompress_ctx(schunk->dctx, lazy_chunk, cbytes, data_dest, isize);
+  mu_assert("Decompression error", dsize == isize);
+  mu_assert("Only unmasked blocks should be read", nbatch_reads == (nblocks + 2) / 3);
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    if (maskout[j * (int)sizeof(int32_t) / BLOCKSIZE]) {
+      continue;
+    }
+    mu_assert("Wrong unmasked contents", data_dest[j] == 3 * CHUNKSIZE + j * 4);
+  }
+  if (needs_free) {
+    free(lazy_chunk);
+  }
+  free(maskout);
+  blosc2_schunk_free(schunk);
+
+  // Slices read the blocks of the next chunk while decompressing the current one
+  io.id = BLOSC2_IO_URING;
+  schunk = blosc2_schunk_open_udio(tdata.urlpath, &io);
+  mu_assert("Cannot open the schunk", schunk != NULL);
+  int32_t *slice = malloc(NCHUNKS * CHUNKSIZE * sizeof(int32_t));
+  int64_t bounds[][2] = {{0, NCHUNKS * CHUNKSIZE}, {CHUNKSIZE / 2, 7 * CHUNKSIZE + 3}, {5, 6}};
+  for (int i = 0; i < (int) (sizeof(bounds) / sizeof(bounds[0])); i++) {
+    int64_t start = bounds[i][0];
+    int64_t stop = bounds[i][1];
+    int rc = blosc2_schunk_get_slice_buffer(schunk, start, stop, slice);
+    mu_assert("Cannot get the slice", rc == 0);
+    for (int64_t j = start; j < stop; j++) {
+      int64_t nchunk = j / CHUNKSIZE;
+      int64_t item = j % CHUNKSIZE;
+      mu_assert("Wrong slice contents", slice[j - start] == nchunk * CHUNKSIZE + item * (nchunk + 1));
+    }
+  }
+  free(slice);
+  blosc2_schunk_free(schunk);
+
+  /* Free resources */
+  blosc2_remove_urlpath(tdata.urlpath);
+  free(data);
+  free(data_dest);
+
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+  for (int i = 0; i < (int) (sizeof(tndata) / sizeof(test_data)); ++i) {
+    tdata = tndata[i];
+    mu_run_test(test_io_uring);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  uring = blosc2_get_io_cb(BLOSC2_IO_URING);
+  if (uring == NULL) {
+    printf("io_uring backend not available; skipping\n");
+    blosc2_destroy();
+    return 0;
+  }
+  blosc2_io_cb counting = *uring;
+  counting.id = COUNTING_IO_ID;
+  blosc2_register_io_cb_ex(&counting, counting_read_batch, NULL);
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Test for opening frame-backed super-chunks out of contiguous frame buffers
+  (blosc2_schunk_from_buffer() without copy).
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+
+#define CHUNKSIZE (100)
+#define NCHUNKS (5000)  // more than a block of the offsets chunk
+
+/* Global vars */
+int tests_run = 0;
+
+typedef struct {
+  int32_t blocksize;
+  int nthreads;
+} test_data;
+
+test_data tdata;
+
+test_data tndata[] = {
+    {0, 1},
+    {0, 4},
+    {CHUNKSIZE * sizeof(int32_t) / 2, 1},
+};
+
+
+static char *check_chunk(blosc2_schunk *schunk, int64_t nchunk, int32_t seed) {
+  int32_t data_dest[CHUNKSIZE];
+  int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, data_dest, sizeof(data_dest));
+  mu_assert("Decompression error", dsize == sizeof(data_dest));
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    mu_assert("Wrong chunk contents", data_dest[j] == seed * CHUNKSIZE + j);
+  }
+  return EXIT_SUCCESS;
+}
+
+static char* test_open_buffer(void) {
+  int32_t data[CHUNKSIZE];
+  char *msg;
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.blocksize = tdata.blocksize;
+  cparams.nthreads = tdata.nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = tdata.nthreads;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .contiguous=true};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data[j] = i * CHUNKSIZE + j;
+    }
+    int64_t nchunks_ = blosc2_schunk_append_buffer(schunk, data, sizeof(data));
+    mu_assert("ERROR: bad append", nchunks_ == i + 1);
+  }
+
+  uint8_t *cframe;
+  bool cframe_needs_free;
+  int64_t cframe_len = blosc2_schunk_to_buffer(schunk, &cframe, &cframe_needs_free);
+  mu_assert("ERROR: bad to_buffer", cframe_len > 0);
+  mu_assert("ERROR: bad open of a non frame", blosc2_schunk_from_buffer((uint8_t *) data, sizeof(data), false) == NULL);
+  // Keep the original contents, in order to check that the buffer is never written
+  uint8_t *cframe_orig = malloc(cframe_len);
+  memcpy(cframe_orig, cframe, cframe_len);
+  blosc2_schunk *schunk2 = blosc2_schunk_from_buffer(cframe, cframe_len, false);
+  mu_assert("ERROR: bad from_buffer", schunk2 != NULL);
+  mu_assert("ERROR: the schunk is not frame-backed", schunk2->frame != NULL && schunk2->data == NULL);
+  uint8_t *cframe2;
+  bool cframe2_needs_free;
+  mu_assert("ERROR: the buffer has been copied", blosc2_schunk_to_buffer(schunk2, &cframe2, &cframe2_needs_free) ==
+                                                 cframe_len && cframe2 == cframe && !cframe2_needs_free);
+  mu_assert("ERROR: the schunk is not contiguous", schunk2->storage->contiguous);
+  mu_assert("ERROR: bad nchunks", schunk2->nchunks == NCHUNKS);
+
+  // Sequential and scattered accesses
+  for (int i = 0; i < NCHUNKS; i += 7) {
+    msg = check_chunk(schunk2, i, i);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+  for (int i = NCHUNKS - 1; i >= 0; i -= 997) {
+    msg = check_chunk(schunk2, i, i);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+
+  // Mutations drop the offsets resolved so far
+  int64_t updated = NCHUNKS / 2;
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    data[j] = -1 * CHUNKSIZE + j;
+  }
+  uint8_t chunk[sizeof(data) + BLOSC2_MAX_OVERHEAD];
+  int csize = blosc2_compress_ctx(schunk2->cctx, data, sizeof(data), chunk, sizeof(chunk));
+  mu_assert("ERROR: compression error", csize > 0);
+  mu_assert("ERROR: bad update", blosc2_schunk_update_chunk(schunk2, updated, chunk, true) == NCHUNKS);
+  msg = check_chunk(schunk2, updated, -1);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  mu_assert("ERROR: bad delete", blosc2_schunk_delete_chunk(schunk2, 0) == NCHUNKS - 1);
+  msg = check_chunk(schunk2, 0, 1);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  msg = check_chunk(schunk2, updated - 1, -1);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  mu_assert("ERROR: bad insert", blosc2_schunk_insert_chunk(schunk2, 0, chunk, true) == NCHUNKS);
+  msg = check_chunk(schunk2, 0, -1);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  msg = check_chunk(schunk2, NCHUNKS - 1, NCHUNKS - 1);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+
+  // The mutations have been done on a private copy
+  mu_assert("ERROR: the buffer has been written", memcmp(cframe, cframe_orig, cframe_len) == 0);
+  blosc2_schunk_free(schunk2);
+  blosc2_schunk_free(schunk);
+  if (cframe_needs_free) {
+    free(cframe);
+  }
+  free(cframe_orig);
+
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+  for (int i = 0; i < (int) (sizeof(tndata) / sizeof(test_data)); ++i) {
+    tdata = tndata[i];
+    mu_run_test(test_open_buffer);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
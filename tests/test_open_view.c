@@ -0,0 +1,200 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Test for read-only super-chunk views of contiguous frame buffers.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+#include "frame.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define HAVE_MMAP
+#endif
+
+#define CHUNKSIZE (100)
+#define NCHUNKS (5000)  // more than a block of the offsets chunk
+#define ZEROS_CHUNK (NCHUNKS / 3)
+
+/* Global vars */
+int tests_run = 0;
+
+
+static char *check_chunk(blosc2_schunk *schunk, int64_t nchunk) {
+  int32_t data_dest[CHUNKSIZE];
+  int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, data_dest, sizeof(data_dest));
+  mu_assert("Decompression error", dsize == sizeof(data_dest));
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    int32_t expected = nchunk == ZEROS_CHUNK ? 0 : (int32_t) nchunk * CHUNKSIZE + j;
+    mu_assert("Wrong chunk contents", data_dest[j] == expected);
+  }
+  return EXIT_SUCCESS;
+}
+
+static char *check_view(blosc2_schunk *view) {
+  char *msg;
+  for (int i = 0; i < NCHUNKS; i += 3) {
+    msg = check_chunk(view, i);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+  for (int i = NCHUNKS - 1; i >= 0; i -= 997) {
+    msg = check_chunk(view, i);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+  return check_chunk(view, ZEROS_CHUNK);
+}
+
+static char* test_open_view(void) {
+  int32_t data[CHUNKSIZE];
+  char *msg;
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.nthreads = 1;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  mu_assert("ERROR: bad meta add", blosc2_meta_add(schunk, "meta", (uint8_t *) "abcd", 4) >= 0);
+  for (int i = 0; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data[j] = i * CHUNKSIZE + j;
+    }
+    if (i == ZEROS_CHUNK) {
+      memset(data, 0, sizeof(data));
+    }
+    mu_assert("ERROR: bad append", blosc2_schunk_append_buffer(schunk, data, sizeof(data)) == i + 1);
+  }
+  mu_assert("ERROR: bad vlmeta add", blosc2_vlmeta_add(schunk, "vlmeta", (uint8_t *) "value", 5, NULL) >= 0);
+
+  uint8_t *cframe;
+  bool cframe_needs_free;
+  int64_t cframe_len = blosc2_schunk_to_buffer(schunk, &cframe, &cframe_needs_free);
+  mu_assert("ERROR: bad to_buffer", cframe_len > 0);
+
+  // The frame lives in a buffer that the view cannot write to
+#ifdef HAVE_MMAP
+  uint8_t *buffer = mmap(NULL, cframe_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  mu_assert("ERROR: cannot map memory", buffer != MAP_FAILED);
+  memcpy(buffer, cframe, cframe_len);
+  mu_assert("ERROR: cannot protect memory", mprotect(buffer, cframe_len, PROT_READ) == 0);
+#else
+  uint8_t *buffer = malloc(cframe_len);
+  memcpy(buffer, cframe, cframe_len);
+#endif
+
+  mu_assert("ERROR: bad view of a non frame", blosc2_schunk_open_view((uint8_t *) data, sizeof(data)) == NULL);
+  blosc2_schunk *view = blosc2_schunk_open_view(buffer, cframe_len);
+  mu_assert("ERROR: bad open_view", view != NULL);
+  blosc2_frame_s *frame = (blosc2_frame_s *) view->frame;
+  mu_assert("ERROR: the view is not backed by the buffer", frame != NULL && frame->cframe == buffer);
+  mu_assert("ERROR: bad nchunks", view->nchunks == NCHUNKS);
+
+  // Several views of the same buffer can be read at the same time
+  blosc2_schunk *view2 = blosc2_schunk_open_view(buffer, cframe_len);
+  mu_assert("ERROR: bad open_view", view2 != NULL);
+  msg = check_view(view);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  msg = check_view(view2);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  blosc2_schunk_free(view2);
+
+#ifdef HAVE_MMAP
+  // ...also from other processes
+  pid_t pid = fork();
+  mu_assert("ERROR: cannot fork", pid >= 0);
+  if (pid == 0) {
+    blosc2_schunk *child_view = blosc2_schunk_open_view(buffer, cframe_len);
+    int failed = child_view == NULL || check_view(child_view) != EXIT_SUCCESS;
+    _exit(failed);
+  }
+  msg = check_view(view);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  int status;
+  mu_assert("ERROR: cannot wait for the child", waitpid(pid, &status, 0) == pid);
+  mu_assert("ERROR: the child cannot read the view", WIFEXITED(status) && WEXITSTATUS(status) == 0);
+#endif
+
+  // Metalayers can be read, but nothing can be modified
+  uint8_t *content;
+  int32_t content_len;
+  mu_assert("ERROR: no metalayer", blosc2_meta_get(view, "meta", &content, &content_len) >= 0);
+  mu_assert("ERROR: bad metalayer", content_len == 4 && memcmp(content, "abcd", 4) == 0);
+  free(content);
+  mu_assert("ERROR: no vlmetalayer", blosc2_vlmeta_get(view, "vlmeta", &content, &content_len) >= 0);
+  mu_assert("ERROR: bad vlmetalayer", content_len == 5 && memcmp(content, "value", 5) == 0);
+  free(content);
+  mu_assert("ERROR: meta update allowed",
+            blosc2_meta_update(view, "meta", (uint8_t *) "dcba", 4) == BLOSC2_ERROR_READ_ONLY);
+  mu_assert("ERROR: vlmeta add allowed",
+            blosc2_vlmeta_add(view, "other", (uint8_t *) "value", 5, NULL) == BLOSC2_ERROR_READ_ONLY);
+  mu_assert("ERROR: vlmeta update allowed",
+            blosc2_vlmeta_update(view, "vlmeta", (uint8_t *) "other", 5, NULL) == BLOSC2_ERROR_READ_ONLY);
+  mu_assert("ERROR: vlmeta delete allowed", blosc2_vlmeta_delete(view, "vlmeta") == BLOSC2_ERROR_READ_ONLY);
+  mu_assert("ERROR: append allowed",
+            blosc2_schunk_append_buffer(view, data, sizeof(data)) == BLOSC2_ERROR_READ_ONLY);
+  mu_assert("ERROR: delete allowed", blosc2_schunk_delete_chunk(view, 0) == BLOSC2_ERROR_READ_ONLY);
+  mu_assert("ERROR: set_slice allowed",
+            blosc2_schunk_set_slice_buffer(view, 0, CHUNKSIZE, data) == BLOSC2_ERROR_READ_ONLY);
+  mu_assert("ERROR: the view has changed", view->nchunks == NCHUNKS);
+  msg = check_view(view);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+
+  mu_assert("ERROR: bad free", blosc2_schunk_free(view) == 0);
+  mu_assert("ERROR: the buffer has been modified", memcmp(buffer, cframe, cframe_len) == 0);
+
+  /* Free resources */
+#ifdef HAVE_MMAP
+  munmap(buffer, cframe_len);
+#else
+  free(buffer);
+#endif
+  if (cframe_needs_free) {
+    free(cframe);
+  }
+  blosc2_schunk_free(schunk);
+
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+  mu_run_test(test_open_view);
+
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
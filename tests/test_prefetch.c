@@ -0,0 +1,282 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Test for the read-ahead of chunks in super-chunks.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+#include "prefetch.h"
+#include "blosc-private.h"
+
+#define CHUNKSIZE (1000)
+#define NCHUNKS (50)
+#define NSLOTS (4)
+
+/* Global vars */
+int tests_run = 0;
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+  bool decompress;
+} test_data;
+
+test_data tdata;
+
+test_data tndata[] = {
+    {false, NULL, false},
+    {false, NULL, true},
+    {true, "test_prefetch.b2frame", false},
+    {true, "test_prefetch.b2frame", true},
+    {false, "test_prefetch.b2frame", false},
+    {false, "test_prefetch.b2frame", true},
+};
+
+
+/* Wait until the prefetching thread is idle, so that the next access is deterministic */
+static void wait_prefetch(blosc2_schunk *schunk) {
+  struct blosc2_prefetch *prefetch = schunk_private(schunk)->prefetch;
+  pthread_mutex_lock(&prefetch->mutex);
+  for (int i = 0; i < prefetch->nslots; i++) {
+    while (prefetch->slots[i].state == PREFETCH_PENDING || prefetch->slots[i].state == PREFETCH_FETCHING) {
+      pthread_cond_wait(&prefetch->cond, &prefetch->mutex);
+    }
+  }
+  pthread_mutex_unlock(&prefetch->mutex);
+}
+
+static char *check_chunk(blosc2_schunk *schunk, int64_t nchunk, int32_t seed) {
+  int32_t data_dest[CHUNKSIZE];
+  int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, data_dest, sizeof(data_dest));
+  mu_assert("Decompression error", dsize == sizeof(data_dest));
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    mu_assert("Wrong chunk contents", data_dest[j] == seed * CHUNKSIZE + j);
+  }
+  return EXIT_SUCCESS;
+}
+
+static char *check_get_chunk(blosc2_schunk *schunk, int64_t nchunk, bool lazy) {
+  int32_t data_dest[CHUNKSIZE];
+  uint8_t *chunk;
+  bool needs_free;
+  int cbytes;
+  if (lazy) {
+    cbytes = blosc2_schunk_get_lazychunk(schunk, nchunk, &chunk, &needs_free);
+  }
+  else {
+    cbytes = blosc2_schunk_get_chunk(schunk, nchunk, &chunk, &needs_free);
+  }
+  mu_assert("ERROR: bad get_chunk", cbytes > 0);
+  int dsize = blosc2_decompress_ctx(schunk->dctx, chunk, cbytes, data_dest, sizeof(data_dest));
+  if (needs_free) {
+    free(chunk);
+  }
+  mu_assert("Decompression error", dsize == sizeof(data_dest));
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    mu_assert("Wrong chunk contents", data_dest[j] == nchunk * CHUNKSIZE + j);
+  }
+  return EXIT_SUCCESS;
+}
+
+/* Access the chunks from `start` on with a stride, with a fresh prefetcher */
+static char *check_stride(blosc2_schunk *schunk, int64_t start, int64_t stride, bool wait) {
+  char *msg;
+  mu_assert("ERROR: bad set_prefetch", blosc2_schunk_set_prefetch(schunk, NSLOTS, tdata.decompress) == 0);
+  int64_t naccesses = 0;
+  for (int64_t i = start; i >= 0 && i < schunk->nchunks; i += stride) {
+    if (wait) {
+      wait_prefetch(schunk);
+    }
+    msg = check_chunk(schunk, i, (int32_t) i);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+    naccesses++;
+  }
+  struct blosc2_prefetch *prefetch = schunk_private(schunk)->prefetch;
+  mu_assert("ERROR: bad number of accesses", prefetch->nhits + prefetch->nmisses == naccesses);
+  if (wait) {
+    // Every chunk after the ones needed to detect the stride has been read ahead
+    mu_assert("ERROR: bad number of hits", prefetch->nhits == naccesses - PREFETCH_MIN_STREAK - 1);
+  }
+  return EXIT_SUCCESS;
+}
+
+static char* test_prefetch(void) {
+  int32_t data[CHUNKSIZE];
+  char *msg;
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_schunk *mem_schunk = NULL;
+  uint8_t *cframe = NULL;
+  bool cframe_needs_free = false;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=tdata.urlpath, .contiguous=tdata.contiguous};
+  blosc2_remove_urlpath(tdata.urlpath);
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data[j] = i * CHUNKSIZE + j;
+    }
+    mu_assert("ERROR: bad append", blosc2_schunk_append_buffer(schunk, data, sizeof(data)) == i + 1);
+  }
+  if (tdata.urlpath == NULL) {
+    // Only frame-backed super-chunks can read ahead
+    mu_assert("ERROR: prefetch allowed", blosc2_schunk_set_prefetch(schunk, NSLOTS, tdata.decompress) ==
+                                         BLOSC2_ERROR_INVALID_PARAM);
+    int64_t cframe_len = blosc2_schunk_to_buffer(schunk, &cframe, &cframe_needs_free);
+    mu_assert("ERROR: bad to_buffer", cframe_len > 0);
+    // The buffer belongs to the in-memory super-chunk, which has to outlive the frame-backed one
+    mem_schunk = schunk;
+    schunk = blosc2_schunk_from_buffer(cframe, cframe_len, false);
+    mu_assert("ERROR: bad from_buffer", schunk != NULL);
+  }
+  mu_assert("ERROR: bad set_prefetch", blosc2_schunk_set_prefetch(schunk, -1, tdata.decompress) ==
+                                       BLOSC2_ERROR_INVALID_PARAM);
+
+  // Sequential, strided and backwards accesses
+  int64_t strides[] = {1, 3, -1, -7};
+  for (int i = 0; i < (int) (sizeof(strides) / sizeof(int64_t)); i++) {
+    int64_t start = strides[i] > 0 ? 0 : NCHUNKS - 1;
+    msg = check_stride(schunk, start, strides[i], true);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+    msg = check_stride(schunk, start, strides[i], false);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+
+  // Random accesses are served too
+  uint32_t seed = 1;
+  for (int i = 0; i < NCHUNKS; i++) {
+    seed = seed * 1103515245 + 12345;
+    int64_t nchunk = (seed >> 16) % NCHUNKS;
+    msg = check_chunk(schunk, nchunk, (int32_t) nchunk);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+
+  // Compressed chunks are read ahead too (unless the thread decompresses them)
+  mu_assert("ERROR: bad set_prefetch", blosc2_schunk_set_prefetch(schunk, NSLOTS, tdata.decompress) == 0);
+  for (int i = 0; i < NCHUNKS; i++) {
+    msg = check_get_chunk(schunk, i, i % 2 == 0);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+  struct blosc2_prefetch *prefetch = schunk_private(schunk)->prefetch;
+  mu_assert("ERROR: bad number of accesses", prefetch->nhits + prefetch->nmisses == NCHUNKS);
+  if (tdata.decompress) {
+    mu_assert("ERROR: compressed chunks read ahead", prefetch->nhits == 0);
+  }
+  // The accesses to compressed chunks drive the read-ahead in both modes
+  mu_assert("ERROR: stride not detected", prefetch->last_nchunk == NCHUNKS - 1 && prefetch->stride == 1 &&
+                                          prefetch->streak >= PREFETCH_MIN_STREAK);
+
+  // Mutations drop the chunks read ahead
+  for (int i = 0; i < NCHUNKS / 2; i++) {
+    wait_prefetch(schunk);
+    msg = check_chunk(schunk, i, i);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+  wait_prefetch(schunk);
+  int64_t updated = NCHUNKS / 2 + 1;
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    data[j] = -1 * CHUNKSIZE + j;
+  }
+  uint8_t chunk[sizeof(data) + BLOSC2_MAX_OVERHEAD];
+  int csize = blosc2_compress_ctx(schunk->cctx, data, sizeof(data), chunk, sizeof(chunk));
+  mu_assert("ERROR: compression error", csize > 0);
+  mu_assert("ERROR: bad update", blosc2_schunk_update_chunk(schunk, updated, chunk, true) == NCHUNKS);
+  msg = check_chunk(schunk, updated - 1, (int32_t) updated - 1);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  msg = check_chunk(schunk, updated, -1);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  msg = check_chunk(schunk, updated + 1, (int32_t) updated + 1);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  wait_prefetch(schunk);
+  mu_assert("ERROR: bad delete", blosc2_schunk_delete_chunk(schunk, updated + 2) == NCHUNKS - 1);
+  for (int64_t i = updated + 2; i < NCHUNKS - 1; i++) {
+    msg = check_chunk(schunk, i, (int32_t) i + 1);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+
+  // Disabling it (or freeing the super-chunk) stops the thread while it reads ahead
+  for (int i = 0; i < NCHUNKS / 2; i++) {
+    msg = check_chunk(schunk, i, i);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+  mu_assert("ERROR: bad set_prefetch", blosc2_schunk_set_prefetch(schunk, 0, false) == 0);
+  mu_assert("ERROR: prefetch not disabled", schunk_private(schunk)->prefetch == NULL);
+  msg = check_chunk(schunk, updated, -1);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  mu_assert("ERROR: bad set_prefetch", blosc2_schunk_set_prefetch(schunk, NSLOTS, tdata.decompress) == 0);
+  for (int i = 0; i < NCHUNKS / 2; i++) {
+    msg = check_chunk(schunk, i, i);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+
+  /* Free resources */
+  blosc2_schunk_free(schunk);
+  if (mem_schunk != NULL) {
+    blosc2_schunk_free(mem_schunk);
+  }
+  if (cframe_needs_free) {
+    free(cframe);
+  }
+  blosc2_remove_urlpath(tdata.urlpath);
+
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+  for (int i = 0; i < (int) (sizeof(tndata) / sizeof(test_data)); ++i) {
+    tdata = tndata[i];
+    mu_run_test(test_prefetch);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
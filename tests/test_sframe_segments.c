@@ -0,0 +1,228 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Test for sparse frames whose chunks are packed into segment files.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+
+#define CHUNKSIZE (50 * 1000)
+#define NCHUNKS (20)
+#define NTHREADS (2)
+#define URLPATH "test_sframe_segments.b2frame"
+
+/* Global vars */
+int tests_run = 0;
+
+typedef struct {
+  int64_t segment_size;
+  int nthreads;
+} test_data;
+
+test_data tdata;
+
+test_data tndata[] = {
+    {4 * 1024, 1},  // smaller than a chunk, so one chunk per segment
+    {32 * 1024, 1},
+    {32 * 1024, NTHREADS},
+    {256 * 1024 * 1024, NTHREADS},
+};
+
+/* The values of the chunk are derived from its seed */
+static void fill_chunk(int32_t *data, int32_t seed) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    data[j] = seed * CHUNKSIZE + j * (seed % 7 + 1) + (j % 13) * seed;
+  }
+}
+
+static bool path_exists(const char *name, int64_t n, const char *ext) {
+  char path[256];
+  sprintf(path, "%s/%08X.%s", name, (unsigned int)n, ext);
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return false;
+  }
+  fclose(fp);
+  return true;
+}
+
+/* Check that the chunks of the schunk match the seeds */
+static char *check_chunks(blosc2_schunk *schunk, const int32_t *seeds, int nchunks) {
+  int32_t *data = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t *data_dest = malloc(CHUNKSIZE * sizeof(int32_t));
+  mu_assert("Wrong number of chunks", schunk->nchunks == nchunks);
+  for (int i = 0; i < nchunks; i++) {
+    fill_chunk(data, seeds[i]);
+    int dsize = blosc2_schunk_decompress_chunk(schunk, i, data_dest, CHUNKSIZE * sizeof(int32_t));
+    mu_assert("Decompression error", dsize == CHUNKSIZE * sizeof(int32_t));
+    mu_assert("Wrong chunk contents", memcmp(data, data_dest, dsize) == 0);
+  }
+  // Items in the middle of the last chunk, out of a single (lazy) block
+  int32_t items[10];
+  int64_t start = (int64_t)(nchunks - 1) * CHUNKSIZE + CHUNKSIZE / 2;
+  int rc = blosc2_schunk_get_slice_buffer(schunk, start, start + 10, items);
+  mu_assert("Cannot get slice", rc >= 0);
+  fill_chunk(data, seeds[nchunks - 1]);
+  mu_assert("Wrong slice contents", memcmp(items, data + CHUNKSIZE / 2, sizeof(items)) == 0);
+  free(data);
+  free(data_dest);
+  return EXIT_SUCCESS;
+}
+
+static char* test_sframe_segments(void) {
+  blosc2_remove_urlpath(URLPATH);
+
+  int32_t *data = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t isize = CHUNKSIZE * sizeof(int32_t);
+  int32_t seeds[NCHUNKS + 3];
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+
+  blosc2_init();
+
+  cparams.typesize = sizeof(int32_t);
+  cparams.nthreads = tdata.nthreads;
+  cparams.blocksize = 16 * 1024;
+  dparams.nthreads = tdata.nthreads;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=URLPATH,
+                            .contiguous=false};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  mu_assert("Cannot set the segment size", blosc2_schunk_set_segment_size(schunk, tdata.segment_size) == 0);
+
+  // Append some chunks
+  int nchunks = 0;
+  for (int i = 0; i < NCHUNKS; i++) {
+    seeds[nchunks] = i + 1;
+    fill_chunk(data, seeds[nchunks]);
+    int64_t nchunks_ = blosc2_schunk_append_buffer(schunk, data, isize);
+    mu_assert("ERROR: bad append", nchunks_ == ++nchunks);
+  }
+
+  // Update, insert and delete chunks
+  uint8_t *chunk = malloc(isize + BLOSC2_MAX_OVERHEAD);
+  seeds[3] = 100;
+  fill_chunk(data, seeds[3]);
+  int csize = blosc2_compress_ctx(schunk->cctx, data, isize, chunk, isize + BLOSC2_MAX_OVERHEAD);
+  mu_assert("Compression error", csize > 0);
+  mu_assert("ERROR: bad update", blosc2_schunk_update_chunk(schunk, 3, chunk, true) == nchunks);
+
+  memmove(seeds + 6, seeds + 5, (nchunks - 5) * sizeof(int32_t));
+  seeds[5] = 200;
+  fill_chunk(data, seeds[5]);
+  csize = blosc2_compress_ctx(schunk->cctx, data, isize, chunk, isize + BLOSC2_MAX_OVERHEAD);
+  mu_assert("Compression error", csize > 0);
+  mu_assert("ERROR: bad insert", blosc2_schunk_insert_chunk(schunk, 5, chunk, true) == ++nchunks);
+
+  mu_assert("ERROR: bad delete", blosc2_schunk_delete_chunk(schunk, 10) == --nchunks);
+  memmove(seeds + 10, seeds + 11, (nchunks - 10) * sizeof(int32_t));
+
+  char *msg = check_chunks(schunk, seeds, nchunks);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  blosc2_schunk_free(schunk);
+
+  // Reopen it (chunks are lazy now) and append some more
+  schunk = blosc2_schunk_open(URLPATH);
+  mu_assert("Cannot open the schunk", schunk != NULL);
+  mu_assert("Segment size can be changed",
+            blosc2_schunk_set_segment_size(schunk, tdata.segment_size) == BLOSC2_ERROR_INVALID_PARAM);
+  msg = check_chunks(schunk, seeds, nchunks);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  seeds[nchunks] = 300;
+  fill_chunk(data, seeds[nchunks]);
+  int64_t nchunks_ = blosc2_schunk_append_buffer(schunk, data, isize);
+  mu_assert("ERROR: bad append", nchunks_ == ++nchunks);
+  seeds[1] = 400;
+  fill_chunk(data, seeds[1]);
+  csize = blosc2_compress_ctx(schunk->cctx, data, isize, chunk, isize + BLOSC2_MAX_OVERHEAD);
+  mu_assert("Compression error", csize > 0);
+  mu_assert("ERROR: bad update", blosc2_schunk_update_chunk(schunk, 1, chunk, true) == nchunks);
+  blosc2_schunk_free(schunk);
+
+  // Simulate an append of the segments index interrupted in the middle of a record
+  FILE *fp = fopen(URLPATH "/segments.b2index", "ab");
+  mu_assert("Cannot open the segments index", fp != NULL);
+  uint8_t partial[5] = {0};
+  mu_assert("Cannot write the partial record", fwrite(partial, 1, sizeof(partial), fp) == sizeof(partial));
+  fclose(fp);
+
+  // The partial record is dropped, and the next records are still aligned
+  schunk = blosc2_schunk_open(URLPATH);
+  mu_assert("Cannot open the schunk", schunk != NULL);
+  msg = check_chunks(schunk, seeds, nchunks);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  seeds[nchunks] = 500;
+  fill_chunk(data, seeds[nchunks]);
+  nchunks_ = blosc2_schunk_append_buffer(schunk, data, isize);
+  mu_assert("ERROR: bad append", nchunks_ == ++nchunks);
+  blosc2_schunk_free(schunk);
+
+  schunk = blosc2_schunk_open(URLPATH);
+  mu_assert("Cannot open the schunk", schunk != NULL);
+  msg = check_chunks(schunk, seeds, nchunks);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  blosc2_schunk_free(schunk);
+
+  // The chunks are in segment files, and not in files of their own
+  mu_assert("Unexpected chunk file", !path_exists(URLPATH, 0, "chunk"));
+  mu_assert("Missing segment file", path_exists(URLPATH, 0, "segment"));
+  int nsegments = 0;
+  while (path_exists(URLPATH, nsegments, "segment")) {
+    nsegments++;
+  }
+  if (tdata.segment_size < CHUNKSIZE) {
+    mu_assert("Chunks should not share segments", nsegments > NCHUNKS);
+  }
+  else {
+    mu_assert("Chunks should share segments", nsegments < NCHUNKS / 2);
+  }
+
+  /* Free resources */
+  blosc2_remove_urlpath(URLPATH);
+  free(data);
+  free(chunk);
+  blosc2_destroy();
+
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+  for (int i = 0; i < (int) (sizeof(tndata) / sizeof(test_data)); ++i) {
+    tdata = tndata[i];
+    mu_run_test(test_sframe_segments);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Test for writing and reading super-chunks as streamed frames.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+#include "frame.h"
+#include "blosc-private.h"
+
+#define NCHUNKS (10)
+#define NCHUNKS_SCHUNK (3)  // chunks in the super-chunk when the stream starts
+
+/* Global vars */
+int tests_run = 0;
+
+typedef struct {
+  int32_t typesize;
+  int32_t nitems;
+  int64_t max_read;
+} test_data;
+
+test_data tdata;
+
+test_data tndata[] = {
+    {4, 10 * 1000, 1 << 20},
+    {4, 10 * 1000, 7},
+    // The 6th chunk looks like the chunk of offsets
+    {8, NCHUNKS / 2, 3},
+};
+
+/* A stream in memory that hands out at most `max_read` bytes per read */
+typedef struct {
+  uint8_t *buffer;
+  int64_t len;
+  int64_t pos;
+  int64_t max_read;
+} memory_stream;
+
+static int64_t memory_write(const void *ptr, int64_t size, void *user_data) {
+  memory_stream *stream = (memory_stream *) user_data;
+  stream->buffer = realloc(stream->buffer, stream->len + size);
+  memcpy(stream->buffer + stream->len, ptr, size);
+  stream->len += size;
+  return size;
+}
+
+static int64_t memory_read(void *ptr, int64_t size, void *user_data) {
+  memory_stream *stream = (memory_stream *) user_data;
+  int64_t rbytes = size < stream->max_read ? size : stream->max_read;
+  if (rbytes > stream->len - stream->pos) {
+    rbytes = stream->len - stream->pos;
+  }
+  memcpy(ptr, stream->buffer + stream->pos, rbytes);
+  stream->pos += rbytes;
+  return rbytes;
+}
+
+static void fill_chunk(uint8_t *data, int nchunk) {
+  int32_t nbytes = tdata.nitems * tdata.typesize;
+  for (int j = 0; j < nbytes; j++) {
+    data[j] = (uint8_t) (nchunk + j / tdata.typesize);
+  }
+}
+
+static char *check_chunk(const uint8_t *chunk, int nchunk) {
+  int32_t nbytes = tdata.nitems * tdata.typesize;
+  uint8_t *expected = malloc(nbytes);
+  uint8_t *data = malloc(nbytes);
+  if (nchunk == NCHUNKS - 1) {
+    memset(expected, 0, nbytes);
+  } else {
+    fill_chunk(expected, nchunk);
+  }
+  int dsize = blosc2_decompress(chunk, BLOSC2_MAX_BUFFERSIZE, data, nbytes);
+  mu_assert("ERROR: bad decompression", dsize == nbytes);
+  mu_assert("ERROR: bad chunk contents", memcmp(data, expected, nbytes) == 0);
+  free(expected);
+  free(data);
+  return EXIT_SUCCESS;
+}
+
+static char *check_metalayers(blosc2_schunk *schunk, bool vlmeta) {
+  uint8_t *content;
+  int32_t content_len;
+  mu_assert("ERROR: bad typesize", schunk->typesize == tdata.typesize);
+  mu_assert("ERROR: no metalayer", blosc2_meta_get(schunk, "meta", &content, &content_len) >= 0);
+  mu_assert("ERROR: bad metalayer", content_len == 4 && memcmp(content, "abcd", 4) == 0);
+  free(content);
+  if (!vlmeta) {
+    return EXIT_SUCCESS;
+  }
+  mu_assert("ERROR: no vlmetalayer", blosc2_vlmeta_get(schunk, "vlmeta", &content, &content_len) >= 0);
+  mu_assert("ERROR: bad vlmetalayer", content_len == 7 && memcmp(content, "written", 7) == 0);
+  free(content);
+  return EXIT_SUCCESS;
+}
+
+static char* test_stream(void) {
+  int32_t nbytes = tdata.nitems * tdata.typesize;
+  uint8_t *data = malloc(nbytes);
+  char *msg;
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = tdata.typesize;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  mu_assert("ERROR: bad meta add", blosc2_meta_add(schunk, "meta", (uint8_t *) "abcd", 4) >= 0);
+  for (int i = 0; i < NCHUNKS_SCHUNK; i++) {
+    fill_chunk(data, i);
+    mu_assert("ERROR: bad append", blosc2_schunk_append_buffer(schunk, data, nbytes) == i + 1);
+  }
+
+  // The rest of chunks only go to the stream
+  memory_stream stream = {.max_read = tdata.max_read};
+  blosc2_stream_writer *writer = blosc2_stream_writer_new(schunk, memory_write, &stream);
+  mu_assert("ERROR: cannot create the writer", writer != NULL);
+  for (int i = NCHUNKS_SCHUNK; i < NCHUNKS - 1; i++) {
+    fill_chunk(data, i);
+    mu_assert("ERROR: bad stream append", blosc2_stream_writer_append_buffer(writer, data, nbytes) == i + 1);
+  }
+  uint8_t zeros[BLOSC_EXTENDED_HEADER_LENGTH];
+  mu_assert("ERROR: bad zeros chunk", blosc2_chunk_zeros(cparams, nbytes, zeros, sizeof(zeros)) > 0);
+  mu_assert("ERROR: bad stream append", blosc2_stream_writer_append_chunk(writer, zeros) == NCHUNKS);
+  // Vlmetalayers are taken when the stream ends
+  mu_assert("ERROR: bad vlmeta add", blosc2_vlmeta_add(schunk, "vlmeta", (uint8_t *) "written", 7, NULL) >= 0);
+  int64_t len = blosc2_stream_writer_end(writer);
+  mu_assert("ERROR: bad stream end", len == stream.len);
+  mu_assert("ERROR: the schunk has been modified", schunk->nchunks == NCHUNKS_SCHUNK);
+  blosc2_schunk_free(schunk);
+
+  // Chunks come out one at a time, and metalayers are known from the start
+  blosc2_stream_reader *reader = blosc2_stream_reader_new(memory_read, &stream);
+  mu_assert("ERROR: cannot create the reader", reader != NULL);
+  msg = check_metalayers(blosc2_stream_reader_schunk(reader), false);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  uint8_t *chunk;
+  int nchunk = 0;
+  int cbytes;
+  while ((cbytes = blosc2_stream_reader_next(reader, &chunk)) > 0) {
+    msg = check_chunk(chunk, nchunk);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+    nchunk++;
+  }
+  mu_assert("ERROR: bad stream read", cbytes == 0);
+  mu_assert("ERROR: bad number of chunks", nchunk == NCHUNKS);
+  mu_assert("ERROR: the stream has not been consumed", stream.pos == stream.len);
+  msg = check_metalayers(blosc2_stream_reader_schunk(reader), true);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  mu_assert("ERROR: bad read after the end", blosc2_stream_reader_next(reader, &chunk) == 0);
+  blosc2_stream_reader_free(reader);
+
+  // A whole super-chunk
+  stream.pos = 0;
+  schunk = blosc2_schunk_from_stream(memory_read, &stream, NULL);
+  mu_assert("ERROR: bad from_stream", schunk != NULL);
+  mu_assert("ERROR: bad number of chunks", schunk->nchunks == NCHUNKS);
+  msg = check_metalayers(schunk, true);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  for (int i = 0; i < NCHUNKS; i++) {
+    bool needs_free;
+    mu_assert("ERROR: bad get_chunk", blosc2_schunk_get_chunk(schunk, i, &chunk, &needs_free) > 0);
+    msg = check_chunk(chunk, i);
+    if (needs_free) {
+      free(chunk);
+    }
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+  }
+  blosc2_schunk_free(schunk);
+
+  // Filling out the unknown sizes in the header gives a regular frame
+  int64_t nbytes_ = (int64_t) NCHUNKS * nbytes;
+  int32_t header_len;
+  from_big(&header_len, stream.buffer + FRAME_HEADER_LEN, sizeof(header_len));
+  int64_t cbytes_ = 0;
+  for (int64_t pos = header_len; nchunk > 0; nchunk--) {
+    int32_t chunk_cbytes;
+    blosc2_cbuffer_sizes(stream.buffer + pos, NULL, &chunk_cbytes, NULL);
+    pos += chunk_cbytes;
+    cbytes_ += chunk_cbytes;
+  }
+  to_big(stream.buffer + FRAME_LEN, &stream.len, sizeof(int64_t));
+  to_big(stream.buffer + FRAME_NBYTES, &nbytes_, sizeof(int64_t));
+  to_big(stream.buffer + FRAME_CBYTES, &cbytes_, sizeof(int64_t));
+  to_big(stream.buffer + FRAME_CHUNKSIZE, &nbytes, sizeof(int32_t));
+  schunk = blosc2_schunk_from_buffer(stream.buffer, stream.len, true);
+  mu_assert("ERROR: bad from_buffer", schunk != NULL);
+  mu_assert("ERROR: bad number of chunks", schunk->nchunks == NCHUNKS);
+  msg = check_metalayers(schunk, true);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  int32_t dsize = blosc2_schunk_decompress_chunk(schunk, NCHUNKS / 2, data, nbytes);
+  mu_assert("ERROR: bad decompression", dsize == nbytes);
+  blosc2_schunk_free(schunk);
+
+  /* Free resources */
+  free(stream.buffer);
+  free(data);
+
+  return EXIT_SUCCESS;
+}
+
+static char* test_stream_empty(void) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = tdata.typesize;
+  blosc2_storage storage = {.cparams=&cparams};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  mu_assert("ERROR: bad meta add", blosc2_meta_add(schunk, "meta", (uint8_t *) "abcd", 4) >= 0);
+  mu_assert("ERROR: bad vlmeta add", blosc2_vlmeta_add(schunk, "vlmeta", (uint8_t *) "written", 7, NULL) >= 0);
+
+  memory_stream stream = {.max_read = tdata.max_read};
+  int64_t len = blosc2_schunk_to_stream(schunk, memory_write, &stream);
+  mu_assert("ERROR: bad to_stream", len == stream.len);
+  blosc2_schunk_free(schunk);
+
+  schunk = blosc2_schunk_from_stream(memory_read, &stream, NULL);
+  mu_assert("ERROR: bad from_stream", schunk != NULL);
+  mu_assert("ERROR: bad number of chunks", schunk->nchunks == 0);
+  char *msg = check_metalayers(schunk, true);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  blosc2_schunk_free(schunk);
+
+  // Truncated streams are detected
+  stream.pos = 0;
+  stream.len -= 1;
+  mu_assert("ERROR: truncated stream not detected",
+            blosc2_schunk_from_stream(memory_read, &stream, NULL) == NULL);
+  free(stream.buffer);
+
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+  for (int i = 0; i < (int) (sizeof(tndata) / sizeof(test_data)); ++i) {
+    tdata = tndata[i];
+    mu_run_test(test_stream);
+    mu_run_test(test_stream_empty);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
@@ -88,7 +88,7 @@ CUTEST_TEST_DATA(udio) {
 CUTEST_TEST_SETUP(udio) {
   blosc2_init();
 
-  blosc2_io_cb io_cb;
+  blosc2_io_cb io_cb = {0};
 
   io_cb.id = 244;
   io_cb.open = (blosc2_open_cb) test_open;
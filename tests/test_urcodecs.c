@@ -19,12 +19,38 @@
 #define CHUNKSIZE (5 * 1000)  // > NCHUNKS for the bench purposes
 #define NTHREADS 4
 
+/* Number of calls to the init and destroy hooks */
+static int ninit = 0;
+static int ndestroy = 0;
+
+
+int codec_init(uint8_t meta, blosc2_cparams* cparams, blosc2_dparams* dparams, void** state) {
+  BLOSC_UNUSED_PARAM(meta);
+  blosc2_schunk *schunk = cparams != NULL ? cparams->schunk : dparams->schunk;
+  if (schunk == NULL) {
+    return -1;
+  }
+  // Read the codec params once per context instead of once per block
+  uint8_t *content;
+  int32_t content_len;
+  if (blosc2_vlmeta_get(schunk, "codec_arange", &content, &content_len) < 0) {
+    return -1;
+  }
+  *state = content;
+  ninit++;
+  return 0;
+}
+
+void codec_destroy(void* state) {
+  free(state);
+  ndestroy++;
+}
 
 
 int codec_encoder(const uint8_t* input, int32_t input_len,
                   uint8_t* output, int32_t output_len,
                   uint8_t meta,
-                  blosc2_cparams* cparams, const void* chunk) {
+                  blosc2_cparams* cparams, const void* chunk, void* state) {
   BLOSC_UNUSED_PARAM(chunk);
   if (cparams->schunk == NULL) {
     return -1;
@@ -33,13 +59,10 @@ int codec_encoder(const uint8_t* input, int32_t input_len,
     BLOSC_TRACE_ERROR("Itemsize %d != 4", cparams->typesize);
     return BLOSC2_ERROR_FAILURE;
   }
-  uint8_t *content;
-  int32_t content_len;
-  blosc2_vlmeta_get(cparams->schunk, "codec_arange", &content, &content_len);
-  if (content[0] != 222) {
+  uint8_t *content = state;
+  if (content == NULL || content[0] != 222) {
     return -1;
   }
-  free(content);
 
   if (meta != 111) {
     return -1;
@@ -71,19 +94,16 @@ int codec_encoder(const uint8_t* input, int32_t input_len,
 int codec_decoder(const uint8_t* input, int32_t input_len,
                   uint8_t* output, int32_t output_len,
                   uint8_t meta,
-                  blosc2_dparams *dparams, const void* chunk) {
+                  blosc2_dparams *dparams, const void* chunk, void* state) {
   BLOSC_UNUSED_PARAM(chunk);
   if (dparams->schunk == NULL) {
     return -1;
   }
 
-  uint8_t *content;
-  int32_t content_len;
-  blosc2_vlmeta_get(dparams->schunk, "codec_arange", &content, &content_len);
-  if (content[0] != 222) {
+  uint8_t *content = state;
+  if (content == NULL || content[0] != 222) {
     return -1;
   }
-  free(content);
 
   if (meta != 111) {
     return -1;
@@ -108,9 +128,10 @@ int codec_decoder(const uint8_t* input, int32_t input_len,
 int codec_decoder_error(const uint8_t* input, int32_t input_len,
                         uint8_t* output, int32_t output_len,
                         uint8_t meta,
-                        blosc2_dparams* dparams, const void* chunk) {
+                        blosc2_dparams* dparams, const void* chunk, void* state) {
   BLOSC_UNUSED_PARAM(dparams);
   BLOSC_UNUSED_PARAM(chunk);
+  BLOSC_UNUSED_PARAM(state);
   if (meta != 111) {
     return -1;
   }
@@ -163,17 +184,19 @@ CUTEST_TEST_TEST(urcodecs) {
   blosc2_codec udcodec;
   udcodec.compname = "arange";
   udcodec.compver = 1;
-  udcodec.encoder = codec_encoder;
+  udcodec.encoder = NULL;
+  udcodec.decoder = NULL;
+  blosc2_codec_decoder_ex_cb decoder;
   if (correct_backward) {
     udcodec.compcode = 250;
     udcodec.complib = 250;
-    udcodec.decoder = codec_decoder;
+    decoder = codec_decoder;
   } else {
     udcodec.compcode = 251;
     udcodec.complib = 251;
-    udcodec.decoder = codec_decoder_error;
+    decoder = codec_decoder_error;
   }
-  int rc = blosc2_register_codec(&udcodec);
+  int rc = blosc2_register_codec_ex(&udcodec, codec_init, codec_destroy, codec_encoder, decoder);
   if (rc != 0) {
     BLOSC_TRACE_ERROR("Error registering the code.");
     return BLOSC2_ERROR_FAILURE;
@@ -204,8 +227,17 @@ CUTEST_TEST_TEST(urcodecs) {
   uint8_t codec_params = 222;
   blosc2_cparams cparams2 = BLOSC2_CPARAMS_DEFAULTS;
   blosc2_vlmeta_add(schunk, "codec_arange", &codec_params, 1, &cparams2);
+  uint8_t content = 0;
+  CUTEST_ASSERT("Cannot add a metalayer", blosc2_meta_add(schunk, "arange_meta", &content, 1) >= 0);
 
+  int ninit_before = 0;
   for (nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    if (nchunk == NCHUNKS / 2) {
+      // Changing the metalayers makes the states to be created again
+      ninit_before = ninit;
+      content = 1;
+      CUTEST_ASSERT("Cannot update a metalayer", blosc2_meta_update(schunk, "arange_meta", &content, 1) >= 0);
+    }
     for (i = 0; i < CHUNKSIZE; i++) {
       ((int32_t *) bdata)[i] = i * nchunk;
     }
@@ -215,6 +247,7 @@ CUTEST_TEST_TEST(urcodecs) {
       return -1;
     }
   }
+  CUTEST_ASSERT("States not created again after a metalayer change", ninit > ninit_before);
   blosc2_schunk_free(schunk);
 
   schunk = blosc2_schunk_open(data->urlpath);
@@ -252,6 +285,13 @@ CUTEST_TEST_TEST(urcodecs) {
   free(bdata);
   free(bdata_dest);
 
+  /* The hooks must run once per context, not once per block */
+  CUTEST_ASSERT("Init hook was not called", ninit > 0);
+  CUTEST_ASSERT("Init hook called too many times", ninit < NCHUNKS);
+  CUTEST_ASSERT("Destroy hook not called for every state", ndestroy == ninit);
+  ninit = 0;
+  ndestroy = 0;
+
   return BLOSC2_ERROR_SUCCESS;
 }
 
@@ -0,0 +1,210 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Test for the in place updates of variable-length metalayers in frames.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+
+#define CHUNKSIZE (10 * 1000)
+#define NCHUNKS (5)
+#define BIGSIZE (100 * 1000)
+
+/* Global vars */
+int tests_run = 0;
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+} test_data;
+
+test_data tdata;
+
+/* The buffer of the frame opened by the last reopen(), which has to outlive its super-chunk */
+uint8_t *reopened_cframe = NULL;
+
+test_data tndata[] = {
+    {true, NULL},
+    {true, "test_vlmeta_inplace.b2frame"},
+    {false, "test_vlmeta_inplace.b2frame"},
+};
+
+
+static char *check_vlmeta(blosc2_schunk *schunk, const char *name, const uint8_t *expected, int32_t expected_len) {
+  uint8_t *content;
+  int32_t content_len;
+  mu_assert("ERROR: cannot get the vlmetalayer", blosc2_vlmeta_get(schunk, name, &content, &content_len) >= 0);
+  mu_assert("ERROR: bad vlmetalayer length", content_len == expected_len);
+  mu_assert("ERROR: bad vlmetalayer content", memcmp(content, expected, content_len) == 0);
+  free(content);
+  return EXIT_SUCCESS;
+}
+
+static char *check_all(blosc2_schunk *schunk, const uint8_t *big, const char *attr) {
+  char *msg = check_vlmeta(schunk, "big", big, BIGSIZE);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  return check_vlmeta(schunk, "attr", (uint8_t *) attr, (int32_t) strlen(attr));
+}
+
+static blosc2_schunk *reopen(blosc2_schunk *schunk) {
+  if (tdata.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    return blosc2_schunk_open(tdata.urlpath);
+  }
+  uint8_t *cframe;
+  bool cframe_needs_free;
+  int64_t cframe_len = blosc2_schunk_to_buffer(schunk, &cframe, &cframe_needs_free);
+  uint8_t *cframe2 = malloc(cframe_len);
+  memcpy(cframe2, cframe, cframe_len);
+  if (cframe_needs_free) {
+    free(cframe);
+  }
+  blosc2_schunk *schunk2 = blosc2_schunk_from_buffer(cframe2, cframe_len, false);
+  blosc2_schunk_free(schunk);
+  free(reopened_cframe);
+  reopened_cframe = cframe2;
+  return schunk2;
+}
+
+static char* test_vlmeta_inplace(void) {
+  int32_t data[CHUNKSIZE];
+  char *msg;
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=tdata.urlpath, .contiguous=tdata.contiguous};
+  blosc2_remove_urlpath(tdata.urlpath);
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data[j] = i * CHUNKSIZE + j;
+    }
+    mu_assert("ERROR: bad append", blosc2_schunk_append_buffer(schunk, data, sizeof(data)) == i + 1);
+  }
+
+  // A large vlmetalayer that does not compress well, and a small one
+  uint8_t *big = malloc(BIGSIZE);
+  uint32_t seed = 1;
+  for (int i = 0; i < BIGSIZE; i++) {
+    seed = seed * 1103515245 + 12345;
+    big[i] = (uint8_t) (seed >> 16);
+  }
+  mu_assert("ERROR: bad vlmeta add", blosc2_vlmeta_add(schunk, "big", big, BIGSIZE, NULL) >= 0);
+  char *attr = "version 1";
+  mu_assert("ERROR: bad vlmeta add", blosc2_vlmeta_add(schunk, "attr", (uint8_t *) attr, (int32_t) strlen(attr),
+                                                       NULL) >= 0);
+  int64_t frame_len = blosc2_schunk_frame_len(schunk);
+
+  // Small updates are written in place, so the frame does not change its size
+  attr = "version 2, somewhat longer";
+  mu_assert("ERROR: bad vlmeta update", blosc2_vlmeta_update(schunk, "attr", (uint8_t *) attr,
+                                                             (int32_t) strlen(attr), NULL) >= 0);
+  mu_assert("ERROR: the trailer has been rebuilt", blosc2_schunk_frame_len(schunk) == frame_len);
+  msg = check_all(schunk, big, attr);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  attr = "v3";
+  mu_assert("ERROR: bad vlmeta update", blosc2_vlmeta_update(schunk, "attr", (uint8_t *) attr,
+                                                             (int32_t) strlen(attr), NULL) >= 0);
+  mu_assert("ERROR: the trailer has been rebuilt", blosc2_schunk_frame_len(schunk) == frame_len);
+  schunk = reopen(schunk);
+  mu_assert("Cannot reopen the schunk", schunk != NULL);
+  msg = check_all(schunk, big, attr);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+
+  // The room left survives re-opening
+  frame_len = blosc2_schunk_frame_len(schunk);
+  attr = "version 4, as long as the 2nd";
+  mu_assert("ERROR: bad vlmeta update", blosc2_vlmeta_update(schunk, "attr", (uint8_t *) attr,
+                                                             (int32_t) strlen(attr), NULL) >= 0);
+  mu_assert("ERROR: the trailer has been rebuilt", blosc2_schunk_frame_len(schunk) == frame_len);
+
+  // Values that do not fit anymore make the trailer grow
+  char long_attr[1000];
+  memset(long_attr, 'x', sizeof(long_attr) - 1);
+  long_attr[sizeof(long_attr) - 1] = '\0';
+  attr = long_attr;
+  mu_assert("ERROR: bad vlmeta update", blosc2_vlmeta_update(schunk, "attr", (uint8_t *) attr,
+                                                             (int32_t) strlen(attr), NULL) >= 0);
+  mu_assert("ERROR: the trailer has not grown", blosc2_schunk_frame_len(schunk) > frame_len);
+  msg = check_all(schunk, big, attr);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+
+  // Appending chunks keeps the values
+  mu_assert("ERROR: bad append", blosc2_schunk_append_buffer(schunk, data, sizeof(data)) == NCHUNKS + 1);
+  attr = "short again";
+  frame_len = blosc2_schunk_frame_len(schunk);
+  mu_assert("ERROR: bad vlmeta update", blosc2_vlmeta_update(schunk, "attr", (uint8_t *) attr,
+                                                             (int32_t) strlen(attr), NULL) >= 0);
+  mu_assert("ERROR: the trailer has been rebuilt", blosc2_schunk_frame_len(schunk) == frame_len);
+  schunk = reopen(schunk);
+  mu_assert("Cannot reopen the schunk", schunk != NULL);
+  msg = check_all(schunk, big, attr);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  int32_t dsize = blosc2_schunk_decompress_chunk(schunk, NCHUNKS, data, sizeof(data));
+  mu_assert("ERROR: bad decompression", dsize == sizeof(data));
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    mu_assert("ERROR: bad chunk contents", data[j] == (NCHUNKS - 1) * CHUNKSIZE + j);
+  }
+
+  // Deleting vlmetalayers rebuilds the trailer
+  mu_assert("ERROR: bad vlmeta delete", blosc2_vlmeta_delete(schunk, "big") == 1);
+  schunk = reopen(schunk);
+  mu_assert("Cannot reopen the schunk", schunk != NULL);
+  mu_assert("ERROR: the vlmetalayer has not been deleted", blosc2_vlmeta_exists(schunk, "big") < 0);
+  msg = check_vlmeta(schunk, "attr", (uint8_t *) attr, (int32_t) strlen(attr));
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+
+  /* Free resources */
+  blosc2_schunk_free(schunk);
+  free(reopened_cframe);
+  reopened_cframe = NULL;
+  blosc2_remove_urlpath(tdata.urlpath);
+  free(big);
+
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+  for (int i = 0; i < (int) (sizeof(tndata) / sizeof(test_data)); ++i) {
+    tdata = tndata[i];
+    mu_run_test(test_vlmeta_inplace);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Test for the zone maps (per chunk and per block statistics) of super-chunks.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include "test_common.h"
+
+#define CHUNKSIZE (10 * 1000)
+#define BLOCKSIZE (1000 * 8)
+#define NCHUNKS (10)
+
+/* Global vars */
+int tests_run = 0;
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+  int nthreads;
+} test_data;
+
+test_data tdata;
+
+test_data tndata[] = {
+    {false, NULL, 1},
+    {true, NULL, 1},
+    {true, "test_zonemap.b2frame", 1},
+    {true, "test_zonemap.b2frame", 4},
+    {false, "test_zonemap.b2frame", 1},
+};
+
+
+/* The items of chunk `nchunk` go from nchunk * CHUNKSIZE upwards, with a NaN every 1000 */
+static void fill_chunk(double *data, int nchunk) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    data[j] = (j % 1000 == 999) ? NAN : (double) nchunk * CHUNKSIZE + j;
+  }
+}
+
+static char *check_query(blosc2_schunk *schunk, double min, double max, int64_t nexpected,
+                         const int64_t *expected) {
+  int64_t *nchunks;
+  int64_t n = blosc2_schunk_zonemap_query(schunk, min, max, &nchunks);
+  mu_assert("ERROR: bad number of chunks in query", n == nexpected);
+  for (int64_t i = 0; i < n; i++) {
+    mu_assert("ERROR: bad chunk in query", nchunks[i] == expected[i]);
+  }
+  free(nchunks);
+  return EXIT_SUCCESS;
+}
+
+static char* test_zonemap(void) {
+  double *data = malloc(CHUNKSIZE * sizeof(double));
+  int32_t isize = CHUNKSIZE * sizeof(double);
+  char *msg;
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(double);
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = tdata.nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams,
+                            .urlpath=tdata.urlpath, .contiguous=tdata.contiguous};
+  blosc2_remove_urlpath(tdata.urlpath);
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  mu_assert("ERROR: bad set_zonemap", blosc2_schunk_set_zonemap(schunk, BLOSC2_ZONEMAP_FLOAT) == 0);
+
+  for (int i = 0; i < NCHUNKS; i++) {
+    fill_chunk(data, i);
+    int64_t nchunks_ = blosc2_schunk_append_buffer(schunk, data, isize);
+    mu_assert("ERROR: bad append", nchunks_ == i + 1);
+  }
+
+  // Chunk statistics
+  blosc2_zonemap_stats stats;
+  mu_assert("ERROR: no stats", blosc2_schunk_get_zonemap_stats(schunk, 3, &stats) == 0);
+  mu_assert("ERROR: bad min", stats.min == 3 * CHUNKSIZE);
+  mu_assert("ERROR: bad max", stats.max == 3 * CHUNKSIZE + CHUNKSIZE - 2);
+  mu_assert("ERROR: bad nnans", stats.nnans == CHUNKSIZE / 1000);
+  mu_assert("ERROR: bad nitems", stats.nitems == CHUNKSIZE);
+  double sum = 0;
+  fill_chunk(data, 3);
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    sum += isnan(data[j]) ? 0 : data[j];
+  }
+  mu_assert("ERROR: bad sum", stats.sum == sum);
+
+  // Chunk and block queries
+  int64_t expected[] = {2, 3};
+  msg = check_query(schunk, 2.5 * CHUNKSIZE, 3.1 * CHUNKSIZE, 2, expected);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  msg = check_query(schunk, -10., -1., 0, NULL);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  bool *maskout;
+  int32_t nblocks;
+  int ncandidates = blosc2_schunk_zonemap_query_blocks(schunk, 2, 2.5 * CHUNKSIZE, 2.5 * CHUNKSIZE + 1500,
+                                                       &maskout, &nblocks);
+  mu_assert("ERROR: bad number of blocks", nblocks == CHUNKSIZE * 8 / BLOCKSIZE);
+  mu_assert("ERROR: bad number of candidate blocks", ncandidates == 2);
+  mu_assert("ERROR: bad candidate blocks", !maskout[5] && !maskout[6] && maskout[4] && maskout[7]);
+  free(maskout);
+
+  // A chunk that comes already compressed has no statistics, so it is always a candidate
+  fill_chunk(data, 3);
+  uint8_t *chunk = malloc(isize + BLOSC2_MAX_OVERHEAD);
+  int csize = blosc2_compress(5, BLOSC_SHUFFLE, sizeof(double), data, isize, chunk, isize + BLOSC2_MAX_OVERHEAD);
+  mu_assert("ERROR: compression error", csize > 0);
+  mu_assert("ERROR: bad update", blosc2_schunk_update_chunk(schunk, 7, chunk, true) == NCHUNKS);
+  mu_assert("ERROR: stats for an unknown chunk", blosc2_schunk_get_zonemap_stats(schunk, 7, &stats) < 0);
+  int64_t *nchunks;
+  int64_t expected_update[] = {2, 3, 7};
+  msg = check_query(schunk, 2.5 * CHUNKSIZE, 3.1 * CHUNKSIZE, 3, expected_update);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  // ...but chunks recompressed from buffers get them again
+  mu_assert("ERROR: bad set_slice", blosc2_schunk_set_slice_buffer(schunk, 7 * CHUNKSIZE, 8 * CHUNKSIZE, data) == 0);
+  mu_assert("ERROR: no stats", blosc2_schunk_get_zonemap_stats(schunk, 7, &stats) == 0);
+  mu_assert("ERROR: bad min", stats.min == 3 * CHUNKSIZE);
+
+  // Entries follow the chunks around
+  mu_assert("ERROR: bad delete", blosc2_schunk_delete_chunk(schunk, 0) == NCHUNKS - 1);
+  mu_assert("ERROR: bad insert", blosc2_schunk_insert_chunk(schunk, 0, chunk, false) == NCHUNKS);
+  int64_t expected_move[] = {0, 2, 3, 7};
+  msg = check_query(schunk, 2.5 * CHUNKSIZE, 3.1 * CHUNKSIZE, 4, expected_move);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  if (tdata.urlpath != NULL) {
+    // The frame does not keep outdated statistics while they are not written (e.g. after a crash)...
+    blosc2_schunk *reader = blosc2_schunk_open(tdata.urlpath);
+    mu_assert("Cannot open the schunk", reader != NULL);
+    int64_t expected_all[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+    msg = check_query(reader, 2.5 * CHUNKSIZE, 3.1 * CHUNKSIZE, NCHUNKS, expected_all);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+    blosc2_schunk_free(reader);
+    // ...and a commit writes them
+    mu_assert("ERROR: bad commit", blosc2_schunk_commit(schunk) == 0);
+    reader = blosc2_schunk_open(tdata.urlpath);
+    mu_assert("Cannot open the schunk", reader != NULL);
+    msg = check_query(reader, 2.5 * CHUNKSIZE, 3.1 * CHUNKSIZE, 4, expected_move);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+    blosc2_schunk_free(reader);
+  }
+
+  // Serialized frames keep the statistics
+  uint8_t *cframe;
+  bool cframe_needs_free;
+  int64_t cframe_len = blosc2_schunk_to_buffer(schunk, &cframe, &cframe_needs_free);
+  mu_assert("ERROR: bad to_buffer", cframe_len > 0);
+  blosc2_schunk *schunk2 = blosc2_schunk_from_buffer(cframe, cframe_len, true);
+  mu_assert("ERROR: bad from_buffer", schunk2 != NULL);
+  msg = check_query(schunk2, 2.5 * CHUNKSIZE, 3.1 * CHUNKSIZE, 4, expected_move);
+  if (msg != EXIT_SUCCESS) {
+    return msg;
+  }
+  blosc2_schunk_free(schunk2);
+  if (cframe_needs_free) {
+    free(cframe);
+  }
+
+  mu_assert("ERROR: bad free", blosc2_schunk_free(schunk) == 0);
+  if (tdata.urlpath != NULL) {
+    schunk = blosc2_schunk_open(tdata.urlpath);
+    mu_assert("Cannot open the schunk", schunk != NULL);
+    msg = check_query(schunk, 2.5 * CHUNKSIZE, 3.1 * CHUNKSIZE, 4, expected_move);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+    // New chunks of a reopened super-chunk get statistics too
+    fill_chunk(data, 3);
+    mu_assert("ERROR: bad append", blosc2_schunk_append_buffer(schunk, data, isize) == NCHUNKS + 1);
+    int64_t expected_append[] = {0, 2, 3, 7, NCHUNKS};
+    msg = check_query(schunk, 2.5 * CHUNKSIZE, 3.1 * CHUNKSIZE, 5, expected_append);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tdata.urlpath);
+    mu_assert("Cannot open the schunk", schunk != NULL);
+    msg = check_query(schunk, 2.5 * CHUNKSIZE, 3.1 * CHUNKSIZE, 5, expected_append);
+    if (msg != EXIT_SUCCESS) {
+      return msg;
+    }
+
+    // Disabling the zone map removes the statistics from the frame
+    mu_assert("ERROR: bad set_zonemap", blosc2_schunk_set_zonemap(schunk, BLOSC2_ZONEMAP_NONE) == 0);
+    mu_assert("ERROR: zone map not disabled", blosc2_schunk_zonemap_query(schunk, 0, 1, &nchunks) < 0);
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tdata.urlpath);
+    mu_assert("Cannot open the schunk", schunk != NULL);
+    mu_assert("ERROR: zone map not removed", blosc2_schunk_zonemap_query(schunk, 0, 1, &nchunks) < 0);
+    blosc2_schunk_free(schunk);
+  }
+
+  /* Free resources */
+  blosc2_remove_urlpath(tdata.urlpath);
+  free(data);
+
+  return EXIT_SUCCESS;
+}
+
+static char* test_zonemap_int(void) {
+  int64_t data[CHUNKSIZE];
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int64_t);
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  mu_assert("ERROR: bad set_zonemap", blosc2_schunk_set_zonemap(schunk, BLOSC2_ZONEMAP_INT) == 0);
+
+  // Values that doubles cannot hold
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    data[j] = INT64_MAX - j;
+  }
+  mu_assert("ERROR: bad append", blosc2_schunk_append_buffer(schunk, data, sizeof(data)) == 1);
+  blosc2_zonemap_stats stats;
+  mu_assert("ERROR: no stats", blosc2_schunk_get_zonemap_stats(schunk, 0, &stats) == 0);
+  mu_assert("ERROR: bad min", stats.min <= (double) (INT64_MAX - CHUNKSIZE + 1));
+  mu_assert("ERROR: bad max", stats.max >= (double) INT64_MAX);
+  mu_assert("ERROR: bad nnans", stats.nnans == 0);
+  blosc2_schunk_free(schunk);
+
+  // Kinds that do not match the typesize are rejected
+  cparams.typesize = 3;
+  schunk = blosc2_schunk_new(&storage);
+  mu_assert("Cannot create the schunk", schunk != NULL);
+  mu_assert("ERROR: bad kind accepted", blosc2_schunk_set_zonemap(schunk, BLOSC2_ZONEMAP_FLOAT) ==
+                                        BLOSC2_ERROR_INVALID_PARAM);
+  int64_t *nchunks;
+  mu_assert("ERROR: unexpected zone map", blosc2_schunk_zonemap_query(schunk, 0, 1, &nchunks) < 0);
+  blosc2_schunk_free(schunk);
+
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+  for (int i = 0; i < (int) (sizeof(tndata) / sizeof(test_data)); ++i) {
+    tdata = tndata[i];
+    mu_run_test(test_zonemap);
+  }
+  mu_run_test(test_zonemap_int);
+
+  return EXIT_SUCCESS;
+}
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+
+  Test for the ZSTD chunk-window mode, where the blocks of a chunk
+  can reference the data in the previous ones.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+
+#define NITEMS (256 * 1024)
+#define PERIOD (32 * 1024)
+#define BLOCKSIZE (64 * 1024)
+#define NGETITEMS (1000)
+
+/* Global vars */
+int tests_run = 0;
+int32_t *data;
+int32_t *data_dest;
+uint8_t *chunk;
+uint8_t *chunk2;
+
+typedef struct {
+  int nthreads;
+  int filter;
+} test_params;
+
+test_params tparams[] = {
+    {1, BLOSC_NOSHUFFLE},
+    {4, BLOSC_NOSHUFFLE},
+    {4, BLOSC_SHUFFLE},
+};
+
+test_params tdata;
+
+
+static int compress(uint8_t meta, uint8_t *dest) {
+  int32_t isize = NITEMS * sizeof(int32_t);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.compcode = BLOSC_ZSTD;
+  cparams.compcode_meta = meta;
+  cparams.clevel = 5;
+  cparams.typesize = sizeof(int32_t);
+  cparams.nthreads = (int16_t) tdata.nthreads;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = (uint8_t) tdata.filter;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data, isize, dest, isize + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  return csize;
+}
+
+
+static char* test_zstd_chunk_window(void) {
+  int32_t isize = NITEMS * sizeof(int32_t);
+
+  int csize = compress(BLOSC2_ZSTD_CHUNK_WINDOW, chunk);
+  mu_assert("ERROR: compression failed", csize > 0);
+  int csize_blocks = compress(0, chunk2);
+  mu_assert("ERROR: compression failed", csize_blocks > 0);
+  // The period of the data is larger than the independent blocks can see
+  mu_assert("ERROR: chunk window does not improve the ratio", csize < csize_blocks);
+  // Only the chunks using the chunk window get the newer version
+  int version, versionlz;
+  blosc2_cbuffer_versions(chunk, &version, &versionlz);
+  mu_assert("ERROR: bad chunk window version", version == BLOSC2_VERSION_FORMAT_ZSTD_WINDOW);
+  blosc2_cbuffer_versions(chunk2, &version, &versionlz);
+  mu_assert("ERROR: bad chunk version", version == BLOSC2_VERSION_FORMAT);
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = (int16_t) tdata.nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, chunk, csize, data_dest, isize);
+  mu_assert("ERROR: decompression failed", dsize == isize);
+  for (int i = 0; i < NITEMS; i++) {
+    mu_assert("ERROR: bad roundtrip", data_dest[i] == data[i]);
+  }
+
+  // Items in a block that is not the first one
+  int start = NITEMS / 2 + 17;
+  dsize = blosc2_getitem_ctx(dctx, chunk, csize, start, NGETITEMS, data_dest, isize);
+  mu_assert("ERROR: getitem failed", dsize == NGETITEMS * (int) sizeof(int32_t));
+  for (int i = 0; i < NGETITEMS; i++) {
+    mu_assert("ERROR: bad getitem", data_dest[i] == data[start + i]);
+  }
+  blosc2_free_ctx(dctx);
+
+  return EXIT_SUCCESS;
+}
+
+
+static char *all_tests(void) {
+  for (int i = 0; i < (int) (sizeof(tparams) / sizeof(test_params)); ++i) {
+    tdata = tparams[i];
+    mu_run_test(test_zstd_chunk_window);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  data = malloc(NITEMS * sizeof(int32_t));
+  data_dest = malloc(NITEMS * sizeof(int32_t));
+  chunk = malloc(NITEMS * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  chunk2 = malloc(NITEMS * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  // Pseudo-random data repeating with a period larger than a block
+  uint32_t seed = 1;
+  for (int i = 0; i < PERIOD; i++) {
+    seed = seed * 1103515245u + 12345u;
+    data[i] = (int32_t) (seed >> 8);
+  }
+  for (int i = PERIOD; i < NITEMS; i++) {
+    data[i] = data[i % PERIOD];
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  free(data);
+  free(data_dest);
+  free(chunk);
+  free(chunk2);
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
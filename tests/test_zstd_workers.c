@@ -0,0 +1,149 @@
+/*
+  Copyright (C) 2021  The Blosc Developers <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+
+  Test for ZSTD compression of chunks having fewer blocks than threads,
+  where the spare threads are handed to ZSTD (BLOSC2_ZSTD_WORKERS).
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+
+#define NITEMS (1000 * 1000)
+#define NTHREADS (4)
+
+/* Global vars */
+int tests_run = 0;
+int32_t *data;
+int32_t *data_dest;
+uint8_t *chunk;
+uint8_t *chunk_serial;
+
+typedef struct {
+  int nblocks;
+  int nthreads;
+  bool workers;  // whether ZSTD workers are expected to be used
+} test_params;
+
+test_params tparams[] = {
+    {1, 1, false},
+    {1, NTHREADS, true},
+    {2, NTHREADS, true},
+    {NTHREADS, NTHREADS, false},
+};
+
+test_params tdata;
+
+
+static int compress(int nthreads, uint8_t compcode_meta, uint8_t *dest) {
+  int32_t isize = NITEMS * sizeof(int32_t);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.compcode = BLOSC_ZSTD;
+  cparams.compcode_meta = compcode_meta;
+  cparams.clevel = 5;
+  cparams.typesize = sizeof(int32_t);
+  cparams.nthreads = (int16_t) nthreads;
+  cparams.blocksize = isize / tdata.nblocks;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data, isize, dest, isize + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  return csize;
+}
+
+/* Whether the blocks of two chunks have the same streams (the blocks compressed in
+   parallel may be stored in any order) */
+static bool same_blocks(const uint8_t *chunk1, const uint8_t *chunk2) {
+  for (int i = 0; i < tdata.nblocks; i++) {
+    int32_t bstart1, bstart2, csize1, csize2;
+    memcpy(&bstart1, chunk1 + BLOSC_EXTENDED_HEADER_LENGTH + i * sizeof(int32_t), sizeof(int32_t));
+    memcpy(&bstart2, chunk2 + BLOSC_EXTENDED_HEADER_LENGTH + i * sizeof(int32_t), sizeof(int32_t));
+    memcpy(&csize1, chunk1 + bstart1, sizeof(int32_t));
+    memcpy(&csize2, chunk2 + bstart2, sizeof(int32_t));
+    if (csize1 != csize2 || memcmp(chunk1 + bstart1, chunk2 + bstart2, sizeof(int32_t) + csize1) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static char* test_zstd_workers(void) {
+  int32_t isize = NITEMS * sizeof(int32_t);
+
+  // Workers are opt-in: the spare threads are not handed to ZSTD by default
+  int csize_serial = compress(1, 0, chunk_serial);
+  mu_assert("ERROR: compression failed", csize_serial > 0);
+  int csize = compress(tdata.nthreads, 0, chunk);
+  mu_assert("ERROR: compression failed", csize > 0);
+  mu_assert("ERROR: workers used by default", same_blocks(chunk, chunk_serial));
+
+  // A single thread never uses workers, so its chunk is the reference
+  csize_serial = compress(1, BLOSC2_ZSTD_WORKERS, chunk_serial);
+  mu_assert("ERROR: compression failed", csize_serial > 0);
+  csize = compress(tdata.nthreads, BLOSC2_ZSTD_WORKERS, chunk);
+  mu_assert("ERROR: compression failed", csize > 0);
+  mu_assert("ERROR: data has not been compressed", csize < isize);
+  size_t nbytes, cbytes, blocksize;
+  blosc1_cbuffer_sizes(chunk, &nbytes, &cbytes, &blocksize);
+  mu_assert("ERROR: unexpected blocksize", blocksize == (size_t) isize / tdata.nblocks);
+  // The jobs of ZSTD workers overlap, so their output differs from the serial one
+  mu_assert("ERROR: ZSTD workers not used", same_blocks(chunk, chunk_serial) != tdata.workers);
+
+  // The chunk must be decompressible by a single thread
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, chunk, csize, data_dest, isize);
+  mu_assert("ERROR: decompression failed", dsize == isize);
+  for (int i = 0; i < NITEMS; i++) {
+    mu_assert("ERROR: bad roundtrip", data_dest[i] == data[i]);
+  }
+  blosc2_free_ctx(dctx);
+
+  return EXIT_SUCCESS;
+}
+
+
+static char *all_tests(void) {
+  for (int i = 0; i < (int) (sizeof(tparams) / sizeof(test_params)); ++i) {
+    tdata = tparams[i];
+    mu_run_test(test_zstd_workers);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  data = malloc(NITEMS * sizeof(int32_t));
+  data_dest = malloc(NITEMS * sizeof(int32_t));
+  chunk = malloc(NITEMS * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  chunk_serial = malloc(NITEMS * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  for (int i = 0; i < NITEMS; i++) {
+    data[i] = i * 3 + (i % 7) * (i % 13);
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  free(data);
+  free(data_dest);
+  free(chunk);
+  free(chunk_serial);
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}